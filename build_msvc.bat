@@ -27,6 +27,13 @@ cl /EHsc /DUNICODE /D_UNICODE /Iinclude /Isrc /I"%VCPKG_INC%" src\*.cpp lib\sqli
 if exist dict\en\en_US.aff copy /Y dict\en\en_US.aff build\dict >nul
 if exist dict\en\en_US.dic copy /Y dict\en\en_US.dic build\dict >nul
 
+:: Precompile the dictionary so startup maps it instead of loading Hunspell
+cl /EHsc /O2 /Isrc tools\dict_compiler.cpp src\dawg_dictionary.cpp /Febuild\dict_compiler.exe
+if exist build\dict\en_US.dic build\dict_compiler.exe build\dict\en_US.aff build\dict\en_US.dic build\dict\en_US.dawg
+
+:: Stand-in sync server for exercising sync without Google Drive
+cl /EHsc /O2 tools\sync_server.cpp /Febuild\sync_server.exe
+
 copy /Y "%VCPKG_ROOT%\installed\%VCPKG_TRIPLET%\bin\hunspell-1.7-0.dll" build >nul
 copy /Y "%VCPKG_ROOT%\installed\%VCPKG_TRIPLET%\bin\intl-8.dll" build >nul
 copy /Y "%VCPKG_ROOT%\installed\%VCPKG_TRIPLET%\bin\iconv-2.dll" build >nul
@@ -2,28 +2,27 @@
 
 #include "credentials.h"
 #include "database.h"
+#include "http_sync_backend.h"
+#include "http_transport.h"
+#include "local_sync_backend.h"
+#include "page_delta.h"
+#include "resumable_upload.h"
+#include "sync_ops.h"
 #include "utils.h"
 
 #include <windows.h>
-#include <winhttp.h>
 
 #include <cctype>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <string>
-#include <fstream>
+#include <map>
+#include <mutex>
 #include <vector>
 
-#pragma comment(lib, "winhttp.lib")
-
 namespace {
 
-struct HttpResponse {
-    DWORD status = 0;
-    std::string body;
-    std::string error;
-};
-
 static std::wstring Utf8ToWide(const std::string& s) {
     if (s.empty()) return L"";
     int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), nullptr, 0);
@@ -65,7 +64,37 @@ static bool ExtractJsonString(const std::string& json, const char* key, std::str
     return true;
 }
 
-static HttpResponse WinHttpRequestBytes(
+static bool ExtractJsonNumber(const std::string& json, const char* key, long long& outValue) {
+    std::string needle = std::string("\"") + key + "\"";
+    size_t p = json.find(needle);
+    if (p == std::string::npos) return false;
+    p = json.find(':', p + needle.size());
+    if (p == std::string::npos) return false;
+    char* end = nullptr;
+    outValue = std::strtoll(json.c_str() + p + 1, &end, 10);
+    return end != json.c_str() + p + 1;
+}
+
+// Access tokens last about an hour. The last one is kept and reused until shortly before it
+// expires, so a sync normally starts without a token request.
+static const ULONGLONG kAccessTokenMarginMs = 5 * 60 * 1000;
+
+struct CachedAccessToken {
+    std::string owner;   // Client id and refresh token it was issued for
+    std::string token;
+    ULONGLONG expiresAt = 0;   // GetTickCount64
+};
+
+static std::mutex g_accessTokenLock;
+static CachedAccessToken g_accessToken;
+
+// Drops the cached token, as after Google turned it down.
+static void ForgetAccessToken() {
+    std::lock_guard<std::mutex> hold(g_accessTokenLock);
+    g_accessToken = CachedAccessToken();
+}
+
+static HttpResult WinHttpRequestBytes(
     const wchar_t* method,
     const std::wstring& host,
     const std::wstring& path,
@@ -73,99 +102,15 @@ static HttpResponse WinHttpRequestBytes(
     const unsigned char* body,
     DWORD bodyLen) {
 
-    HttpResponse resp;
-
-    HINTERNET hSession = WinHttpOpen(L"NoteSoFast/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-        WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
-    if (!hSession) {
-        resp.error = "WinHttpOpen failed";
-        return resp;
-    }
-
-    // Keep UI responsive; don't hang forever.
-    WinHttpSetTimeouts(hSession, 10000, 10000, 15000, 15000);
-
-    HINTERNET hConnect = WinHttpConnect(hSession, host.c_str(), INTERNET_DEFAULT_HTTPS_PORT, 0);
-    if (!hConnect) {
-        resp.error = "WinHttpConnect failed";
-        WinHttpCloseHandle(hSession);
-        return resp;
-    }
-
-    HINTERNET hRequest = WinHttpOpenRequest(
-        hConnect,
-        method,
-        path.c_str(),
-        nullptr,
-        WINHTTP_NO_REFERER,
-        WINHTTP_DEFAULT_ACCEPT_TYPES,
-        WINHTTP_FLAG_SECURE);
-
-    if (!hRequest) {
-        resp.error = "WinHttpOpenRequest failed";
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return resp;
-    }
-
-    BOOL ok = WinHttpSendRequest(
-        hRequest,
-        headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headers.c_str(),
-        headers.empty() ? 0 : (DWORD)-1,
-        (LPVOID)body,
-        bodyLen,
-        bodyLen,
-        0);
-
-    if (!ok) {
-        resp.error = "WinHttpSendRequest failed";
-        WinHttpCloseHandle(hRequest);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return resp;
-    }
-
-    if (!WinHttpReceiveResponse(hRequest, nullptr)) {
-        resp.error = "WinHttpReceiveResponse failed";
-        WinHttpCloseHandle(hRequest);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return resp;
-    }
-
-    DWORD status = 0;
-    DWORD statusSize = sizeof(status);
-    WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX,
-        &status, &statusSize, WINHTTP_NO_HEADER_INDEX);
-    resp.status = status;
-
-    std::string response;
-    for (;;) {
-        DWORD avail = 0;
-        if (!WinHttpQueryDataAvailable(hRequest, &avail)) {
-            break;
-        }
-        if (avail == 0) {
-            break;
-        }
-        std::string chunk;
-        chunk.resize(avail);
-        DWORD read = 0;
-        if (!WinHttpReadData(hRequest, &chunk[0], avail, &read) || read == 0) {
-            break;
-        }
-        chunk.resize(read);
-        response += chunk;
+    WinHttpTransport transport(host);
+    HttpResult resp = transport.Send(Utils::WideToUtf8(method), Utils::WideToUtf8(path), Utils::WideToUtf8(headers), body, bodyLen);
+    if (resp.status == 401) {
+        ForgetAccessToken();
     }
-    resp.body = std::move(response);
-
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
     return resp;
 }
 
-static HttpResponse WinHttpPostForm(const std::wstring& host, const std::wstring& path, const std::string& bodyUtf8) {
+static HttpResult WinHttpPostForm(const std::wstring& host, const std::wstring& path, const std::string& bodyUtf8) {
     std::wstring headers = L"Content-Type: application/x-www-form-urlencoded\r\nAccept: application/json\r\n";
     return WinHttpRequestBytes(L"POST", host, path, headers,
         (const unsigned char*)(bodyUtf8.empty() ? nullptr : bodyUtf8.data()),
@@ -182,6 +127,15 @@ static bool RefreshAccessToken(
     outAccessToken.clear();
     outError.clear();
 
+    std::string owner = clientId + "\n" + refreshToken;
+    {
+        std::lock_guard<std::mutex> hold(g_accessTokenLock);
+        if (g_accessToken.owner == owner && GetTickCount64() < g_accessToken.expiresAt) {
+            outAccessToken = g_accessToken.token;
+            return true;
+        }
+    }
+
     std::string body;
     body += "client_id=" + UrlEncode(clientId);
     if (!clientSecret.empty()) {
@@ -190,7 +144,7 @@ static bool RefreshAccessToken(
     body += "&refresh_token=" + UrlEncode(refreshToken);
     body += "&grant_type=refresh_token";
 
-    HttpResponse resp = WinHttpPostForm(L"oauth2.googleapis.com", L"/token", body);
+    HttpResult resp = WinHttpPostForm(L"oauth2.googleapis.com", L"/token", body);
     if (resp.status != 200) {
         std::string err;
         std::string errDesc;
@@ -210,23 +164,140 @@ static bool RefreshAccessToken(
         return false;
     }
 
+    long long expiresIn = 0;
+    if (ExtractJsonNumber(resp.body, "expires_in", expiresIn) && expiresIn * 1000 > (long long)kAccessTokenMarginMs) {
+        std::lock_guard<std::mutex> hold(g_accessTokenLock);
+        g_accessToken.owner = owner;
+        g_accessToken.token = outAccessToken;
+        g_accessToken.expiresAt = GetTickCount64() + (ULONGLONG)expiresIn * 1000 - kAccessTokenMarginMs;
+    }
     return true;
 }
 
-static bool FindAppDataFile(const std::string& accessToken, const std::string& fileName, std::string& outId, std::string& outModifiedTime, std::string& outError) {
+static unsigned long long FileTimeToU64(const FILETIME& ft) {
+    ULARGE_INTEGER uli;
+    uli.LowPart = ft.dwLowDateTime;
+    uli.HighPart = ft.dwHighDateTime;
+    return uli.QuadPart;
+}
+
+static bool GetFileLastWriteTimeUtcU64(const std::wstring& path, unsigned long long& outFt) {
+    outFt = 0;
+    WIN32_FILE_ATTRIBUTE_DATA fad = {};
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad)) {
+        return false;
+    }
+    outFt = FileTimeToU64(fad.ftLastWriteTime);
+    return true;
+}
+
+static std::string FileNameFromPath(const std::wstring& path) {
+    size_t slash = path.find_last_of(L"\\/");
+    if (slash != std::wstring::npos && slash + 1 < path.size()) {
+        return Utils::WideToUtf8(path.substr(slash + 1));
+    }
+    return "notesofast.db";
+}
+
+static bool WriteAllBytes(const std::wstring& path, const std::vector<unsigned char>& bytes) {
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    DWORD written = 0;
+    BOOL ok = TRUE;
+    if (!bytes.empty()) {
+        ok = WriteFile(h, bytes.data(), (DWORD)bytes.size(), &written, nullptr);
+    }
+    CloseHandle(h);
+    return ok && written == (DWORD)bytes.size();
+}
+
+static bool ParseRfc3339ToFileTimeUtc(const std::string& s, unsigned long long& outFileTimeUtc) {
+    outFileTimeUtc = 0;
+
+    // Expected: YYYY-MM-DDTHH:MM:SS(.sss)Z
+    int Y = 0, M = 0, D = 0, h = 0, m = 0, sec = 0;
+    if (std::sscanf(s.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d", &Y, &M, &D, &h, &m, &sec) != 6) {
+        return false;
+    }
+
+    SYSTEMTIME st = {};
+    st.wYear = (WORD)Y;
+    st.wMonth = (WORD)M;
+    st.wDay = (WORD)D;
+    st.wHour = (WORD)h;
+    st.wMinute = (WORD)m;
+    st.wSecond = (WORD)sec;
+
+    FILETIME ft = {};
+    if (!SystemTimeToFileTime(&st, &ft)) {
+        return false;
+    }
+    outFileTimeUtc = FileTimeToU64(ft);
+    return true;
+}
+
+// "YYYY-MM-DDTHH:MM:SSZ" for FILETIME ticks, empty for 0.
+static std::string FormatFileTimeUtc(unsigned long long fileTimeUtc) {
+    FILETIME ft;
+    ft.dwLowDateTime = (DWORD)fileTimeUtc;
+    ft.dwHighDateTime = (DWORD)(fileTimeUtc >> 32);
+    SYSTEMTIME st = {};
+    if (fileTimeUtc == 0 || !FileTimeToSystemTime(&ft, &st)) {
+        return std::string();
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%04u-%02u-%02uT%02u:%02u:%02uZ",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+    return buf;
+}
+
+static const char kDriveFileFields[] = "id,name,modifiedTime,size,version";
+
+// A string literal for a Drive search query (q=), quoted and escaped.
+static std::string DriveQueryString(const std::string& s) {
+    std::string out = "'";
+    for (char c : s) {
+        if (c == '\\' || c == '\'') out.push_back('\\');
+        out.push_back(c);
+    }
+    return out + "'";
+}
+
+// One flat file object of a Drive response.
+static bool ParseDriveFile(const std::string& json, std::string& outId, SyncObjectInfo& outInfo) {
+    std::string modifiedTime;
+    std::string size;
+    if (!ExtractJsonString(json, "id", outId) || outId.empty()) {
+        return false;
+    }
+    ExtractJsonString(json, "name", outInfo.name);
+    ExtractJsonString(json, "version", outInfo.version);
+    ExtractJsonString(json, "size", size);
+    outInfo.size = std::strtoull(size.c_str(), nullptr, 10);
+    if (!ExtractJsonString(json, "modifiedTime", modifiedTime) ||
+        !ParseRfc3339ToFileTimeUtc(modifiedTime, outInfo.modifiedTime)) {
+        outInfo.modifiedTime = 0;
+    }
+    return true;
+}
+
+// outId stays empty (and the call succeeds) when there is no appDataFolder file fileName.
+static bool FindAppDataFile(const std::string& accessToken, const std::string& fileName, std::string& outId, SyncObjectInfo& outInfo, std::string& outError) {
     outId.clear();
-    outModifiedTime.clear();
+    outInfo = SyncObjectInfo();
     outError.clear();
 
     // q=name='notesofast.db'
-    std::string q = "name='" + fileName + "'";
-    std::string pathUtf8 = "/drive/v3/files?spaces=appDataFolder&fields=files(id,name,modifiedTime,size)&q=" + UrlEncode(q);
+    std::string q = "name=" + DriveQueryString(fileName);
+    std::string pathUtf8 = std::string("/drive/v3/files?spaces=appDataFolder&fields=files(") + kDriveFileFields + ")&q=" + UrlEncode(q);
 
     std::wstring headers = L"Accept: application/json\r\n";
     std::wstring auth = L"Authorization: Bearer " + Utf8ToWide(accessToken) + L"\r\n";
     headers += auth;
 
-    HttpResponse resp = WinHttpRequestBytes(L"GET", L"www.googleapis.com", Utf8ToWide(pathUtf8), headers, nullptr, 0);
+    HttpResult resp = WinHttpRequestBytes(L"GET", L"www.googleapis.com", Utf8ToWide(pathUtf8), headers, nullptr, 0);
     if (resp.status != 200) {
         std::string msg;
         ExtractJsonString(resp.body, "message", msg);
@@ -237,21 +308,21 @@ static bool FindAppDataFile(const std::string& accessToken, const std::string& f
         return false;
     }
 
-    // Very small parser: find first "id":"..." and "modifiedTime":"..." in the files array.
+    // Very small parser: the first flat object in the files array.
     size_t filesPos = resp.body.find("\"files\"");
-    if (filesPos == std::string::npos) {
+    size_t open = (filesPos == std::string::npos) ? filesPos : resp.body.find('{', filesPos);
+    size_t close = (open == std::string::npos) ? open : resp.body.find('}', open);
+    if (close == std::string::npos) {
         return true; // no files
     }
-    std::string id;
-    std::string mt;
-    ExtractJsonString(resp.body.substr(filesPos), "id", id);
-    ExtractJsonString(resp.body.substr(filesPos), "modifiedTime", mt);
-    outId = id;
-    outModifiedTime = mt;
+    if (!ParseDriveFile(resp.body.substr(open, close - open + 1), outId, outInfo)) {
+        outId.clear();
+        outInfo = SyncObjectInfo();
+    }
     return true;
 }
 
-static HttpResponse DriveUploadMultipart(
+static HttpResult DriveUploadMultipart(
     const wchar_t* method,
     const std::string& accessToken,
     const std::wstring& path,
@@ -293,77 +364,430 @@ static HttpResponse DriveUploadMultipart(
     return WinHttpRequestBytes(method, L"www.googleapis.com", path, headers, body.data(), (DWORD)body.size());
 }
 
-static unsigned long long FileTimeToU64(const FILETIME& ft) {
-    ULARGE_INTEGER uli;
-    uli.LowPart = ft.dwLowDateTime;
-    uli.HighPart = ft.dwHighDateTime;
-    return uli.QuadPart;
+static HttpResult DriveDownloadFile(const std::string& accessToken, const std::string& fileId) {
+    std::string pathUtf8 = "/drive/v3/files/" + fileId + "?alt=media";
+
+    std::wstring headers;
+    headers += L"Authorization: Bearer " + Utf8ToWide(accessToken) + L"\r\n";
+
+    return WinHttpRequestBytes(L"GET", L"www.googleapis.com", Utf8ToWide(pathUtf8), headers, nullptr, 0);
 }
 
-static bool GetFileLastWriteTimeUtcU64(const std::wstring& path, unsigned long long& outFt) {
-    outFt = 0;
-    WIN32_FILE_ATTRIBUTE_DATA fad = {};
-    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad)) {
+static HttpResult DriveDeleteFile(const std::string& accessToken, const std::string& fileId) {
+    std::string pathUtf8 = "/drive/v3/files/" + fileId;
+
+    std::wstring headers;
+    headers += L"Authorization: Bearer " + Utf8ToWide(accessToken) + L"\r\n";
+
+    return WinHttpRequestBytes(L"DELETE", L"www.googleapis.com", Utf8ToWide(pathUtf8), headers, nullptr, 0);
+}
+
+// Creates the appDataFolder file fileName (fileId empty) or replaces the content of fileId.
+static bool WriteAppDataFile(
+    const std::string& accessToken,
+    const std::string& fileId,
+    const std::string& fileName,
+    const std::vector<unsigned char>& content,
+    const std::string& mimeType,
+    std::string& outId,
+    SyncObjectInfo& outInfo,
+    std::string& outError) {
+
+    HttpResult resp;
+    if (fileId.empty()) {
+        resp = DriveUploadMultipart(L"POST", accessToken,
+            L"/upload/drive/v3/files?uploadType=multipart&fields=" + Utf8ToWide(kDriveFileFields),
+            fileName,
+            content,
+            mimeType,
+            true);
+    } else {
+        std::wstring path = L"/upload/drive/v3/files/" + Utf8ToWide(fileId) +
+            L"?uploadType=multipart&fields=" + Utf8ToWide(kDriveFileFields);
+        resp = DriveUploadMultipart(L"PATCH", accessToken, path, fileName, content, mimeType, false);
+    }
+
+    if (resp.status != 200 && resp.status != 201) {
+        std::string eDesc;
+        ExtractJsonString(resp.body, "message", eDesc);
+        outError = "Drive upload failed (HTTP " + std::to_string(resp.status) + ")";
+        if (!eDesc.empty()) outError += ": " + eDesc;
         return false;
     }
-    outFt = FileTimeToU64(fad.ftLastWriteTime);
+
+    std::string id;
+    outInfo = SyncObjectInfo();
+    ParseDriveFile(resp.body, id, outInfo);
+    outId = id.empty() ? fileId : id;
+    outInfo.name = fileName;
     return true;
 }
 
-static std::string FileNameFromPath(const std::wstring& path) {
-    size_t slash = path.find_last_of(L"\\/");
-    if (slash != std::wstring::npos && slash + 1 < path.size()) {
-        return Utils::WideToUtf8(path.substr(slash + 1));
+// WriteAppDataFile for content of any size: a resumable upload session takes it a chunk at a
+// time, so memory stays flat and a dropped connection costs one chunk, not the whole file.
+static bool StreamAppDataFile(
+    const std::string& accessToken,
+    const std::string& fileId,
+    const std::string& fileName,
+    SyncSource& content,
+    const std::string& mimeType,
+    const SyncProgress& progress,
+    std::string& outId,
+    SyncObjectInfo& outInfo,
+    std::string& outError) {
+
+    std::string auth = "Authorization: Bearer " + accessToken + "\r\n";
+    std::string meta = "{\"name\":\"" + fileName + "\"";
+    if (fileId.empty()) {
+        meta += ",\"parents\":[\"appDataFolder\"]";
     }
-    return "notesofast.db";
+    meta += "}";
+    std::string headers = "Content-Type: application/json; charset=UTF-8\r\n";
+    headers += "X-Upload-Content-Type: " + mimeType + "\r\n";
+    headers += "X-Upload-Content-Length: " + std::to_string(content.Size()) + "\r\n";
+    headers += auth;
+
+    // The session keeps the query of the request that started it, fields included.
+    WinHttpTransport transport(L"www.googleapis.com");
+    std::string query = std::string("?uploadType=resumable&fields=") + kDriveFileFields;
+    HttpResult resp = fileId.empty()
+        ? transport.Send("POST", "/upload/drive/v3/files" + query, headers, (const unsigned char*)meta.data(), meta.size())
+        : transport.Send("PATCH", "/upload/drive/v3/files/" + fileId + query, headers, (const unsigned char*)meta.data(), meta.size());
+    auto location = resp.headers.find("location");
+    if (resp.status == 200 && location != resp.headers.end()) {
+        resp = ResumableUpload::Send(transport, ResumableUpload::SessionPath(location->second), auth, content, progress);
+    }
+
+    if (resp.status != 200 && resp.status != 201) {
+        if (resp.status == 401) {
+            ForgetAccessToken();
+        }
+        if (resp.status == 0 || resp.status == 308) {
+            outError = "Drive upload failed: " + resp.error;
+            return false;
+        }
+        std::string eDesc;
+        ExtractJsonString(resp.body, "message", eDesc);
+        outError = "Drive upload failed (HTTP " + std::to_string(resp.status) + ")";
+        if (!eDesc.empty()) outError += ": " + eDesc;
+        return false;
+    }
+
+    std::string id;
+    outInfo = SyncObjectInfo();
+    ParseDriveFile(resp.body, id, outInfo);
+    outId = id.empty() ? fileId : id;
+    outInfo.name = fileName;
+    return true;
 }
 
-static bool WriteAllBytes(const std::wstring& path, const std::vector<unsigned char>& bytes) {
-    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+// A file read in place, for uploads that stream it rather than load it. Files open for writing
+// elsewhere can be read too, as the live database is by RemoteChangedSinceSync.
+class FileSyncSource : public SyncSource {
+public:
+    explicit FileSyncSource(const std::wstring& path) {
+        m_handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER size = {};
+        if (m_handle != INVALID_HANDLE_VALUE && GetFileSizeEx(m_handle, &size)) {
+            m_size = (unsigned long long)size.QuadPart;
+        }
+    }
+
+    ~FileSyncSource() {
+        if (m_handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_handle);
+        }
+    }
+
+    bool IsOpen() const { return m_handle != INVALID_HANDLE_VALUE; }
+
+    unsigned long long Size() const override { return m_size; }
+
+    bool Read(unsigned long long offset, unsigned char* buffer, size_t length) override {
+        while (length > 0) {
+            OVERLAPPED at = {};
+            at.Offset = (DWORD)offset;
+            at.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD chunk = length < (1u << 30) ? (DWORD)length : (1u << 30);
+            DWORD read = 0;
+            if (!ReadFile(m_handle, buffer, chunk, &read, &at) || read != chunk) {
+                return false;
+            }
+            offset += read;
+            buffer += read;
+            length -= read;
+        }
+        return true;
+    }
+
+private:
+    FileSyncSource(const FileSyncSource&) = delete;
+    FileSyncSource& operator=(const FileSyncSource&) = delete;
+
+    HANDLE m_handle;
+    unsigned long long m_size = 0;
+};
+
+// Creates the appDataFolder file fileName or replaces its content.
+static CloudSyncResult UploadAppDataFile(
+    const std::string& accessToken,
+    const std::string& fileName,
+    const std::vector<unsigned char>& content,
+    const std::string& mimeType) {
+
+    CloudSyncResult r;
+    std::string fileId;
+    SyncObjectInfo info;
+    if (!FindAppDataFile(accessToken, fileName, fileId, info, r.error) ||
+        !WriteAppDataFile(accessToken, fileId, fileName, content, mimeType, fileId, info, r.error)) {
+        return r;
+    }
+    r.remoteModifiedTime = FormatFileTimeUtc(info.modifiedTime);
+    r.success = true;
+    return r;
+}
+
+static bool ReadAllBytes(const std::wstring& path, std::vector<unsigned char>& bytes) {
+    bytes.clear();
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
     if (h == INVALID_HANDLE_VALUE) {
         return false;
     }
-    DWORD written = 0;
-    BOOL ok = TRUE;
-    if (!bytes.empty()) {
-        ok = WriteFile(h, bytes.data(), (DWORD)bytes.size(), &written, nullptr);
+    LARGE_INTEGER size = {};
+    BOOL ok = GetFileSizeEx(h, &size);
+    if (ok && size.QuadPart > 0) {
+        bytes.resize((size_t)size.QuadPart);
+        DWORD read = 0;
+        ok = ReadFile(h, bytes.data(), (DWORD)bytes.size(), &read, nullptr) && read == (DWORD)bytes.size();
     }
     CloseHandle(h);
-    return ok && written == (DWORD)bytes.size();
+    if (!ok) bytes.clear();
+    return ok != FALSE;
 }
 
-static bool ParseRfc3339ToFileTimeUtc(const std::string& s, unsigned long long& outFileTimeUtc) {
-    outFileTimeUtc = 0;
-
-    // Expected: YYYY-MM-DDTHH:MM:SS(.sss)Z
-    int Y = 0, M = 0, D = 0, h = 0, m = 0, sec = 0;
-    if (std::sscanf(s.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d", &Y, &M, &D, &h, &m, &sec) != 6) {
-        return false;
-    }
+// The appDataFolder files whose name starts with prefix, with their ids.
+static bool ListAppDataFiles(
+    const std::string& accessToken,
+    const std::string& prefix,
+    std::vector<std::pair<SyncObjectInfo, std::string>>& outFiles,
+    std::string& outError) {
 
-    SYSTEMTIME st = {};
-    st.wYear = (WORD)Y;
-    st.wMonth = (WORD)M;
-    st.wDay = (WORD)D;
-    st.wHour = (WORD)h;
-    st.wMinute = (WORD)m;
-    st.wSecond = (WORD)sec;
+    outFiles.clear();
+    std::wstring headers = L"Accept: application/json\r\n";
+    headers += L"Authorization: Bearer " + Utf8ToWide(accessToken) + L"\r\n";
 
-    FILETIME ft = {};
-    if (!SystemTimeToFileTime(&st, &ft)) {
-        return false;
+    // "contains" on names matches by prefix, so Drive sends only our files rather than the whole
+    // folder; it is looser than a string prefix, which is checked again below.
+    std::string q;
+    if (!prefix.empty()) {
+        q = "&q=" + UrlEncode("name contains " + DriveQueryString(prefix));
     }
-    outFileTimeUtc = FileTimeToU64(ft);
+    std::string pageToken;
+    do {
+        std::string pathUtf8 = std::string("/drive/v3/files?spaces=appDataFolder&pageSize=1000&fields=nextPageToken,files(") +
+            kDriveFileFields + ")" + q;
+        if (!pageToken.empty()) {
+            pathUtf8 += "&pageToken=" + UrlEncode(pageToken);
+        }
+        HttpResult resp = WinHttpRequestBytes(L"GET", L"www.googleapis.com", Utf8ToWide(pathUtf8), headers, nullptr, 0);
+        if (resp.status != 200) {
+            outError = "Drive list failed (HTTP " + std::to_string(resp.status) + ")";
+            return false;
+        }
+
+        // Each file is a flat object in the files array.
+        size_t pos = resp.body.find("\"files\"");
+        while (pos != std::string::npos) {
+            size_t open = resp.body.find('{', pos);
+            size_t close = (open == std::string::npos) ? open : resp.body.find('}', open);
+            if (close == std::string::npos) {
+                break;
+            }
+            std::string id;
+            SyncObjectInfo info;
+            if (ParseDriveFile(resp.body.substr(open, close - open + 1), id, info) &&
+                info.name.compare(0, prefix.size(), prefix) == 0) {
+                outFiles.emplace_back(info, id);
+            }
+            pos = close + 1;
+        }
+        ExtractJsonString(resp.body, "nextPageToken", pageToken);
+    } while (!pageToken.empty());
     return true;
 }
 
-static HttpResponse DriveDownloadFile(const std::string& accessToken, const std::string& fileId) {
-    std::string pathUtf8 = "/drive/v3/files/" + fileId + "?alt=media";
+// Sync objects in appDataFolder. Drive uploads take no precondition, so a conditional Put looks
+// the version up first; two machines writing within that window can both succeed.
+class DriveSyncBackend : public SyncBackend {
+public:
+    explicit DriveSyncBackend(const std::string& accessToken) : m_accessToken(accessToken) {}
+
+    SyncStatus Put(const std::string& name,
+                   const std::vector<unsigned char>& content,
+                   const std::string& ifVersion,
+                   SyncObjectInfo* outInfo,
+                   std::string& outError) override {
+        std::string id;
+        SyncStatus status = CheckVersion(name, ifVersion, id, outError);
+        if (status != SyncStatus::Ok) {
+            return status;
+        }
+        SyncObjectInfo written;
+        if (!WriteAppDataFile(m_accessToken, id, name, content, "application/octet-stream", id, written, outError)) {
+            return SyncStatus::Failed;
+        }
+        m_ids[name] = id;
+        if (outInfo) {
+            *outInfo = written;
+        }
+        return SyncStatus::Ok;
+    }
 
-    std::wstring headers;
-    headers += L"Authorization: Bearer " + Utf8ToWide(accessToken) + L"\r\n";
+    // Up to a chunk goes in one multipart request, anything larger through an upload session.
+    SyncStatus PutStream(const std::string& name,
+                         SyncSource& content,
+                         const std::string& ifVersion,
+                         SyncObjectInfo* outInfo,
+                         const SyncProgress& progress,
+                         std::string& outError) override {
+        if (content.Size() <= kSyncChunkSize) {
+            return SyncBackend::PutStream(name, content, ifVersion, outInfo, progress, outError);
+        }
+        std::string id;
+        SyncStatus status = CheckVersion(name, ifVersion, id, outError);
+        if (status != SyncStatus::Ok) {
+            return status;
+        }
+        SyncObjectInfo written;
+        if (!StreamAppDataFile(m_accessToken, id, name, content, "application/octet-stream", progress, id, written, outError)) {
+            return SyncStatus::Failed;
+        }
+        m_ids[name] = id;
+        if (outInfo) {
+            *outInfo = written;
+        }
+        return SyncStatus::Ok;
+    }
 
-    return WinHttpRequestBytes(L"GET", L"www.googleapis.com", Utf8ToWide(pathUtf8), headers, nullptr, 0);
+    SyncStatus Get(const std::string& name,
+                   std::vector<unsigned char>& outContent,
+                   SyncObjectInfo* outInfo,
+                   std::string& outError) override {
+        outContent.clear();
+        // Ids never change, so a listed object needs no lookup unless its details are wanted.
+        std::string id;
+        auto it = m_ids.find(name);
+        if (it != m_ids.end() && !outInfo) {
+            id = it->second;
+        } else {
+            SyncObjectInfo info;
+            SyncStatus status = Lookup(name, id, info, outError);
+            if (status != SyncStatus::Ok) {
+                return status;
+            }
+            if (outInfo) {
+                *outInfo = info;
+            }
+        }
+        HttpResult resp = DriveDownloadFile(m_accessToken, id);
+        if (resp.status == 404) {
+            return SyncStatus::NotFound;
+        }
+        if (resp.status != 200) {
+            outError = "Drive download of " + name + " failed (HTTP " + std::to_string(resp.status) + ")";
+            return SyncStatus::Failed;
+        }
+        outContent.assign(resp.body.begin(), resp.body.end());
+        return SyncStatus::Ok;
+    }
+
+    SyncStatus Stat(const std::string& name, SyncObjectInfo& outInfo, std::string& outError) override {
+        std::string id;
+        return Lookup(name, id, outInfo, outError);
+    }
+
+    SyncStatus List(const std::string& prefix, std::vector<SyncObjectInfo>& outObjects, std::string& outError) override {
+        std::vector<std::pair<SyncObjectInfo, std::string>> files;
+        if (!ListAppDataFiles(m_accessToken, prefix, files, outError)) {
+            return SyncStatus::Failed;
+        }
+        outObjects.clear();
+        for (const auto& file : files) {
+            outObjects.push_back(file.first);
+            m_ids[file.first.name] = file.second;
+        }
+        return SyncStatus::Ok;
+    }
+
+    SyncStatus Delete(const std::string& name, std::string& outError) override {
+        std::string id;
+        auto it = m_ids.find(name);
+        if (it != m_ids.end()) {
+            id = it->second;
+        } else {
+            SyncObjectInfo info;
+            SyncStatus status = Lookup(name, id, info, outError);
+            if (status != SyncStatus::Ok) {
+                return status;
+            }
+        }
+        HttpResult resp = DriveDeleteFile(m_accessToken, id);
+        m_ids.erase(name);
+        if (resp.status == 404) {
+            return SyncStatus::NotFound;
+        }
+        if (resp.status != 204 && resp.status != 200) {
+            outError = "Drive delete of " + name + " failed (HTTP " + std::to_string(resp.status) + ")";
+            return SyncStatus::Failed;
+        }
+        return SyncStatus::Ok;
+    }
+
+private:
+    // Finds the file to write (outId empty for a new one) and checks ifVersion against it.
+    SyncStatus CheckVersion(const std::string& name, const std::string& ifVersion, std::string& outId, std::string& outError) {
+        SyncObjectInfo current;
+        if (!FindAppDataFile(m_accessToken, name, outId, current, outError)) {
+            return SyncStatus::Failed;
+        }
+        if (!ifVersion.empty()) {
+            bool matches = (ifVersion == kSyncCreateOnly) ? outId.empty() : !outId.empty() && current.version == ifVersion;
+            if (!matches) {
+                return SyncStatus::Conflict;
+            }
+        }
+        return SyncStatus::Ok;
+    }
+
+    SyncStatus Lookup(const std::string& name, std::string& outId, SyncObjectInfo& outInfo, std::string& outError) {
+        if (!FindAppDataFile(m_accessToken, name, outId, outInfo, outError)) {
+            return SyncStatus::Failed;
+        }
+        if (outId.empty()) {
+            return SyncStatus::NotFound;
+        }
+        m_ids[name] = outId;
+        return SyncStatus::Ok;
+    }
+
+    std::string m_accessToken;
+    std::map<std::string, std::string> m_ids;
+};
+
+// The local record of the last upload, next to the database.
+static std::wstring SyncStatePath(const std::wstring& dbPath) {
+    return dbPath + L".syncstate";
+}
+
+// The copy of the database this machine last uploaded or restored: the base a restore merges
+// the remote copy and the file against.
+static std::wstring SyncBasePath(const std::wstring& dbPath) {
+    return dbPath + L".syncbase";
+}
+
+static std::string OpBatchPrefix(const std::string& fileName) {
+    return fileName + ".ops.";
 }
 
 } // namespace
@@ -390,53 +814,7 @@ CloudSyncResult CloudSync::UploadToAppDataFolder(
         return r;
     }
 
-    std::string fileId;
-    std::string modifiedTime;
-    if (!FindAppDataFile(accessToken, fileName, fileId, modifiedTime, err)) {
-        r.error = err;
-        return r;
-    }
-
-    if (fileId.empty()) {
-        HttpResponse resp = DriveUploadMultipart(L"POST", accessToken,
-            L"/upload/drive/v3/files?uploadType=multipart",
-            fileName,
-            content,
-            mimeType,
-            true);
-
-        if (resp.status != 200 && resp.status != 201) {
-            std::string e;
-            std::string eDesc;
-            ExtractJsonString(resp.body, "message", eDesc);
-            r.error = "Drive upload failed (HTTP " + std::to_string(resp.status) + ")";
-            if (!eDesc.empty()) r.error += ": " + eDesc;
-            return r;
-        }
-
-        std::string mt;
-        ExtractJsonString(resp.body, "modifiedTime", mt);
-        r.remoteModifiedTime = mt;
-        r.success = true;
-        return r;
-    }
-
-    std::wstring path = L"/upload/drive/v3/files/" + Utf8ToWide(fileId) + L"?uploadType=multipart";
-    HttpResponse resp = DriveUploadMultipart(L"PATCH", accessToken, path, fileName, content, mimeType, false);
-
-    if (resp.status != 200) {
-        std::string eDesc;
-        ExtractJsonString(resp.body, "message", eDesc);
-        r.error = "Drive upload failed (HTTP " + std::to_string(resp.status) + ")";
-        if (!eDesc.empty()) r.error += ": " + eDesc;
-        return r;
-    }
-
-    std::string mt;
-    ExtractJsonString(resp.body, "modifiedTime", mt);
-    r.remoteModifiedTime = mt;
-    r.success = true;
-    return r;
+    return UploadAppDataFile(accessToken, fileName, content, mimeType);
 }
 
 CloudSyncResult CloudSync::DownloadIfRemoteNewer(
@@ -458,8 +836,8 @@ CloudSyncResult CloudSync::DownloadIfRemoteNewer(
     }
 
     std::string fileId;
-    std::string modifiedTime;
-    if (!FindAppDataFile(accessToken, fileName, fileId, modifiedTime, err)) {
+    SyncObjectInfo info;
+    if (!FindAppDataFile(accessToken, fileName, fileId, info, err)) {
         r.error = err;
         return r;
     }
@@ -469,16 +847,14 @@ CloudSyncResult CloudSync::DownloadIfRemoteNewer(
         return r;
     }
 
-    unsigned long long remoteFt = 0;
-    if (!modifiedTime.empty() && ParseRfc3339ToFileTimeUtc(modifiedTime, remoteFt)) {
-        if (remoteFt <= localDbLastWriteFileTimeUtc) {
-            r.success = true;
-            r.remoteModifiedTime = modifiedTime;
-            return r;
-        }
+    std::string modifiedTime = FormatFileTimeUtc(info.modifiedTime);
+    if (info.modifiedTime != 0 && info.modifiedTime <= localDbLastWriteFileTimeUtc) {
+        r.success = true;
+        r.remoteModifiedTime = modifiedTime;
+        return r;
     }
 
-    HttpResponse resp = DriveDownloadFile(accessToken, fileId);
+    HttpResult resp = DriveDownloadFile(accessToken, fileId);
     if (resp.status != 200) {
         r.error = "Drive download failed (HTTP " + std::to_string(resp.status) + ")";
         return r;
@@ -490,27 +866,91 @@ CloudSyncResult CloudSync::DownloadIfRemoteNewer(
     return r;
 }
 
-CloudSyncResult CloudSync::UploadDatabaseSnapshot(Database* db, const std::wstring& dbPath, const std::string& clientId) {
-    CloudSyncResult r;
+bool CloudSync::UsesGoogleAccount(const std::string& backendSpec) {
+    return backendSpec.empty() || backendSpec == "drive";
+}
 
-    if (!db) {
-        r.error = "Missing database";
-        return r;
+bool CloudSync::OpenBackend(const std::string& backendSpec,
+                            const std::string& clientId,
+                            std::unique_ptr<SyncBackend>& outBackend,
+                            std::string& outError) {
+    outBackend.reset();
+
+    if (backendSpec.compare(0, 7, "folder:") == 0) {
+        if (backendSpec.size() == 7) {
+            outError = "Missing sync folder";
+            return false;
+        }
+        outBackend = std::make_unique<LocalSyncBackend>(Utils::Utf8ToWide(backendSpec.substr(7)));
+        return true;
+    }
+
+    bool secure = backendSpec.compare(0, 8, "https://") == 0;
+    if (secure || backendSpec.compare(0, 7, "http://") == 0) {
+        // scheme://host[:port][/base]
+        std::string rest = backendSpec.substr(secure ? 8 : 7);
+        size_t slash = rest.find('/');
+        std::string hostPort = rest.substr(0, slash);
+        std::string basePath = (slash == std::string::npos) ? std::string() : rest.substr(slash);
+        size_t colon = hostPort.find(':');
+        unsigned long port = 0;
+        if (colon != std::string::npos) {
+            port = std::strtoul(hostPort.c_str() + colon + 1, nullptr, 10);
+            hostPort.resize(colon);
+        }
+        if (hostPort.empty() || port > 65535) {
+            outError = "Invalid sync server address: " + backendSpec;
+            return false;
+        }
+        outBackend = std::make_unique<HttpSyncBackend>(
+            std::make_unique<WinHttpTransport>(Utils::Utf8ToWide(hostPort), (unsigned short)port, secure), basePath);
+        return true;
+    }
+
+    if (!UsesGoogleAccount(backendSpec)) {
+        outError = "Unknown sync backend: " + backendSpec;
+        return false;
     }
     if (clientId.empty()) {
-        r.error = "Missing OAuth Client ID";
-        return r;
+        outError = "Missing OAuth Client ID";
+        return false;
     }
 
     std::string refreshToken;
     if (!Credentials::ReadUtf8String(CloudSync::kCloudRefreshTokenCredTarget, refreshToken) || refreshToken.empty()) {
-        r.error = "Not connected (missing refresh token)";
-        return r;
+        outError = "Not connected (missing refresh token)";
+        return false;
     }
 
     std::string clientSecret;
     Credentials::ReadUtf8String(CloudSync::kCloudClientSecretCredTarget, clientSecret);
 
+    std::string accessToken;
+    if (!RefreshAccessToken(clientId, clientSecret, refreshToken, accessToken, outError)) {
+        return false;
+    }
+    outBackend = std::make_unique<DriveSyncBackend>(accessToken);
+    return true;
+}
+
+CloudSyncResult CloudSync::UploadDatabaseSnapshot(Database* db,
+                                                  const std::wstring& dbPath,
+                                                  const std::string& clientId,
+                                                  const SyncProgress& progress,
+                                                  const std::atomic<bool>* cancel,
+                                                  const Database::BackupProgress& snapshotProgress) {
+    CloudSyncResult r;
+
+    if (!db) {
+        r.error = "Missing database";
+        return r;
+    }
+
+    std::unique_ptr<SyncBackend> backend;
+    if (!OpenBackend(db->GetSetting(kCloudBackendSetting, ""), clientId, backend, r.error)) {
+        return r;
+    }
+
     wchar_t tmpPath[MAX_PATH];
     GetTempPathW(MAX_PATH, tmpPath);
     wchar_t snapName[128];
@@ -518,78 +958,233 @@ CloudSyncResult CloudSync::UploadDatabaseSnapshot(Database* db, const std::wstri
     std::wstring snapPath = std::wstring(tmpPath) + snapName;
     std::string snapPathUtf8 = Utils::WideToUtf8(snapPath);
 
-    if (!db->BackupToFile(snapPathUtf8)) {
-        r.error = "Failed to create DB snapshot";
+    if (!db->BackupToFile(snapPathUtf8, cancel, snapshotProgress)) {
+        DeleteFileW(snapPath.c_str());
+        r.error = (cancel && cancel->load()) ? "Sync cancelled" : "Failed to create DB snapshot";
         return r;
     }
 
-    std::ifstream in(snapPathUtf8, std::ios::binary);
-    if (!in) {
-        r.error = "Failed to read DB snapshot";
+    std::wstring statePath = SyncStatePath(dbPath);
+    PageDelta::SyncState state;
+    std::vector<unsigned char> stateBytes;
+    if (ReadAllBytes(statePath, stateBytes)) {
+        PageDelta::ParseState(stateBytes, state);
+    }
+
+    // Read in place while it uploads: memory stays a chunk, however large the database.
+    PageDelta::PushResult pushed;
+    SyncStatus status = SyncStatus::Failed;
+    const uint64_t lastFingerprint = state.fingerprint;
+    bool unchanged = false;
+    {
+        FileSyncSource snapshot(snapPath);
+        uint64_t fingerprint = 0;
+        if (!snapshot.IsOpen()) {
+            r.error = "Failed to read DB snapshot";
+        } else if (lastFingerprint != 0 && PageDelta::Fingerprint(snapshot, fingerprint) &&
+                   fingerprint == lastFingerprint) {
+            // Same content as last uploaded or restored: nothing to send, not even a manifest check.
+            unchanged = true;
+        } else {
+            status = PageDelta::Push(*backend, FileNameFromPath(dbPath), snapshot, state, pushed, progress, r.error);
+        }
+    }
+    // Pushed or already there: the remote copy now has this content.
+    bool synced = unchanged || status == SyncStatus::Ok;
+    if (!synced || !MoveFileExW(snapPath.c_str(), SyncBasePath(dbPath).c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(snapPath.c_str());
+    }
+    if (unchanged) {
+        r.success = true;
+        return r;
+    }
+    if (status == SyncStatus::Conflict) {
+        // The next upload starts a new base.
+        DeleteFileW(statePath.c_str());
+    }
+    if (status != SyncStatus::Ok) {
         return r;
     }
-    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-    in.close();
 
-    std::string fileName = FileNameFromPath(dbPath);
-    return CloudSync::UploadToAppDataFolder(clientId, clientSecret, refreshToken, fileName, bytes, "application/x-sqlite3");
+    // Best effort: without it the next upload is a full base again.
+    if (pushed.kind != PageDelta::UploadPlan::Unchanged || state.fingerprint != lastFingerprint) {
+        PageDelta::SerializeState(state, stateBytes);
+        WriteAllBytes(statePath, stateBytes);
+    }
+    r.remoteModifiedTime = FormatFileTimeUtc(pushed.manifest.modifiedTime);
+    r.success = true;
+    return r;
 }
 
-CloudSyncResult CloudSync::RestoreDatabaseIfRemoteNewer(const std::wstring& dbPath, const std::string& clientId, bool& outRestored) {
-    outRestored = false;
-    CloudSyncResult r;
-
-    if (clientId.empty()) {
-        r.error = "Missing OAuth Client ID";
-        return r;
+// Whether the remote copy, whose manifest gives remoteFingerprint, should be merged into the file
+// at dbPath. Fingerprints only move with the content, unlike file times, which every local write
+// and every machine's clock move. It is merged when it differs from the file and from what this
+// machine last uploaded or restored. False when either fingerprint is unknown.
+static bool RemoteChangedSinceSync(const std::wstring& dbPath, uint64_t remoteFingerprint, bool& outNewer) {
+    PageDelta::SyncState last;
+    std::vector<unsigned char> stateBytes;
+    if (remoteFingerprint == 0 || !ReadAllBytes(SyncStatePath(dbPath), stateBytes) ||
+        !PageDelta::ParseState(stateBytes, last) || last.fingerprint == 0) {
+        return false;
+    }
+    outNewer = false;
+    if (remoteFingerprint == last.fingerprint) {
+        return true;
+    }
+    uint64_t localFingerprint = 0;
+    {
+        FileSyncSource local(dbPath);
+        if (!local.IsOpen() || !PageDelta::Fingerprint(local, localFingerprint)) {
+            return false;
+        }
     }
+    outNewer = remoteFingerprint != localFingerprint;
+    return true;
+}
 
-    std::string refreshToken;
-    if (!Credentials::ReadUtf8String(CloudSync::kCloudRefreshTokenCredTarget, refreshToken) || refreshToken.empty()) {
-        r.error = "Not connected (missing refresh token)";
-        return r;
+// Merges the downloaded copy at downloadPath into the database at dbPath against the last synced
+// base (see Database::MergeFrom).
+static bool MergeDownloaded(const std::wstring& dbPath, const std::wstring& downloadPath, std::string& outError) {
+    // Opening the download brings its schema and journal up to this version's, whoever wrote it.
+    {
+        Database other;
+        if (!other.Initialize(Utils::WideToUtf8(downloadPath))) {
+            outError = "Failed to open downloaded database";
+            return false;
+        }
     }
+    std::wstring basePath = SyncBasePath(dbPath);
+    bool hasBase = GetFileAttributesW(basePath.c_str()) != INVALID_FILE_ATTRIBUTES;
+    Database db;
+    Database::MergeStats stats;
+    if (!db.Initialize(Utils::WideToUtf8(dbPath)) ||
+        !db.MergeFrom(Utils::WideToUtf8(downloadPath), hasBase ? Utils::WideToUtf8(basePath) : std::string(), stats)) {
+        outError = "Failed to merge downloaded database";
+        return false;
+    }
+    return true;
+}
 
-    std::string clientSecret;
-    Credentials::ReadUtf8String(CloudSync::kCloudClientSecretCredTarget, clientSecret);
+CloudSyncResult CloudSync::RestoreDatabaseIfRemoteNewer(const std::wstring& dbPath,
+                                                        const std::string& backendSpec,
+                                                        const std::string& clientId,
+                                                        bool& outRestored) {
+    outRestored = false;
+    CloudSyncResult r;
 
     unsigned long long localFt = 0;
     GetFileLastWriteTimeUtcU64(dbPath, localFt); // if missing, stays 0
 
-    std::vector<unsigned char> content;
-    std::string fileName = FileNameFromPath(dbPath);
-    r = CloudSync::DownloadIfRemoteNewer(clientId, clientSecret, refreshToken, fileName, localFt, content);
-    if (!r.success) {
+    std::unique_ptr<SyncBackend> backend;
+    if (!OpenBackend(backendSpec, clientId, backend, r.error)) {
         return r;
     }
 
-    if (content.empty()) {
-        // No remote file, or remote not newer.
+    std::string fileName = FileNameFromPath(dbPath);
+    SyncObjectInfo manifestInfo;
+    std::vector<unsigned char> manifestBytes;
+    SyncStatus status = backend->Get(PageDelta::ManifestName(fileName), manifestBytes, &manifestInfo, r.error);
+    if (status == SyncStatus::Failed) {
         return r;
     }
 
-    // Write to a temp file in the same directory, then replace.
+    std::vector<unsigned char> content;
+    std::vector<unsigned char> stateBytes;
+    if (status == SyncStatus::NotFound) {
+        // Uploaded before delta sync: the remote file is the whole database.
+        SyncObjectInfo baseInfo;
+        status = backend->Stat(fileName, baseInfo, r.error);
+        if (status == SyncStatus::Failed) {
+            return r;
+        }
+        if (status == SyncStatus::NotFound || (baseInfo.modifiedTime != 0 && baseInfo.modifiedTime <= localFt)) {
+            // No remote file, or remote not newer.
+            r.remoteModifiedTime = FormatFileTimeUtc(baseInfo.modifiedTime);
+            r.success = true;
+            return r;
+        }
+        if (backend->Get(fileName, content, nullptr, r.error) != SyncStatus::Ok || content.empty()) {
+            if (r.error.empty()) r.error = "Remote database is missing";
+            return r;
+        }
+        r.remoteModifiedTime = FormatFileTimeUtc(baseInfo.modifiedTime);
+    } else {
+        r.remoteModifiedTime = FormatFileTimeUtc(manifestInfo.modifiedTime);
+        PageDelta::Manifest remote;
+        PageDelta::ParseManifest(std::string(manifestBytes.begin(), manifestBytes.end()), remote);
+        bool newer;
+        if (!RemoteChangedSinceSync(dbPath, remote.fingerprint, newer)) {
+            // No fingerprints to go by (first sync here, or an older version uploaded). The
+            // manifest is written last by every upload, so its time is the time of the remote copy.
+            newer = manifestInfo.modifiedTime == 0 || manifestInfo.modifiedTime > localFt;
+        }
+        if (!newer) {
+            r.success = true;
+            return r;
+        }
+
+        PageDelta::SyncState state;
+        status = PageDelta::Pull(*backend, fileName, content, state, manifestInfo, r.error);
+        if (status != SyncStatus::Ok) {
+            if (status == SyncStatus::NotFound) r.error = "Remote sync manifest disappeared";
+            return r;
+        }
+        if (!state.baseId.empty()) {
+            PageDelta::SerializeState(state, stateBytes);
+        }
+        r.remoteModifiedTime = FormatFileTimeUtc(manifestInfo.modifiedTime);
+    }
+    r.error.clear();
+    // Write to a temp file in the same directory and merge it in: edits made here since the last
+    // sync stay, where replacing the file would drop them.
     std::wstring tmp = dbPath + L".cloud.tmp";
     if (!WriteAllBytes(tmp, content)) {
-        r.success = false;
         r.error = "Failed to write downloaded database";
         return r;
     }
-
-    // Best-effort backup of the current DB.
-    std::wstring bak = dbPath + L".bak";
-    MoveFileExW(dbPath.c_str(), bak.c_str(), MOVEFILE_REPLACE_EXISTING);
-
-    if (!MoveFileExW(tmp.c_str(), dbPath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
-        // Try to restore original if replace failed.
-        MoveFileExW(bak.c_str(), dbPath.c_str(), MOVEFILE_REPLACE_EXISTING);
+    if (!MergeDownloaded(dbPath, tmp, r.error)) {
         DeleteFileW(tmp.c_str());
-        r.success = false;
-        r.error = "Failed to replace local database";
         return r;
     }
 
+    // Both sides now descend from the download: it is the base of the next merge, and the next
+    // upload diffs against it (or starts a new base after a legacy restore).
+    if (!MoveFileExW(tmp.c_str(), SyncBasePath(dbPath).c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(tmp.c_str());
+    }
+    if (stateBytes.empty()) {
+        DeleteFileW(SyncStatePath(dbPath).c_str());
+    } else {
+        WriteAllBytes(SyncStatePath(dbPath), stateBytes);
+    }
+
     outRestored = true;
     r.success = true;
     return r;
 }
+
+CloudSyncResult CloudSync::ExchangeChanges(const std::wstring& dbPath, const std::string& clientId, int& outApplied) {
+    outApplied = 0;
+    CloudSyncResult r;
+
+    // A connection of its own: applying remote changes is one write transaction, which must not
+    // swallow the UI's statements on the shared connection.
+    Database db;
+    if (!db.Initialize(Utils::WideToUtf8(dbPath))) {
+        r.error = "Failed to open database for sync";
+        return r;
+    }
+
+    std::unique_ptr<SyncBackend> backend;
+    if (!OpenBackend(db.GetSetting(kCloudBackendSetting, ""), clientId, backend, r.error)) {
+        return r;
+    }
+
+    OpSyncStats stats;
+    if (!OpSync::Exchange(db, *backend, OpBatchPrefix(FileNameFromPath(dbPath)), stats, r.error)) {
+        return r;
+    }
+    outApplied = stats.opsApplied;
+    r.success = true;
+    return r;
+}
@@ -1,10 +1,13 @@
 #pragma once
 
+#include "database.h"
+#include "sync_backend.h"
+
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
-class Database;
-
 struct CloudSyncResult {
     bool success = false;
     std::string error;
@@ -17,6 +20,20 @@ namespace CloudSync {
 static const wchar_t kCloudRefreshTokenCredTarget[] = L"NoteSoFast.GoogleDrive.RefreshToken";
 static const wchar_t kCloudClientSecretCredTarget[] = L"NoteSoFast.GoogleDrive.ClientSecret";
 
+// Where synced objects live: empty or "drive" for Google Drive appDataFolder, "folder:<path>" for
+// a directory, "http://host[:port][/base]" (or https) for an object server like tools/sync_server.
+static const char kCloudBackendSetting[] = "cloud_sync_backend";
+
+// Whether the backend needs the OAuth client id and a refresh token.
+bool UsesGoogleAccount(const std::string& backendSpec);
+
+// Connects to the backend named by backendSpec. For Drive this reads the credentials from
+// Windows Credential Manager and refreshes the access token.
+bool OpenBackend(const std::string& backendSpec,
+                 const std::string& clientId,
+                 std::unique_ptr<SyncBackend>& outBackend,
+                 std::string& outError);
+
 // Uploads the given bytes as a file named fileName into Google Drive appDataFolder.
 // Creates the file if it doesn't exist; otherwise updates it.
 CloudSyncResult UploadToAppDataFolder(
@@ -37,13 +54,30 @@ CloudSyncResult DownloadIfRemoteNewer(
     unsigned long long localDbLastWriteFileTimeUtc,
     std::vector<unsigned char>& outContent);
 
-// Uploads a consistent snapshot of the current database to Drive appDataFolder.
-// Reads refresh token + client secret from Windows Credential Manager.
-CloudSyncResult UploadDatabaseSnapshot(Database* db, const std::wstring& dbPath, const std::string& clientId);
+// Uploads a consistent snapshot of the current database to the backend set in the database
+// (only the pages changed since the last upload, see page_delta.h). The snapshot is copied to a
+// temporary file a few pages at a time (snapshotProgress reports it; cancel stops it) and then
+// streamed from there, with progress called as it goes out. Both callbacks may be empty and are
+// called from this thread.
+CloudSyncResult UploadDatabaseSnapshot(Database* db,
+                                       const std::wstring& dbPath,
+                                       const std::string& clientId,
+                                       const SyncProgress& progress = SyncProgress(),
+                                       const std::atomic<bool>* cancel = nullptr,
+                                       const Database::BackupProgress& snapshotProgress = Database::BackupProgress());
+
+// Merges the remote copy into the local database if it changed since this machine last synced:
+// rows changed only remotely are taken, and a note edited on both sides gets a conflict copy
+// (see Database::MergeFrom). Only the small manifest is fetched unless it did. Safe with the
+// database open elsewhere: the merge runs on a connection of its own in one transaction, so call
+// it off the UI thread. outRestored is set to true only when a merge ran.
+CloudSyncResult RestoreDatabaseIfRemoteNewer(const std::wstring& dbPath,
+                                             const std::string& backendSpec,
+                                             const std::string& clientId,
+                                             bool& outRestored);
 
-// Restores the local database file from Drive appDataFolder if the remote copy is newer.
-// Reads refresh token + client secret from Windows Credential Manager.
-// outRestored is set to true only when the local file was replaced.
-CloudSyncResult RestoreDatabaseIfRemoteNewer(const std::wstring& dbPath, const std::string& clientId, bool& outRestored);
+// Exchanges row-level changes with the other machines (see sync_ops.h): applies theirs to the
+// database at dbPath and pushes the local ones. outApplied counts the local rows changed.
+CloudSyncResult ExchangeChanges(const std::wstring& dbPath, const std::string& clientId, int& outApplied);
 
 } // namespace CloudSync
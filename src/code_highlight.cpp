@@ -0,0 +1,485 @@
+#include "code_highlight.h"
+#include <cwchar>
+
+namespace CodeHighlight {
+
+namespace {
+
+enum CharClass : unsigned char {
+    CC_OTHER = 0,
+    CC_SPACE = 1,
+    CC_DIGIT = 2,
+    CC_IDENT = 4
+};
+
+struct CharTable {
+    unsigned char cls[128];
+
+    constexpr CharTable() : cls() {
+        for (int i = 0; i < 128; ++i) {
+            unsigned char v = CC_OTHER;
+            if (i == ' ' || i == '\t' || i == '\r' || i == '\n' || i == '\f' || i == '\v') {
+                v = CC_SPACE;
+            } else if (i >= '0' && i <= '9') {
+                v = CC_DIGIT;
+            } else if ((i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') || i == '_') {
+                v = CC_IDENT;
+            }
+            cls[i] = v;
+        }
+    }
+};
+
+constexpr CharTable kChars;
+
+inline unsigned char ClassOf(wchar_t ch) {
+    // Treat everything outside ASCII as identifier text; good enough for coloring.
+    return ((unsigned)ch < 128) ? kChars.cls[ch] : (unsigned char)CC_IDENT;
+}
+
+// Keyword tables must stay sorted (plain code point order) for the binary search.
+const wchar_t* const kCppKeywords[] = {
+    L"alignas", L"alignof", L"asm", L"auto", L"bool", L"break", L"case", L"catch", L"char",
+    L"char16_t", L"char32_t", L"char8_t", L"class", L"co_await", L"co_return", L"co_yield",
+    L"const", L"const_cast", L"consteval", L"constexpr", L"constinit", L"continue", L"decltype",
+    L"default", L"delete", L"do", L"double", L"dynamic_cast", L"else", L"enum", L"explicit",
+    L"export", L"extern", L"false", L"final", L"float", L"for", L"friend", L"goto", L"if",
+    L"inline", L"int", L"long", L"mutable", L"namespace", L"new", L"noexcept", L"nullptr",
+    L"operator", L"override", L"private", L"protected", L"public", L"register",
+    L"reinterpret_cast", L"return", L"short", L"signed", L"size_t", L"sizeof", L"static",
+    L"static_assert", L"static_cast", L"struct", L"switch", L"template", L"this", L"thread_local",
+    L"throw", L"true", L"try", L"typedef", L"typeid", L"typename", L"union", L"unsigned", L"using",
+    L"virtual", L"void", L"volatile", L"wchar_t", L"while"
+};
+
+const wchar_t* const kPythonKeywords[] = {
+    L"False", L"None", L"True", L"and", L"as", L"assert", L"async", L"await", L"break", L"class",
+    L"continue", L"def", L"del", L"elif", L"else", L"except", L"finally", L"for", L"from",
+    L"global", L"if", L"import", L"in", L"is", L"lambda", L"nonlocal", L"not", L"or", L"pass",
+    L"raise", L"return", L"self", L"try", L"while", L"with", L"yield"
+};
+
+const wchar_t* const kJavaScriptKeywords[] = {
+    L"as", L"async", L"await", L"break", L"case", L"catch", L"class", L"const", L"continue",
+    L"debugger", L"default", L"delete", L"do", L"else", L"enum", L"export", L"extends", L"false",
+    L"finally", L"for", L"from", L"function", L"if", L"implements", L"import", L"in",
+    L"instanceof", L"interface", L"let", L"new", L"null", L"of", L"return", L"static", L"super",
+    L"switch", L"this", L"throw", L"true", L"try", L"type", L"typeof", L"undefined", L"var",
+    L"void", L"while", L"with", L"yield"
+};
+
+// Lowercase; SQL keywords match case-insensitively.
+const wchar_t* const kSqlKeywords[] = {
+    L"add", L"all", L"alter", L"and", L"as", L"asc", L"autoincrement", L"begin", L"between",
+    L"blob", L"by", L"case", L"cast", L"check", L"collate", L"commit", L"constraint", L"create",
+    L"cross", L"default", L"delete", L"desc", L"distinct", L"drop", L"else", L"end", L"exists",
+    L"foreign", L"from", L"full", L"glob", L"group", L"having", L"if", L"in", L"index", L"inner",
+    L"insert", L"integer", L"intersect", L"into", L"is", L"join", L"key", L"left", L"like",
+    L"limit", L"not", L"null", L"offset", L"on", L"or", L"order", L"outer", L"pragma", L"primary",
+    L"real", L"references", L"replace", L"returning", L"right", L"rollback", L"select", L"set",
+    L"table", L"temp", L"text", L"then", L"transaction", L"trigger", L"union", L"unique",
+    L"update", L"using", L"values", L"view", L"when", L"where", L"with", L"without"
+};
+
+const wchar_t* const kShellKeywords[] = {
+    L"break", L"case", L"cd", L"continue", L"do", L"done", L"echo", L"elif", L"else", L"esac",
+    L"eval", L"exec", L"exit", L"export", L"fi", L"for", L"function", L"if", L"in", L"local",
+    L"read", L"readonly", L"return", L"select", L"set", L"shift", L"source", L"test", L"then",
+    L"trap", L"unset", L"until", L"while"
+};
+
+const wchar_t* const kJsonKeywords[] = {
+    L"false", L"null", L"true"
+};
+
+struct LanguageSpec {
+    const wchar_t* const* keywords;
+    size_t keywordCount;
+    bool keywordsIgnoreCase;
+    const wchar_t* lineComment;       // nullptr when unsupported
+    const wchar_t* blockCommentOpen;  // nullptr when unsupported
+    const wchar_t* blockCommentClose;
+    const wchar_t* quotes;            // characters that open a string
+    bool tripleQuotes;                // Python """...""" and '''...'''
+    bool backslashEscapes;
+    bool multilineStrings;            // strings may span lines (backtick strings always do)
+    bool commentNeedsWordStart;       // shell: '#' only starts a comment at the start of a word
+    bool preprocessorLines;           // C/C++ '#' directives
+    bool dollarVariables;             // shell $VAR, ${VAR}, $1
+    bool objectKeys;                  // JSON: a string followed by ':' is a key
+};
+
+#define KEYWORDS(table) table, sizeof(table) / sizeof(table[0])
+
+const LanguageSpec kCppSpec = {
+    KEYWORDS(kCppKeywords), false, L"//", L"/*", L"*/", L"\"'", false, true, false, false, true, false, false
+};
+const LanguageSpec kPythonSpec = {
+    KEYWORDS(kPythonKeywords), false, L"#", nullptr, nullptr, L"\"'", true, true, false, false, false, false, false
+};
+const LanguageSpec kJavaScriptSpec = {
+    KEYWORDS(kJavaScriptKeywords), false, L"//", L"/*", L"*/", L"\"'`", false, true, false, false, false, false, false
+};
+const LanguageSpec kSqlSpec = {
+    KEYWORDS(kSqlKeywords), true, L"--", L"/*", L"*/", L"'\"`", false, false, true, false, false, false, false
+};
+const LanguageSpec kShellSpec = {
+    KEYWORDS(kShellKeywords), false, L"#", nullptr, nullptr, L"\"'`", false, true, true, true, false, true, false
+};
+const LanguageSpec kJsonSpec = {
+    KEYWORDS(kJsonKeywords), false, nullptr, nullptr, nullptr, L"\"", false, true, false, false, false, false, true
+};
+
+#undef KEYWORDS
+
+const LanguageSpec* SpecFor(Language language) {
+    switch (language) {
+        case Language::Cpp: return &kCppSpec;
+        case Language::Python: return &kPythonSpec;
+        case Language::JavaScript: return &kJavaScriptSpec;
+        case Language::Sql: return &kSqlSpec;
+        case Language::Shell: return &kShellSpec;
+        case Language::Json: return &kJsonSpec;
+        case Language::None:
+        default: return nullptr;
+    }
+}
+
+int CompareKeyword(const wchar_t* keyword, const wchar_t* word, size_t length, bool ignoreCase) {
+    for (size_t k = 0; k < length; ++k) {
+        wchar_t a = keyword[k];
+        if (a == 0) {
+            return -1;
+        }
+        wchar_t b = word[k];
+        if (ignoreCase && b >= L'A' && b <= L'Z') {
+            b = (wchar_t)(b + (L'a' - L'A'));
+        }
+        if (a != b) {
+            return (a < b) ? -1 : 1;
+        }
+    }
+    return (keyword[length] == 0) ? 0 : 1;
+}
+
+bool IsKeyword(const LanguageSpec& spec, const wchar_t* word, size_t length) {
+    // No keyword in the tables is longer than this.
+    if (length > 16) {
+        return false;
+    }
+    size_t lo = 0;
+    size_t hi = spec.keywordCount;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int cmp = CompareKeyword(spec.keywords[mid], word, length, spec.keywordsIgnoreCase);
+        if (cmp == 0) {
+            return true;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+bool StartsWith(const wchar_t* text, size_t length, size_t pos, const wchar_t* prefix) {
+    if (!prefix) {
+        return false;
+    }
+    for (size_t k = 0; prefix[k] != 0; ++k) {
+        if (pos + k >= length || text[pos + k] != prefix[k]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IsQuote(const LanguageSpec& spec, wchar_t ch) {
+    for (const wchar_t* q = spec.quotes; *q; ++q) {
+        if (*q == ch) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t SkipToLineEnd(const wchar_t* text, size_t length, size_t pos, bool allowContinuation) {
+    while (pos < length) {
+        if (text[pos] == L'\n') {
+            size_t back = pos;
+            if (back > 0 && text[back - 1] == L'\r') {
+                --back;
+            }
+            if (allowContinuation && back > 0 && text[back - 1] == L'\\') {
+                ++pos;
+                continue;
+            }
+            break;
+        }
+        ++pos;
+    }
+    return pos;
+}
+
+size_t ScanString(const LanguageSpec& spec, const wchar_t* text, size_t length, size_t pos) {
+    const wchar_t quote = text[pos];
+
+    if (spec.tripleQuotes && pos + 2 < length && text[pos + 1] == quote && text[pos + 2] == quote) {
+        size_t j = pos + 3;
+        while (j < length) {
+            if (spec.backslashEscapes && text[j] == L'\\') {
+                j += 2;
+                continue;
+            }
+            if (j + 2 < length && text[j] == quote && text[j + 1] == quote && text[j + 2] == quote) {
+                return j + 3;
+            }
+            ++j;
+        }
+        return length;
+    }
+
+    const bool multiline = spec.multilineStrings || quote == L'`';
+    size_t j = pos + 1;
+    while (j < length) {
+        wchar_t c = text[j];
+        if (spec.backslashEscapes && c == L'\\') {
+            j += 2;
+            continue;
+        }
+        if (c == quote) {
+            return j + 1;
+        }
+        if (c == L'\n' && !multiline) {
+            return j;
+        }
+        ++j;
+    }
+    return length;
+}
+
+size_t ScanNumber(const wchar_t* text, size_t length, size_t pos) {
+    size_t j = pos;
+    while (j < length) {
+        wchar_t c = text[j];
+        if ((ClassOf(c) & (CC_DIGIT | CC_IDENT)) || c == L'.' || c == L'\'') {
+            // Exponent sign: 1e-5, 2.5E+10
+            if ((c == L'e' || c == L'E') && j + 1 < length && (text[j + 1] == L'+' || text[j + 1] == L'-')) {
+                j += 2;
+                continue;
+            }
+            ++j;
+            continue;
+        }
+        break;
+    }
+    return j;
+}
+
+size_t ScanShellVariable(const wchar_t* text, size_t length, size_t pos) {
+    size_t j = pos + 1;
+    if (j >= length) {
+        return pos;
+    }
+    if (text[j] == L'{') {
+        while (j < length && text[j] != L'}' && text[j] != L'\n') {
+            ++j;
+        }
+        return (j < length && text[j] == L'}') ? j + 1 : j;
+    }
+    if (ClassOf(text[j]) & (CC_IDENT | CC_DIGIT)) {
+        while (j < length && (ClassOf(text[j]) & (CC_IDENT | CC_DIGIT))) {
+            ++j;
+        }
+        return j;
+    }
+    // Special parameters: $@ $# $? $$ $! $* $-
+    switch (text[j]) {
+        case L'@': case L'#': case L'?': case L'$': case L'!': case L'*': case L'-':
+            return j + 1;
+        default:
+            return pos;
+    }
+}
+
+void AddRun(std::vector<Run>& out, size_t start, size_t length, TokenKind kind) {
+    if (length == 0) {
+        return;
+    }
+    if (!out.empty() && out.back().kind == kind && out.back().start + out.back().length == start) {
+        out.back().length += length;
+        return;
+    }
+    Run r;
+    r.start = start;
+    r.length = length;
+    r.kind = kind;
+    out.push_back(r);
+}
+
+std::wstring ToLowerAscii(const std::wstring& s) {
+    std::wstring out = s;
+    for (auto& c : out) {
+        if (c >= L'A' && c <= L'Z') {
+            c = (wchar_t)(c + (L'a' - L'A'));
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+Language LanguageFromInfoString(const std::wstring& info) {
+    // Only the first word matters: ```python title="x"
+    size_t end = 0;
+    while (end < info.size() && info[end] != L' ' && info[end] != L'\t' && info[end] != L'{') {
+        ++end;
+    }
+    std::wstring lang = ToLowerAscii(info.substr(0, end));
+
+    if (lang == L"c" || lang == L"cpp" || lang == L"c++" || lang == L"cc" || lang == L"cxx" ||
+        lang == L"h" || lang == L"hpp" || lang == L"hxx") {
+        return Language::Cpp;
+    }
+    if (lang == L"py" || lang == L"python" || lang == L"python3") {
+        return Language::Python;
+    }
+    if (lang == L"js" || lang == L"javascript" || lang == L"jsx" || lang == L"mjs" ||
+        lang == L"ts" || lang == L"typescript" || lang == L"tsx") {
+        return Language::JavaScript;
+    }
+    if (lang == L"sql" || lang == L"sqlite" || lang == L"mysql" || lang == L"postgres" || lang == L"pgsql") {
+        return Language::Sql;
+    }
+    if (lang == L"sh" || lang == L"bash" || lang == L"shell" || lang == L"zsh" || lang == L"console") {
+        return Language::Shell;
+    }
+    if (lang == L"json" || lang == L"jsonc") {
+        return Language::Json;
+    }
+    return Language::None;
+}
+
+void Lex(Language language, const wchar_t* text, size_t length, std::vector<Run>& out) {
+    out.clear();
+    if (!text || length == 0) {
+        return;
+    }
+
+    const LanguageSpec* spec = SpecFor(language);
+    if (!spec) {
+        AddRun(out, 0, length, TokenKind::Text);
+        return;
+    }
+
+    size_t plainStart = 0;
+    auto token = [&](size_t start, size_t end, TokenKind kind) {
+        AddRun(out, plainStart, start - plainStart, TokenKind::Text);
+        AddRun(out, start, end - start, kind);
+        plainStart = end;
+    };
+
+    bool atLineStart = true;
+    size_t i = 0;
+    while (i < length) {
+        const wchar_t ch = text[i];
+        const unsigned char cls = ClassOf(ch);
+
+        if (ch == L'\n') {
+            atLineStart = true;
+            ++i;
+            continue;
+        }
+        if (cls == CC_SPACE) {
+            ++i;
+            continue;
+        }
+
+        const bool lineStart = atLineStart;
+        atLineStart = false;
+
+        if (cls == CC_IDENT) {
+            size_t end = i + 1;
+            while (end < length && (ClassOf(text[end]) & (CC_IDENT | CC_DIGIT))) {
+                ++end;
+            }
+            if (IsKeyword(*spec, text + i, end - i)) {
+                token(i, end, TokenKind::Keyword);
+            }
+            i = end;
+            continue;
+        }
+
+        if (cls == CC_DIGIT || (ch == L'.' && i + 1 < length && ClassOf(text[i + 1]) == CC_DIGIT)) {
+            size_t end = ScanNumber(text, length, i);
+            token(i, end, TokenKind::Number);
+            i = end;
+            continue;
+        }
+
+        if (spec->preprocessorLines && lineStart && ch == L'#') {
+            size_t end = SkipToLineEnd(text, length, i, true);
+            token(i, end, TokenKind::Preprocessor);
+            i = end;
+            continue;
+        }
+
+        if (StartsWith(text, length, i, spec->lineComment) &&
+            (!spec->commentNeedsWordStart || i == 0 || ClassOf(text[i - 1]) == CC_SPACE)) {
+            size_t end = SkipToLineEnd(text, length, i, false);
+            token(i, end, TokenKind::Comment);
+            i = end;
+            continue;
+        }
+
+        if (StartsWith(text, length, i, spec->blockCommentOpen)) {
+            size_t openLen = wcslen(spec->blockCommentOpen);
+            size_t closeLen = wcslen(spec->blockCommentClose);
+            size_t end = i + openLen;
+            while (end < length && !StartsWith(text, length, end, spec->blockCommentClose)) {
+                ++end;
+            }
+            end = (end < length) ? end + closeLen : length;
+            token(i, end, TokenKind::Comment);
+            i = end;
+            continue;
+        }
+
+        if (IsQuote(*spec, ch)) {
+            size_t end = ScanString(*spec, text, length, i);
+            if (end > length) {
+                end = length;
+            }
+            TokenKind kind = TokenKind::String;
+            if (spec->objectKeys) {
+                size_t k = end;
+                while (k < length && ClassOf(text[k]) == CC_SPACE) {
+                    ++k;
+                }
+                if (k < length && text[k] == L':') {
+                    kind = TokenKind::Variable;
+                }
+            }
+            token(i, end, kind);
+            i = end;
+            continue;
+        }
+
+        if (spec->dollarVariables && ch == L'$') {
+            size_t end = ScanShellVariable(text, length, i);
+            if (end > i) {
+                token(i, end, TokenKind::Variable);
+                i = end;
+                continue;
+            }
+        }
+
+        ++i;
+    }
+
+    AddRun(out, plainStart, length - plainStart, TokenKind::Text);
+}
+
+} // namespace CodeHighlight
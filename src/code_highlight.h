@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace CodeHighlight {
+
+enum class Language {
+    None,
+    Cpp,
+    Python,
+    JavaScript,
+    Sql,
+    Shell,
+    Json
+};
+
+enum class TokenKind : unsigned char {
+    Text,
+    Keyword,
+    String,
+    Comment,
+    Number,
+    Preprocessor,
+    Variable   // shell $VAR, JSON object keys
+};
+
+static const int kTokenKindCount = 7;
+
+struct Run {
+    size_t start = 0;
+    size_t length = 0;
+    TokenKind kind = TokenKind::Text;
+};
+
+// Maps a fenced code block info string ("cpp", "python", "sh", ...) to a language.
+// Unknown or empty info strings map to Language::None (monospace, no colors).
+Language LanguageFromInfoString(const std::wstring& info);
+
+// Splits text into colored runs in a single pass driven by per-language tables (no regex).
+// Runs cover the whole text in order and adjacent runs never share a kind.
+// out is cleared first; reuse it across calls to avoid reallocations.
+void Lex(Language language, const wchar_t* text, size_t length, std::vector<Run>& out);
+
+} // namespace CodeHighlight
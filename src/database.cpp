@@ -1,6 +1,153 @@
 #include "database.h"
 #include <iostream>
-#include "utils.h"
+#include <unordered_set>
+#include "markdown.h"
+
+// Resolves a link to the oldest note with a matching title (case-insensitive, like the index).
+#define NOTE_LINK_RESOLVE_SQL \
+    "(SELECT id FROM notes WHERE notes.title = note_links.target_title COLLATE NOCASE ORDER BY id LIMIT 1)"
+
+// BackupToFile copies this many pages per step (1 MB of 4 KB pages), pausing in between so
+// writes to the database get their turn.
+static const int kBackupPagesPerStep = 256;
+static const int kBackupStepPauseMs = 5;
+static const int kBackupMaxRestarts = 3;
+
+static std::string AsciiLower(std::string s) {
+    for (char& c : s) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    }
+    return s;
+}
+
+// Tables journaled for op-based sync. A parent column holds the local id of a row of another synced
+// table and travels as that row's gid. Tables without an integer id are identified by their
+// leading key columns, so both replicas derive the same gid for the same row. Columns not listed
+// (notes.spell_language, detected per machine) stay local and updating them journals nothing.
+struct SyncColumn {
+    const char* name;
+    const char* parent = nullptr;
+};
+
+struct SyncTable {
+    const char* name;
+    bool hasId;
+    int keyColumns;         // Tables without id
+    const char* seedKey;    // Tables with id: with the id, names a row that predates the journal
+    SyncColumn columns[10]; // Up to a null name
+};
+
+static const SyncTable kSyncTables[] = {
+    { "notes", true, 0, "created_at",
+      { { "title" }, { "content" }, { "color_id" }, { "is_archived" }, { "is_pinned" }, { "is_checklist" },
+        { "created_at" }, { "modified_at" } } },
+    { "tags", true, 0, "name", { { "name" }, { "tag_order" } } },
+    { "checklist_items", true, 0, "note_id",
+      { { "note_id", "notes" }, { "item_text" }, { "is_checked" }, { "item_order" } } },
+    { "note_tags", false, 2, nullptr, { { "note_id", "notes" }, { "tag_id", "tags" } } },
+    { "snippets", true, 0, "\"trigger\"", { { "trigger" }, { "snippet" } } },
+    { "user_dictionary", false, 1, nullptr, { { "word" }, { "added_at" } } },
+};
+
+#define SYNC_CLOCK_TICK_SQL \
+    "UPDATE sync_state SET hlc = MAX(hlc + 1, CAST((julianday('now') - 2440587.5) * 86400000 AS INTEGER) << 16);"
+
+static const SyncTable* FindSyncTable(const std::string& name) {
+    for (const SyncTable& table : kSyncTables) {
+        if (name == table.name) return &table;
+    }
+    return nullptr;
+}
+
+// schema ("" or e.g. "merge_remote.") names the database whose rows and sync_rows are read.
+static std::string GidOfLocalSql(const char* table, const std::string& localId, const std::string& schema = "") {
+    return "(SELECT gid FROM " + schema + "sync_rows WHERE tbl = '" + table + "' AND local_id = " + localId + ")";
+}
+
+static std::string LocalOfGidSql(const char* table, const std::string& gid) {
+    return std::string("(SELECT local_id FROM sync_rows WHERE tbl = '") + table + "' AND gid = " + gid + ")";
+}
+
+// Column value of row (NEW, OLD or a table name) as it travels: parents as their gid.
+static std::string SyncValueSql(const SyncColumn& column, const std::string& row, const std::string& schema = "") {
+    std::string value = row + ".\"" + column.name + "\"";
+    return column.parent ? GidOfLocalSql(column.parent, value, schema) : value;
+}
+
+// Column value read back from a payload bound as ?1, parents resolved to their local id.
+static std::string SyncPayloadValueSql(const SyncColumn& column) {
+    std::string value = std::string("json_extract(?1, '$.") + column.name + "')";
+    return column.parent ? LocalOfGidSql(column.parent, value) : value;
+}
+
+static std::string SyncPayloadSql(const SyncTable& table, const std::string& row, const std::string& schema = "") {
+    std::string sql = "json_object(";
+    for (int i = 0; table.columns[i].name; ++i) {
+        if (i > 0) sql += ", ";
+        sql += std::string("'") + table.columns[i].name + "', " + SyncValueSql(table.columns[i], row, schema);
+    }
+    return sql + ")";
+}
+
+static std::string SyncGidSql(const SyncTable& table, const std::string& row, const std::string& schema = "") {
+    if (table.hasId) {
+        return GidOfLocalSql(table.name, row + ".id", schema);
+    }
+    std::string sql;
+    for (int i = 0; i < table.keyColumns; ++i) {
+        if (i > 0) sql += " || '/' || ";
+        sql += SyncValueSql(table.columns[i], row, schema);
+    }
+    return sql;
+}
+
+// Journals the new state of row. Only a row's latest op is ever pushed, so the earlier one goes: the
+// log holds one entry per row however often it is edited, sync enabled or not.
+static std::string SyncLogSql(const SyncTable& table, const std::string& row, bool deleted) {
+    return std::string("DELETE FROM change_log WHERE tbl = '") + table.name + "' AND gid = " + SyncGidSql(table, row) +
+        "; INSERT INTO change_log (tbl, gid, hlc, origin, deleted, payload) SELECT '" + table.name +
+        "', g, hlc, replica, " + (deleted ? "1" : "0") + ", " + SyncPayloadSql(table, row) +
+        " FROM (SELECT " + SyncGidSql(table, row) + " AS g), sync_state WHERE g IS NOT NULL;";
+}
+
+static std::string SyncVersionSql(const SyncTable& table, const std::string& row, bool deleted) {
+    std::string where = table.hasId ? "local_id = " + row + ".id" : "gid = " + SyncGidSql(table, row);
+    return std::string("UPDATE sync_rows SET hlc = (SELECT hlc FROM sync_state), origin = (SELECT replica FROM sync_state), "
+        "deleted = ") + (deleted ? "1" : "0") + " WHERE tbl = '" + table.name + "' AND " + where + ";";
+}
+
+// The triggers that journal one table; they stay quiet while remote ops are applied.
+static std::string SyncTriggersSql(const SyncTable& table) {
+    std::string name = table.name;
+    std::string when = " FOR EACH ROW WHEN (SELECT applying FROM sync_state) = 0 BEGIN " SYNC_CLOCK_TICK_SQL " ";
+    std::string sql;
+
+    sql += "DROP TRIGGER IF EXISTS sync_" + name + "_insert;";
+    sql += "CREATE TRIGGER sync_" + name + "_insert AFTER INSERT ON " + name + when;
+    if (table.hasId) {
+        sql += "INSERT OR REPLACE INTO sync_rows (tbl, gid, local_id, hlc, origin, deleted) SELECT '" + name +
+            "', lower(hex(randomblob(8))), NEW.id, hlc, replica, 0 FROM sync_state;";
+    } else {
+        sql += "INSERT OR REPLACE INTO sync_rows (tbl, gid, local_id, hlc, origin, deleted) SELECT '" + name +
+            "', g, NULL, hlc, replica, 0 FROM (SELECT " + SyncGidSql(table, "NEW") + " AS g), sync_state WHERE g IS NOT NULL;";
+    }
+    sql += SyncLogSql(table, "NEW", false) + " END;";
+
+    if (table.hasId) {
+        std::string columns;
+        for (int i = 0; table.columns[i].name; ++i) {
+            columns += std::string(i > 0 ? ", " : "") + "\"" + table.columns[i].name + "\"";
+        }
+        sql += "DROP TRIGGER IF EXISTS sync_" + name + "_update;";
+        sql += "CREATE TRIGGER sync_" + name + "_update AFTER UPDATE OF " + columns + " ON " + name + when;
+        sql += SyncVersionSql(table, "NEW", false) + SyncLogSql(table, "NEW", false) + " END;";
+    }
+
+    sql += "DROP TRIGGER IF EXISTS sync_" + name + "_delete;";
+    sql += "CREATE TRIGGER sync_" + name + "_delete AFTER DELETE ON " + name + when;
+    sql += SyncLogSql(table, "OLD", true) + SyncVersionSql(table, "OLD", true) + " END;";
+    return sql;
+}
 
 Database::Database() {
     m_db = nullptr;
@@ -17,6 +164,9 @@ bool Database::Initialize(const std::string& dbPath) {
         return false;
     }
     
+    // The cloud sync thread works on a connection of its own; wait for each other's writes.
+    sqlite3_busy_timeout(m_db, 5000);
+
     if (!CreateSchema()) return false;
 
     // Migration: Check for is_checklist column
@@ -34,6 +184,17 @@ bool Database::Initialize(const std::string& dbPath) {
         sqlite3_finalize(stmt);
     }
 
+    // Migration: spell_language caches the detected spell check locale per note
+    if (sqlite3_prepare_v2(m_db, "SELECT spell_language FROM notes LIMIT 1", -1, &stmt, nullptr) != SQLITE_OK) {
+        char* errMsg = nullptr;
+        if (sqlite3_exec(m_db, "ALTER TABLE notes ADD COLUMN spell_language TEXT", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::cerr << "Migration error (spell_language): " << errMsg << std::endl;
+            sqlite3_free(errMsg);
+        }
+    } else {
+        sqlite3_finalize(stmt);
+    }
+
     // Migration: ensure search_history exists for older databases
     const char* checkSearchSql = "SELECT search_term FROM search_history LIMIT 1";
     if (sqlite3_prepare_v2(m_db, checkSearchSql, -1, &stmt, nullptr) != SQLITE_OK) {
@@ -77,38 +238,128 @@ bool Database::Initialize(const std::string& dbPath) {
         sqlite3_finalize(stmt);
     }
 
+    // The sync journal's triggers cover the tables above, so it comes after their migrations.
+    // Without it the notes still work; only op-based sync is unavailable.
+    CreateSyncJournal();
+
+    // Migration: index [[links]] of notes written before note_links existed
+    if (GetSetting("NoteLinksIndexed") != "1") {
+        if (IndexAllNoteLinks()) {
+            SetSetting("NoteLinksIndexed", "1");
+        }
+    }
 
     return InitializeColors();
 }
 
-bool Database::BackupToFile(const std::string& destDbPath) {
-    if (!m_db) {
+bool Database::InitializeReadOnly(const std::string& dbPath) {
+    if (sqlite3_open_v2(dbPath.c_str(), &m_db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        std::cerr << "Can't open database: " << sqlite3_errmsg(m_db) << std::endl;
+        Close();
         return false;
     }
+    sqlite3_busy_timeout(m_db, 5000);
+    return true;
+}
 
-    sqlite3* outDb = nullptr;
-    if (sqlite3_open(destDbPath.c_str(), &outDb) != SQLITE_OK) {
-        if (outDb) sqlite3_close(outDb);
+bool Database::BackupToFile(const std::string& destDbPath, const std::atomic<bool>* cancel,
+                            const BackupProgress& progress) {
+    if (!m_db) {
         return false;
     }
 
-    sqlite3_backup* backup = sqlite3_backup_init(outDb, "main", m_db, "main");
-    if (!backup) {
-        sqlite3_close(outDb);
-        return false;
+    // Under WAL, read on a connection of our own inside one read transaction: it sees a single
+    // version of the file while writes here carry on. A rollback journal has no such version, so
+    // step on m_db itself instead. It is held only a step at a time, and SQLite mirrors writes
+    // made through it between steps into the copy, where another connection's writes would make
+    // the copy start over.
+    bool wal = false;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(m_db, "PRAGMA journal_mode", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char* mode = (const char*)sqlite3_column_text(stmt, 0);
+            wal = mode && AsciiLower(mode) == "wal";
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3* srcDb = m_db;
+    const char* srcPath = sqlite3_db_filename(m_db, "main");
+    if (wal && srcPath && srcPath[0]) {
+        sqlite3* readDb = nullptr;
+        if (sqlite3_open_v2(srcPath, &readDb, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK) {
+            sqlite3_busy_timeout(readDb, 5000);
+            if (sqlite3_exec(readDb, "BEGIN; SELECT count(*) FROM sqlite_master;", nullptr, nullptr, nullptr) == SQLITE_OK) {
+                srcDb = readDb;
+                readDb = nullptr;
+            }
+        }
+        if (readDb) sqlite3_close(readDb);
     }
 
-    int rc = sqlite3_backup_step(backup, -1);
-    sqlite3_backup_finish(backup);
+    sqlite3* outDb = nullptr;
+    sqlite3_backup* backup = nullptr;
+    if (sqlite3_open(destDbPath.c_str(), &outDb) == SQLITE_OK) {
+        backup = sqlite3_backup_init(outDb, "main", srcDb, "main");
+    }
 
-    bool ok = (rc == SQLITE_DONE);
-    sqlite3_close(outDb);
-    return ok;
+    int rc = SQLITE_ERROR;
+    if (backup) {
+        int restarts = 0;
+        int lastRemaining = -1;
+        for (;;) {
+            if (cancel && cancel->load()) {
+                rc = SQLITE_ABORT;
+                break;
+            }
+            // Past a few restarts (writes from elsewhere keep coming) copy the rest in one step.
+            int pages = restarts < kBackupMaxRestarts ? kBackupPagesPerStep : -1;
+            rc = sqlite3_backup_step(backup, pages);
+            if (rc != SQLITE_OK && rc != SQLITE_BUSY && rc != SQLITE_LOCKED && rc != SQLITE_DONE) {
+                break;
+            }
+            int remaining = sqlite3_backup_remaining(backup);
+            if (lastRemaining >= 0 && remaining > lastRemaining) {
+                ++restarts;
+            }
+            lastRemaining = remaining;
+            if (progress) {
+                int total = sqlite3_backup_pagecount(backup);
+                progress(total - remaining, total);
+            }
+            if (rc == SQLITE_DONE) {
+                break;
+            }
+            sqlite3_sleep(kBackupStepPauseMs);
+        }
+        sqlite3_backup_finish(backup);
+    }
+    if (outDb) sqlite3_close(outDb);
+    if (srcDb != m_db) {
+        sqlite3_exec(srcDb, "COMMIT", nullptr, nullptr, nullptr);
+        sqlite3_close(srcDb);
+    }
+    return rc == SQLITE_DONE;
+}
+
+Database::ChangeStamp Database::GetChangeStamp() {
+    ChangeStamp stamp;
+    if (!m_db) {
+        return stamp;
+    }
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, "PRAGMA data_version", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            stamp.dataVersion = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    stamp.totalChanges = sqlite3_total_changes64(m_db);
+    return stamp;
 }
 
 std::vector<Note> Database::GetAllNotes(bool includeArchived, SortBy sortBy) {
     std::vector<Note> notes;
-    std::string sql = "SELECT id, title, content, color_id, is_archived, is_pinned, is_checklist, created_at, modified_at FROM notes ";
+    std::string sql = "SELECT id, title, content, color_id, is_archived, is_pinned, is_checklist, created_at, modified_at, spell_language FROM notes ";
     
     if (!includeArchived) {
         sql += "WHERE is_archived = 0 ";
@@ -144,6 +395,8 @@ std::vector<Note> Database::GetAllNotes(bool includeArchived, SortBy sortBy) {
             note.is_checklist = sqlite3_column_int(stmt, 6) != 0;
             note.created_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
             note.modified_at = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
+            const char* spellLanguage = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 9));
+            note.spell_language = spellLanguage ? spellLanguage : "";
             
             if (note.is_checklist) {
                 note.checklist_items = GetChecklistItems(note.id);
@@ -159,6 +412,11 @@ bool Database::CreateNote(Note& note) {
     const char* sql = "INSERT INTO notes (title, content, created_at, modified_at) VALUES (?, ?, CURRENT_TIMESTAMP, CURRENT_TIMESTAMP)";
     sqlite3_stmt* stmt;
 
+    if (!ExecSql("BEGIN", "CreateNote")) {
+        return false;
+    }
+
+    bool success = false;
     if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
         sqlite3_bind_text(stmt, 1, note.title.c_str(), -1, SQLITE_STATIC);
         sqlite3_bind_text(stmt, 2, note.content.c_str(), -1, SQLITE_STATIC);
@@ -166,24 +424,52 @@ bool Database::CreateNote(Note& note) {
         int result = sqlite3_step(stmt);
         if (result == SQLITE_DONE) {
             note.id = (int)sqlite3_last_insert_rowid(m_db);
-            sqlite3_finalize(stmt);
-            return true;
+            success = true;
         } else {
             // Debug: Show the error
             const char* errMsg = sqlite3_errmsg(m_db);
             fprintf(stderr, "CreateNote failed: %s (result=%d)\n", errMsg, result);
-            sqlite3_finalize(stmt);
         }
+        sqlite3_finalize(stmt);
     } else {
         fprintf(stderr, "CreateNote prepare failed: %s\n", sqlite3_errmsg(m_db));
     }
-    return false;
+
+    // Index the new note's links and attach links that were waiting for this title.
+    if (success) {
+        success = SyncNoteLinks(note.id, note.content) && ResolveLinksByTitle(note.title);
+    }
+    if (!success || !ExecSql("COMMIT", "CreateNote")) {
+        ExecSql("ROLLBACK", "CreateNote");
+        return false;
+    }
+    return true;
 }
 
 bool Database::UpdateNote(const Note& note) {
     const char* sql = "UPDATE notes SET title = ?, content = ?, modified_at = CURRENT_TIMESTAMP WHERE id = ?";
     sqlite3_stmt* stmt;
 
+    // Immediate: this reads before it writes, and a deferred transaction would fail at once instead
+    // of waiting while a sync connection holds the write lock.
+    if (!ExecSql("BEGIN IMMEDIATE", "UpdateNote")) {
+        return false;
+    }
+
+    // Remember the previous title so a rename only touches the links naming the old or new title.
+    std::string oldTitle;
+    bool hasOldTitle = false;
+    if (sqlite3_prepare_v2(m_db, "SELECT title FROM notes WHERE id = ?", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, note.id);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* title = sqlite3_column_text(stmt, 0);
+            oldTitle = title ? reinterpret_cast<const char*>(title) : "";
+            hasOldTitle = true;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    bool success = false;
     if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
         sqlite3_bind_text(stmt, 1, note.title.c_str(), -1, SQLITE_STATIC);
         sqlite3_bind_text(stmt, 2, note.content.c_str(), -1, SQLITE_STATIC);
@@ -191,34 +477,239 @@ bool Database::UpdateNote(const Note& note) {
 
         int result = sqlite3_step(stmt);
         if (result == SQLITE_DONE) {
-            sqlite3_finalize(stmt);
-            return true;
+            success = true;
         } else {
             // Debug: Show the error
             const char* errMsg = sqlite3_errmsg(m_db);
             fprintf(stderr, "UpdateNote failed: note.id=%d, %s (result=%d)\n", note.id, errMsg, result);
-            sqlite3_finalize(stmt);
         }
+        sqlite3_finalize(stmt);
     } else {
         fprintf(stderr, "UpdateNote prepare failed: %s\n", sqlite3_errmsg(m_db));
     }
-    return false;
+
+    if (success) {
+        success = SyncNoteLinks(note.id, note.content);
+    }
+    if (success && hasOldTitle && oldTitle != note.title) {
+        success = ResolveLinksToNote(note.id) && ResolveLinksByTitle(note.title);
+    }
+    if (!success || !ExecSql("COMMIT", "UpdateNote")) {
+        ExecSql("ROLLBACK", "UpdateNote");
+        return false;
+    }
+    return true;
 }
 
 bool Database::DeleteNote(int id) {
     const char* sql = "DELETE FROM notes WHERE id = ?";
     sqlite3_stmt* stmt;
 
+    if (!ExecSql("BEGIN", "DeleteNote")) {
+        return false;
+    }
+
+    bool success = false;
     if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
         sqlite3_bind_int(stmt, 1, id);
+        success = (sqlite3_step(stmt) == SQLITE_DONE);
+        sqlite3_finalize(stmt);
+    }
 
-        if (sqlite3_step(stmt) == SQLITE_DONE) {
+    // Drop the note's own links; links pointing at it fall back to another note with that title, if any.
+    if (success && sqlite3_prepare_v2(m_db, "DELETE FROM note_links WHERE source_note_id = ?", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, id);
+        success = (sqlite3_step(stmt) == SQLITE_DONE);
+        sqlite3_finalize(stmt);
+    }
+    if (success) {
+        success = ResolveLinksToNote(id);
+    }
+    if (!success || !ExecSql("COMMIT", "DeleteNote")) {
+        ExecSql("ROLLBACK", "DeleteNote");
+        return false;
+    }
+    return true;
+}
+
+std::vector<Database::NoteLinkRef> Database::GetBacklinks(int noteId) {
+    std::vector<NoteLinkRef> links;
+    const char* sql =
+        "SELECT n.id, n.title FROM note_links l JOIN notes n ON n.id = l.source_note_id "
+        "WHERE l.target_note_id = ? AND l.source_note_id <> l.target_note_id "
+        "ORDER BY n.title COLLATE NOCASE";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, noteId);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            NoteLinkRef ref;
+            ref.noteId = sqlite3_column_int(stmt, 0);
+            const unsigned char* title = sqlite3_column_text(stmt, 1);
+            ref.title = title ? reinterpret_cast<const char*>(title) : "";
+            links.push_back(ref);
+        }
+        sqlite3_finalize(stmt);
+    }
+    return links;
+}
+
+int Database::FindNoteIdByTitle(const std::string& title) {
+    const char* sql = "SELECT id FROM notes WHERE title = ? COLLATE NOCASE ORDER BY id LIMIT 1";
+    sqlite3_stmt* stmt;
+    int id = -1;
+
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, title.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            id = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    return id;
+}
+
+bool Database::ExecSql(const char* sql, const char* context) {
+    char* errMsg = nullptr;
+    if (sqlite3_exec(m_db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        fprintf(stderr, "%s: %s failed: %s\n", context, sql, errMsg ? errMsg : "unknown error");
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool Database::SyncNoteLinks(int noteId, const std::string& content) {
+    std::vector<std::string> newTargets = Markdown::ExtractWikiLinkTargets(content);
+    std::unordered_set<std::string> newKeys;
+    for (const auto& target : newTargets) {
+        newKeys.insert(AsciiLower(target));
+    }
+
+    // Diff against the stored link set so an edit only writes the links it added or removed.
+    std::unordered_set<std::string> oldKeys;
+    std::vector<std::string> removed;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, "SELECT target_title FROM note_links WHERE source_note_id = ?", -1, &stmt, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "SyncNoteLinks prepare failed: %s\n", sqlite3_errmsg(m_db));
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, noteId);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* text = sqlite3_column_text(stmt, 0);
+        std::string target = text ? reinterpret_cast<const char*>(text) : "";
+        std::string key = AsciiLower(target);
+        if (newKeys.count(key) == 0) {
+            removed.push_back(target);
+        }
+        oldKeys.insert(std::move(key));
+    }
+    sqlite3_finalize(stmt);
+
+    if (!removed.empty()) {
+        if (sqlite3_prepare_v2(m_db, "DELETE FROM note_links WHERE source_note_id = ? AND target_title = ?", -1, &stmt, nullptr) != SQLITE_OK) {
+            fprintf(stderr, "SyncNoteLinks prepare failed: %s\n", sqlite3_errmsg(m_db));
+            return false;
+        }
+        for (const auto& target : removed) {
+            sqlite3_bind_int(stmt, 1, noteId);
+            sqlite3_bind_text(stmt, 2, target.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                fprintf(stderr, "SyncNoteLinks delete failed: %s\n", sqlite3_errmsg(m_db));
+                sqlite3_finalize(stmt);
+                return false;
+            }
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    bool hasAdded = false;
+    for (const auto& target : newTargets) {
+        if (oldKeys.count(AsciiLower(target)) == 0) {
+            hasAdded = true;
+            break;
+        }
+    }
+    if (!hasAdded) {
+        return true;
+    }
+
+    const char* insertSql =
+        "INSERT OR IGNORE INTO note_links (source_note_id, target_title, target_note_id) "
+        "VALUES (?1, ?2, (SELECT id FROM notes WHERE title = ?2 COLLATE NOCASE ORDER BY id LIMIT 1))";
+    if (sqlite3_prepare_v2(m_db, insertSql, -1, &stmt, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "SyncNoteLinks prepare failed: %s\n", sqlite3_errmsg(m_db));
+        return false;
+    }
+    for (const auto& target : newTargets) {
+        if (oldKeys.count(AsciiLower(target)) != 0) {
+            continue;
+        }
+        sqlite3_bind_int(stmt, 1, noteId);
+        sqlite3_bind_text(stmt, 2, target.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            fprintf(stderr, "SyncNoteLinks insert failed: %s\n", sqlite3_errmsg(m_db));
             sqlite3_finalize(stmt);
-            return true;
+            return false;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool Database::ResolveLinksByTitle(const std::string& title) {
+    const char* sql = "UPDATE note_links SET target_note_id = " NOTE_LINK_RESOLVE_SQL " WHERE target_title = ?";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "ResolveLinksByTitle prepare failed: %s\n", sqlite3_errmsg(m_db));
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, title.c_str(), -1, SQLITE_STATIC);
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    return success;
+}
+
+bool Database::ResolveLinksToNote(int noteId) {
+    const char* sql = "UPDATE note_links SET target_note_id = " NOTE_LINK_RESOLVE_SQL " WHERE target_note_id = ?";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "ResolveLinksToNote prepare failed: %s\n", sqlite3_errmsg(m_db));
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, noteId);
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    return success;
+}
+
+bool Database::IndexAllNoteLinks() {
+    if (!ExecSql("BEGIN IMMEDIATE", "IndexAllNoteLinks")) {
+        return false;
+    }
+
+    std::vector<std::pair<int, std::string>> notes;
+    sqlite3_stmt* stmt;
+    bool success = false;
+    if (sqlite3_prepare_v2(m_db, "SELECT id, content FROM notes", -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char* content = sqlite3_column_text(stmt, 1);
+            notes.emplace_back(sqlite3_column_int(stmt, 0), content ? reinterpret_cast<const char*>(content) : "");
         }
         sqlite3_finalize(stmt);
+        success = true;
     }
-    return false;
+
+    for (size_t i = 0; success && i < notes.size(); ++i) {
+        success = SyncNoteLinks(notes[i].first, notes[i].second);
+    }
+    if (!success || !ExecSql("COMMIT", "IndexAllNoteLinks")) {
+        ExecSql("ROLLBACK", "IndexAllNoteLinks");
+        return false;
+    }
+    return true;
 }
 
 std::vector<Database::Color> Database::GetColors() {
@@ -289,7 +780,8 @@ bool Database::CreateSchema() {
         "    is_pinned INTEGER DEFAULT 0,"
         "    is_checklist INTEGER DEFAULT 0,"
         "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
-        "    modified_at DATETIME DEFAULT CURRENT_TIMESTAMP"
+        "    modified_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
+        "    spell_language TEXT"
         ");"
         "CREATE TABLE IF NOT EXISTS colors ("
         "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
@@ -326,10 +818,23 @@ bool Database::CreateSchema() {
         "    trigger TEXT NOT NULL,"
         "    snippet TEXT NOT NULL"
         ");"
+        "CREATE TABLE IF NOT EXISTS user_dictionary ("
+        "    word TEXT PRIMARY KEY,"
+        "    added_at DATETIME DEFAULT CURRENT_TIMESTAMP"
+        ") WITHOUT ROWID;"
         "CREATE TABLE IF NOT EXISTS settings ("
         "    key TEXT PRIMARY KEY,"
         "    value TEXT"
-        ");";
+        ");"
+        "CREATE TABLE IF NOT EXISTS note_links ("
+        "    source_note_id INTEGER NOT NULL,"
+        "    target_title TEXT NOT NULL COLLATE NOCASE,"
+        "    target_note_id INTEGER,"
+        "    PRIMARY KEY (source_note_id, target_title)"
+        ") WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS idx_note_links_target_note ON note_links(target_note_id);"
+        "CREATE INDEX IF NOT EXISTS idx_note_links_target_title ON note_links(target_title);"
+        "CREATE INDEX IF NOT EXISTS idx_notes_title_nocase ON notes(title COLLATE NOCASE);";
 
     char* errMsg = nullptr;
     int rc = sqlite3_exec(m_db, sql, nullptr, nullptr, &errMsg);
@@ -584,6 +1089,54 @@ bool Database::ToggleNoteType(int noteId, bool isChecklist) {
     return false;
 }
 
+bool Database::SetNoteSpellLanguage(int noteId, const std::string& locale) {
+    const char* sql = "UPDATE notes SET spell_language = ? WHERE id = ?";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, locale.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, noteId);
+        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+        sqlite3_finalize(stmt);
+        return success;
+    }
+    return false;
+}
+
+std::vector<std::string> Database::GetUserDictionaryWords() {
+    std::vector<std::string> words;
+    const char* sql = "SELECT word FROM user_dictionary ORDER BY added_at, word";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char* word = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            if (word) {
+                words.push_back(word);
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+    return words;
+}
+
+bool Database::AddUserDictionaryWord(const std::string& word) {
+    if (word.empty()) {
+        return false;
+    }
+
+    const char* sql = "INSERT OR IGNORE INTO user_dictionary (word) VALUES (?)";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, word.c_str(), -1, SQLITE_STATIC);
+        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+        sqlite3_finalize(stmt);
+        return success;
+    }
+    return false;
+}
+
 std::vector<std::string> Database::GetSearchHistory(int limit) {
     std::vector<std::string> history;
     const char* sql = "SELECT search_term FROM search_history ORDER BY last_used DESC LIMIT ?";
@@ -832,6 +1385,582 @@ bool Database::SetSetting(const std::string& key, const std::string& value) {
 }
 
 
+bool Database::CreateSyncJournal() {
+    // The journal needs SQLite's JSON functions; without them the database just doesn't sync by ops.
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, "SELECT json_object('a', 1)", -1, &stmt, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "CreateSyncJournal: JSON functions unavailable, op sync disabled\n");
+        return false;
+    }
+    sqlite3_finalize(stmt);
+
+    const char* schema =
+        "CREATE TABLE IF NOT EXISTS sync_state ("
+        "    id INTEGER PRIMARY KEY CHECK (id = 1),"
+        "    replica TEXT NOT NULL,"
+        "    hlc INTEGER NOT NULL DEFAULT 0,"
+        "    applying INTEGER NOT NULL DEFAULT 0"
+        ");"
+        "CREATE TABLE IF NOT EXISTS sync_rows ("
+        "    tbl TEXT NOT NULL,"
+        "    gid TEXT NOT NULL,"
+        "    local_id INTEGER,"
+        "    hlc INTEGER NOT NULL,"
+        "    origin TEXT NOT NULL,"
+        "    deleted INTEGER NOT NULL DEFAULT 0,"
+        "    PRIMARY KEY (tbl, gid)"
+        ") WITHOUT ROWID;"
+        "CREATE UNIQUE INDEX IF NOT EXISTS idx_sync_rows_local ON sync_rows(tbl, local_id);"
+        "CREATE TABLE IF NOT EXISTS change_log ("
+        "    seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "    tbl TEXT NOT NULL,"
+        "    gid TEXT NOT NULL,"
+        "    hlc INTEGER NOT NULL,"
+        "    origin TEXT NOT NULL,"
+        "    deleted INTEGER NOT NULL,"
+        "    payload TEXT"
+        ");"
+        "CREATE INDEX IF NOT EXISTS idx_change_log_row ON change_log(tbl, gid);";
+
+    if (!ExecSql("BEGIN", "CreateSyncJournal")) {
+        return false;
+    }
+    bool success = ExecSql(schema, "CreateSyncJournal");
+
+    // First run: give this replica an id and journal the rows that already exist, so the first
+    // push carries them. Their gids derive from the row, so copies of one database agree on them.
+    bool seeded = false;
+    if (success && sqlite3_prepare_v2(m_db, "SELECT 1 FROM sync_state", -1, &stmt, nullptr) == SQLITE_OK) {
+        seeded = (sqlite3_step(stmt) == SQLITE_ROW);
+        sqlite3_finalize(stmt);
+    }
+    if (success && !seeded) {
+        std::string seed = "INSERT INTO sync_state (id, replica, hlc, applying) VALUES (1, lower(hex(randomblob(8))), 0, 0);"
+            SYNC_CLOCK_TICK_SQL;
+        for (const SyncTable& table : kSyncTables) {
+            std::string name = table.name;
+            if (table.hasId) {
+                seed += "INSERT OR IGNORE INTO sync_rows (tbl, gid, local_id, hlc, origin, deleted) SELECT '" + name +
+                    "', 's' || id || '.' || COALESCE(" + table.seedKey + ", ''), id, (SELECT hlc FROM sync_state), "
+                    "(SELECT replica FROM sync_state), 0 FROM " + name + ";";
+            } else {
+                seed += "INSERT OR IGNORE INTO sync_rows (tbl, gid, local_id, hlc, origin, deleted) SELECT '" + name +
+                    "', g, NULL, hlc, replica, 0 FROM (SELECT " + SyncGidSql(table, name) + " AS g FROM " + name +
+                    "), sync_state WHERE g IS NOT NULL;";
+            }
+            seed += "INSERT INTO change_log (tbl, gid, hlc, origin, deleted, payload) SELECT '" + name +
+                "', g, hlc, replica, 0, p FROM (SELECT " + SyncGidSql(table, name) + " AS g, " +
+                SyncPayloadSql(table, name) + " AS p FROM " + name + "), sync_state WHERE g IS NOT NULL;";
+        }
+        success = ExecSql(seed.c_str(), "CreateSyncJournal");
+    }
+
+    // Triggers are recreated on every start, so older databases get the current ones; logs they
+    // wrote before entries were coalesced are compacted to each row's latest op.
+    for (const SyncTable& table : kSyncTables) {
+        if (success) {
+            success = ExecSql(SyncTriggersSql(table).c_str(), "CreateSyncJournal");
+        }
+    }
+    if (success) {
+        success = ExecSql("DELETE FROM change_log WHERE seq NOT IN (SELECT MAX(seq) FROM change_log GROUP BY tbl, gid)",
+                          "CreateSyncJournal");
+    }
+    if (!success || !ExecSql("COMMIT", "CreateSyncJournal")) {
+        ExecSql("ROLLBACK", "CreateSyncJournal");
+        return false;
+    }
+    return true;
+}
+
+std::string Database::GetSyncReplicaId() {
+    std::string replica;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, "SELECT replica FROM sync_state WHERE id = 1", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char* value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            if (value) replica = value;
+        }
+        sqlite3_finalize(stmt);
+    }
+    return replica;
+}
+
+bool Database::GetPendingSyncOps(long long afterSeq, std::vector<SyncOp>& outOps, long long& outLastSeq) {
+    outOps.clear();
+    outLastSeq = afterSeq;
+
+    // Only the latest op of each row: it carries the whole row, so the earlier ones add nothing.
+    const char* sql =
+        "SELECT c.tbl, c.gid, c.hlc, c.origin, c.deleted, c.payload FROM change_log c "
+        "WHERE c.seq > ?1 AND c.seq = (SELECT MAX(seq) FROM change_log d WHERE d.tbl = c.tbl AND d.gid = c.gid) "
+        "ORDER BY c.seq";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "GetPendingSyncOps prepare failed: %s\n", sqlite3_errmsg(m_db));
+        return false;
+    }
+    sqlite3_bind_int64(stmt, 1, afterSeq);
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        SyncOp op;
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        op.table = text ? text : "";
+        text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        op.gid = text ? text : "";
+        op.hlc = (uint64_t)sqlite3_column_int64(stmt, 2);
+        text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        op.origin = text ? text : "";
+        op.deleted = sqlite3_column_int(stmt, 4) != 0;
+        text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+        op.payload = text ? text : "";
+        outOps.push_back(std::move(op));
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        outOps.clear();
+        return false;
+    }
+
+    if (sqlite3_prepare_v2(m_db, "SELECT MAX(seq) FROM change_log", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+            outLastSeq = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    return true;
+}
+
+bool Database::PruneSyncLog(long long throughSeq) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, "DELETE FROM change_log WHERE seq <= ?", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, throughSeq);
+        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+        sqlite3_finalize(stmt);
+        return success;
+    }
+    return false;
+}
+
+bool Database::ApplySyncOps(const std::vector<SyncOp>& ops, int& outApplied) {
+    outApplied = 0;
+    if (!ExecSql("BEGIN IMMEDIATE", "ApplySyncOps")) {
+        return false;
+    }
+
+    bool success = ExecSql("UPDATE sync_state SET applying = 1 WHERE id = 1", "ApplySyncOps");
+    for (size_t i = 0; success && i < ops.size(); ++i) {
+        bool changed = false;
+        success = ApplySyncOp(ops[i], false, changed);
+        if (changed) ++outApplied;
+    }
+    if (success) {
+        success = ExecSql("UPDATE sync_state SET applying = 0 WHERE id = 1", "ApplySyncOps");
+    }
+    if (!success || !ExecSql("COMMIT", "ApplySyncOps")) {
+        ExecSql("ROLLBACK", "ApplySyncOps");
+        outApplied = 0;
+        return false;
+    }
+    return true;
+}
+
+// Applies one remote op if it is newer than what this replica has for the row, or regardless
+// with force. Ops that cannot apply (a table this version does not know, a parent that is gone)
+// are skipped, not errors.
+bool Database::ApplySyncOp(const SyncOp& op, bool force, bool& outChanged) {
+    outChanged = false;
+    const SyncTable* table = FindSyncTable(op.table);
+    if (!table || op.gid.empty()) {
+        return true;
+    }
+    std::string name = table->name;
+    sqlite3_stmt* stmt;
+
+    // Keep the clock ahead of every stamp seen, so local edits made after this one win over it.
+    if (sqlite3_prepare_v2(m_db, "UPDATE sync_state SET hlc = MAX(hlc, ?) WHERE id = 1", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)op.hlc);
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    if (!success) {
+        return false;
+    }
+
+    long long localId = 0;
+    bool hasLocalId = false;
+    if (sqlite3_prepare_v2(m_db, "SELECT local_id, hlc, origin FROM sync_rows WHERE tbl = ? AND gid = ?", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, op.gid.c_str(), -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        hasLocalId = sqlite3_column_type(stmt, 0) != SQLITE_NULL;
+        localId = sqlite3_column_int64(stmt, 0);
+        const char* origin = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        if (!force && !OpSync::Newer(op.hlc, op.origin, (uint64_t)sqlite3_column_int64(stmt, 1), origin ? origin : "")) {
+            sqlite3_finalize(stmt);
+            return true;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    // Statements below bind the payload as ?1 and, for rows with an id, the local id as ?2.
+    std::string sql;
+    bool exists = false;
+    if (table->hasId && hasLocalId) {
+        sql = "SELECT 1 FROM " + name + " WHERE id = ?";
+        if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            return false;
+        }
+        sqlite3_bind_int64(stmt, 1, localId);
+        exists = (sqlite3_step(stmt) == SQLITE_ROW);
+        sqlite3_finalize(stmt);
+    }
+
+    if (op.deleted) {
+        if (table->hasId) {
+            sql = exists ? "DELETE FROM " + name + " WHERE id = ?2" : "";
+        } else {
+            sql = "DELETE FROM " + name + " WHERE ";
+            for (int i = 0; i < table->keyColumns; ++i) {
+                if (i > 0) sql += " AND ";
+                sql += std::string("\"") + table->columns[i].name + "\" = " + SyncPayloadValueSql(table->columns[i]);
+            }
+        }
+    } else if (exists) {
+        sql = "UPDATE " + name + " SET ";
+        for (int i = 0; table->columns[i].name; ++i) {
+            if (i > 0) sql += ", ";
+            sql += std::string("\"") + table->columns[i].name + "\" = " + SyncPayloadValueSql(table->columns[i]);
+        }
+        sql += " WHERE id = ?2";
+    } else {
+        std::string columns;
+        std::string values;
+        for (int i = 0; table->columns[i].name; ++i) {
+            if (i > 0) {
+                columns += ", ";
+                values += ", ";
+            }
+            columns += std::string("\"") + table->columns[i].name + "\"";
+            values += SyncPayloadValueSql(table->columns[i]);
+        }
+        if (table->hasId && hasLocalId) {
+            // Deleted here but edited later elsewhere: bring it back under its old id, so rows
+            // that still refer to it attach again.
+            columns = "id, " + columns;
+            values = "?2, " + values;
+        }
+        if (table->hasId) {
+            sql = "INSERT INTO " + name + " (" + columns + ") VALUES (" + values + ")";
+        } else {
+            // A row keyed by parents whose rows this replica never had refers to nothing.
+            sql = "INSERT OR IGNORE INTO " + name + " (" + columns + ") SELECT " + values + " WHERE 1";
+            for (int i = 0; i < table->keyColumns; ++i) {
+                sql += " AND " + SyncPayloadValueSql(table->columns[i]) + " IS NOT NULL";
+            }
+        }
+    }
+
+    if (!sql.empty()) {
+        if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            fprintf(stderr, "ApplySyncOp prepare failed: %s\n", sqlite3_errmsg(m_db));
+            return false;
+        }
+        sqlite3_bind_text(stmt, 1, op.payload.c_str(), -1, SQLITE_STATIC);
+        if (table->hasId && hasLocalId) {
+            sqlite3_bind_int64(stmt, 2, localId);
+        }
+        int rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            // E.g. a checklist item whose note was deleted here: nothing to attach it to.
+            return true;
+        }
+        if (table->hasId && !op.deleted && !exists) {
+            localId = sqlite3_last_insert_rowid(m_db);
+            hasLocalId = true;
+        }
+    }
+
+    const char* versionSql =
+        "INSERT INTO sync_rows (tbl, gid, local_id, hlc, origin, deleted) VALUES (?, ?, ?, ?, ?, ?) "
+        "ON CONFLICT (tbl, gid) DO UPDATE SET local_id = excluded.local_id, hlc = excluded.hlc, "
+        "origin = excluded.origin, deleted = excluded.deleted";
+    if (sqlite3_prepare_v2(m_db, versionSql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, op.gid.c_str(), -1, SQLITE_STATIC);
+    if (hasLocalId) {
+        sqlite3_bind_int64(stmt, 3, localId);
+    } else {
+        sqlite3_bind_null(stmt, 3);
+    }
+    sqlite3_bind_int64(stmt, 4, (sqlite3_int64)op.hlc);
+    sqlite3_bind_text(stmt, 5, op.origin.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 6, op.deleted ? 1 : 0);
+    success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    if (!success) {
+        return false;
+    }
+
+    // Keep the [[link]] index in step with the notes, as CreateNote/UpdateNote/DeleteNote do.
+    if (name == "notes" && hasLocalId) {
+        int noteId = (int)localId;
+        if (op.deleted) {
+            if (sqlite3_prepare_v2(m_db, "DELETE FROM note_links WHERE source_note_id = ?", -1, &stmt, nullptr) == SQLITE_OK) {
+                sqlite3_bind_int(stmt, 1, noteId);
+                success = (sqlite3_step(stmt) == SQLITE_DONE);
+                sqlite3_finalize(stmt);
+            }
+            success = success && ResolveLinksToNote(noteId);
+        } else {
+            std::string title;
+            std::string content;
+            if (sqlite3_prepare_v2(m_db, "SELECT title, content FROM notes WHERE id = ?", -1, &stmt, nullptr) == SQLITE_OK) {
+                sqlite3_bind_int(stmt, 1, noteId);
+                if (sqlite3_step(stmt) == SQLITE_ROW) {
+                    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+                    title = text ? text : "";
+                    text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+                    content = text ? text : "";
+                }
+                sqlite3_finalize(stmt);
+            }
+            success = SyncNoteLinks(noteId, content) && ResolveLinksToNote(noteId) && ResolveLinksByTitle(title);
+        }
+    }
+    outChanged = success;
+    return success;
+}
+
+bool Database::MergeFrom(const std::string& otherPath, const std::string& basePath, MergeStats& outStats) {
+    outStats = MergeStats();
+    if (!AttachForMerge(otherPath, "merge_remote")) {
+        return false;
+    }
+    bool hasBase = !basePath.empty() && AttachForMerge(basePath, "merge_base");
+
+    // Not IMMEDIATE, which would lock the attached files for writing too: the first statement
+    // writes, which takes the lock on main alone.
+    bool success = ExecSql("BEGIN", "MergeFrom");
+    if (success) {
+        // The other copy's rows are its replica's changes, not ours: journal none of them. The
+        // conflict copies are new notes of this replica and are journaled like any other.
+        success = ExecSql("UPDATE sync_state SET applying = 1 WHERE id = 1", "MergeFrom");
+        std::vector<long long> conflicts;
+        for (const SyncTable& table : kSyncTables) {
+            if (success) {
+                success = MergeTable(table, hasBase, outStats, conflicts);
+            }
+        }
+        if (success) {
+            success = ExecSql("UPDATE sync_state SET applying = 0 WHERE id = 1", "MergeFrom");
+        }
+        for (size_t i = 0; success && i < conflicts.size(); ++i) {
+            bool added = false;
+            success = CopyAsConflict("merge_remote", conflicts[i], added);
+            if (added) ++outStats.conflicts;
+        }
+        if (!success || !ExecSql("COMMIT", "MergeFrom")) {
+            ExecSql("ROLLBACK", "MergeFrom");
+            outStats = MergeStats();
+            success = false;
+        }
+    }
+
+    ExecSql("DETACH DATABASE merge_remote", "MergeFrom");
+    if (hasBase) {
+        ExecSql("DETACH DATABASE merge_base", "MergeFrom");
+    }
+    return success;
+}
+
+// Attaches the database at path (which must exist) as schema, if it has a sync journal.
+bool Database::AttachForMerge(const std::string& path, const char* schema) {
+    sqlite3_stmt* stmt;
+    std::string sql = std::string("ATTACH DATABASE ? AS ") + schema;
+    if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+    bool attached = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    if (!attached) {
+        fprintf(stderr, "AttachForMerge: %s\n", sqlite3_errmsg(m_db));
+        return false;
+    }
+
+    bool journaled = false;
+    sql = std::string("SELECT 1 FROM ") + schema + ".sqlite_master WHERE name = 'sync_rows'";
+    if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+        journaled = (sqlite3_step(stmt) == SQLITE_ROW);
+        sqlite3_finalize(stmt);
+    }
+    if (!journaled) {
+        ExecSql((std::string("DETACH DATABASE ") + schema).c_str(), "AttachForMerge");
+    }
+    return journaled;
+}
+
+// Merges the rows of one table whose version in merge_remote differs from the base and from
+// main. Notes edited on both sides are left alone and returned by their merge_remote id.
+bool Database::MergeTable(const SyncTable& table, bool hasBase, MergeStats& stats, std::vector<long long>& outConflicts) {
+    std::string name = table.name;
+    auto differs = [](const char* a, const char* b) {
+        return std::string("(") + b + ".gid IS NULL OR " + a + ".hlc IS NOT " + b + ".hlc OR " + a + ".origin IS NOT " +
+            b + ".origin OR " + a + ".deleted IS NOT " + b + ".deleted)";
+    };
+    // The row as it travels, read from one side: by id, or by the key its gid is made of.
+    auto payload = [&](const std::string& schema, const char* version) {
+        std::string where = table.hasId ? std::string("t.id = ") + version + ".local_id"
+                                        : SyncGidSql(table, "t", schema) + " = " + version + ".gid";
+        return "(SELECT " + SyncPayloadSql(table, "t", schema) + " FROM " + schema + name + " t WHERE " + where + ")";
+    };
+
+    // A deleted row is gone from merge_remote; main still has its key columns for the delete.
+    std::string sql = "SELECT r.gid, r.hlc, r.origin, r.deleted, r.local_id, " + payload("merge_remote.", "r") + ", " +
+        payload("main.", "l") + ", " + (hasBase ? "l.gid IS NOT NULL AND " + differs("l", "b") : std::string("0")) +
+        ", l.deleted FROM merge_remote.sync_rows r ";
+    if (hasBase) {
+        sql += "LEFT JOIN merge_base.sync_rows b ON b.tbl = r.tbl AND b.gid = r.gid ";
+    }
+    sql += "LEFT JOIN main.sync_rows l ON l.tbl = r.tbl AND l.gid = r.gid WHERE r.tbl = '" + name + "' AND " +
+        differs("r", "l");
+    if (hasBase) {
+        sql += " AND " + differs("r", "b");
+    }
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "MergeTable prepare failed: %s\n", sqlite3_errmsg(m_db));
+        return false;
+    }
+    std::vector<SyncOp> ops;
+    std::vector<bool> forced;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        SyncOp op;
+        op.table = name;
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        op.gid = text ? text : "";
+        op.hlc = (uint64_t)sqlite3_column_int64(stmt, 1);
+        text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        op.origin = text ? text : "";
+        op.deleted = sqlite3_column_int(stmt, 3) != 0;
+        const char* remoteRow = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+        const char* localRow = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
+        bool changedHere = sqlite3_column_int(stmt, 7) != 0;
+        bool deletedHere = sqlite3_column_int(stmt, 8) != 0;
+        if (!remoteRow && !localRow) {
+            continue;
+        }
+        op.payload = remoteRow ? remoteRow : localRow;
+
+        if (changedHere && name == "notes" && !op.deleted && !deletedHere && remoteRow && localRow &&
+            std::string(remoteRow) != localRow) {
+            outConflicts.push_back(sqlite3_column_int64(stmt, 4));
+            continue;
+        }
+        ops.push_back(std::move(op));
+        // Changed there only: taken whatever the clocks say. Changed on both sides, or no base to
+        // tell: the later change wins.
+        forced.push_back(hasBase && !changedHere);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        return false;
+    }
+
+    for (size_t i = 0; i < ops.size(); ++i) {
+        bool changed = false;
+        if (!ApplySyncOp(ops[i], forced[i], changed)) {
+            return false;
+        }
+        if (changed) ++stats.rowsMerged;
+    }
+    return true;
+}
+
+bool Database::AddConflictCopy(long long noteId, bool& outAdded) {
+    outAdded = false;
+    if (!ExecSql("BEGIN", "AddConflictCopy")) {
+        return false;
+    }
+    if (!CopyAsConflict("main", noteId, outAdded) || !ExecSql("COMMIT", "AddConflictCopy")) {
+        ExecSql("ROLLBACK", "AddConflictCopy");
+        outAdded = false;
+        return false;
+    }
+    return true;
+}
+
+// Adds a version of a note as a new note, with its checklist items, tags and links, unless a copy
+// of it is here already (the same download merged again). schema holds that version: merge_remote
+// for a note edited on both sides during MergeFrom, main for AddConflictCopy.
+bool Database::CopyAsConflict(const char* schema, long long otherNoteId, bool& outAdded) {
+    outAdded = false;
+    std::string from = schema;
+    std::string noteSql =
+        "INSERT INTO notes (title, content, color_id, is_archived, is_pinned, is_checklist, created_at, modified_at, spell_language) "
+        "SELECT title || ' (conflict)', content, color_id, is_archived, is_pinned, is_checklist, created_at, modified_at, spell_language "
+        "FROM " + from + ".notes r WHERE id = ? AND NOT EXISTS (SELECT 1 FROM main.notes n "
+        "WHERE n.title = r.title || ' (conflict)' AND n.content IS r.content)";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(m_db, noteSql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "CopyAsConflict prepare failed: %s\n", sqlite3_errmsg(m_db));
+        return false;
+    }
+    sqlite3_bind_int64(stmt, 1, otherNoteId);
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    if (!success || sqlite3_changes(m_db) == 0) {
+        return success;
+    }
+    long long noteId = sqlite3_last_insert_rowid(m_db);
+    outAdded = true;
+
+    // Tags by gid: merge_remote's tags were merged first, so each has a row here.
+    const std::string childSql[] = {
+        "INSERT INTO checklist_items (note_id, item_text, is_checked, item_order) "
+        "SELECT ?2, item_text, is_checked, item_order FROM " + from + ".checklist_items WHERE note_id = ?1",
+        "INSERT OR IGNORE INTO note_tags (note_id, tag_id) SELECT ?2, l.local_id FROM " + from + ".note_tags t "
+        "JOIN " + from + ".sync_rows r ON r.tbl = 'tags' AND r.local_id = t.tag_id "
+        "JOIN main.sync_rows l ON l.tbl = 'tags' AND l.gid = r.gid AND l.deleted = 0 WHERE t.note_id = ?1",
+    };
+    for (const std::string& sql : childSql) {
+        if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            fprintf(stderr, "CopyAsConflict prepare failed: %s\n", sqlite3_errmsg(m_db));
+            return false;
+        }
+        sqlite3_bind_int64(stmt, 1, otherNoteId);
+        sqlite3_bind_int64(stmt, 2, noteId);
+        success = (sqlite3_step(stmt) == SQLITE_DONE);
+        sqlite3_finalize(stmt);
+        if (!success) {
+            return false;
+        }
+    }
+
+    std::string title;
+    std::string content;
+    if (sqlite3_prepare_v2(m_db, "SELECT title, content FROM notes WHERE id = ?", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, noteId);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            title = text ? text : "";
+            text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            content = text ? text : "";
+        }
+        sqlite3_finalize(stmt);
+    }
+    return SyncNoteLinks((int)noteId, content) && ResolveLinksByTitle(title);
+}
+
 void Database::Close() {
     if (m_db) {
         sqlite3_close(m_db);
@@ -1,9 +1,14 @@
 #pragma once
+#include <atomic>
+#include <functional>
 #include <string>
 #include <vector>
 #include <map>
 #include "sqlite3.h"
 #include "note.h"
+#include "sync_ops.h"
+
+struct SyncTable;
 
 class Database {
 public:
@@ -25,6 +30,28 @@ public:
         std::wstring snippet;
     };
 
+    struct NoteLinkRef {
+        int noteId;
+        std::string title;
+    };
+
+    // Moves on every write to the file: data_version counts other connections' commits,
+    // totalChanges the rows this one changed.
+    struct ChangeStamp {
+        long long dataVersion = -1;
+        long long totalChanges = -1;
+
+        bool operator==(const ChangeStamp& other) const {
+            return dataVersion == other.dataVersion && totalChanges == other.totalChanges;
+        }
+        bool operator!=(const ChangeStamp& other) const { return !(*this == other); }
+    };
+
+    struct MergeStats {
+        int rowsMerged = 0;   // Rows taken from the other copy
+        int conflicts = 0;    // Conflict copies added for notes edited on both sides
+    };
+
     enum class SortBy {
         DateModified,
         DateCreated,
@@ -34,6 +61,9 @@ public:
     Database();
     ~Database();
     bool Initialize(const std::string& dbPath);
+    // Opens an existing database for reading only, without schema setup or migrations; for
+    // worker threads that need a connection of their own.
+    bool InitializeReadOnly(const std::string& dbPath);
     void Close();
 
     std::vector<Note> GetAllNotes(bool includeArchived = false, SortBy sortBy = SortBy::DateModified);
@@ -55,6 +85,7 @@ public:
     bool ToggleChecklistItem(int itemId, bool isChecked);
     bool ReorderChecklistItem(int itemId, int newOrder);
     bool ToggleNoteType(int noteId, bool isChecklist);
+    bool SetNoteSpellLanguage(int noteId, const std::string& locale);   // Leaves modified_at alone
     
     // Search history methods
     std::vector<std::string> GetSearchHistory(int limit = 128);
@@ -72,6 +103,10 @@ public:
     bool AddTagToNote(int noteId, int tagId);
     bool RemoveTagFromNote(int noteId, int tagId);
 
+    // User dictionary methods (words added from the spelling context menu)
+    std::vector<std::string> GetUserDictionaryWords();
+    bool AddUserDictionaryWord(const std::string& word);
+
     // Snippet methods
     std::vector<Snippet> GetSnippets();
     bool CreateSnippet(Snippet& snippet);
@@ -79,16 +114,61 @@ public:
     bool DeleteSnippet(int id);
     bool TryGetSnippetByTrigger(const std::wstring& trigger, std::wstring& outSnippet);
 
+    // Note link methods ([[Title]] links are indexed on CreateNote/UpdateNote/DeleteNote)
+    std::vector<NoteLinkRef> GetBacklinks(int noteId);
+    int FindNoteIdByTitle(const std::string& title);
+
     // Settings methods
     std::string GetSetting(const std::string& key, const std::string& defaultValue = "");
     bool SetSetting(const std::string& key, const std::string& value);
 
-    // Creates a consistent snapshot of the current database into a new SQLite file.
-    bool BackupToFile(const std::string& destDbPath);
+    // A few microseconds; equal stamps mean nothing was written in between. Any thread.
+    ChangeStamp GetChangeStamp();
+
+    // Pages of a BackupToFile copied so far, out of the database's total.
+    typedef std::function<void(int copied, int total)> BackupProgress;
+
+    // Creates a consistent snapshot of the current database into a new SQLite file, a few pages
+    // at a time with pauses in between, so writes here go on meanwhile. Under WAL it reads in one
+    // transaction on a connection of its own; otherwise writes made meanwhile end up in the copy.
+    // progress is called on this thread after each step. False on failure or once cancel is set.
+    bool BackupToFile(const std::string& destDbPath, const std::atomic<bool>* cancel = nullptr,
+                      const BackupProgress& progress = BackupProgress());
+
+    // Op-based sync journal (see sync_ops.h); triggers keep each row's latest local change in change_log
+    std::string GetSyncReplicaId();
+    bool GetPendingSyncOps(long long afterSeq, std::vector<SyncOp>& outOps, long long& outLastSeq);
+    bool PruneSyncLog(long long throughSeq);
+    bool ApplySyncOps(const std::vector<SyncOp>& ops, int& outApplied);   // One transaction
+
+    // Three-way merge of another copy of this database (one downloaded by a restore) into this
+    // one, in one transaction. basePath is the copy both sides last synced from: rows changed
+    // only there are taken, rows changed only here kept, and a note edited on both sides keeps
+    // this edit and gets the other as a new note titled "<title> (conflict)", once however often
+    // the same copy is merged. Other conflicts go to the later change, as with ops. basePath
+    // empty when there is none: then every row that differs goes to the later change. Versions
+    // are compared in sync_rows, so only changed rows are read whole. False, with nothing
+    // changed, when otherPath has no sync journal.
+    bool MergeFrom(const std::string& otherPath, const std::string& basePath, MergeStats& outStats);
+
+    // Keeps the note as it is now as a new note "<title> (conflict)" with its checklist items,
+    // tags and links, the copy MergeFrom makes; outAdded false when that copy exists already.
+    // For a note changed elsewhere while the editor held unsaved edits to it.
+    bool AddConflictCopy(long long noteId, bool& outAdded);
 
 private:
     bool CreateSchema();
     bool InitializeColors();
+    bool ExecSql(const char* sql, const char* context);
+    bool CreateSyncJournal();
+    bool ApplySyncOp(const SyncOp& op, bool force, bool& outChanged);
+    bool AttachForMerge(const std::string& path, const char* schema);
+    bool MergeTable(const SyncTable& table, bool hasBase, MergeStats& stats, std::vector<long long>& outConflicts);
+    bool CopyAsConflict(const char* schema, long long otherNoteId, bool& outAdded);
+    bool IndexAllNoteLinks();
+    bool SyncNoteLinks(int noteId, const std::string& content);
+    bool ResolveLinksByTitle(const std::string& title);
+    bool ResolveLinksToNote(int noteId);
     sqlite3* m_db;
 };
 
@@ -0,0 +1,285 @@
+#include "dawg_dictionary.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+const char kMagic[8] = { 'N', 'S', 'F', 'D', 'A', 'W', 'G', '1' };
+const size_t kHeaderSize = 24;
+const uint32_t kMaxNodes = 1u << 24;
+
+uint32_t ReadU32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void AppendU32(std::vector<unsigned char>& out, uint32_t v) {
+    out.push_back((unsigned char)(v & 0xFF));
+    out.push_back((unsigned char)((v >> 8) & 0xFF));
+    out.push_back((unsigned char)((v >> 16) & 0xFF));
+    out.push_back((unsigned char)((v >> 24) & 0xFF));
+}
+
+struct BuildNode {
+    bool final = false;
+    std::vector<std::pair<unsigned char, uint32_t>> edges;   // label, registered node id
+};
+
+// Nodes with the same finality and the same outgoing edges are merged, so the signature is the
+// node's identity in the register.
+std::string Signature(const BuildNode& node) {
+    std::string sig;
+    sig.reserve(1 + node.edges.size() * 5);
+    sig.push_back(node.final ? '1' : '0');
+    for (const auto& edge : node.edges) {
+        sig.push_back((char)edge.first);
+        sig.append((const char*)&edge.second, sizeof(edge.second));
+    }
+    return sig;
+}
+
+} // namespace
+
+DawgDictionary::~DawgDictionary() {
+    Close();
+}
+
+bool DawgDictionary::Open(const std::wstring& path) {
+    Close();
+
+#ifdef _WIN32
+    m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(m_file, &size) || size.QuadPart < (LONGLONG)kHeaderSize || size.QuadPart > 0x7FFFFFFF) {
+        Close();
+        return false;
+    }
+    m_mapping = CreateFileMappingW(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!m_mapping) {
+        Close();
+        return false;
+    }
+    m_view = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_view) {
+        Close();
+        return false;
+    }
+    m_viewSize = (size_t)size.QuadPart;
+#else
+    // POSIX build (tests, tools): the path is taken as UTF-8.
+    std::string narrow;
+    for (wchar_t c : path) {
+        uint32_t cp = (uint32_t)c;
+        if (cp < 0x80) {
+            narrow.push_back((char)cp);
+        } else if (cp < 0x800) {
+            narrow.push_back((char)(0xC0 | (cp >> 6)));
+            narrow.push_back((char)(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            narrow.push_back((char)(0xE0 | (cp >> 12)));
+            narrow.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+            narrow.push_back((char)(0x80 | (cp & 0x3F)));
+        } else {
+            narrow.push_back((char)(0xF0 | (cp >> 18)));
+            narrow.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+            narrow.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+            narrow.push_back((char)(0x80 | (cp & 0x3F)));
+        }
+    }
+    int fd = open(narrow.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)kHeaderSize || st.st_size > 0x7FFFFFFF) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    m_view = view;
+    m_viewSize = (size_t)st.st_size;
+#endif
+
+    const unsigned char* data = (const unsigned char*)m_view;
+    uint64_t fileSize = m_viewSize;
+    uint32_t nodeCount = ReadU32(data + 8);
+    uint32_t edgeCount = ReadU32(data + 12);
+    uint64_t expected = kHeaderSize + ((uint64_t)nodeCount + 1 + edgeCount) * 4;
+    if (memcmp(data, kMagic, sizeof(kMagic)) != 0 || nodeCount == 0 || nodeCount > kMaxNodes || expected != fileSize) {
+        fprintf(stderr, "Invalid dictionary file\n");
+        Close();
+        return false;
+    }
+
+    m_nodeCount = nodeCount;
+    m_edgeCount = edgeCount;
+    m_wordCount = ReadU32(data + 16);
+    m_nodes = (const uint32_t*)(data + kHeaderSize);
+    m_edges = m_nodes + nodeCount + 1;
+    return true;
+}
+
+void DawgDictionary::Close() {
+#ifdef _WIN32
+    if (m_view) {
+        UnmapViewOfFile(m_view);
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = NULL;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_view) {
+        munmap(const_cast<void*>(m_view), m_viewSize);
+    }
+#endif
+    m_view = nullptr;
+    m_viewSize = 0;
+    m_nodes = nullptr;
+    m_edges = nullptr;
+    m_nodeCount = 0;
+    m_edgeCount = 0;
+    m_wordCount = 0;
+}
+
+bool DawgDictionary::Contains(const char* word, size_t length) const {
+    if (!m_nodes) {
+        return false;
+    }
+
+    uint32_t node = 0;
+    for (size_t i = 0; i < length; ++i) {
+        const uint32_t label = (unsigned char)word[i];
+        uint32_t lo = m_nodes[node] >> 1;
+        uint32_t hi = m_nodes[node + 1] >> 1;
+        if (hi > m_edgeCount || lo > hi) {
+            return false;
+        }
+        // Binary search over the node's edges, which are sorted by label.
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if ((m_edges[mid] & 0xFF) < label) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo == (m_nodes[node + 1] >> 1) || (m_edges[lo] & 0xFF) != label) {
+            return false;
+        }
+        node = m_edges[lo] >> 8;
+        if (node >= m_nodeCount) {
+            return false;
+        }
+    }
+    return (m_nodes[node] & 1) != 0;
+}
+
+bool DawgDictionary::Build(std::vector<std::string> words, std::vector<unsigned char>& out, std::string& error) {
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    if (!words.empty() && words.front().empty()) {
+        words.erase(words.begin());
+    }
+
+    // Incremental construction from sorted input (Daciuk et al.): only the path of the previous
+    // word is unregistered; the part no longer shared with the next word is merged into the
+    // register of equivalent nodes.
+    std::vector<BuildNode> registered;
+    std::unordered_map<std::string, uint32_t> index;
+    std::vector<BuildNode> path(1);
+    auto minimize = [&](size_t downTo) {
+        while (path.size() > downTo + 1) {
+            std::string sig = Signature(path.back());
+            auto it = index.find(sig);
+            uint32_t id;
+            if (it != index.end()) {
+                id = it->second;
+            } else {
+                id = (uint32_t)registered.size();
+                registered.push_back(std::move(path.back()));
+                index.emplace(std::move(sig), id);
+            }
+            path.pop_back();
+            path.back().edges.back().second = id;
+        }
+    };
+
+    std::string previous;
+    for (const std::string& word : words) {
+        size_t common = 0;
+        while (common < word.size() && common < previous.size() && word[common] == previous[common]) {
+            ++common;
+        }
+        minimize(common);
+        for (size_t i = common; i < word.size(); ++i) {
+            path.back().edges.push_back(std::make_pair((unsigned char)word[i], 0u));
+            path.emplace_back();
+        }
+        path.back().final = true;
+        previous = word;
+    }
+    minimize(0);
+
+    // The root stays unregistered; it becomes node 0 and registered node k becomes k + 1.
+    const uint64_t nodeCount = (uint64_t)registered.size() + 1;
+    if (nodeCount > kMaxNodes) {
+        error = "Too many automaton nodes (" + std::to_string(nodeCount) + ")";
+        return false;
+    }
+    uint64_t edgeCount = path[0].edges.size();
+    for (const BuildNode& node : registered) {
+        edgeCount += node.edges.size();
+    }
+    if (edgeCount >= 0x7FFFFFFF) {
+        error = "Too many automaton edges";
+        return false;
+    }
+
+    out.assign(kMagic, kMagic + sizeof(kMagic));
+    out.reserve(kHeaderSize + (size_t)(nodeCount + 1 + edgeCount) * 4);
+    AppendU32(out, (uint32_t)nodeCount);
+    AppendU32(out, (uint32_t)edgeCount);
+    AppendU32(out, (uint32_t)words.size());
+    AppendU32(out, 0);
+
+    uint32_t firstEdge = 0;
+    auto appendNode = [&](const BuildNode& node) {
+        AppendU32(out, (firstEdge << 1) | (node.final ? 1u : 0u));
+        firstEdge += (uint32_t)node.edges.size();
+    };
+    appendNode(path[0]);
+    for (const BuildNode& node : registered) {
+        appendNode(node);
+    }
+    AppendU32(out, firstEdge << 1);
+
+    auto appendEdges = [&](const BuildNode& node) {
+        for (const auto& edge : node.edges) {
+            AppendU32(out, ((edge.second + 1) << 8) | edge.first);
+        }
+    };
+    appendEdges(path[0]);
+    for (const BuildNode& node : registered) {
+        appendEdges(node);
+    }
+    return true;
+}
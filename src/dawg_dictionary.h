@@ -0,0 +1,49 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only set of UTF-8 words stored as a minimized DAWG (shared prefixes and suffixes), built
+// offline by tools/dict_compiler and memory-mapped at run time. Opening it maps the file instead of
+// parsing a dictionary, and only the pages a lookup touches are ever read.
+//
+// File layout (little-endian): a 24-byte header ("NSFDAWG1", node count, edge count, word count,
+// reserved), then nodeCount + 1 node words (first edge index << 1 | final bit; the extra entry
+// closes the last node's edge range), then edge words (target node << 8 | label byte), sorted by
+// label within a node. Node 0 is the root.
+class DawgDictionary {
+public:
+    DawgDictionary() = default;
+    ~DawgDictionary();
+    DawgDictionary(const DawgDictionary&) = delete;
+    DawgDictionary& operator=(const DawgDictionary&) = delete;
+
+    bool Open(const std::wstring& path);
+    void Close();
+    bool IsOpen() const { return m_nodes != nullptr; }
+
+    bool Contains(const char* word, size_t length) const;
+    uint32_t WordCount() const { return m_wordCount; }
+
+    // Builds the file image for words (UTF-8, any order, duplicates allowed). Fails when the
+    // automaton would not fit the 24-bit node index.
+    static bool Build(std::vector<std::string> words, std::vector<unsigned char>& out, std::string& error);
+
+private:
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = NULL;
+#endif
+    const void* m_view = nullptr;
+    size_t m_viewSize = 0;
+    const uint32_t* m_nodes = nullptr;
+    const uint32_t* m_edges = nullptr;
+    uint32_t m_nodeCount = 0;
+    uint32_t m_edgeCount = 0;
+    uint32_t m_wordCount = 0;
+};
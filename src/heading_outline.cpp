@@ -0,0 +1,261 @@
+#include "heading_outline.h"
+#include "markdown.h"
+#include <utility>
+
+struct HeadingOutline::Node {
+    size_t gap = 0;        // Distance from the previous entry (from 0 for the first one)
+    size_t sumGap = 0;     // Sum of gap over this subtree
+    size_t headings = 0;   // Headings in this subtree
+    size_t fences = 0;     // Fence delimiters in this subtree
+    unsigned int priority = 0;
+    int level = 0;         // 1..6 for headings, 0 for a fence delimiter
+    std::wstring text;
+    Node* left = nullptr;
+    Node* right = nullptr;
+};
+
+static bool IsLineBreak(wchar_t c) {
+    return c == L'\r' || c == L'\n';
+}
+
+HeadingOutline::~HeadingOutline() {
+    Clear();
+}
+
+void HeadingOutline::Clear() {
+    Destroy(m_root);
+    m_root = nullptr;
+}
+
+size_t HeadingOutline::SumGap(const Node* node) {
+    return node ? node->sumGap : 0;
+}
+
+size_t HeadingOutline::Headings(const Node* node) {
+    return node ? node->headings : 0;
+}
+
+size_t HeadingOutline::Fences(const Node* node) {
+    return node ? node->fences : 0;
+}
+
+void HeadingOutline::Update(Node* node) {
+    node->sumGap = SumGap(node->left) + node->gap + SumGap(node->right);
+    node->headings = Headings(node->left) + (node->level > 0 ? 1 : 0) + Headings(node->right);
+    node->fences = Fences(node->left) + (node->level == 0 ? 1 : 0) + Fences(node->right);
+}
+
+// left receives the entries before pos, right the rest. base is the offset the subtree's gaps
+// are relative to. The first entry of right keeps its gap relative to the last entry of left.
+void HeadingOutline::Split(Node* node, size_t base, size_t pos, Node*& left, Node*& right) {
+    if (!node) {
+        left = right = nullptr;
+        return;
+    }
+    size_t offset = base + SumGap(node->left) + node->gap;
+    if (offset < pos) {
+        Split(node->right, offset, pos, node->right, right);
+        left = node;
+    } else {
+        Split(node->left, base, pos, left, node->left);
+        right = node;
+    }
+    Update(node);
+}
+
+HeadingOutline::Node* HeadingOutline::Merge(Node* left, Node* right) {
+    if (!left) return right;
+    if (!right) return left;
+    if (left->priority > right->priority) {
+        left->right = Merge(left->right, right);
+        Update(left);
+        return left;
+    }
+    right->left = Merge(left, right->left);
+    Update(right);
+    return right;
+}
+
+void HeadingOutline::Destroy(Node* node) {
+    if (!node) {
+        return;
+    }
+    Destroy(node->left);
+    Destroy(node->right);
+    delete node;
+}
+
+void HeadingOutline::SetFirstGap(Node* node, size_t gap) {
+    if (node->left) {
+        SetFirstGap(node->left, gap);
+    } else {
+        node->gap = gap;
+    }
+    Update(node);
+}
+
+void HeadingOutline::Collect(const Node* node, size_t base, std::vector<OutlineHeading>& out) {
+    if (!node) {
+        return;
+    }
+    Collect(node->left, base, out);
+    size_t offset = base + SumGap(node->left) + node->gap;
+    if (node->level > 0) {
+        OutlineHeading heading;
+        heading.offset = offset;
+        heading.level = node->level;
+        heading.text = node->text;
+        out.push_back(std::move(heading));
+    }
+    Collect(node->right, offset, out);
+}
+
+HeadingOutline::Node* HeadingOutline::NewNode(size_t gap, int level, std::wstring text) {
+    // xorshift32; only used to keep the treap balanced.
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+
+    Node* node = new Node();
+    node->gap = gap;
+    node->priority = m_seed;
+    node->level = level;
+    node->text = std::move(text);
+    Update(node);
+    return node;
+}
+
+bool HeadingOutline::ScanLines(const wchar_t* text, size_t start, size_t end, bool inFence, size_t lastOffset,
+                               Node*& out, size_t& outLastOffset, bool trackFences) {
+    wchar_t fenceChar = 0;
+    size_t fenceLength = 0;
+    size_t pos = start;
+    while (pos < end) {
+        // The \n of a \r\n pair belongs to the previous line.
+        if (text[pos] == L'\n' && pos > 0 && text[pos - 1] == L'\r') {
+            ++pos;
+            continue;
+        }
+        size_t lineEnd = pos;
+        while (lineEnd < end && !IsLineBreak(text[lineEnd])) {
+            ++lineEnd;
+        }
+
+        std::wstring line(text + pos, lineEnd - pos);
+        wchar_t lineFenceChar = 0;
+        size_t lineFenceLength = 0;
+        std::wstring info;
+        if (Markdown::ParseMarkdownFence(line, lineFenceChar, lineFenceLength, &info)) {
+            if (!trackFences) {
+                return false;
+            }
+            bool delimiter = false;
+            if (!inFence) {
+                fenceChar = lineFenceChar;
+                fenceLength = lineFenceLength;
+                delimiter = true;
+            } else if (lineFenceChar == fenceChar && lineFenceLength >= fenceLength && info.empty()) {
+                delimiter = true;
+            }
+            if (delimiter) {
+                inFence = !inFence;
+                out = Merge(out, NewNode(pos - lastOffset, 0, std::wstring()));
+                lastOffset = pos;
+            }
+        } else if (!inFence && !line.empty() && line[0] != L'\t' && line.compare(0, 4, L"    ") != 0) {
+            // Four spaces of indentation make it indented code, not a heading.
+            std::wstring headingText;
+            int level = Markdown::ParseAtxHeading(Markdown::TrimLeft(line), headingText);
+            if (level > 0) {
+                out = Merge(out, NewNode(pos - lastOffset, level, Markdown::TrimSpaces(headingText)));
+                lastOffset = pos;
+            }
+        }
+        pos = lineEnd + 1;
+    }
+    outLastOffset = lastOffset;
+    return true;
+}
+
+void HeadingOutline::Rebuild(const wchar_t* text, size_t length) {
+    Clear();
+    size_t lastOffset = 0;
+    ScanLines(text, 0, length, false, 0, m_root, lastOffset, true);
+}
+
+bool HeadingOutline::ApplyEdit(const wchar_t* text, size_t length, const TextEdit& edit) {
+    if (edit.Empty()) {
+        return true;
+    }
+
+    // Touched lines: from the start of the line holding offset to the end of the line holding the
+    // end of the inserted text. Everything outside is unchanged apart from the shift after it.
+    size_t lineStart = edit.offset;
+    while (lineStart > 0 && !IsLineBreak(text[lineStart - 1])) {
+        --lineStart;
+    }
+    size_t lineEnd = edit.offset + edit.inserted;
+    while (lineEnd < length && !IsLineBreak(text[lineEnd])) {
+        ++lineEnd;
+    }
+    size_t oldLineEnd = lineEnd - edit.inserted + edit.removed;
+
+    Node* before = nullptr;
+    Node* rest = nullptr;
+    Node* touched = nullptr;
+    Node* after = nullptr;
+    Split(m_root, 0, lineStart, before, rest);
+    size_t beforeEnd = SumGap(before);   // Offset of the last entry before the touched lines
+    Split(rest, beforeEnd, oldLineEnd + 1, touched, after);
+
+    Node* added = nullptr;
+    size_t lastOffset = beforeEnd;
+    bool inFence = (Fences(before) % 2) != 0;
+    if (Fences(touched) > 0 || !ScanLines(text, lineStart, lineEnd, inFence, beforeEnd, added, lastOffset, false)) {
+        Destroy(added);
+        m_root = Merge(before, Merge(touched, after));
+        return false;
+    }
+
+    if (after) {
+        // Only the first entry after the edit stores a distance that crosses it.
+        const Node* first = after;
+        while (first->left) {
+            first = first->left;
+        }
+        size_t oldOffset = beforeEnd + SumGap(touched) + first->gap;
+        size_t newOffset = oldOffset - edit.removed + edit.inserted;
+        SetFirstGap(after, newOffset - lastOffset);
+    }
+
+    Destroy(touched);
+    m_root = Merge(Merge(before, added), after);
+    return true;
+}
+
+size_t HeadingOutline::Count() const {
+    return Headings(m_root);
+}
+
+void HeadingOutline::GetHeadings(std::vector<OutlineHeading>& out) const {
+    out.clear();
+    out.reserve(Count());
+    Collect(m_root, 0, out);
+}
+
+int HeadingOutline::FindHeadingAt(size_t offset) const {
+    size_t count = 0;
+    size_t base = 0;
+    const Node* node = m_root;
+    while (node) {
+        size_t nodeOffset = base + SumGap(node->left) + node->gap;
+        if (nodeOffset <= offset) {
+            count += Headings(node->left) + (node->level > 0 ? 1 : 0);
+            base = nodeOffset;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return (int)count - 1;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "text_edit.h"
+
+struct OutlineHeading {
+    size_t offset = 0;   // Start of the heading line
+    int level = 0;       // 1..6
+    std::wstring text;
+};
+
+// Index of the ATX headings ("# Title") of one markdown text, kept up to date from edits.
+// Entries live in a treap ordered by position where every node stores its distance to the
+// previous entry, so an edit rescans only the lines it touched and shifts all later headings by
+// fixing a single distance: O(changed lines + log n). Code fence delimiters are indexed too, so
+// '#' lines inside fenced code are not headings. Line breaks may be \r, \n or \r\n.
+class HeadingOutline {
+public:
+    HeadingOutline() = default;
+    ~HeadingOutline();
+    HeadingOutline(const HeadingOutline&) = delete;
+    HeadingOutline& operator=(const HeadingOutline&) = delete;
+
+    void Clear();
+    void Rebuild(const wchar_t* text, size_t length);
+
+    // Applies edit, where text/length is the text after the edit. Returns false (leaving the
+    // index unchanged) when the edit adds or removes a code fence delimiter; the caller then
+    // has to Rebuild() since that can change every line after it.
+    bool ApplyEdit(const wchar_t* text, size_t length, const TextEdit& edit);
+
+    size_t Count() const;
+    void GetHeadings(std::vector<OutlineHeading>& out) const;
+
+    // Index (into GetHeadings order) of the last heading starting at or before offset, or -1.
+    int FindHeadingAt(size_t offset) const;
+
+private:
+    struct Node;
+
+    static size_t SumGap(const Node* node);
+    static size_t Headings(const Node* node);
+    static size_t Fences(const Node* node);
+    static void Update(Node* node);
+    static void Split(Node* node, size_t base, size_t pos, Node*& left, Node*& right);
+    static Node* Merge(Node* left, Node* right);
+    static void Destroy(Node* node);
+    static void SetFirstGap(Node* node, size_t gap);
+    static void Collect(const Node* node, size_t base, std::vector<OutlineHeading>& out);
+
+    // Appends the entries found in the lines of [start, end) to out. With trackFences, fence
+    // delimiters are indexed; without it, any fence line makes the scan fail.
+    bool ScanLines(const wchar_t* text, size_t start, size_t end, bool inFence, size_t lastOffset,
+                   Node*& out, size_t& outLastOffset, bool trackFences);
+    Node* NewNode(size_t gap, int level, std::wstring text);
+
+    Node* m_root = nullptr;
+    unsigned int m_seed = 0x9E3779B9u;
+};
@@ -0,0 +1,549 @@
+#define NOMINMAX
+#include "html_document.h"
+#include "markdown.h"
+#include "markdown_chunks.h"
+#include "code_highlight.h"
+#include "utils.h"
+#include <algorithm>
+#include <cwchar>
+#include <cwctype>
+
+namespace {
+
+const size_t kWriteChunkBytes = 64 * 1024;
+
+// CSS class per CodeHighlight::TokenKind (Text gets no span).
+const char* const kTokenClasses[CodeHighlight::kTokenKindCount] = {
+    nullptr, "kw", "str", "com", "num", "pre", "var"
+};
+
+const char kDocumentStyle[] =
+    "body{font-family:Segoe UI,Arial,sans-serif;max-width:860px;margin:2em auto;padding:0 1em;line-height:1.5;color:#000}"
+    "pre{font-family:Consolas,monospace;background:#f6f6f6;padding:.6em .8em;overflow:auto}"
+    "table{border-collapse:collapse}td,th{border:1px solid #d9d9d9;padding:.2em .6em}"
+    "blockquote{margin-left:0;padding-left:1em;border-left:3px solid #d9d9d9;color:#444}"
+    "ul.checklist{list-style:none;padding-left:0}.wikilink{color:#0000ee;border-bottom:1px dotted #0000ee}footer{margin-top:2em;color:#777;font-size:.85em}"
+    ".kw{color:#0000c0}.str{color:#a31515}.com{color:#008000}.num{color:#098658}.pre{color:#804080}.var{color:#0070a0}";
+
+// Buffers UTF-8 output and hands it to the sink in kWriteChunkBytes pieces.
+class Writer {
+public:
+    Writer(const HtmlDocument::Sink& sink, const HtmlDocument::LinkTargets* links) : m_sink(sink), m_links(links) {
+        m_buf.reserve(kWriteChunkBytes + 1024);
+    }
+
+    bool Ok() const { return m_ok; }
+
+    const HtmlDocument::LinkTargets* Links() const { return m_links; }
+
+    void Raw(const char* s) {
+        m_buf += s;
+        MaybeFlush();
+    }
+
+    void Raw(const std::string& s) {
+        m_buf += s;
+        MaybeFlush();
+    }
+
+    // Escapes and converts UTF-16 to UTF-8 in the same pass.
+    void Text(const wchar_t* s, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            unsigned int c = (unsigned int)s[i];
+            if (c < 0x80) {
+                AppendEscapedAscii((char)c);
+                continue;
+            }
+            if (c >= 0xD800 && c <= 0xDBFF && i + 1 < len && s[i + 1] >= 0xDC00 && s[i + 1] <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + ((unsigned int)s[i + 1] - 0xDC00);
+                ++i;
+            } else if (c >= 0xD800 && c <= 0xDFFF) {
+                c = 0xFFFD; // Unpaired surrogate
+            }
+            AppendUtf8(c);
+        }
+        MaybeFlush();
+    }
+
+    void Text(const std::wstring& s) {
+        Text(s.c_str(), s.size());
+    }
+
+    // Escapes text that is already UTF-8 (note titles, checklist items).
+    void TextUtf8(const std::string& s) {
+        for (char ch : s) {
+            AppendEscapedAscii(ch);
+        }
+        MaybeFlush();
+    }
+
+    bool Flush() {
+        if (m_ok && !m_buf.empty() && !m_sink(m_buf.data(), m_buf.size())) {
+            m_ok = false;
+        }
+        m_buf.clear();
+        return m_ok;
+    }
+
+private:
+    void MaybeFlush() {
+        if (m_buf.size() >= kWriteChunkBytes) {
+            Flush();
+        }
+    }
+
+    void AppendEscapedAscii(char ch) {
+        switch (ch) {
+            case '&': m_buf += "&amp;"; break;
+            case '<': m_buf += "&lt;"; break;
+            case '>': m_buf += "&gt;"; break;
+            case '"': m_buf += "&quot;"; break;
+            case '\'': m_buf += "&#39;"; break;
+            case '\r': break;
+            default: m_buf.push_back(ch); break;
+        }
+    }
+
+    void AppendUtf8(unsigned int c) {
+        if (c < 0x800) {
+            m_buf.push_back((char)(0xC0 | (c >> 6)));
+            m_buf.push_back((char)(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            m_buf.push_back((char)(0xE0 | (c >> 12)));
+            m_buf.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            m_buf.push_back((char)(0x80 | (c & 0x3F)));
+        } else {
+            m_buf.push_back((char)(0xF0 | (c >> 18)));
+            m_buf.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+            m_buf.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            m_buf.push_back((char)(0x80 | (c & 0x3F)));
+        }
+    }
+
+    const HtmlDocument::Sink& m_sink;
+    const HtmlDocument::LinkTargets* m_links;
+    std::string m_buf;
+    bool m_ok = true;
+};
+
+void WriteInline(Writer& w, const std::wstring& text) {
+    auto runs = Markdown::ParseInlineMarkdown(text);
+    for (const auto& run : runs) {
+        // Other schemes (javascript:, data:, file: ...) would run or open something from a page
+        // the user only meant to read: their text is written without the link.
+        const bool link = run.link && !run.url.empty() && Markdown::IsSafeLinkUrl(run.url);
+        // A link to another exported note points at its file.
+        const std::string noteHref = (!run.wikiTarget.empty() && w.Links()) ? w.Links()->HrefFor(run.wikiTarget) : std::string();
+        if (link) {
+            w.Raw("<a href=\"");
+            w.Text(Markdown::EnsureUrlHasScheme(run.url));
+            w.Raw("\">");
+        } else if (!noteHref.empty()) {
+            w.Raw("<a class=\"wikilink\" href=\"");
+            w.Raw(noteHref);
+            w.Raw("\">");
+        } else if (!run.wikiTarget.empty()) {
+            w.Raw("<span class=\"wikilink\" title=\"");
+            w.Text(run.wikiTarget);
+            w.Raw("\">");
+        }
+        if (run.bold) w.Raw("<strong>");
+        if (run.italic) w.Raw("<em>");
+        if (run.strike) w.Raw("<del>");
+        w.Text(run.text);
+        if (run.strike) w.Raw("</del>");
+        if (run.italic) w.Raw("</em>");
+        if (run.bold) w.Raw("</strong>");
+        if (link || !noteHref.empty()) {
+            w.Raw("</a>");
+        } else if (!run.wikiTarget.empty()) {
+            w.Raw("</span>");
+        }
+    }
+}
+
+void WriteCodeBlock(Writer& w, const std::wstring& code, const std::wstring& info) {
+    CodeHighlight::Language language = CodeHighlight::LanguageFromInfoString(info);
+    std::vector<CodeHighlight::Run> runs;
+    CodeHighlight::Lex(language, code.c_str(), code.size(), runs);
+
+    w.Raw("<pre><code>");
+    for (const auto& run : runs) {
+        const char* cls = kTokenClasses[(int)run.kind];
+        if (cls) {
+            w.Raw("<span class=\"");
+            w.Raw(cls);
+            w.Raw("\">");
+        }
+        w.Text(code.c_str() + run.start, run.length);
+        if (cls) {
+            w.Raw("</span>");
+        }
+    }
+    w.Raw("</code></pre>\n");
+}
+
+void WriteTableRow(Writer& w, const std::vector<std::wstring>& cells, size_t colCount, bool header) {
+    w.Raw("<tr>");
+    for (size_t c = 0; c < colCount; ++c) {
+        w.Raw(header ? "<th>" : "<td>");
+        if (c < cells.size()) {
+            WriteInline(w, cells[c]);
+        }
+        w.Raw(header ? "</th>" : "</td>");
+    }
+    w.Raw("</tr>\n");
+}
+
+// 1 = unordered ("- ", "* ", "+ "), 2 = ordered ("1. ", "1) "), 0 = not a list item.
+int ParseListItem(const std::wstring& trimmed, std::wstring& text) {
+    if (trimmed.size() >= 2 && (trimmed[0] == L'-' || trimmed[0] == L'*' || trimmed[0] == L'+') && trimmed[1] == L' ') {
+        text = trimmed.substr(2);
+        return 1;
+    }
+    size_t digits = 0;
+    while (digits < trimmed.size() && iswdigit(trimmed[digits])) {
+        digits++;
+    }
+    if (digits > 0 && digits + 1 < trimmed.size() && (trimmed[digits] == L'.' || trimmed[digits] == L')') && trimmed[digits + 1] == L' ') {
+        text = trimmed.substr(digits + 2);
+        return 2;
+    }
+    return 0;
+}
+
+struct BlockState {
+    bool inParagraph = false;
+    int listKind = 0;     // see ParseListItem
+    bool inQuote = false;
+};
+
+void CloseParagraph(Writer& w, BlockState& st) {
+    if (st.inParagraph) {
+        w.Raw("</p>\n");
+        st.inParagraph = false;
+    }
+}
+
+void CloseList(Writer& w, BlockState& st) {
+    if (st.listKind != 0) {
+        w.Raw(st.listKind == 2 ? "</ol>\n" : "</ul>\n");
+        st.listKind = 0;
+    }
+}
+
+void CloseQuote(Writer& w, BlockState& st) {
+    if (st.inQuote) {
+        w.Raw("</blockquote>\n");
+        st.inQuote = false;
+    }
+}
+
+void CloseBlocks(Writer& w, BlockState& st) {
+    CloseParagraph(w, st);
+    CloseList(w, st);
+    CloseQuote(w, st);
+}
+
+void WriteMarkdownLines(Writer& w, const std::vector<std::wstring>& lines, BlockState& st) {
+    for (size_t lineIndex = 0; lineIndex < lines.size(); ++lineIndex) {
+        const std::wstring& rawLine = lines[lineIndex];
+        std::wstring trimmed = Markdown::TrimLeft(rawLine);
+
+        if (st.inQuote && (trimmed.empty() || trimmed[0] != L'>')) {
+            CloseQuote(w, st);
+        }
+
+        wchar_t fenceChar = 0;
+        size_t fenceLength = 0;
+        std::wstring fenceInfo;
+        if (Markdown::ParseMarkdownFence(rawLine, fenceChar, fenceLength, &fenceInfo)) {
+            CloseBlocks(w, st);
+            std::wstring code;
+            size_t j = lineIndex + 1;
+            while (j < lines.size()) {
+                wchar_t closeChar = 0;
+                size_t closeLength = 0;
+                std::wstring closeInfo;
+                if (Markdown::ParseMarkdownFence(lines[j], closeChar, closeLength, &closeInfo) &&
+                    closeChar == fenceChar && closeLength >= fenceLength && closeInfo.empty()) {
+                    break;
+                }
+                if (j > lineIndex + 1) {
+                    code += L'\n';
+                }
+                code += lines[j];
+                j++;
+            }
+            WriteCodeBlock(w, code, fenceInfo);
+            lineIndex = (j < lines.size()) ? j : lines.size() - 1;
+            continue;
+        }
+
+        if (!st.inParagraph && st.listKind == 0 && Markdown::IsIndentedCodeLine(rawLine) &&
+            (lineIndex == 0 || Markdown::TrimLeft(lines[lineIndex - 1]).empty())) {
+            CloseBlocks(w, st);
+            std::wstring code = Markdown::StripCodeIndent(rawLine);
+            size_t lastCodeLine = lineIndex;
+            for (size_t j = lineIndex + 1; j < lines.size(); ++j) {
+                if (Markdown::IsIndentedCodeLine(lines[j])) {
+                    for (size_t k = lastCodeLine + 1; k <= j; ++k) {
+                        code += L'\n';
+                        code += Markdown::StripCodeIndent(lines[k]);
+                    }
+                    lastCodeLine = j;
+                } else if (!Markdown::TrimLeft(lines[j]).empty()) {
+                    break;
+                }
+            }
+            WriteCodeBlock(w, code, L"");
+            lineIndex = lastCodeLine;
+            continue;
+        }
+
+        if (trimmed.empty()) {
+            CloseBlocks(w, st);
+            continue;
+        }
+
+        if (Markdown::LooksLikeMarkdownTableRow(trimmed) && lineIndex + 1 < lines.size() &&
+            Markdown::LooksLikeMarkdownTableSeparator(Markdown::TrimLeft(lines[lineIndex + 1]))) {
+            CloseBlocks(w, st);
+            std::vector<std::wstring> headerCells = Markdown::SplitMarkdownTableRow(trimmed);
+            std::vector<std::vector<std::wstring>> bodyRows;
+            size_t j = lineIndex + 2;
+            while (j < lines.size()) {
+                std::wstring t = Markdown::TrimLeft(lines[j]);
+                if (t.empty() || !Markdown::LooksLikeMarkdownTableRow(t)) break;
+                if (!Markdown::LooksLikeMarkdownTableSeparator(t)) {
+                    bodyRows.push_back(Markdown::SplitMarkdownTableRow(t));
+                }
+                j++;
+            }
+
+            size_t colCount = headerCells.size();
+            for (const auto& r : bodyRows) {
+                colCount = std::max(colCount, r.size());
+            }
+            w.Raw("<table>\n<thead>\n");
+            WriteTableRow(w, headerCells, colCount, true);
+            w.Raw("</thead>\n<tbody>\n");
+            for (const auto& r : bodyRows) {
+                WriteTableRow(w, r, colCount, false);
+            }
+            w.Raw("</tbody>\n</table>\n");
+            lineIndex = j - 1;
+            continue;
+        }
+
+        if (Markdown::IsHorizontalRule(trimmed)) {
+            CloseBlocks(w, st);
+            w.Raw("<hr>\n");
+            continue;
+        }
+
+        std::wstring text;
+        int headerLevel = Markdown::ParseAtxHeading(trimmed, text);
+        if (headerLevel > 0) {
+            CloseBlocks(w, st);
+            std::string tag = "h" + std::to_string(headerLevel);
+            w.Raw("<" + tag + ">");
+            WriteInline(w, text);
+            w.Raw("</" + tag + ">\n");
+            continue;
+        }
+
+        if (trimmed[0] == L'>') {
+            if (!st.inQuote) {
+                CloseBlocks(w, st);
+                w.Raw("<blockquote>\n");
+                st.inQuote = true;
+            } else {
+                w.Raw("<br>\n");
+            }
+            WriteInline(w, Markdown::TrimLeft(trimmed.substr(1)));
+            continue;
+        }
+
+        int listKind = ParseListItem(trimmed, text);
+        if (listKind != 0) {
+            CloseParagraph(w, st);
+            if (st.listKind != listKind) {
+                CloseList(w, st);
+                w.Raw(listKind == 2 ? "<ol>\n" : "<ul>\n");
+                st.listKind = listKind;
+            }
+            w.Raw("<li>");
+            WriteInline(w, text);
+            w.Raw("</li>\n");
+            continue;
+        }
+
+        // Plain paragraph line: consecutive lines join; two trailing spaces force a break.
+        CloseList(w, st);
+        if (!st.inParagraph) {
+            w.Raw("<p>");
+            st.inParagraph = true;
+        } else {
+            w.Raw("\n");
+        }
+        bool hardBreak = Markdown::HasMarkdownHardBreak(rawLine);
+        WriteInline(w, hardBreak ? Markdown::TrimRightSpaces(trimmed) : trimmed);
+        if (hardBreak) {
+            w.Raw("<br>");
+        }
+    }
+}
+
+void WriteMarkdownBody(Writer& w, std::wstring markdown) {
+    // Convert block by block so working memory is bounded by the chunk size, not the note.
+    MarkdownChunkScheduler chunks;
+    unsigned int generation = chunks.Reset(std::move(markdown));
+    MarkdownChunkLimits limits;
+    limits.minChars = 64 * 1024;
+    limits.maxChars = 512 * 1024;
+
+    BlockState st;
+    std::vector<std::wstring> lines;
+    while (w.Ok() && chunks.NextChunk(generation, limits, lines)) {
+        WriteMarkdownLines(w, lines, st);
+    }
+    CloseBlocks(w, st);
+}
+
+void WriteDocumentStart(Writer& w, const std::string& titleUtf8) {
+    w.Raw("<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>");
+    w.TextUtf8(titleUtf8);
+    w.Raw("</title>\n<style>");
+    w.Raw(kDocumentStyle);
+    w.Raw("</style>\n</head>\n<body>\n");
+}
+
+void WriteDocumentEnd(Writer& w) {
+    w.Raw("</body>\n</html>\n");
+}
+
+void WriteNoteDocument(Writer& w, const Note& note) {
+    WriteDocumentStart(w, note.title);
+    w.Raw("<article>\n");
+
+    if (note.is_checklist) {
+        w.Raw("<h1>");
+        w.TextUtf8(note.title);
+        w.Raw("</h1>\n<ul class=\"checklist\">\n");
+        for (const auto& item : note.checklist_items) {
+            w.Raw(item.is_checked ? "<li><input type=\"checkbox\" disabled checked> " : "<li><input type=\"checkbox\" disabled> ");
+            w.TextUtf8(item.item_text);
+            w.Raw("</li>\n");
+        }
+        w.Raw("</ul>\n");
+    } else {
+        WriteMarkdownBody(w, Utils::Utf8ToWide(note.content));
+    }
+
+    w.Raw("</article>\n<footer>Created ");
+    w.TextUtf8(note.created_at);
+    w.Raw(" &middot; Modified ");
+    w.TextUtf8(note.modified_at);
+    w.Raw("</footer>\n");
+    WriteDocumentEnd(w);
+}
+
+// Link titles compare as SQLite's NOCASE does: ASCII letters only.
+std::string FoldTitle(std::string title) {
+    for (char& c : title) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    }
+    return title;
+}
+
+} // namespace
+
+namespace HtmlDocument {
+
+void LinkTargets::Add(const Note& note, const std::wstring& fileName) {
+    auto inserted = m_byTitle.emplace(FoldTitle(note.title), std::make_pair(note.id, std::string()));
+    if (inserted.second || note.id < inserted.first->second.first) {
+        inserted.first->second = std::make_pair(note.id, UrlEncodePath(fileName));
+    }
+}
+
+std::string LinkTargets::HrefFor(const std::wstring& title) const {
+    auto it = m_byTitle.find(FoldTitle(Utils::WideToUtf8(title)));
+    return it == m_byTitle.end() ? std::string() : it->second.second;
+}
+
+std::string UrlEncodePath(const std::wstring& name) {
+    static const char kHex[] = "0123456789ABCDEF";
+    std::string utf8 = Utils::WideToUtf8(name);
+    std::string out;
+    out.reserve(utf8.size() * 3);
+    for (unsigned char c : utf8) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+            c == '-' || c == '_' || c == '.' || c == '~') {
+            out.push_back((char)c);
+        } else {
+            out.push_back('%');
+            out.push_back(kHex[c >> 4]);
+            out.push_back(kHex[c & 0x0F]);
+        }
+    }
+    return out;
+}
+
+std::wstring FileNameForNote(const Note& note) {
+    std::wstring title = Utils::Utf8ToWide(note.title);
+    if (title.size() > 48) {
+        title.resize(48);
+        // Don't leave half of a surrogate pair at the cut.
+        if (title.back() >= 0xD800 && title.back() <= 0xDBFF) {
+            title.pop_back();
+        }
+    }
+    for (auto& c : title) {
+        if (c < 0x20 || wcschr(L"<>:\"/\\|?*", c)) c = L'_';
+    }
+    while (!title.empty() && (title.back() == L'.' || title.back() == L' ')) {
+        title.pop_back();
+    }
+    if (title.empty()) {
+        title = L"note";
+    }
+    // The id keeps names unique even when titles collide.
+    return title + L"-" + std::to_wstring(note.id) + L".html";
+}
+
+bool WriteNote(const Note& note, const LinkTargets* links, const Sink& sink) {
+    Writer w(sink, links);
+    WriteNoteDocument(w, note);
+    return w.Flush();
+}
+
+bool WriteIndex(const std::string& title,
+                const std::vector<Note>& notes,
+                const std::vector<std::wstring>& fileNames,
+                const std::vector<unsigned char>& listed,
+                const Sink& sink) {
+    Writer w(sink, nullptr);
+    WriteDocumentStart(w, title);
+    w.Raw("<h1>");
+    w.TextUtf8(title);
+    w.Raw("</h1>\n<ul>\n");
+    for (size_t i = 0; i < notes.size() && w.Ok(); ++i) {
+        if (!listed[i]) {
+            continue;
+        }
+        w.Raw("<li><a href=\"");
+        w.Raw(UrlEncodePath(fileNames[i]));
+        w.Raw("\">");
+        w.TextUtf8(notes[i].title.empty() ? std::string("(untitled)") : notes[i].title);
+        w.Raw("</a> <small>");
+        w.TextUtf8(notes[i].modified_at);
+        w.Raw("</small></li>\n");
+    }
+    w.Raw("</ul>\n");
+    WriteDocumentEnd(w);
+    return w.Flush();
+}
+
+} // namespace HtmlDocument
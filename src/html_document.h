@@ -0,0 +1,48 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "note.h"
+
+// The HTML that export writes, apart from the files and threads it is written with
+// (html_export.cpp). Output goes to a sink in chunks as it is produced, so a document is never
+// held in memory whole.
+namespace HtmlDocument {
+
+// Takes the next piece of UTF-8 output; false stops the document.
+typedef std::function<bool(const char* data, size_t size)> Sink;
+
+// The exported file each [[link]] between notes points to. Titles match ignoring ASCII case, and
+// the note with the lowest id wins, as the app resolves links.
+class LinkTargets {
+public:
+    void Add(const Note& note, const std::wstring& fileName);
+
+    // Href of the note titled title, empty when none was added.
+    std::string HrefFor(const std::wstring& title) const;
+
+private:
+    std::map<std::string, std::pair<int, std::string>> m_byTitle;   // Folded title: note id, href
+};
+
+// A file name for the note from its title and id, valid on Windows and unique among notes.
+std::wstring FileNameForNote(const Note& note);
+
+// Percent-encodes a relative file name for use in an href.
+std::string UrlEncodePath(const std::wstring& name);
+
+// Writes note as a standalone document, markdown converted block by block. With links, [[links]]
+// to the notes in it become links to their files.
+bool WriteNote(const Note& note, const LinkTargets* links, const Sink& sink);
+
+// The index page: a link to fileNames[i] for each notes[i] whose listed[i] is set, in order.
+bool WriteIndex(const std::string& title,
+                const std::vector<Note>& notes,
+                const std::vector<std::wstring>& fileNames,
+                const std::vector<unsigned char>& listed,
+                const Sink& sink);
+
+} // namespace HtmlDocument
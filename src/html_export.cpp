@@ -0,0 +1,161 @@
+#define NOMINMAX
+#include "html_export.h"
+#include "html_document.h"
+#include "utils.h"
+#include <windows.h>
+#include <process.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace {
+
+const int kMaxExportThreads = 8;
+
+// Writes the document's chunks to the file as they come.
+HtmlDocument::Sink FileSink(HANDLE hFile) {
+    return [hFile](const char* data, size_t size) {
+        size_t offset = 0;
+        while (offset < size) {
+            DWORD written = 0;
+            if (!WriteFile(hFile, data + offset, (DWORD)(size - offset), &written, NULL) || written == 0) {
+                return false;
+            }
+            offset += written;
+        }
+        return true;
+    };
+}
+
+std::string LastErrorMessage(const char* what, const std::wstring& path) {
+    return std::string(what) + " " + Utils::WideToUtf8(path) + " (error " + std::to_string(GetLastError()) + ")";
+}
+
+bool ExportToFile(const Note& note, const HtmlDocument::LinkTargets* links, const std::wstring& path, std::string& outError) {
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        outError = LastErrorMessage("Failed to create", path);
+        return false;
+    }
+
+    bool ok = HtmlDocument::WriteNote(note, links, FileSink(hFile));
+    if (!ok) {
+        outError = LastErrorMessage("Failed to write", path);
+    }
+    CloseHandle(hFile);
+    if (!ok) {
+        DeleteFileW(path.c_str());
+    }
+    return ok;
+}
+
+struct BulkExportJob {
+    const std::vector<Note>* notes = nullptr;
+    const std::vector<std::wstring>* fileNames = nullptr;
+    std::vector<unsigned char>* exportedFlags = nullptr;
+    const HtmlDocument::LinkTargets* links = nullptr;
+    std::wstring directory;
+    std::atomic<size_t> next{0};
+    std::atomic<int> exported{0};
+    std::atomic<int> failed{0};
+    std::atomic<bool> errorClaimed{false};
+    std::string firstError;   // Written once by the worker that claims it; read after join
+};
+
+unsigned __stdcall BulkExportWorker(void* p) {
+    BulkExportJob* job = (BulkExportJob*)p;
+    for (;;) {
+        size_t i = job->next.fetch_add(1);
+        if (i >= job->notes->size()) {
+            break;
+        }
+
+        std::string error;
+        std::wstring path = job->directory + L"\\" + (*job->fileNames)[i];
+        if (ExportToFile((*job->notes)[i], job->links, path, error)) {
+            (*job->exportedFlags)[i] = 1;
+            job->exported++;
+        } else {
+            job->failed++;
+            bool expected = false;
+            if (job->errorClaimed.compare_exchange_strong(expected, true)) {
+                job->firstError = error;
+            }
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+namespace HtmlExport {
+
+bool ExportNoteToFile(const Note& note, const std::wstring& path, std::string& outError) {
+    return ExportToFile(note, nullptr, path, outError);
+}
+
+HtmlExportResult ExportNotesToDirectory(const std::vector<Note>& notes, const std::wstring& directory, const std::wstring& indexFileName, const std::wstring& indexTitle) {
+    HtmlExportResult result;
+
+    std::vector<std::wstring> fileNames;
+    fileNames.reserve(notes.size());
+    HtmlDocument::LinkTargets links;
+    for (const auto& note : notes) {
+        fileNames.push_back(HtmlDocument::FileNameForNote(note));
+        links.Add(note, fileNames.back());
+    }
+    std::vector<unsigned char> exportedFlags(notes.size(), 0);
+
+    BulkExportJob job;
+    job.notes = &notes;
+    job.fileNames = &fileNames;
+    job.exportedFlags = &exportedFlags;
+    job.links = &links;
+    job.directory = directory;
+
+    SYSTEM_INFO si = {};
+    GetSystemInfo(&si);
+    int workerCount = (int)si.dwNumberOfProcessors;
+    if (workerCount < 1) workerCount = 1;
+    if (workerCount > kMaxExportThreads) workerCount = kMaxExportThreads;
+    if ((size_t)workerCount > notes.size()) workerCount = (int)std::max<size_t>(notes.size(), 1);
+
+    // The calling thread is one of the workers.
+    std::vector<HANDLE> threads;
+    for (int t = 1; t < workerCount; ++t) {
+        uintptr_t th = _beginthreadex(nullptr, 0, BulkExportWorker, &job, 0, nullptr);
+        if (th) {
+            threads.push_back((HANDLE)th);
+        }
+    }
+    BulkExportWorker(&job);
+    for (HANDLE th : threads) {
+        WaitForSingleObject(th, INFINITE);
+        CloseHandle(th);
+    }
+
+    result.exported = job.exported.load();
+    result.failed = job.failed.load();
+    result.error = job.firstError;
+
+    // Index page, streamed like the notes themselves.
+    std::wstring indexPath = directory + L"\\" + indexFileName;
+    HANDLE hFile = CreateFileW(indexPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        if (result.error.empty()) {
+            result.error = LastErrorMessage("Failed to create", indexPath);
+        }
+        return result;
+    }
+
+    bool indexOk = HtmlDocument::WriteIndex(Utils::WideToUtf8(indexTitle), notes, fileNames, exportedFlags, FileSink(hFile));
+    if (!indexOk && result.error.empty()) {
+        result.error = LastErrorMessage("Failed to write", indexPath);
+    }
+    CloseHandle(hFile);
+
+    result.success = indexOk && result.failed == 0;
+    return result;
+}
+
+} // namespace HtmlExport
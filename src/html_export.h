@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "note.h"
+
+struct HtmlExportResult {
+    bool success = false;
+    int exported = 0;
+    int failed = 0;
+    std::string error;   // First error encountered, if any
+};
+
+namespace HtmlExport {
+
+// Writes a single note as a standalone HTML document. Markdown is converted while the file is
+// written, in fixed-size chunks, so the full document is never held in memory.
+bool ExportNoteToFile(const Note& note, const std::wstring& path, std::string& outError);
+
+// Exports every note into directory (one .html file per note) on a pool of worker threads and
+// writes an index page named indexFileName linking to all of them, in the given order. [[Links]]
+// between exported notes point to each other's files.
+HtmlExportResult ExportNotesToDirectory(const std::vector<Note>& notes, const std::wstring& directory, const std::wstring& indexFileName, const std::wstring& indexTitle);
+
+} // namespace HtmlExport
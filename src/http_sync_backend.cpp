@@ -0,0 +1,210 @@
+#include "http_sync_backend.h"
+#include "resumable_upload.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+std::string PercentEncode(const std::string& s) {
+    static const char* hex = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : s) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out.push_back((char)c);
+        } else {
+            out.push_back('%');
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 15]);
+        }
+    }
+    return out;
+}
+
+std::string PercentDecode(const std::string& s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '%' && i + 2 < s.size() && std::isxdigit((unsigned char)s[i + 1]) &&
+            std::isxdigit((unsigned char)s[i + 2])) {
+            out.push_back((char)std::strtol(s.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        } else {
+            out.push_back(s[i]);
+        }
+    }
+    return out;
+}
+
+std::string Header(const HttpResult& resp, const char* name) {
+    auto it = resp.headers.find(name);
+    return it == resp.headers.end() ? std::string() : it->second;
+}
+
+SyncStatus StatusOf(const HttpResult& resp, const std::string& what, std::string& outError) {
+    if (resp.status >= 200 && resp.status < 300) {
+        return SyncStatus::Ok;
+    }
+    if (resp.status == 404) {
+        return SyncStatus::NotFound;
+    }
+    if (resp.status == 412) {
+        return SyncStatus::Conflict;
+    }
+    if (resp.status == 0) {
+        outError = "Sync server unreachable (" + resp.error + ")";
+    } else {
+        outError = what + " failed (HTTP " + std::to_string(resp.status) + ")";
+    }
+    return SyncStatus::Failed;
+}
+
+std::string ConditionHeaders(const std::string& ifVersion) {
+    if (ifVersion == kSyncCreateOnly) {
+        return "If-None-Match: *\r\n";
+    }
+    if (!ifVersion.empty()) {
+        return "If-Match: \"" + ifVersion + "\"\r\n";
+    }
+    return std::string();
+}
+
+void FillInfo(const std::string& name, const HttpResult& resp, unsigned long long size, SyncObjectInfo& out) {
+    out.name = name;
+    out.version = Header(resp, "etag");
+    if (out.version.size() >= 2 && out.version.front() == '"' && out.version.back() == '"') {
+        out.version = out.version.substr(1, out.version.size() - 2);
+    }
+    out.size = size;
+    out.modifiedTime = std::strtoull(Header(resp, "x-modified-time").c_str(), nullptr, 10);
+}
+
+} // namespace
+
+HttpSyncBackend::HttpSyncBackend(std::unique_ptr<HttpTransport> transport, const std::string& basePath)
+    : m_transport(std::move(transport)), m_basePath(basePath) {
+    while (!m_basePath.empty() && m_basePath.back() == '/') {
+        m_basePath.pop_back();
+    }
+}
+
+std::string HttpSyncBackend::ObjectPath(const std::string& name) const {
+    return m_basePath + "/o/" + PercentEncode(name);
+}
+
+SyncStatus HttpSyncBackend::Put(const std::string& name,
+                                const std::vector<unsigned char>& content,
+                                const std::string& ifVersion,
+                                SyncObjectInfo* outInfo,
+                                std::string& outError) {
+    std::string headers = "Content-Type: application/octet-stream\r\n" + ConditionHeaders(ifVersion);
+    HttpResult resp = m_transport->Send("PUT", ObjectPath(name), headers, content.data(), content.size());
+    SyncStatus status = StatusOf(resp, "Upload of " + name, outError);
+    if (status == SyncStatus::NotFound) {
+        outError = "Sync server has no object store at " + m_basePath;
+        return SyncStatus::Failed;
+    }
+    if (status == SyncStatus::Ok && outInfo) {
+        FillInfo(name, resp, content.size(), *outInfo);
+    }
+    return status;
+}
+
+SyncStatus HttpSyncBackend::PutStream(const std::string& name,
+                                      SyncSource& content,
+                                      const std::string& ifVersion,
+                                      SyncObjectInfo* outInfo,
+                                      const SyncProgress& progress,
+                                      std::string& outError) {
+    if (content.Size() <= kSyncChunkSize) {
+        return SyncBackend::PutStream(name, content, ifVersion, outInfo, progress, outError);
+    }
+
+    std::string headers = ConditionHeaders(ifVersion) + "X-Upload-Content-Length: " + std::to_string(content.Size()) + "\r\n";
+    HttpResult resp = m_transport->Send("POST", m_basePath + "/u/" + PercentEncode(name), headers, nullptr, 0);
+    SyncStatus status = StatusOf(resp, "Upload of " + name, outError);
+    if (status == SyncStatus::NotFound) {
+        outError = "Sync server does not take resumable uploads at " + m_basePath;
+        return SyncStatus::Failed;
+    }
+    if (status != SyncStatus::Ok) {
+        return status;
+    }
+    std::string location = Header(resp, "location");
+    if (location.empty()) {
+        outError = "Sync server started an upload without a session";
+        return SyncStatus::Failed;
+    }
+
+    resp = ResumableUpload::Send(*m_transport, ResumableUpload::SessionPath(location),
+        "Content-Type: application/octet-stream\r\n", content, progress);
+    if (resp.status == 0 || resp.status == 308) {
+        outError = "Upload of " + name + " failed: " + resp.error;
+        return SyncStatus::Failed;
+    }
+    status = StatusOf(resp, "Upload of " + name, outError);
+    if (status == SyncStatus::NotFound) {
+        outError = "Upload session for " + name + " expired";
+        return SyncStatus::Failed;
+    }
+    if (status == SyncStatus::Ok && outInfo) {
+        FillInfo(name, resp, content.Size(), *outInfo);
+    }
+    return status;
+}
+
+SyncStatus HttpSyncBackend::Get(const std::string& name,
+                                std::vector<unsigned char>& outContent,
+                                SyncObjectInfo* outInfo,
+                                std::string& outError) {
+    outContent.clear();
+    HttpResult resp = m_transport->Send("GET", ObjectPath(name), std::string(), nullptr, 0);
+    SyncStatus status = StatusOf(resp, "Download of " + name, outError);
+    if (status != SyncStatus::Ok) {
+        return status;
+    }
+    outContent.assign(resp.body.begin(), resp.body.end());
+    if (outInfo) {
+        FillInfo(name, resp, outContent.size(), *outInfo);
+    }
+    return status;
+}
+
+SyncStatus HttpSyncBackend::Stat(const std::string& name, SyncObjectInfo& outInfo, std::string& outError) {
+    HttpResult resp = m_transport->Send("HEAD", ObjectPath(name), std::string(), nullptr, 0);
+    SyncStatus status = StatusOf(resp, "Lookup of " + name, outError);
+    if (status == SyncStatus::Ok) {
+        FillInfo(name, resp, std::strtoull(Header(resp, "content-length").c_str(), nullptr, 10), outInfo);
+    }
+    return status;
+}
+
+SyncStatus HttpSyncBackend::List(const std::string& prefix, std::vector<SyncObjectInfo>& outObjects, std::string& outError) {
+    outObjects.clear();
+    HttpResult resp = m_transport->Send("GET", m_basePath + "/o/?prefix=" + PercentEncode(prefix), std::string(), nullptr, 0);
+    SyncStatus status = StatusOf(resp, "Listing", outError);
+    if (status != SyncStatus::Ok) {
+        if (status == SyncStatus::NotFound) {
+            outError = "Sync server has no object store at " + m_basePath;
+        }
+        return SyncStatus::Failed;
+    }
+
+    std::istringstream lines(resp.body);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        SyncObjectInfo info;
+        if (fields >> name >> info.version >> info.size >> info.modifiedTime) {
+            info.name = PercentDecode(name);
+            outObjects.push_back(std::move(info));
+        }
+    }
+    return SyncStatus::Ok;
+}
+
+SyncStatus HttpSyncBackend::Delete(const std::string& name, std::string& outError) {
+    HttpResult resp = m_transport->Send("DELETE", ObjectPath(name), std::string(), nullptr, 0);
+    return StatusOf(resp, "Delete of " + name, outError);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "http_transport.h"
+#include "sync_backend.h"
+
+#include <memory>
+
+// Sync objects on a plain HTTP object server, such as tools/sync_server:
+//   GET    <base>/o/<name>          content; ETag is the version, X-Modified-Time FILETIME ticks
+//   HEAD   <base>/o/<name>          the same headers, no content
+//   PUT    <base>/o/<name>          If-Match: "<version>" or If-None-Match: * make it conditional
+//                                   (412 when the condition fails)
+//   DELETE <base>/o/<name>          removes the object (404 when there is none)
+//   GET    <base>/o/?prefix=<p>     one "<name> <version> <size> <modified>" line per object
+//   POST   <base>/u/<name>          starts a resumable upload (see resumable_upload.h) of
+//                                   X-Upload-Content-Length bytes; Location names the session.
+//                                   Takes the same conditions as PUT, checked again at the end
+// Names are percent-encoded in paths and listings.
+class HttpSyncBackend : public SyncBackend {
+public:
+    HttpSyncBackend(std::unique_ptr<HttpTransport> transport, const std::string& basePath);
+
+    SyncStatus Put(const std::string& name,
+                   const std::vector<unsigned char>& content,
+                   const std::string& ifVersion,
+                   SyncObjectInfo* outInfo,
+                   std::string& outError) override;
+
+    // Content up to kSyncChunkSize goes in one PUT, anything larger through an upload session.
+    SyncStatus PutStream(const std::string& name,
+                         SyncSource& content,
+                         const std::string& ifVersion,
+                         SyncObjectInfo* outInfo,
+                         const SyncProgress& progress,
+                         std::string& outError) override;
+
+    SyncStatus Get(const std::string& name,
+                   std::vector<unsigned char>& outContent,
+                   SyncObjectInfo* outInfo,
+                   std::string& outError) override;
+
+    SyncStatus Stat(const std::string& name, SyncObjectInfo& outInfo, std::string& outError) override;
+
+    SyncStatus List(const std::string& prefix, std::vector<SyncObjectInfo>& outObjects, std::string& outError) override;
+
+    SyncStatus Delete(const std::string& name, std::string& outError) override;
+
+private:
+    std::string ObjectPath(const std::string& name) const;
+
+    std::unique_ptr<HttpTransport> m_transport;
+    std::string m_basePath;   // No trailing slash
+};
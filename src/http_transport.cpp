@@ -0,0 +1,172 @@
+#include "http_transport.h"
+#include "utils.h"
+
+#include <windows.h>
+#include <winhttp.h>
+
+#include <mutex>
+
+#pragma comment(lib, "winhttp.lib")
+
+namespace {
+
+// "Name: value" lines after the status line, names lower-cased.
+void ParseRawHeaders(const std::wstring& raw, std::map<std::string, std::string>& out) {
+    std::string text = Utils::WideToUtf8(raw);
+    size_t pos = text.find("\r\n");
+    while (pos != std::string::npos && pos + 2 < text.size()) {
+        size_t start = pos + 2;
+        size_t end = text.find("\r\n", start);
+        std::string line = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            std::string name = line.substr(0, colon);
+            for (char& c : name) {
+                if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+            }
+            size_t value = line.find_first_not_of(' ', colon + 1);
+            out[name] = value == std::string::npos ? std::string() : line.substr(value);
+        }
+        pos = end;
+    }
+}
+
+} // namespace
+
+struct WinHttpTransport::Session {
+    HINTERNET session = nullptr;
+    HINTERNET connect = nullptr;
+
+    ~Session() {
+        if (connect) WinHttpCloseHandle(connect);
+        if (session) WinHttpCloseHandle(session);
+    }
+};
+
+WinHttpTransport::WinHttpTransport(const std::wstring& host, unsigned short port, bool secure)
+    : m_host(host), m_port(port), m_secure(secure), m_session(SessionFor(host, port, secure)) {
+}
+
+std::shared_ptr<WinHttpTransport::Session> WinHttpTransport::SessionFor(const std::wstring& host,
+                                                                        unsigned short port,
+                                                                        bool secure) {
+    // Never freed: a sync thread may still be using a session while the process exits.
+    static std::mutex* lock = new std::mutex;
+    static auto* sessions = new std::map<std::wstring, std::shared_ptr<Session>>;
+
+    INTERNET_PORT actualPort = port ? port : (secure ? INTERNET_DEFAULT_HTTPS_PORT : INTERNET_DEFAULT_HTTP_PORT);
+    std::wstring key = (secure ? L"https://" : L"http://") + host + L":" + std::to_wstring(actualPort);
+    std::lock_guard<std::mutex> hold(*lock);
+    std::shared_ptr<Session>& cached = (*sessions)[key];
+    if (cached) {
+        return cached;
+    }
+
+    auto opened = std::make_shared<Session>();
+    opened->session = WinHttpOpen(L"NoteSoFast/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+        WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+    if (!opened->session) {
+        return nullptr;
+    }
+    // Keep UI responsive; don't hang forever.
+    WinHttpSetTimeouts(opened->session, 10000, 10000, 15000, 15000);
+    opened->connect = WinHttpConnect(opened->session, host.c_str(), actualPort, 0);
+    if (!opened->connect) {
+        return nullptr;
+    }
+    cached = opened;
+    return cached;
+}
+
+HttpResult WinHttpTransport::Send(const std::string& method,
+                                  const std::string& path,
+                                  const std::string& headers,
+                                  const unsigned char* body,
+                                  size_t bodySize) {
+    HttpResult resp;
+
+    if (!m_session) {
+        resp.error = "WinHttpOpen or WinHttpConnect failed";
+        return resp;
+    }
+
+    std::wstring methodW = Utils::Utf8ToWide(method);
+    std::wstring pathW = Utils::Utf8ToWide(path);
+    HINTERNET hRequest = WinHttpOpenRequest(
+        m_session->connect,
+        methodW.c_str(),
+        pathW.c_str(),
+        nullptr,
+        WINHTTP_NO_REFERER,
+        WINHTTP_DEFAULT_ACCEPT_TYPES,
+        m_secure ? WINHTTP_FLAG_SECURE : 0);
+
+    if (!hRequest) {
+        resp.error = "WinHttpOpenRequest failed";
+        return resp;
+    }
+
+    std::wstring headersW = Utils::Utf8ToWide(headers);
+    BOOL ok = WinHttpSendRequest(
+        hRequest,
+        headersW.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headersW.c_str(),
+        headersW.empty() ? 0 : (DWORD)-1,
+        (LPVOID)body,
+        (DWORD)bodySize,
+        (DWORD)bodySize,
+        0);
+
+    if (!ok) {
+        resp.error = "WinHttpSendRequest failed";
+        WinHttpCloseHandle(hRequest);
+        return resp;
+    }
+
+    if (!WinHttpReceiveResponse(hRequest, nullptr)) {
+        resp.error = "WinHttpReceiveResponse failed";
+        WinHttpCloseHandle(hRequest);
+        return resp;
+    }
+
+    DWORD status = 0;
+    DWORD statusSize = sizeof(status);
+    WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX,
+        &status, &statusSize, WINHTTP_NO_HEADER_INDEX);
+    resp.status = status;
+
+    DWORD rawSize = 0;
+    WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF, WINHTTP_HEADER_NAME_BY_INDEX,
+        WINHTTP_NO_OUTPUT_BUFFER, &rawSize, WINHTTP_NO_HEADER_INDEX);
+    if (rawSize > 0) {
+        std::wstring raw(rawSize / sizeof(wchar_t) + 1, L'\0');
+        if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF, WINHTTP_HEADER_NAME_BY_INDEX,
+                &raw[0], &rawSize, WINHTTP_NO_HEADER_INDEX)) {
+            raw.resize(rawSize / sizeof(wchar_t));
+            ParseRawHeaders(raw, resp.headers);
+        }
+    }
+
+    std::string response;
+    for (;;) {
+        DWORD avail = 0;
+        if (!WinHttpQueryDataAvailable(hRequest, &avail)) {
+            break;
+        }
+        if (avail == 0) {
+            break;
+        }
+        std::string chunk;
+        chunk.resize(avail);
+        DWORD read = 0;
+        if (!WinHttpReadData(hRequest, &chunk[0], avail, &read) || read == 0) {
+            break;
+        }
+        chunk.resize(read);
+        response += chunk;
+    }
+    resp.body = std::move(response);
+
+    // Only the request is closed; its connection, read to the end, goes back to the session's pool.
+    WinHttpCloseHandle(hRequest);
+    return resp;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+
+// HTTP exchanges with one host. The interface is portable: WinHttpTransport is what the app uses,
+// and anything else (a plain socket client, a fake) can stand in for it.
+struct HttpResult {
+    unsigned long status = 0;                      // 0 when no response arrived
+    std::string body;
+    std::map<std::string, std::string> headers;    // Names lower-cased
+    std::string error;
+};
+
+class HttpTransport {
+public:
+    virtual ~HttpTransport() = default;
+
+    // headers: "Name: value\r\n" lines, may be empty.
+    virtual HttpResult Send(const std::string& method,
+                            const std::string& path,
+                            const std::string& headers,
+                            const unsigned char* body,
+                            size_t bodySize) = 0;
+};
+
+// Transports to the same host, port and scheme share one WinHTTP session that stays open for the
+// life of the process, so its keep-alive connections (and their TLS handshakes) carry over from
+// one request, and one sync, to the next. Safe to use from several threads.
+class WinHttpTransport : public HttpTransport {
+public:
+    // port 0 = the scheme's default port.
+    explicit WinHttpTransport(const std::wstring& host, unsigned short port = 0, bool secure = true);
+
+    HttpResult Send(const std::string& method,
+                    const std::string& path,
+                    const std::string& headers,
+                    const unsigned char* body,
+                    size_t bodySize) override;
+
+private:
+    struct Session;
+
+    std::wstring m_host;
+    unsigned short m_port;
+    bool m_secure;
+    std::shared_ptr<Session> m_session;   // Null when WinHTTP could not open one
+
+    static std::shared_ptr<Session> SessionFor(const std::wstring& host, unsigned short port, bool secure);
+};
@@ -0,0 +1,176 @@
+#include "language_detector.h"
+#include "spell_tokenizer.h"
+#include <cstdint>
+#include <cstring>
+#include <cwctype>
+
+namespace {
+
+// The most frequent trigrams of each language in rank order, words padded with one space.
+struct LanguageProfile {
+    const char* code;
+    const wchar_t* trigrams[40];
+};
+
+const LanguageProfile kProfiles[] = {
+    { "en", { L" th", L"the", L"he ", L"ed ", L" an", L"and", L"nd ", L"ing", L"ng ", L" to",
+              L"to ", L" of", L"of ", L" in", L"er ", L"in ", L"is ", L"on ", L"es ", L"at ",
+              L"re ", L"ion", L"hat", L" is", L"tio", L"ent", L" fo", L"for", L"or ", L" ha",
+              L"it ", L" wi", L"wit", L"ith", L"th ", L"ly ", L"all", L" be", L"ver", L"ter" } },
+    { "de", { L"en ", L"er ", L" de", L"der", L"ie ", L" di", L"die", L"ch ", L"ich", L"sch",
+              L"ein", L" ei", L"und", L" un", L"nd ", L"cht", L"den", L"che", L" zu", L"te ",
+              L"ung", L"gen", L"ine", L"nde", L" da", L"das", L"ist", L" is", L"st ", L" ge",
+              L"eit", L"hen", L"ter", L"auf", L" au", L"nic", L"ht ", L"mit", L" mi", L"ach" } },
+    { "fr", { L"es ", L" de", L"de ", L"le ", L"ent", L" le", L"nt ", L"la ", L" la", L"re ",
+              L"les", L"ion", L" pa", L"ue ", L" co", L"des", L"on ", L"tio", L"et ", L" et",
+              L"our", L" po", L" qu", L"que", L"ait", L" un", L"ne ", L"men", L"est", L" es",
+              L"par", L"ur ", L" da", L"dan", L"ans", L"ons", L"eur", L"ais", L" ce", L"ous" } },
+    { "es", { L" de", L"de ", L"os ", L"la ", L" la", L"el ", L" el", L"es ", L"que", L" qu",
+              L"ue ", L"en ", L" en", L"as ", L"ent", L"ado", L" co", L"los", L" lo", L"i\x00F3n",
+              L"\x00F3n ", L" se", L"con", L"ra ", L"nte", L" po", L"par", L"ien", L"ara", L"del",
+              L"una", L" un", L"est", L"cio", L"por", L" es", L"ada", L"ero", L"mos", L" ca" } },
+    { "it", { L" di", L"di ", L"to ", L"la ", L" de", L"che", L"he ", L" ch", L"ell", L"no ",
+              L"del", L" co", L"one", L"ent", L"ion", L"lla", L"le ", L"are", L"re ", L"ato",
+              L" la", L" il", L"il ", L" in", L"per", L" pe", L"ere", L"ti ", L"nte", L"zio",
+              L"con", L" un", L"ta ", L"gli", L"ono", L"ess", L"sse", L"ndo", L"ame", L" so" } },
+    { "pt", { L" de", L"de ", L"os ", L"do ", L" qu", L"que", L"ue ", L"as ", L" co", L"\x00E7\x00E3o",
+              L"\x00E3o ", L"da ", L" do", L"em ", L"ent", L"es ", L" se", L"nte", L"ara", L"com",
+              L"par", L" pa", L"men", L" um", L"um ", L" na", L"uma", L"n\x00E3o", L" n\x00E3", L"ado",
+              L"\x00F5" L"es", L"nto", L"ria", L"ais", L" po", L"por", L"ida", L"sta", L"\x00E9m ", L" em" } },
+    { "nl", { L"en ", L" de", L"de ", L"het", L" he", L"et ", L"van", L" va", L"an ", L"een",
+              L" ee", L"ijk", L"er ", L"aar", L"oor", L" ge", L"ing", L"ver", L"sch", L" in",
+              L"in ", L"nde", L"ten", L" te", L"den", L"ie ", L"lij", L"zij", L" zi", L"ij ",
+              L"dat", L" da", L"cht", L"ond", L"erd", L"eer", L"nie", L" ni", L"oek", L"wor" } },
+};
+
+const size_t kProfileSize = 40;
+const size_t kMaxSampleWords = 400;
+const size_t kMaxScanChars = 16 * 1024;
+const unsigned int kMinTrigrams = 40;
+
+inline uint64_t Pack(wchar_t a, wchar_t b, wchar_t c) {
+    return ((uint64_t)(uint32_t)a << 42) | ((uint64_t)(uint32_t)b << 21) | (uint64_t)(uint32_t)c;
+}
+
+// Trigram counts of the sample in a small open-addressed table on the stack. Once half the slots
+// are taken, unseen trigrams are only counted in total, so probing always ends at an empty slot.
+struct TrigramCounts {
+    static const size_t kSlots = 4096;   // Power of two
+    static const size_t kMaxKeys = kSlots / 2;
+    uint64_t keys[kSlots];
+    uint16_t counts[kSlots];
+    unsigned int total = 0;
+    size_t used = 0;
+
+    TrigramCounts() {
+        memset(counts, 0, sizeof(counts));
+    }
+
+    static size_t Slot(uint64_t key) {
+        return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 52) & (kSlots - 1);
+    }
+
+    void Add(uint64_t key) {
+        ++total;
+        for (size_t i = Slot(key);; i = (i + 1) & (kSlots - 1)) {
+            if (counts[i] == 0) {
+                if (used < kMaxKeys) {
+                    keys[i] = key;
+                    counts[i] = 1;
+                    ++used;
+                }
+                return;
+            }
+            if (keys[i] == key) {
+                if (counts[i] < 0xFFFF) ++counts[i];
+                return;
+            }
+        }
+    }
+
+    unsigned int Get(uint64_t key) const {
+        for (size_t i = Slot(key);; i = (i + 1) & (kSlots - 1)) {
+            if (counts[i] == 0) return 0;
+            if (keys[i] == key) return counts[i];
+        }
+    }
+};
+
+} // namespace
+
+namespace LanguageDetector {
+
+const std::vector<std::string>& SupportedLanguages() {
+    static const std::vector<std::string> languages = [] {
+        std::vector<std::string> codes;
+        for (const LanguageProfile& profile : kProfiles) {
+            codes.push_back(profile.code);
+        }
+        return codes;
+    }();
+    return languages;
+}
+
+std::string Detect(const wchar_t* text, size_t length, const std::vector<std::string>& candidates) {
+    // Sample the first words of prose; a few hundred are plenty to tell languages apart.
+    TrigramCounts counts;
+    size_t scan = length < kMaxScanChars ? length : kMaxScanChars;
+    SpellTokenizer tokenizer(text, scan, 0, scan);
+    SpellToken token;
+    size_t words = 0;
+    while (words < kMaxSampleWords && tokenizer.Next(token)) {
+        ++words;
+        wchar_t prev2 = L' ';
+        wchar_t prev1 = L' ';
+        for (size_t i = 0; i <= token.length; ++i) {
+            wchar_t c = (i < token.length) ? (wchar_t)towlower(text[token.start + i]) : L' ';
+            if (i > 0) {
+                counts.Add(Pack(prev2, prev1, c));
+            }
+            prev2 = prev1;
+            prev1 = c;
+        }
+    }
+    if (counts.total < kMinTrigrams) {
+        return std::string();
+    }
+
+    // Score = profile hits weighted by rank, so the most typical trigrams count most.
+    const LanguageProfile* best = nullptr;
+    double bestScore = 0.0;
+    double secondScore = 0.0;
+    for (const LanguageProfile& profile : kProfiles) {
+        bool wanted = false;
+        for (const std::string& code : candidates) {
+            if (code == profile.code) {
+                wanted = true;
+                break;
+            }
+        }
+        if (!wanted) {
+            continue;
+        }
+
+        double score = 0.0;
+        for (size_t rank = 0; rank < kProfileSize; ++rank) {
+            const wchar_t* t = profile.trigrams[rank];
+            score += (double)(kProfileSize - rank) * counts.Get(Pack(t[0], t[1], t[2]));
+        }
+        score /= counts.total;
+        if (score > bestScore) {
+            secondScore = bestScore;
+            bestScore = score;
+            best = &profile;
+        } else if (score > secondScore) {
+            secondScore = score;
+        }
+    }
+
+    // Closely related languages share trigrams; only answer on a clear lead.
+    if (!best || bestScore < 1.0 || bestScore < secondScore * 1.2) {
+        return std::string();
+    }
+    return best->code;
+}
+
+} // namespace LanguageDetector
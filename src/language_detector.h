@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Guesses the language of a text from character trigrams. Only prose words are sampled (code,
+// links and URLs are skipped by SpellTokenizer) and only the start of the text is read, so a call
+// costs well under 0.1 ms regardless of the note size. No allocations beyond the returned string.
+namespace LanguageDetector {
+
+// ISO 639-1 codes with a built-in profile.
+const std::vector<std::string>& SupportedLanguages();
+
+// Best match among candidates (ISO 639-1 codes, e.g. "en", "de"), or an empty string when the
+// text is too short or no candidate clearly wins.
+std::string Detect(const wchar_t* text, size_t length, const std::vector<std::string>& candidates);
+
+} // namespace LanguageDetector
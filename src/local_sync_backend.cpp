@@ -0,0 +1,565 @@
+#define NOMINMAX
+#include "local_sync_backend.h"
+
+#include "utils.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <thread>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+// The few file operations the backend needs, on Win32 or POSIX (where the tests run). Paths are
+// UTF-16 on Windows and UTF-8 elsewhere.
+#ifdef _WIN32
+typedef std::wstring FilePath;
+#else
+typedef std::string FilePath;
+#endif
+
+enum class FileState { Found, Missing, Failed };
+
+struct FileInfo {
+    unsigned long long modifiedTime = 0;   // FILETIME ticks, UTC
+    unsigned long long size = 0;
+};
+
+const char kLockName[] = ".lock";
+const char kTempSuffix[] = ".tmp";
+const unsigned kLockTimeoutMs = 10000;
+
+std::string VersionOf(unsigned long long modifiedTime, unsigned long long size) {
+    char buf[40];
+    std::snprintf(buf, sizeof(buf), "%llx.%llx", modifiedTime, size);
+    return buf;
+}
+
+void FillInfo(const std::string& name, const FileInfo& file, SyncObjectInfo& out) {
+    out.name = name;
+    out.modifiedTime = file.modifiedTime;
+    out.size = file.size;
+    out.version = VersionOf(out.modifiedTime, out.size);
+}
+
+bool ValidName(const std::string& name) {
+    if (name.empty() || name.find_first_of("/\\:*?\"<>|") != std::string::npos || name == kLockName) {
+        return false;
+    }
+    return name.size() < 4 || name.compare(name.size() - 4, 4, kTempSuffix) != 0;
+}
+
+#ifdef _WIN32
+
+FilePath NativePath(const std::wstring& path) {
+    return path;
+}
+
+FilePath NativeName(const std::string& name) {
+    return Utils::Utf8ToWide(name);
+}
+
+unsigned long long FileTimeToU64(const FILETIME& ft) {
+    return ((unsigned long long)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
+
+bool IsMissing(DWORD error) {
+    return error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND;
+}
+
+// Different for every thread of every process writing into the directory.
+FilePath UniqueSuffix() {
+    wchar_t unique[48];
+    std::swprintf(unique, 48, L".%lu.%lu", GetCurrentProcessId(), GetCurrentThreadId());
+    return unique;
+}
+
+// Held by whoever is writing into the directory, across processes.
+class DirectoryLock {
+public:
+    explicit DirectoryLock(const FilePath& path) {
+        DWORD start = GetTickCount();
+        for (;;) {
+            m_handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS,
+                FILE_ATTRIBUTE_HIDDEN, nullptr);
+            if (m_handle != INVALID_HANDLE_VALUE) {
+                return;
+            }
+            DWORD error = GetLastError();
+            if ((error != ERROR_SHARING_VIOLATION && error != ERROR_ACCESS_DENIED) ||
+                GetTickCount() - start > kLockTimeoutMs) {
+                return;
+            }
+            Sleep(5);
+        }
+    }
+
+    ~DirectoryLock() {
+        if (m_handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_handle);
+        }
+    }
+
+    bool Held() const { return m_handle != INVALID_HANDLE_VALUE; }
+
+private:
+    DirectoryLock(const DirectoryLock&) = delete;
+    DirectoryLock& operator=(const DirectoryLock&) = delete;
+
+    HANDLE m_handle;
+};
+
+FileState StatFile(const FilePath& path, FileInfo& out) {
+    WIN32_FILE_ATTRIBUTE_DATA fad = {};
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad)) {
+        return IsMissing(GetLastError()) ? FileState::Missing : FileState::Failed;
+    }
+    if (fad.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        return FileState::Missing;
+    }
+    out.modifiedTime = FileTimeToU64(fad.ftLastWriteTime);
+    out.size = ((unsigned long long)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+    return FileState::Found;
+}
+
+FileState ReadWholeFile(const FilePath& path, std::vector<unsigned char>& out, FileInfo& outInfo) {
+    // Share delete, so a writer can rename a new version over the file while it is being read.
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        return IsMissing(GetLastError()) ? FileState::Missing : FileState::Failed;
+    }
+    BY_HANDLE_FILE_INFORMATION info = {};
+    BOOL ok = GetFileInformationByHandle(h, &info);
+    if (ok) {
+        outInfo.modifiedTime = FileTimeToU64(info.ftLastWriteTime);
+        outInfo.size = ((unsigned long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+        out.resize((size_t)outInfo.size);
+        size_t done = 0;
+        while (ok && done < out.size()) {
+            DWORD chunk = (DWORD)std::min<size_t>(out.size() - done, 1u << 30);
+            DWORD read = 0;
+            ok = ReadFile(h, out.data() + done, chunk, &read, nullptr) && read == chunk;
+            done += read;
+        }
+    }
+    CloseHandle(h);
+    return ok ? FileState::Found : FileState::Failed;
+}
+
+// Copies content a chunk at a time, so memory stays flat however large it is.
+bool WriteNewFile(const FilePath& path, SyncSource& content, const SyncProgress& progress) {
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    unsigned long long total = content.Size();
+    std::vector<unsigned char> chunk((size_t)std::min<unsigned long long>(total, kSyncChunkSize));
+    BOOL ok = TRUE;
+    for (unsigned long long done = 0; ok && done < total;) {
+        DWORD length = (DWORD)std::min<unsigned long long>(total - done, chunk.size());
+        DWORD written = 0;
+        ok = content.Read(done, chunk.data(), length) &&
+            WriteFile(h, chunk.data(), length, &written, nullptr) && written == length;
+        done += length;
+        if (ok && progress) progress(done, total);
+    }
+    // On disk before it is renamed into place, so a crash leaves the old version, not a torn one.
+    ok = ok && FlushFileBuffers(h);
+    CloseHandle(h);
+    if (!ok) {
+        DeleteFileW(path.c_str());
+    }
+    return ok != FALSE;
+}
+
+bool ReplaceFile(const FilePath& from, const FilePath& to) {
+    return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+}
+
+FileState RemoveFile(const FilePath& path) {
+    if (DeleteFileW(path.c_str())) {
+        return FileState::Found;
+    }
+    return IsMissing(GetLastError()) ? FileState::Missing : FileState::Failed;
+}
+
+bool SetModifiedTime(const FilePath& path, unsigned long long modifiedTime) {
+    FILETIME ft;
+    ft.dwLowDateTime = (DWORD)modifiedTime;
+    ft.dwHighDateTime = (DWORD)(modifiedTime >> 32);
+    HANDLE h = CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    BOOL ok = SetFileTime(h, nullptr, nullptr, &ft);
+    CloseHandle(h);
+    return ok != FALSE;
+}
+
+// The files in dir whose names start with prefix.
+bool ListFiles(const FilePath& dir, const std::string& prefix, std::vector<SyncObjectInfo>& out) {
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileW((dir + NativeName(prefix) + L"*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        return GetLastError() == ERROR_FILE_NOT_FOUND;
+    }
+    do {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            continue;
+        }
+        // The pattern also matches short 8.3 names; keep only real prefix matches.
+        std::string name = Utils::WideToUtf8(data.cFileName);
+        if (name.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        FileInfo file;
+        file.modifiedTime = FileTimeToU64(data.ftLastWriteTime);
+        file.size = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        SyncObjectInfo info;
+        FillInfo(name, file, info);
+        out.push_back(std::move(info));
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+    return true;
+}
+
+#else
+
+const unsigned long long kUnixEpochTicks = 116444736000000000ull;
+
+FilePath NativePath(const std::wstring& path) {
+    return Utils::WideToUtf8(path);
+}
+
+FilePath NativeName(const std::string& name) {
+    return name;
+}
+
+void FillFileInfo(const struct stat& st, FileInfo& out) {
+    out.modifiedTime = kUnixEpochTicks + (unsigned long long)st.st_mtim.tv_sec * 10000000ull +
+        (unsigned long long)st.st_mtim.tv_nsec / 100;
+    out.size = (unsigned long long)st.st_size;
+}
+
+FilePath UniqueSuffix() {
+    return "." + std::to_string((unsigned long)getpid()) + "." +
+        std::to_string((unsigned long)std::hash<std::thread::id>()(std::this_thread::get_id()));
+}
+
+// Held by whoever is writing into the directory, across processes and threads (each lock opens
+// the file anew, and flock excludes other open descriptions of it).
+class DirectoryLock {
+public:
+    explicit DirectoryLock(const FilePath& path) {
+        m_fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (m_fd < 0) {
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        while (flock(m_fd, LOCK_EX | LOCK_NB) != 0) {
+            if ((errno != EWOULDBLOCK && errno != EINTR) ||
+                std::chrono::steady_clock::now() - start > std::chrono::milliseconds(kLockTimeoutMs)) {
+                close(m_fd);
+                m_fd = -1;
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+
+    ~DirectoryLock() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    bool Held() const { return m_fd >= 0; }
+
+private:
+    DirectoryLock(const DirectoryLock&) = delete;
+    DirectoryLock& operator=(const DirectoryLock&) = delete;
+
+    int m_fd;
+};
+
+FileState StatFile(const FilePath& path, FileInfo& out) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return (errno == ENOENT || errno == ENOTDIR) ? FileState::Missing : FileState::Failed;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        return FileState::Missing;
+    }
+    FillFileInfo(st, out);
+    return FileState::Found;
+}
+
+FileState ReadWholeFile(const FilePath& path, std::vector<unsigned char>& out, FileInfo& outInfo) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? FileState::Missing : FileState::Failed;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok) {
+        FillFileInfo(st, outInfo);
+        out.resize((size_t)outInfo.size);
+        size_t done = 0;
+        while (ok && done < out.size()) {
+            ssize_t n = read(fd, out.data() + done, out.size() - done);
+            ok = n > 0 || (n < 0 && errno == EINTR);
+            done += n > 0 ? (size_t)n : 0;
+        }
+    }
+    close(fd);
+    return ok ? FileState::Found : FileState::Failed;
+}
+
+bool WriteNewFile(const FilePath& path, SyncSource& content, const SyncProgress& progress) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    unsigned long long total = content.Size();
+    std::vector<unsigned char> chunk((size_t)std::min<unsigned long long>(total, kSyncChunkSize));
+    bool ok = true;
+    for (unsigned long long done = 0; ok && done < total;) {
+        size_t length = (size_t)std::min<unsigned long long>(total - done, chunk.size());
+        ok = content.Read(done, chunk.data(), length);
+        for (size_t written = 0; ok && written < length;) {
+            ssize_t n = write(fd, chunk.data() + written, length - written);
+            ok = n > 0 || (n < 0 && errno == EINTR);
+            written += n > 0 ? (size_t)n : 0;
+        }
+        done += length;
+        if (ok && progress) progress(done, total);
+    }
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+    if (!ok) {
+        unlink(path.c_str());
+    }
+    return ok;
+}
+
+bool ReplaceFile(const FilePath& from, const FilePath& to) {
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+FileState RemoveFile(const FilePath& path) {
+    if (unlink(path.c_str()) == 0) {
+        return FileState::Found;
+    }
+    return errno == ENOENT ? FileState::Missing : FileState::Failed;
+}
+
+bool SetModifiedTime(const FilePath& path, unsigned long long modifiedTime) {
+    unsigned long long sinceEpoch = modifiedTime - kUnixEpochTicks;
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = (time_t)(sinceEpoch / 10000000ull);
+    times[1].tv_nsec = (long)(sinceEpoch % 10000000ull) * 100;
+    return utimensat(AT_FDCWD, path.c_str(), times, 0) == 0;
+}
+
+bool ListFiles(const FilePath& dir, const std::string& prefix, std::vector<SyncObjectInfo>& out) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        return false;
+    }
+    while (struct dirent* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        FileInfo file;
+        if (name.compare(0, prefix.size(), prefix) != 0 || StatFile(dir + name, file) != FileState::Found) {
+            continue;
+        }
+        SyncObjectInfo info;
+        FillInfo(name, file, info);
+        out.push_back(std::move(info));
+    }
+    closedir(d);
+    return true;
+}
+
+#endif
+
+FilePath PathOf(const std::wstring& dir, const std::string& name) {
+    return NativePath(dir) + NativeName(name);
+}
+
+} // namespace
+
+LocalSyncBackend::LocalSyncBackend(const std::wstring& directory) : m_dir(directory) {
+    if (!m_dir.empty() && m_dir.back() != L'\\' && m_dir.back() != L'/') {
+#ifdef _WIN32
+        m_dir += L'\\';
+#else
+        m_dir += L'/';
+#endif
+    }
+}
+
+SyncStatus LocalSyncBackend::Put(const std::string& name,
+                                 const std::vector<unsigned char>& content,
+                                 const std::string& ifVersion,
+                                 SyncObjectInfo* outInfo,
+                                 std::string& outError) {
+    MemorySyncSource source(content.data(), content.size());
+    return PutStream(name, source, ifVersion, outInfo, SyncProgress(), outError);
+}
+
+SyncStatus LocalSyncBackend::PutStream(const std::string& name,
+                                       SyncSource& content,
+                                       const std::string& ifVersion,
+                                       SyncObjectInfo* outInfo,
+                                       const SyncProgress& progress,
+                                       std::string& outError) {
+    if (!ValidName(name)) {
+        outError = "Invalid sync object name: " + name;
+        return SyncStatus::Failed;
+    }
+
+    FilePath path = PathOf(m_dir, name);
+    FilePath tmp = path + UniqueSuffix() + NativeName(kTempSuffix);
+    if (!WriteNewFile(tmp, content, progress)) {
+        outError = "Failed to write " + name + " to the sync folder";
+        return SyncStatus::Failed;
+    }
+
+    DirectoryLock lock(PathOf(m_dir, kLockName));
+    if (!lock.Held()) {
+        RemoveFile(tmp);
+        outError = "Sync folder is locked";
+        return SyncStatus::Failed;
+    }
+
+    SyncObjectInfo current;
+    std::string statError;
+    SyncStatus existing = Stat(name, current, statError);
+    if (existing == SyncStatus::Failed) {
+        RemoveFile(tmp);
+        outError = statError;
+        return existing;
+    }
+    if (!ifVersion.empty()) {
+        bool matches = (ifVersion == kSyncCreateOnly) ? existing == SyncStatus::NotFound
+                                                      : existing == SyncStatus::Ok && current.version == ifVersion;
+        if (!matches) {
+            RemoveFile(tmp);
+            return SyncStatus::Conflict;
+        }
+    }
+
+    if (!ReplaceFile(tmp, path)) {
+        RemoveFile(tmp);
+        outError = "Failed to replace " + name + " in the sync folder";
+        return SyncStatus::Failed;
+    }
+
+    SyncObjectInfo written;
+    if (Stat(name, written, statError) != SyncStatus::Ok) {
+        outError = statError;
+        return SyncStatus::Failed;
+    }
+    if (existing == SyncStatus::Ok && written.modifiedTime <= current.modifiedTime) {
+        // Written within the clock's resolution, or before a writer that got the lock first: keep
+        // the time moving forward, so a version never comes back.
+        if (!SetModifiedTime(path, current.modifiedTime + 1) || Stat(name, written, statError) != SyncStatus::Ok) {
+            outError = "Failed to stamp " + name + " in the sync folder";
+            return SyncStatus::Failed;
+        }
+    }
+    if (outInfo) {
+        *outInfo = written;
+    }
+    return SyncStatus::Ok;
+}
+
+SyncStatus LocalSyncBackend::Get(const std::string& name,
+                                 std::vector<unsigned char>& outContent,
+                                 SyncObjectInfo* outInfo,
+                                 std::string& outError) {
+    outContent.clear();
+    if (!ValidName(name)) {
+        return SyncStatus::NotFound;
+    }
+    FileInfo file;
+    FileState state = ReadWholeFile(PathOf(m_dir, name), outContent, file);
+    if (state == FileState::Missing) {
+        return SyncStatus::NotFound;
+    }
+    if (state == FileState::Failed) {
+        outContent.clear();
+        outError = "Failed to read " + name + " from the sync folder";
+        return SyncStatus::Failed;
+    }
+    if (outInfo) {
+        FillInfo(name, file, *outInfo);
+    }
+    return SyncStatus::Ok;
+}
+
+SyncStatus LocalSyncBackend::Stat(const std::string& name, SyncObjectInfo& outInfo, std::string& outError) {
+    if (!ValidName(name)) {
+        return SyncStatus::NotFound;
+    }
+    FileInfo file;
+    FileState state = StatFile(PathOf(m_dir, name), file);
+    if (state == FileState::Missing) {
+        return SyncStatus::NotFound;
+    }
+    if (state == FileState::Failed) {
+        outError = "Failed to read " + name + " in the sync folder";
+        return SyncStatus::Failed;
+    }
+    FillInfo(name, file, outInfo);
+    return SyncStatus::Ok;
+}
+
+SyncStatus LocalSyncBackend::List(const std::string& prefix, std::vector<SyncObjectInfo>& outObjects, std::string& outError) {
+    outObjects.clear();
+    if (!ListFiles(NativePath(m_dir), prefix, outObjects)) {
+        outObjects.clear();
+        outError = "Sync folder not found";
+        return SyncStatus::Failed;
+    }
+    outObjects.erase(std::remove_if(outObjects.begin(), outObjects.end(),
+                                    [](const SyncObjectInfo& info) { return !ValidName(info.name); }),
+                     outObjects.end());
+    return SyncStatus::Ok;
+}
+
+SyncStatus LocalSyncBackend::Delete(const std::string& name, std::string& outError) {
+    if (!ValidName(name)) {
+        return SyncStatus::NotFound;
+    }
+    DirectoryLock lock(PathOf(m_dir, kLockName));
+    if (!lock.Held()) {
+        outError = "Sync folder is locked";
+        return SyncStatus::Failed;
+    }
+    FileState state = RemoveFile(PathOf(m_dir, name));
+    if (state == FileState::Missing) {
+        return SyncStatus::NotFound;
+    }
+    if (state == FileState::Failed) {
+        outError = "Failed to delete " + name + " from the sync folder";
+        return SyncStatus::Failed;
+    }
+    return SyncStatus::Ok;
+}
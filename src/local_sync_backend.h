@@ -0,0 +1,40 @@
+#pragma once
+
+#include "sync_backend.h"
+
+// Sync objects as files in a directory: a folder another tool keeps in step between machines (a
+// network share, a synced folder), or a scratch directory to exercise sync offline. Versions are
+// the file's write time and size; writes go to a temporary file renamed into place while a lock
+// file is held, so conditional writes are atomic against other processes using the directory.
+// Object names ending in ".tmp" are reserved for the temporary files. Builds on Win32, and on POSIX for the tests.
+class LocalSyncBackend : public SyncBackend {
+public:
+    explicit LocalSyncBackend(const std::wstring& directory);
+
+    SyncStatus Put(const std::string& name,
+                   const std::vector<unsigned char>& content,
+                   const std::string& ifVersion,
+                   SyncObjectInfo* outInfo,
+                   std::string& outError) override;
+
+    SyncStatus PutStream(const std::string& name,
+                         SyncSource& content,
+                         const std::string& ifVersion,
+                         SyncObjectInfo* outInfo,
+                         const SyncProgress& progress,
+                         std::string& outError) override;
+
+    SyncStatus Get(const std::string& name,
+                   std::vector<unsigned char>& outContent,
+                   SyncObjectInfo* outInfo,
+                   std::string& outError) override;
+
+    SyncStatus Stat(const std::string& name, SyncObjectInfo& outInfo, std::string& outError) override;
+
+    SyncStatus List(const std::string& prefix, std::vector<SyncObjectInfo>& outObjects, std::string& outError) override;
+
+    SyncStatus Delete(const std::string& name, std::string& outError) override;
+
+private:
+    std::wstring m_dir;   // With a trailing separator
+};
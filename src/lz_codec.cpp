@@ -0,0 +1,212 @@
+#include "lz_codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const int kHashBits = 14;
+const size_t kMinMatch = 4;
+const size_t kMaxOffset = 65535;
+// Matches stop this far from the end and the last literals cover it, as in LZ4, so the match
+// finder can read 8 bytes at a time without running off the block.
+const size_t kEndLiterals = 8;
+
+inline uint32_t Read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint64_t Read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint32_t HashOf(uint32_t v) {
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+inline int TrailingZeroBytes(uint64_t v) {
+    int n = 0;
+    while ((v & 0xFF) == 0) {
+        v >>= 8;
+        ++n;
+    }
+    return n;
+}
+
+unsigned char* PutLength(unsigned char* op, size_t extra) {
+    while (extra >= 255) {
+        *op++ = 255;
+        extra -= 255;
+    }
+    *op++ = (unsigned char)extra;
+    return op;
+}
+
+unsigned char* PutSequence(unsigned char* op, const unsigned char* literals, size_t literalCount,
+                           size_t offset, size_t matchLength) {
+    unsigned char* token = op++;
+    *token = (unsigned char)((literalCount < 15 ? literalCount : 15) << 4);
+    if (literalCount >= 15) {
+        op = PutLength(op, literalCount - 15);
+    }
+    if (literalCount > 0) {
+        memcpy(op, literals, literalCount);
+        op += literalCount;
+    }
+    if (matchLength == 0) {
+        return op;
+    }
+    *op++ = (unsigned char)offset;
+    *op++ = (unsigned char)(offset >> 8);
+    size_t extra = matchLength - kMinMatch;
+    *token |= (unsigned char)(extra < 15 ? extra : 15);
+    if (extra >= 15) {
+        op = PutLength(op, extra - 15);
+    }
+    return op;
+}
+
+bool GetLength(const unsigned char*& ip, const unsigned char* end, size_t& length) {
+    unsigned char b;
+    do {
+        if (ip >= end) return false;
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+} // namespace
+
+namespace LzCodec {
+
+size_t CompressBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+Compressor::Compressor() : m_table((size_t)1 << kHashBits) {
+}
+
+size_t Compressor::Compress(const unsigned char* data, size_t size, unsigned char* out) {
+    unsigned char* op = out;
+    size_t anchor = 0;
+    if (size > kEndLiterals + kMinMatch) {
+        std::fill(m_table.begin(), m_table.end(), 0);
+        const size_t limit = size - kEndLiterals - kMinMatch;
+        size_t ip = 0;
+        while (ip < limit) {
+            uint32_t sequence = Read32(data + ip);
+            uint32_t& slot = m_table[HashOf(sequence)];
+            size_t ref = slot;   // Position + 1
+            slot = (uint32_t)(ip + 1);
+            if (ref == 0 || ip + 1 - ref > kMaxOffset || Read32(data + ref - 1) != sequence) {
+                // Skip faster through data that keeps not matching.
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            ref -= 1;
+
+            // Extend backwards over literals, then forwards eight bytes at a time.
+            while (ip > anchor && ref > 0 && data[ip - 1] == data[ref - 1]) {
+                --ip;
+                --ref;
+            }
+            size_t length = kMinMatch;
+            const size_t matchEnd = size - kEndLiterals;
+            while (ip + length + 8 <= matchEnd) {
+                uint64_t diff = Read64(data + ip + length) ^ Read64(data + ref + length);
+                if (diff != 0) {
+                    length += TrailingZeroBytes(diff);
+                    break;
+                }
+                length += 8;
+            }
+            if (ip + length + 8 > matchEnd) {
+                while (ip + length < matchEnd && data[ip + length] == data[ref + length]) {
+                    ++length;
+                }
+            }
+
+            op = PutSequence(op, data + anchor, ip - anchor, ip - ref, length);
+            ip += length;
+            anchor = ip;
+            if (ip - 2 < limit) {
+                m_table[HashOf(Read32(data + ip - 2))] = (uint32_t)(ip - 1);
+            }
+        }
+    }
+    op = PutSequence(op, data + anchor, size - anchor, 0, 0);
+    return (size_t)(op - out);
+}
+
+bool Decompress(const unsigned char* data, size_t size, unsigned char* out, size_t outSize) {
+    const unsigned char* ip = data;
+    const unsigned char* const end = data + size;
+    unsigned char* op = out;
+    unsigned char* const outEnd = out + outSize;
+
+    while (ip < end) {
+        unsigned char token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !GetLength(ip, end, literals)) {
+            return false;
+        }
+        if (literals > (size_t)(end - ip) || literals > (size_t)(outEnd - op)) {
+            return false;
+        }
+        if (literals <= 16 && end - ip >= 16 && outEnd - op >= 16) {
+            // Short literals with room to spare: one fixed-size copy, the excess rewritten later.
+            memcpy(op, ip, 16);
+        } else if (literals > 0) {
+            memcpy(op, ip, literals);
+        }
+        ip += literals;
+        op += literals;
+        if (ip == end) {
+            break;
+        }
+
+        if (end - ip < 2) {
+            return false;
+        }
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        size_t length = token & 15;
+        if (length == 15 && !GetLength(ip, end, length)) {
+            return false;
+        }
+        length += kMinMatch;
+        if (offset == 0 || offset > (size_t)(op - out) || length > (size_t)(outEnd - op)) {
+            return false;
+        }
+
+        const unsigned char* match = op - offset;
+        if (offset >= 8 && (size_t)(outEnd - op) >= length + 8) {
+            // Each 8-byte step reads only bytes already written; the last may overshoot.
+            for (size_t i = 0; i < length; i += 8) {
+                memcpy(op + i, match + i, 8);
+            }
+        } else if (offset >= 8) {
+            size_t i = 0;
+            for (; i + 8 <= length; i += 8) {
+                memcpy(op + i, match + i, 8);
+            }
+            for (; i < length; ++i) {
+                op[i] = match[i];
+            }
+        } else {
+            // Overlapping runs (a repeated byte or short pattern): byte by byte.
+            for (size_t i = 0; i < length; ++i) {
+                op[i] = match[i];
+            }
+        }
+        op += length;
+    }
+    return op == outEnd;
+}
+
+} // namespace LzCodec
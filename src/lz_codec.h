@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A small LZ77 block codec in the LZ4 mould: byte-aligned sequences of literals and 64 KiB-window
+// matches, no entropy stage, so it compresses at hundreds of MB/s and decodes faster still.
+// Blocks are independent.
+//
+// Sequence layout: a token (literal count in the high nibble, match length - 4 in the low one; 15
+// means more follows as bytes added up until one is below 255), the literals, then the match
+// offset (u16, little-endian, never 0) and the extra length bytes. The last sequence is literals
+// only and ends the block.
+namespace LzCodec {
+
+// Largest output Compress can produce for size bytes of input.
+size_t CompressBound(size_t size);
+
+// Reusable state for Compress, so repeated calls don't reallocate the match table.
+class Compressor {
+public:
+    Compressor();
+
+    // Compresses size bytes into out (at least CompressBound(size) bytes). Returns the compressed
+    // length; the same input always compresses to the same bytes.
+    size_t Compress(const unsigned char* data, size_t size, unsigned char* out);
+
+private:
+    std::vector<uint32_t> m_table;   // Last position + 1 per hash, 0 = none
+};
+
+// Decompresses a whole block into exactly outSize bytes. False when the block is damaged or does
+// not decode to outSize bytes; never reads or writes outside the buffers.
+bool Decompress(const unsigned char* data, size_t size, unsigned char* out, size_t outSize);
+
+} // namespace LzCodec
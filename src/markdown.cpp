@@ -0,0 +1,420 @@
+#include "markdown.h"
+#include <cwctype>
+#include <unordered_set>
+
+namespace Markdown {
+
+namespace {
+
+// Finds the target (and optional label) of a [[wiki link]] at pos. Works on both UTF-16 and UTF-8
+// text since every delimiter is ASCII.
+template <typename CharT>
+bool ScanWikiLink(const std::basic_string<CharT>& text, size_t pos, size_t& end,
+                  size_t& targetStart, size_t& targetLength, size_t& labelStart, size_t& labelLength) {
+    if (pos + 1 >= text.size() || text[pos] != CharT('[') || text[pos + 1] != CharT('[')) {
+        return false;
+    }
+
+    size_t pipe = std::basic_string<CharT>::npos;
+    size_t i = pos + 2;
+    for (; i + 1 < text.size(); ++i) {
+        CharT c = text[i];
+        if (c == CharT('\n') || c == CharT('\r') || c == CharT('[')) {
+            return false;
+        }
+        if (c == CharT(']')) {
+            if (text[i + 1] != CharT(']')) {
+                return false;
+            }
+            break;
+        }
+        if (c == CharT('|') && pipe == std::basic_string<CharT>::npos) {
+            pipe = i;
+        }
+    }
+    if (i + 1 >= text.size()) {
+        return false;
+    }
+
+    auto trim = [&](size_t start, size_t stop, size_t& outStart, size_t& outLength) {
+        while (start < stop && (text[start] == CharT(' ') || text[start] == CharT('\t'))) ++start;
+        while (stop > start && (text[stop - 1] == CharT(' ') || text[stop - 1] == CharT('\t'))) --stop;
+        outStart = start;
+        outLength = stop - start;
+    };
+
+    size_t targetEnd = (pipe != std::basic_string<CharT>::npos) ? pipe : i;
+    trim(pos + 2, targetEnd, targetStart, targetLength);
+    if (targetLength == 0) {
+        return false;
+    }
+    if (pipe != std::basic_string<CharT>::npos) {
+        trim(pipe + 1, i, labelStart, labelLength);
+    }
+    if (pipe == std::basic_string<CharT>::npos || labelLength == 0) {
+        labelStart = targetStart;
+        labelLength = targetLength;
+    }
+    end = i + 2;
+    return true;
+}
+
+} // namespace
+
+std::wstring TrimLeft(const std::wstring& s) {
+    size_t i = 0;
+    while (i < s.size() && (s[i] == L' ' || s[i] == L'\t')) {
+        ++i;
+    }
+    return s.substr(i);
+}
+
+std::wstring TrimRightSpaces(const std::wstring& s) {
+    size_t end = s.size();
+    while (end > 0 && (s[end - 1] == L' ' || s[end - 1] == L'\t')) {
+        --end;
+    }
+    return s.substr(0, end);
+}
+
+std::wstring TrimSpaces(const std::wstring& s) {
+    size_t start = 0;
+    while (start < s.size() && (s[start] == L' ' || s[start] == L'\t')) {
+        ++start;
+    }
+    size_t end = s.size();
+    while (end > start && (s[end - 1] == L' ' || s[end - 1] == L'\t')) {
+        --end;
+    }
+    return s.substr(start, end - start);
+}
+
+bool LooksLikeMarkdownTableRow(const std::wstring& trimmed) {
+    // Minimal heuristic: must contain at least 2 pipes and some non-pipe content.
+    int pipes = 0;
+    bool hasOther = false;
+    for (wchar_t c : trimmed) {
+        if (c == L'|') pipes++;
+        else if (c != L' ' && c != L'\t') hasOther = true;
+    }
+    return (pipes >= 2 && hasOther);
+}
+
+bool LooksLikeMarkdownTableSeparator(const std::wstring& trimmed) {
+    // Separator line like: | --- | ---: | :--- |
+    bool sawDash = false;
+    bool sawPipe = false;
+    for (wchar_t c : trimmed) {
+        if (c == L'|') {
+            sawPipe = true;
+            continue;
+        }
+        if (c == L'-') {
+            sawDash = true;
+            continue;
+        }
+        if (c == L':' || c == L' ' || c == L'\t') {
+            continue;
+        }
+        return false;
+    }
+    return sawPipe && sawDash;
+}
+
+std::vector<std::wstring> SplitMarkdownTableRow(const std::wstring& line) {
+    std::wstring t = TrimSpaces(line);
+    if (!t.empty() && t.front() == L'|') t.erase(t.begin());
+    if (!t.empty() && t.back() == L'|') t.pop_back();
+
+    std::vector<std::wstring> cells;
+    size_t start = 0;
+    while (start <= t.size()) {
+        size_t end = t.find(L'|', start);
+        std::wstring cell = (end == std::wstring::npos) ? t.substr(start) : t.substr(start, end - start);
+        cells.push_back(TrimSpaces(cell));
+        if (end == std::wstring::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+
+    // Drop trailing empty cell caused by a final '|' after trimming.
+    while (!cells.empty() && cells.back().empty()) {
+        cells.pop_back();
+    }
+    return cells;
+}
+
+bool HasMarkdownHardBreak(const std::wstring& line) {
+    // In Markdown, two trailing spaces indicate a hard line break.
+    // Count actual spaces (not tabs).
+    int spaces = 0;
+    for (size_t i = line.size(); i > 0; --i) {
+        wchar_t c = line[i - 1];
+        if (c == L' ') {
+            spaces++;
+        } else if (c == L'\t') {
+            // tabs don't count toward the "two spaces" convention
+            continue;
+        } else {
+            break;
+        }
+        if (spaces >= 2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IsHorizontalRule(const std::wstring& trimmed) {
+    if (trimmed.size() < 3) return false;
+    wchar_t ch = trimmed[0];
+    if (ch != L'-' && ch != L'*' && ch != L'_') return false;
+    int count = 0;
+    for (wchar_t c : trimmed) {
+        if (c == ch) {
+            count++;
+        } else if (c != L' ' && c != L'\t') {
+            return false;
+        }
+    }
+    return count >= 3;
+}
+
+int ParseAtxHeading(const std::wstring& trimmed, std::wstring& text) {
+    size_t i = 0;
+    while (i < trimmed.size() && trimmed[i] == L'#' && i < 6) {
+        ++i;
+    }
+    if (i > 0 && i < trimmed.size() && trimmed[i] == L' ') {
+        text = trimmed.substr(i + 1);
+        return (int)i;
+    }
+    return 0;
+}
+
+std::wstring EnsureUrlHasScheme(const std::wstring& url) {
+    if (url.empty()) {
+        return url;
+    }
+    if (url.find(L"://") != std::wstring::npos) {
+        return url;
+    }
+    // Allow mailto: and other non-:// schemes
+    if (url.find(L":") != std::wstring::npos) {
+        return url;
+    }
+    return L"https://" + url;
+}
+
+bool IsSafeLinkUrl(const std::wstring& url) {
+    std::wstring scheme;
+    for (wchar_t c : url) {
+        if (c == L'\t' || c == L'\r' || c == L'\n' || (scheme.empty() && c <= L' ')) {
+            continue;
+        }
+        if (c == L':') {
+            return scheme == L"http" || scheme == L"https" || scheme == L"mailto";
+        }
+        bool letter = (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z');
+        bool schemeChar = letter || (!scheme.empty() && ((c >= L'0' && c <= L'9') || c == L'+' || c == L'-' || c == L'.'));
+        if (!schemeChar) {
+            // A path, query or fragment comes first: relative.
+            return true;
+        }
+        scheme += (wchar_t)towlower(c);
+    }
+    return true;
+}
+
+bool ParseWikiLink(const std::wstring& text, size_t pos, size_t& end, std::wstring& target, std::wstring& label) {
+    size_t targetStart = 0, targetLength = 0, labelStart = 0, labelLength = 0;
+    if (!ScanWikiLink(text, pos, end, targetStart, targetLength, labelStart, labelLength)) {
+        return false;
+    }
+    target = text.substr(targetStart, targetLength);
+    label = text.substr(labelStart, labelLength);
+    return true;
+}
+
+std::vector<std::string> ExtractWikiLinkTargets(const std::string& content) {
+    std::vector<std::string> targets;
+    std::unordered_set<std::string> seen;
+    size_t pos = content.find("[[");
+    while (pos != std::string::npos) {
+        size_t end = 0, targetStart = 0, targetLength = 0, labelStart = 0, labelLength = 0;
+        if (!ScanWikiLink(content, pos, end, targetStart, targetLength, labelStart, labelLength)) {
+            pos = content.find("[[", pos + 1);
+            continue;
+        }
+
+        std::string target = content.substr(targetStart, targetLength);
+        std::string key = target;
+        for (char& c : key) {
+            if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        }
+        if (seen.insert(std::move(key)).second) {
+            targets.push_back(std::move(target));
+        }
+        pos = content.find("[[", end);
+    }
+    return targets;
+}
+
+std::vector<InlineRun> ParseInlineMarkdown(const std::wstring& text) {
+    std::vector<InlineRun> runs;
+    bool bold = false;
+    bool italic = false;
+    bool strike = false;
+
+    auto flush = [&](std::wstring& buf) {
+        if (!buf.empty()) {
+            InlineRun r;
+            r.text = buf;
+            r.bold = bold;
+            r.italic = italic;
+            r.strike = strike;
+            runs.push_back(std::move(r));
+            buf.clear();
+        }
+    };
+
+    std::wstring buf;
+    for (size_t i = 0; i < text.size();) {
+        // Note link: [[Title]] or [[Title|label]]
+        if (text[i] == L'[' && i + 1 < text.size() && text[i + 1] == L'[') {
+            size_t end = 0;
+            std::wstring target, label;
+            if (ParseWikiLink(text, i, end, target, label)) {
+                flush(buf);
+                InlineRun r;
+                r.text = std::move(label);
+                r.bold = bold;
+                r.italic = italic;
+                r.strike = strike;
+                r.wikiTarget = std::move(target);
+                runs.push_back(std::move(r));
+                i = end;
+                continue;
+            }
+        }
+
+        // Link: [text](url)
+        if (text[i] == L'[') {
+            size_t closeBracket = text.find(L']', i + 1);
+            if (closeBracket != std::wstring::npos && closeBracket + 1 < text.size() && text[closeBracket + 1] == L'(') {
+                size_t closeParen = text.find(L')', closeBracket + 2);
+                if (closeParen != std::wstring::npos) {
+                    flush(buf);
+                    InlineRun r;
+                    r.text = text.substr(i + 1, closeBracket - (i + 1));
+                    r.bold = bold;
+                    r.italic = italic;
+                    r.strike = strike;
+                    r.link = true;
+                    r.url = text.substr(closeBracket + 2, closeParen - (closeBracket + 2));
+                    runs.push_back(std::move(r));
+                    i = closeParen + 1;
+                    continue;
+                }
+            }
+        }
+
+        // Strike: ~~
+        if (i + 1 < text.size() && text[i] == L'~' && text[i + 1] == L'~') {
+            flush(buf);
+            strike = !strike;
+            i += 2;
+            continue;
+        }
+
+        // Bold: ** or __
+        if (i + 1 < text.size() && ((text[i] == L'*' && text[i + 1] == L'*') || (text[i] == L'_' && text[i + 1] == L'_'))) {
+            flush(buf);
+            bold = !bold;
+            i += 2;
+            continue;
+        }
+
+        // Italic: * or _
+        if (text[i] == L'*' || text[i] == L'_') {
+            flush(buf);
+            italic = !italic;
+            i += 1;
+            continue;
+        }
+
+        buf.push_back(text[i]);
+        i += 1;
+    }
+    flush(buf);
+    return runs;
+}
+
+bool IsIndentedCodeLine(const std::wstring& line) {
+    // Four spaces or a tab, followed by some content.
+    size_t i = 0;
+    if (!line.empty() && line[0] == L'\t') {
+        i = 1;
+    } else {
+        while (i < line.size() && i < 4 && line[i] == L' ') {
+            ++i;
+        }
+        if (i < 4) {
+            return false;
+        }
+    }
+    return !TrimLeft(line.substr(i)).empty();
+}
+
+std::wstring StripCodeIndent(const std::wstring& line) {
+    if (!line.empty() && line[0] == L'\t') {
+        return line.substr(1);
+    }
+    size_t i = 0;
+    while (i < line.size() && i < 4 && line[i] == L' ') {
+        ++i;
+    }
+    return line.substr(i);
+}
+
+bool ParseMarkdownFence(const std::wstring& line, wchar_t& fenceChar, size_t& fenceLength, std::wstring* info) {
+    size_t i = 0;
+    while (i < line.size() && i < 3 && line[i] == L' ') {
+        ++i;
+    }
+    if (i >= line.size() || (line[i] != L'`' && line[i] != L'~')) {
+        return false;
+    }
+
+    wchar_t ch = line[i];
+    size_t count = 0;
+    while (i < line.size() && line[i] == ch) {
+        ++count;
+        ++i;
+    }
+    if (count < 3) {
+        return false;
+    }
+    // A backtick fence's info string can't contain backticks (that's inline code).
+    if (ch == L'`' && line.find(L'`', i) != std::wstring::npos) {
+        return false;
+    }
+
+    fenceChar = ch;
+    fenceLength = count;
+    if (info) {
+        size_t start = i;
+        while (start < line.size() && (line[start] == L' ' || line[start] == L'\t')) {
+            ++start;
+        }
+        size_t end = line.size();
+        while (end > start && (line[end - 1] == L' ' || line[end - 1] == L'\t')) {
+            --end;
+        }
+        *info = line.substr(start, end - start);
+    }
+    return true;
+}
+
+} // namespace Markdown
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Markdown line/inline parsing shared by the preview renderer and the HTML exporter.
+namespace Markdown {
+
+struct InlineRun {
+    std::wstring text;
+    bool bold = false;
+    bool italic = false;
+    bool strike = false;
+    bool link = false;
+    std::wstring url;
+    std::wstring wikiTarget;  // Non-empty for [[note links]]; link is false for those
+};
+
+std::wstring TrimLeft(const std::wstring& s);
+std::wstring TrimRightSpaces(const std::wstring& s);
+std::wstring TrimSpaces(const std::wstring& s);
+
+bool LooksLikeMarkdownTableRow(const std::wstring& trimmed);
+bool LooksLikeMarkdownTableSeparator(const std::wstring& trimmed);
+std::vector<std::wstring> SplitMarkdownTableRow(const std::wstring& line);
+
+// Two trailing spaces indicate a hard line break.
+bool HasMarkdownHardBreak(const std::wstring& line);
+bool IsHorizontalRule(const std::wstring& trimmed);
+// Returns 1..6 for "# " .. "###### " headers (text receives the header text), 0 otherwise.
+int ParseAtxHeading(const std::wstring& trimmed, std::wstring& text);
+std::wstring EnsureUrlHasScheme(const std::wstring& url);
+// True for links that are safe to emit as a live href: http, https and mailto URLs, and URLs
+// without a scheme. Leading spaces and embedded tabs/newlines, which browsers skip, don't hide
+// a scheme ("java\tscript:").
+bool IsSafeLinkUrl(const std::wstring& url);
+
+// Recognizes a wiki link [[Target]] or [[Target|label]] starting at pos (no line breaks inside).
+// end receives the index just past the closing brackets; label is the target when none is given.
+bool ParseWikiLink(const std::wstring& text, size_t pos, size_t& end, std::wstring& target, std::wstring& label);
+
+// Returns the distinct [[link]] targets of UTF-8 note content, trimmed, in first-seen order.
+// Targets differing only in ASCII case count once, matching the NOCASE title lookup.
+std::vector<std::string> ExtractWikiLinkTargets(const std::string& content);
+
+// Splits a line into styled runs: [[note link]], [text](url), ~~strike~~, **bold**/__bold__, *italic*/_italic_.
+std::vector<InlineRun> ParseInlineMarkdown(const std::wstring& text);
+
+// Indented code: four spaces or a tab followed by some content.
+bool IsIndentedCodeLine(const std::wstring& line);
+std::wstring StripCodeIndent(const std::wstring& line);
+
+// Recognizes a fenced code block delimiter (``` or ~~~, at most 3 leading spaces).
+// fenceLength receives the number of fence characters and info (optional) the trimmed info string.
+bool ParseMarkdownFence(const std::wstring& line, wchar_t& fenceChar, size_t& fenceLength, std::wstring* info = nullptr);
+
+} // namespace Markdown
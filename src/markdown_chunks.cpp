@@ -0,0 +1,98 @@
+#include "markdown_chunks.h"
+#include "markdown.h"
+#include <utility>
+
+static bool IsBlankLine(const std::wstring& line) {
+    for (wchar_t c : line) {
+        if (c != L' ' && c != L'\t') {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned int MarkdownChunkScheduler::Reset(std::wstring text) {
+    m_text = std::move(text);
+    m_pos = 0;
+    m_active = true;
+    m_fenceChar = 0;
+    m_fenceLength = 0;
+    m_fenceInfo.clear();
+    return ++m_generation;
+}
+
+void MarkdownChunkScheduler::Cancel() {
+    m_active = false;
+    m_text.clear();
+    m_text.shrink_to_fit();
+    m_pos = 0;
+    m_fenceChar = 0;
+    m_fenceLength = 0;
+    m_fenceInfo.clear();
+    ++m_generation;
+}
+
+bool MarkdownChunkScheduler::NextChunk(unsigned int generation, const MarkdownChunkLimits& limits, std::vector<std::wstring>& outLines) {
+    outLines.clear();
+    if (generation != m_generation || !HasMore()) {
+        return false;
+    }
+
+    // The previous chunk was cut inside fenced code: reopen the block, or the renderer would take
+    // the rest of it for prose and its closing fence for the start of a new block.
+    if (m_fenceChar != 0) {
+        outLines.push_back(std::wstring(m_fenceLength, m_fenceChar) + m_fenceInfo);
+    }
+
+    size_t chars = 0;
+    while (m_pos <= m_text.size()) {
+        size_t end = m_text.find(L'\n', m_pos);
+        bool last = (end == std::wstring::npos);
+        if (last) {
+            end = m_text.size();
+        }
+
+        std::wstring line = m_text.substr(m_pos, end - m_pos);
+        if (!line.empty() && line.back() == L'\r') {
+            line.pop_back();
+        }
+        chars += (end - m_pos) + 1;
+        bool blank = IsBlankLine(line);
+        wchar_t fenceChar = 0;
+        size_t fenceLength = 0;
+        std::wstring info;
+        if (!blank && Markdown::ParseMarkdownFence(line, fenceChar, fenceLength, &info)) {
+            if (m_fenceChar == 0) {
+                m_fenceChar = fenceChar;
+                m_fenceLength = fenceLength;
+                m_fenceInfo = info;
+            } else if (fenceChar == m_fenceChar && fenceLength >= m_fenceLength && info.empty()) {
+                m_fenceChar = 0;
+                m_fenceLength = 0;
+                m_fenceInfo.clear();
+            }
+        }
+        outLines.push_back(std::move(line));
+
+        if (last) {
+            // Past the end: HasMore() turns false.
+            m_pos = m_text.size() + 1;
+            break;
+        }
+        m_pos = end + 1;
+
+        bool sizeReached = (outLines.size() >= limits.minLines && chars >= limits.minChars);
+        // Blank lines inside fenced code aren't block boundaries.
+        if (blank && sizeReached && m_fenceChar == 0) {
+            break;
+        }
+        if (limits.maxChars > 0 && chars >= limits.maxChars) {
+            break;
+        }
+    }
+
+    if (!HasMore()) {
+        m_active = false;
+    }
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Limits for a single render chunk. A chunk normally ends right after a blank line outside fenced
+// code (a block boundary), so every chunk can be rendered on its own with only the carried-over
+// spacing state. A hard cut inside fenced code makes the next chunk start with a copy of the
+// opening fence, so the rest of the block still renders as code.
+struct MarkdownChunkLimits {
+    size_t minLines = 0;  // don't stop at a block boundary before this many lines...
+    size_t minChars = 0;  // ...or before this many characters
+    size_t maxChars = 0;  // hard cut at a line boundary when no block boundary shows up (0 = none)
+};
+
+// Splits markdown text into line chunks lazily, so the cost of producing a chunk only depends on
+// the chunk and not on the size of the note. Has no window dependencies; the caller decides when
+// to ask for the next chunk (e.g. from a timer) and cancels by calling Cancel() or Reset().
+class MarkdownChunkScheduler {
+public:
+    // Starts a new render generation over text. Any chunks of the previous generation are dropped.
+    unsigned int Reset(std::wstring text);
+
+    // Drops the remaining chunks of the current generation.
+    void Cancel();
+
+    unsigned int Generation() const { return m_generation; }
+    bool HasMore() const { return m_active && m_pos <= m_text.size(); }
+    size_t Position() const { return m_pos; }
+    size_t TextSize() const { return m_text.size(); }
+
+    // Fills outLines with the next chunk of lines (CR stripped). Returns false when generation is
+    // stale (the render was cancelled or restarted) or when there is nothing left to render.
+    bool NextChunk(unsigned int generation, const MarkdownChunkLimits& limits, std::vector<std::wstring>& outLines);
+
+private:
+    std::wstring m_text;
+    size_t m_pos = 0;
+    unsigned int m_generation = 0;
+    bool m_active = false;
+    wchar_t m_fenceChar = 0;     // Non-zero while inside a fenced code block
+    size_t m_fenceLength = 0;
+    std::wstring m_fenceInfo;    // Info string of the open fence, repeated when it is reopened
+};
@@ -20,5 +20,6 @@ struct Note {
     bool is_checklist = false;
     std::string created_at;
     std::string modified_at;
+    std::string spell_language;   // Spell check locale picked for this note (e.g. "en_GB"), empty until detected
     std::vector<ChecklistItem> checklist_items;
 };
@@ -0,0 +1,772 @@
+#include "page_delta.h"
+#include "sync_codec.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+const char kPatchMagic[8] = { 'N', 'S', 'F', 'P', 'T', 'C', 'H', '1' };
+const char kStateMagic[8] = { 'N', 'S', 'F', 'S', 'Y', 'N', 'C', '2' };
+const char kStateMagicV1[8] = { 'N', 'S', 'F', 'S', 'Y', 'N', 'C', '1' };
+const uint32_t kDefaultPageSize = 4096;
+
+inline uint64_t Rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t Mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+void PutU16(std::vector<unsigned char>& out, uint32_t v) {
+    out.push_back((unsigned char)v);
+    out.push_back((unsigned char)(v >> 8));
+}
+
+void PutU32(std::vector<unsigned char>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back((unsigned char)(v >> (8 * i)));
+}
+
+void PutU64(std::vector<unsigned char>& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out.push_back((unsigned char)(v >> (8 * i)));
+}
+
+// Bounds-checked little-endian reader over a byte buffer.
+struct Reader {
+    const unsigned char* p;
+    size_t left;
+
+    bool Bytes(size_t n, const unsigned char*& out) {
+        if (n > left) return false;
+        out = p;
+        p += n;
+        left -= n;
+        return true;
+    }
+    bool U16(uint32_t& v) {
+        const unsigned char* b;
+        if (!Bytes(2, b)) return false;
+        v = (uint32_t)b[0] | ((uint32_t)b[1] << 8);
+        return true;
+    }
+    bool U32(uint32_t& v) {
+        const unsigned char* b;
+        if (!Bytes(4, b)) return false;
+        v = 0;
+        for (int i = 0; i < 4; ++i) v |= (uint32_t)b[i] << (8 * i);
+        return true;
+    }
+    bool U64(uint64_t& v) {
+        const unsigned char* b;
+        if (!Bytes(8, b)) return false;
+        v = 0;
+        for (int i = 0; i < 8; ++i) v |= (uint64_t)b[i] << (8 * i);
+        return true;
+    }
+};
+
+size_t PageCount(uint64_t size, uint32_t pageSize) {
+    return (size_t)((size + pageSize - 1) / pageSize);
+}
+
+size_t PageLength(uint64_t size, uint32_t pageSize, size_t index) {
+    uint64_t start = (uint64_t)index * pageSize;
+    uint64_t rest = size - start;
+    return (size_t)(rest < pageSize ? rest : pageSize);
+}
+
+// Decodes a downloaded base or patch in place; raw ones (format 1, or a version without delta
+// sync) are left alone.
+bool Unpack(std::vector<unsigned char>& bytes, std::string& error) {
+    if (!SyncCodec::IsEncoded(bytes.data(), bytes.size())) {
+        return true;
+    }
+    std::vector<unsigned char> plain;
+    if (!SyncCodec::Decode(bytes, plain, error)) {
+        return false;
+    }
+    bytes.swap(plain);
+    return true;
+}
+
+// Folds page hashes into PageDelta::Fingerprint, a page at a time. The first page is hashed again
+// without the header fields SQLite rewrites on its own: the change counter (offset 24), the schema
+// cookie (40), which every backup bumps, and the version-valid-for and library numbers (92).
+class Fingerprinter {
+public:
+    explicit Fingerprinter(uint64_t size) : m_h(0x2545F4914F6CDD1Dull ^ size) {}
+
+    void AddPage(size_t index, const unsigned char* page, size_t length, uint64_t pageHash) {
+        if (index == 0 && length >= 100) {
+            std::vector<unsigned char> first(page, page + length);
+            memset(&first[24], 0, 4);
+            memset(&first[40], 0, 4);
+            memset(&first[92], 0, 8);
+            pageHash = PageDelta::Hash(first.data(), first.size());
+        }
+        m_h = Mix(Rotl(m_h, 23) ^ pageHash);
+    }
+
+    uint64_t Final() const { return m_h; }
+
+private:
+    uint64_t m_h;
+};
+
+std::string Hex64(uint64_t v) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)v);
+    return buf;
+}
+
+// Skips what Hex64 writes, or a run of decimal digits; false when it is not there.
+bool SkipHex64(const std::string& s, size_t& pos) {
+    if (s.size() - pos < 16) return false;
+    for (size_t end = pos + 16; pos < end; ++pos) {
+        if (!isxdigit((unsigned char)s[pos]) || isupper((unsigned char)s[pos])) return false;
+    }
+    return true;
+}
+
+bool SkipDigits(const std::string& s, size_t& pos) {
+    size_t start = pos;
+    while (pos < s.size() && isdigit((unsigned char)s[pos])) ++pos;
+    return pos > start;
+}
+
+// A base or patch object of fileName under any version's naming, as opposed to its manifest, its
+// op batches or the whole file an older version uploads.
+bool IsDeltaObject(const std::string& fileName, const std::string& name) {
+    if (name.size() <= fileName.size() + 1 || name.compare(0, fileName.size(), fileName) != 0 ||
+        name[fileName.size()] != '.') {
+        return false;
+    }
+    std::string rest = name.substr(fileName.size() + 1);
+    if (rest == "patch") {
+        return true;
+    }
+    size_t pos = 0;
+    if (!SkipHex64(rest, pos) || pos == rest.size() || rest[pos++] != '-' || !SkipDigits(rest, pos)) {
+        return false;
+    }
+    if (pos == rest.size()) {
+        return true;
+    }
+    return rest[pos++] == '.' && SkipDigits(rest, pos) && pos < rest.size() && rest[pos++] == '-' &&
+        SkipHex64(rest, pos) && pos == rest.size();
+}
+
+} // namespace
+
+namespace PageDelta {
+
+uint64_t Hash(const unsigned char* data, size_t size) {
+    Hasher hasher(size);
+    hasher.Update(data, size);
+    return hasher.Final();
+}
+
+Hasher::Hasher(uint64_t totalSize) : m_h(0x9E3779B97F4A7C15ull ^ (totalSize * 0x87C37B91114253D5ull)) {
+}
+
+void Hasher::Update(const unsigned char* data, size_t size) {
+    // Eight bytes per step; pages are hashed on every upload, so this has to keep up with the disk.
+    uint64_t h = m_h;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t k;
+        memcpy(&k, data + i, 8);
+        k *= 0x87C37B91114253D5ull;
+        k = Rotl(k, 31);
+        k *= 0x4CF5AD432745937Full;
+        h ^= k;
+        h = Rotl(h, 27) * 5 + 0x52DCE729;
+    }
+    m_h = h;
+    for (size_t shift = 0; i < size; ++i, shift += 8) {
+        m_tail |= (uint64_t)data[i] << shift;
+    }
+}
+
+uint64_t Hasher::Final() const {
+    return Mix(m_h ^ Mix(m_tail));
+}
+
+uint32_t PageSizeOf(const unsigned char* data, size_t size) {
+    static const char kSqliteMagic[] = "SQLite format 3";
+    if (size < 100 || memcmp(data, kSqliteMagic, sizeof(kSqliteMagic)) != 0) {
+        return kDefaultPageSize;
+    }
+    uint32_t pageSize = ((uint32_t)data[16] << 8) | data[17];
+    if (pageSize == 1) {
+        return 65536;
+    }
+    // A power of two between 512 and 32768, or the header is not to be trusted.
+    if (pageSize < 512 || pageSize > 32768 || (pageSize & (pageSize - 1)) != 0) {
+        return kDefaultPageSize;
+    }
+    return pageSize;
+}
+
+std::vector<uint64_t> HashPages(const unsigned char* data, size_t size, uint32_t pageSize) {
+    std::vector<uint64_t> hashes(PageCount(size, pageSize));
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        hashes[i] = Hash(data + i * pageSize, PageLength(size, pageSize, i));
+    }
+    return hashes;
+}
+
+uint64_t Fingerprint(const unsigned char* data, size_t size) {
+    const uint32_t pageSize = PageSizeOf(data, size);
+    Fingerprinter fingerprint(size);
+    for (size_t i = 0; i < PageCount(size, pageSize); ++i) {
+        const unsigned char* page = data + i * pageSize;
+        size_t length = PageLength(size, pageSize, i);
+        fingerprint.AddPage(i, page, length, Hash(page, length));
+    }
+    return fingerprint.Final();
+}
+
+bool Fingerprint(SyncSource& source, uint64_t& out) {
+    const uint64_t size = source.Size();
+    std::vector<unsigned char> chunk((size_t)(size < kSyncChunkSize ? size : kSyncChunkSize));
+    uint32_t pageSize = kDefaultPageSize;
+    Fingerprinter fingerprint(size);
+    size_t index = 0;
+    for (uint64_t offset = 0; offset < size; offset += chunk.size()) {
+        size_t length = (size_t)(size - offset < chunk.size() ? size - offset : chunk.size());
+        if (!source.Read(offset, chunk.data(), length)) {
+            return false;
+        }
+        if (offset == 0) {
+            pageSize = PageSizeOf(chunk.data(), length);
+        }
+        for (size_t at = 0; at < length; at += pageSize, ++index) {
+            size_t pageLength = length - at < pageSize ? length - at : pageSize;
+            fingerprint.AddPage(index, chunk.data() + at, pageLength, Hash(chunk.data() + at, pageLength));
+        }
+    }
+    out = fingerprint.Final();
+    return true;
+}
+
+std::string BaseIdOf(const unsigned char* data, size_t size) {
+    return Hex64(Hash(data, size)) + "-" + std::to_string(size);
+}
+
+bool PlanUpload(const SyncState& last, SyncSource& snapshot, UploadPlan& outPlan) {
+    outPlan = UploadPlan();
+    UploadPlan& plan = outPlan;
+    const uint64_t size = snapshot.Size();
+    std::vector<unsigned char> chunk((size_t)(size < kSyncChunkSize ? size : kSyncChunkSize));
+    if (!chunk.empty() && !snapshot.Read(0, chunk.data(), chunk.size())) {
+        return false;
+    }
+    const uint32_t pageSize = PageSizeOf(chunk.data(), chunk.size());
+
+    // Cumulative against the base: every page the base lacks or has different. Only the page
+    // numbers are kept; PatchSource reads the pages again when the patch is sent.
+    const bool haveBase = !last.baseId.empty() && last.pageSize == pageSize;
+    bool patchable = haveBase && last.patchCount + 1 < kMaxPatchesPerBase;
+    uint64_t patchSize = 0;
+    if (patchable) {
+        std::vector<unsigned char>& header = plan.patchHeader;
+        header.insert(header.end(), kPatchMagic, kPatchMagic + sizeof(kPatchMagic));
+        PutU16(header, (uint32_t)last.baseId.size());
+        header.insert(header.end(), last.baseId.begin(), last.baseId.end());
+        PutU64(header, size);
+        PutU32(header, pageSize);
+        PutU64(header, 0);   // File hash, known at the end
+        PutU32(header, 0);   // Page count, likewise
+        patchSize = header.size();
+    }
+
+    // One pass: the file hash, and the page hashes a new base would need. A chunk is a whole
+    // number of pages, since kSyncChunkSize is a multiple of every SQLite page size.
+    Hasher fileHasher(size);
+    Fingerprinter fingerprint(size);
+    std::vector<uint64_t> pageHashes;
+    pageHashes.reserve(PageCount(size, pageSize));
+    for (uint64_t offset = 0; offset < size; offset += chunk.size()) {
+        size_t length = (size_t)(size - offset < chunk.size() ? size - offset : chunk.size());
+        if (offset > 0 && !snapshot.Read(offset, chunk.data(), length)) {
+            return false;
+        }
+        fileHasher.Update(chunk.data(), length);
+        for (size_t at = 0; at < length; at += pageSize) {
+            size_t index = pageHashes.size();
+            size_t pageLength = length - at < pageSize ? length - at : pageSize;
+            pageHashes.push_back(Hash(chunk.data() + at, pageLength));
+            fingerprint.AddPage(index, chunk.data() + at, pageLength, pageHashes.back());
+            if (patchable && (index >= last.baseHashes.size() || last.baseHashes[index] != pageHashes.back())) {
+                plan.patchPages.push_back((uint32_t)index);
+                patchSize += 4 + pageLength;
+                // Half the file changed since the base; a new base is cheaper from here on.
+                patchable = patchSize * 2 <= size;
+            }
+        }
+    }
+    const uint64_t fileHash = fileHasher.Final();
+
+    plan.manifest.pageSize = pageSize;
+    plan.manifest.fileSize = size;
+    plan.manifest.fileHash = fileHash;
+    plan.state.pageSize = pageSize;
+    plan.state.fileSize = size;
+    plan.state.fileHash = fileHash;
+    plan.manifest.fingerprint = fingerprint.Final();
+    plan.state.fingerprint = plan.manifest.fingerprint;
+
+    if (haveBase && last.fileSize == size && last.fileHash == fileHash) {
+        plan.kind = UploadPlan::Unchanged;
+        plan.patchHeader.clear();
+        plan.patchPages.clear();
+        plan.state = last;
+        plan.state.fingerprint = plan.manifest.fingerprint;
+        return true;
+    }
+
+    if (patchable) {
+        std::vector<unsigned char>& header = plan.patchHeader;
+        size_t hashPos = header.size() - 12;
+        for (int b = 0; b < 8; ++b) {
+            header[hashPos + b] = (unsigned char)(fileHash >> (8 * b));
+        }
+        for (int b = 0; b < 4; ++b) {
+            header[hashPos + 8 + b] = (unsigned char)(plan.patchPages.size() >> (8 * b));
+        }
+        plan.kind = UploadPlan::Patch;
+        plan.changedPages = plan.patchPages.size();
+        plan.patchSize = patchSize;
+        plan.manifest.baseId = last.baseId;
+        plan.manifest.hasPatch = true;
+        plan.manifest.patchCount = last.patchCount + 1;
+        plan.state.baseId = last.baseId;
+        plan.state.patchCount = last.patchCount + 1;
+        plan.state.baseHashes = last.baseHashes;
+        return true;
+    }
+
+    plan.kind = UploadPlan::Base;
+    plan.patchHeader.clear();
+    plan.patchPages = std::vector<uint32_t>();
+    plan.changedPages = pageHashes.size();
+    plan.manifest.baseId = Hex64(fileHash) + "-" + std::to_string(size);
+    plan.state.baseId = plan.manifest.baseId;
+    plan.state.baseHashes = std::move(pageHashes);
+    return true;
+}
+
+PatchSource::PatchSource(const UploadPlan& plan, SyncSource& snapshot) : m_plan(plan), m_snapshot(snapshot) {
+}
+
+unsigned long long PatchSource::Size() const {
+    return m_plan.patchSize;
+}
+
+bool PatchSource::Read(unsigned long long offset, unsigned char* buffer, size_t length) {
+    // The header, then per page its index and bytes. Every page is whole but the file's last one,
+    // which can only be the last entry, so entry k starts at header + k * (4 + page size).
+    const uint64_t headerSize = m_plan.patchHeader.size();
+    const uint64_t pageSize = m_plan.manifest.pageSize;
+    const uint64_t fileSize = m_plan.manifest.fileSize;
+    if (offset > m_plan.patchSize || length > m_plan.patchSize - offset) {
+        return false;
+    }
+    while (length > 0) {
+        size_t n;
+        if (offset < headerSize) {
+            n = (size_t)(headerSize - offset < length ? headerSize - offset : length);
+            memcpy(buffer, m_plan.patchHeader.data() + offset, n);
+        } else {
+            uint64_t entry = (offset - headerSize) / (4 + pageSize);
+            uint64_t within = (offset - headerSize) % (4 + pageSize);
+            uint32_t index = m_plan.patchPages[(size_t)entry];
+            if (within < 4) {
+                unsigned char number[4];
+                for (int b = 0; b < 4; ++b) number[b] = (unsigned char)(index >> (8 * b));
+                n = (size_t)(4 - within < length ? 4 - within : length);
+                memcpy(buffer, number + within, n);
+            } else {
+                uint64_t pageStart = (uint64_t)index * pageSize;
+                uint64_t pageLength = fileSize - pageStart < pageSize ? fileSize - pageStart : pageSize;
+                uint64_t rest = pageLength - (within - 4);
+                n = (size_t)(rest < length ? rest : length);
+                if (!m_snapshot.Read(pageStart + (within - 4), buffer, n)) {
+                    return false;
+                }
+            }
+        }
+        offset += n;
+        buffer += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool Reassemble(const Manifest& manifest,
+                const std::vector<unsigned char>& base,
+                const std::vector<unsigned char>* patch,
+                std::vector<unsigned char>& out,
+                std::string& error) {
+    out.clear();
+    if (BaseIdOf(base.data(), base.size()) != manifest.baseId) {
+        error = "Remote base does not match the manifest";
+        return false;
+    }
+
+    if (!patch) {
+        out = base;
+    } else {
+        Reader r = { patch->data(), patch->size() };
+        const unsigned char* magic;
+        uint32_t idLength = 0;
+        const unsigned char* id;
+        uint64_t fileSize = 0;
+        uint32_t pageSize = 0;
+        uint64_t fileHash = 0;
+        uint32_t count = 0;
+        if (!r.Bytes(sizeof(kPatchMagic), magic) || memcmp(magic, kPatchMagic, sizeof(kPatchMagic)) != 0 ||
+            !r.U16(idLength) || !r.Bytes(idLength, id) ||
+            !r.U64(fileSize) || !r.U32(pageSize) || !r.U64(fileHash) || !r.U32(count)) {
+            error = "Remote patch is damaged";
+            return false;
+        }
+        if (std::string((const char*)id, idLength) != manifest.baseId) {
+            error = "Remote patch belongs to another base";
+            return false;
+        }
+        if (pageSize != manifest.pageSize || fileSize != manifest.fileSize || fileHash != manifest.fileHash) {
+            error = "Remote patch does not match the manifest";
+            return false;
+        }
+        // Every page is at least its 4-byte index, and the file can only grow by the pages the
+        // patch carries, so a damaged header cannot make out huge.
+        if (pageSize == 0 || pageSize > 65536 || count > r.left / 4 ||
+            fileSize > base.size() + (uint64_t)count * pageSize) {
+            error = "Remote patch is damaged";
+            return false;
+        }
+
+        out.assign(base.begin(), base.begin() + (size_t)(base.size() < fileSize ? base.size() : fileSize));
+        out.resize((size_t)fileSize);
+        size_t pages = PageCount(fileSize, pageSize);
+        for (uint32_t n = 0; n < count; ++n) {
+            uint32_t index = 0;
+            const unsigned char* bytes;
+            if (!r.U32(index) || index >= pages ||
+                !r.Bytes(PageLength(fileSize, pageSize, index), bytes)) {
+                error = "Remote patch is damaged";
+                return false;
+            }
+            memcpy(&out[(size_t)index * pageSize], bytes, PageLength(fileSize, pageSize, index));
+        }
+    }
+
+    if (out.size() != manifest.fileSize || Hash(out.data(), out.size()) != manifest.fileHash) {
+        out.clear();
+        error = "Reassembled database does not match the manifest";
+        return false;
+    }
+    return true;
+}
+
+SyncState StateFor(const Manifest& manifest, const std::vector<unsigned char>& base) {
+    SyncState state;
+    state.baseId = manifest.baseId;
+    state.pageSize = PageSizeOf(base.data(), base.size());
+    state.patchCount = manifest.patchCount;
+    state.fileSize = manifest.fileSize;
+    state.fileHash = manifest.fileHash;
+    state.fingerprint = manifest.fingerprint;
+    state.baseHashes = HashPages(base.data(), base.size(), state.pageSize);
+    if (manifest.pageSize != state.pageSize) {
+        // The file changed page size since the base: the next upload starts a new base.
+        state.baseId.clear();
+    }
+    return state;
+}
+
+std::string FormatManifest(const Manifest& manifest) {
+    std::string text;
+    text += "format=" + std::to_string(manifest.format) + "\n";
+    text += "base=" + manifest.baseId + "\n";
+    text += std::string("patch=") + (manifest.hasPatch ? "1" : "0") + "\n";
+    text += "patches=" + std::to_string(manifest.patchCount) + "\n";
+    text += "pagesize=" + std::to_string(manifest.pageSize) + "\n";
+    text += "size=" + std::to_string(manifest.fileSize) + "\n";
+    text += "hash=" + Hex64(manifest.fileHash) + "\n";
+    if (manifest.fingerprint != 0) {
+        text += "fingerprint=" + Hex64(manifest.fingerprint) + "\n";
+    }
+    return text;
+}
+
+bool ParseManifest(const std::string& text, Manifest& out) {
+    out = Manifest();
+    out.format = 0;   // Required
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string line = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string key = line.substr(0, eq);
+        std::string value = line.substr(eq + 1);
+        if (key == "format") out.format = (uint32_t)std::strtoul(value.c_str(), nullptr, 10);
+        else if (key == "base") out.baseId = value;
+        else if (key == "patch") out.hasPatch = (value == "1");
+        else if (key == "patches") out.patchCount = (uint32_t)std::strtoul(value.c_str(), nullptr, 10);
+        else if (key == "pagesize") out.pageSize = (uint32_t)std::strtoul(value.c_str(), nullptr, 10);
+        else if (key == "size") out.fileSize = std::strtoull(value.c_str(), nullptr, 10);
+        else if (key == "hash") out.fileHash = std::strtoull(value.c_str(), nullptr, 16);
+        else if (key == "fingerprint") out.fingerprint = std::strtoull(value.c_str(), nullptr, 16);
+    }
+    return out.format >= 1 && out.format <= 3 && !out.baseId.empty() && out.pageSize != 0;
+}
+
+void SerializeState(const SyncState& state, std::vector<unsigned char>& out) {
+    out.clear();
+    out.reserve(56 + state.baseId.size() + state.baseHashes.size() * 8);
+    out.insert(out.end(), kStateMagic, kStateMagic + sizeof(kStateMagic));
+    PutU16(out, (uint32_t)state.baseId.size());
+    out.insert(out.end(), state.baseId.begin(), state.baseId.end());
+    PutU32(out, state.pageSize);
+    PutU32(out, state.patchCount);
+    PutU64(out, state.fileSize);
+    PutU64(out, state.fileHash);
+    PutU64(out, state.fingerprint);
+    PutU32(out, (uint32_t)state.baseHashes.size());
+    for (uint64_t h : state.baseHashes) {
+        PutU64(out, h);
+    }
+}
+
+bool ParseState(const std::vector<unsigned char>& bytes, SyncState& out) {
+    out = SyncState();
+    Reader r = { bytes.data(), bytes.size() };
+    const unsigned char* magic;
+    uint32_t idLength = 0;
+    const unsigned char* id;
+    uint32_t count = 0;
+    // Version 1 states predate the fingerprint and leave it 0.
+    bool v1 = false;
+    if (!r.Bytes(sizeof(kStateMagic), magic) ||
+        (memcmp(magic, kStateMagic, sizeof(kStateMagic)) != 0 &&
+         !(v1 = memcmp(magic, kStateMagicV1, sizeof(kStateMagicV1)) == 0)) ||
+        !r.U16(idLength) || !r.Bytes(idLength, id) ||
+        !r.U32(out.pageSize) || !r.U32(out.patchCount) || !r.U64(out.fileSize) || !r.U64(out.fileHash) ||
+        (!v1 && !r.U64(out.fingerprint)) ||
+        !r.U32(count) || r.left != (size_t)count * 8) {
+        out = SyncState();
+        return false;
+    }
+    out.baseId.assign((const char*)id, idLength);
+    out.baseHashes.resize(count);
+    for (uint64_t& h : out.baseHashes) {
+        r.U64(h);
+    }
+    return true;
+}
+
+std::string ManifestName(const std::string& fileName) {
+    return fileName + ".manifest";
+}
+
+std::string BaseName(const std::string& fileName, const Manifest& manifest) {
+    return manifest.format < 3 ? fileName : fileName + "." + manifest.baseId;
+}
+
+std::string PatchName(const std::string& fileName, const Manifest& manifest) {
+    if (manifest.format < 3) {
+        return fileName + ".patch";
+    }
+    return BaseName(fileName, manifest) + "." + std::to_string(manifest.patchCount) + "-" + Hex64(manifest.fileHash);
+}
+
+SyncStatus Push(SyncBackend& backend,
+                const std::string& fileName,
+                SyncSource& snapshot,
+                SyncState& ioState,
+                PushResult& outResult,
+                const SyncProgress& progress,
+                std::string& outError) {
+    outResult = PushResult();
+
+    // A patch only applies to the base it was made against. If another machine uploaded a new base
+    // since, start over with a base of our own; if it only patched ours, upload even when unchanged.
+    // Bases named by an older version are replaced by one under the current names.
+    std::vector<unsigned char> manifestBytes;
+    SyncObjectInfo remoteInfo;
+    SyncStatus status = backend.Get(ManifestName(fileName), manifestBytes, &remoteInfo, outError);
+    if (status == SyncStatus::Failed) {
+        return status;
+    }
+    std::string ifVersion = kSyncCreateOnly;
+    Manifest remote;
+    if (status == SyncStatus::NotFound ||
+        !ParseManifest(std::string(manifestBytes.begin(), manifestBytes.end()), remote) ||
+        remote.format < 3 || remote.baseId != ioState.baseId) {
+        ioState = SyncState();
+    } else if (remote.fileHash != ioState.fileHash) {
+        ioState.fileHash = 0;
+        ioState.patchCount = remote.patchCount;
+    }
+    if (status == SyncStatus::Ok) {
+        ifVersion = remoteInfo.version;
+    }
+
+    UploadPlan plan;
+    if (!PlanUpload(ioState, snapshot, plan)) {
+        outError = "Failed to read the database snapshot";
+        return SyncStatus::Failed;
+    }
+    outResult.kind = plan.kind;
+    outResult.changedPages = plan.changedPages;
+    if (plan.kind == UploadPlan::Unchanged) {
+        ioState.fingerprint = plan.state.fingerprint;
+        outResult.manifest = remoteInfo;
+        return SyncStatus::Ok;
+    }
+
+    // Named after their content, so they overwrite nothing the remote manifest refers to: until
+    // the manifest below is written they are invisible to a restore.
+    PatchSource patch(plan, snapshot);
+    SyncSource& payload = (plan.kind == UploadPlan::Base) ? snapshot : static_cast<SyncSource&>(patch);
+    SyncCodec::CompressedSource packed(payload);
+    if (!packed.Prepare()) {
+        outError = "Failed to read the database snapshot";
+        return SyncStatus::Failed;
+    }
+    const std::string baseName = BaseName(fileName, plan.manifest);
+    const std::string patchName = PatchName(fileName, plan.manifest);
+    status = backend.PutStream(plan.kind == UploadPlan::Base ? baseName : patchName, packed,
+        std::string(), nullptr, progress, outError);
+    outResult.bytesPlanned = payload.Size();
+    outResult.bytesSent += packed.Size();
+    if (status != SyncStatus::Ok) {
+        return SyncStatus::Failed;
+    }
+
+    // Publishes the upload, only if the manifest is still the one read at the start.
+    std::string manifestText = FormatManifest(plan.manifest);
+    status = backend.Put(ManifestName(fileName), std::vector<unsigned char>(manifestText.begin(), manifestText.end()),
+        ifVersion, &outResult.manifest, outError);
+    outResult.bytesSent += manifestText.size();
+    if (status == SyncStatus::Conflict) {
+        // What we uploaded is left for the next push to clear away; the other machine's base may
+        // have the same name.
+        ioState = SyncState();
+        outError = "Another machine uploaded at the same time";
+        return status;
+    }
+    if (status != SyncStatus::Ok) {
+        return SyncStatus::Failed;
+    }
+    ioState = std::move(plan.state);
+
+    // Clear away bases and patches the manifest no longer refers to. Ones written after it may
+    // belong to a push that read it and has yet to publish; they are left to a later push.
+    std::vector<SyncObjectInfo> objects;
+    std::string ignored;
+    if (backend.List(fileName + ".", objects, ignored) == SyncStatus::Ok) {
+        for (const SyncObjectInfo& object : objects) {
+            if (IsDeltaObject(fileName, object.name) && object.name != baseName &&
+                !(plan.manifest.hasPatch && object.name == patchName) &&
+                object.modifiedTime != 0 && object.modifiedTime < outResult.manifest.modifiedTime) {
+                backend.Delete(object.name, ignored);
+            }
+        }
+    }
+    return SyncStatus::Ok;
+}
+
+SyncStatus Pull(SyncBackend& backend,
+                const std::string& fileName,
+                std::vector<unsigned char>& outContent,
+                SyncState& outState,
+                SyncObjectInfo& outManifest,
+                std::string& outError) {
+    outContent.clear();
+    outState = SyncState();
+
+    // A push that lands meanwhile may clear away the objects of the manifest read here; the
+    // manifest is then read again, once.
+    Manifest manifest;
+    std::vector<unsigned char> base;
+    std::vector<unsigned char> patch;
+    SyncObjectInfo baseInfo;
+    for (int attempt = 0;; ++attempt) {
+        std::vector<unsigned char> manifestBytes;
+        std::string previousVersion = outManifest.version;
+        SyncStatus status = backend.Get(ManifestName(fileName), manifestBytes, &outManifest, outError);
+        if (status != SyncStatus::Ok) {
+            return status;
+        }
+        if (!ParseManifest(std::string(manifestBytes.begin(), manifestBytes.end()), manifest)) {
+            outError = "Failed to read the remote sync manifest";
+            return SyncStatus::Failed;
+        }
+
+        if (manifest.format >= 3) {
+            // A version without delta sync uploads the whole file under fileName itself.
+            SyncObjectInfo wholeInfo;
+            status = backend.Stat(fileName, wholeInfo, outError);
+            if (status == SyncStatus::Failed) {
+                return status;
+            }
+            if (status == SyncStatus::Ok && wholeInfo.modifiedTime != 0 &&
+                wholeInfo.modifiedTime > outManifest.modifiedTime) {
+                status = backend.Get(fileName, outContent, nullptr, outError);
+                if (status != SyncStatus::Ok || !Unpack(outContent, outError)) {
+                    outContent.clear();
+                    return SyncStatus::Failed;
+                }
+                return SyncStatus::Ok;
+            }
+        }
+
+        status = backend.Get(BaseName(fileName, manifest), base, &baseInfo, outError);
+        if (status == SyncStatus::Ok && manifest.hasPatch) {
+            status = backend.Get(PatchName(fileName, manifest), patch, nullptr, outError);
+        }
+        if (status == SyncStatus::NotFound && attempt == 0) {
+            continue;
+        }
+        if (status != SyncStatus::Ok) {
+            if (status == SyncStatus::NotFound) {
+                outError = attempt > 0 && outManifest.version == previousVersion ?
+                    "Remote database is missing" : "Remote database changed while downloading";
+            }
+            return SyncStatus::Failed;
+        }
+        break;
+    }
+    if (!Unpack(base, outError) || (manifest.hasPatch && !Unpack(patch, outError))) {
+        return SyncStatus::Failed;
+    }
+
+    if (Reassemble(manifest, base, manifest.hasPatch ? &patch : nullptr, outContent, outError)) {
+        outState = StateFor(manifest, base);
+    } else if (manifest.format < 3 && baseInfo.modifiedTime != 0 && baseInfo.modifiedTime > outManifest.modifiedTime) {
+        // A version without delta sync replaced the whole file, which was the base, after the last
+        // delta upload.
+        outContent = std::move(base);
+    } else {
+        return SyncStatus::Failed;
+    }
+    return SyncStatus::Ok;
+}
+
+} // namespace PageDelta
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "sync_backend.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Page-level delta sync of database snapshots. Remotely there is a base (a full snapshot), at most
+// one patch (every page that differs from the base, so restoring is base + one patch) and a small
+// text manifest naming both. Bases and patches are named after their content and never
+// overwritten in use, so an upload is published only by the conditional write of the manifest;
+// the ones it no longer names are deleted after it. Locally a sync state keeps the per-page
+// hashes of the base, so an upload only hashes the new snapshot and sends the pages that differ.
+// A new base is uploaded when the patch grows past half the file or after kMaxPatchesPerBase
+// uploads. Uploads read the snapshot through a SyncSource a chunk at a time, and the patch is cut
+// from it as it is sent, so pushing holds kSyncChunkSize and 12 bytes per page, not the file.
+// The base and patch travel compressed (sync_codec.h). The manifest's format keeps versions that
+// cannot read them from trying: 2 added compression, 3 the content names. Pull still reads 1 and 2.
+// Portable: no Win32; Push and Pull move the bytes through a SyncBackend.
+//
+// Patch layout (little-endian): "NSFPTCH1", base id length (u16) and bytes, file size (u64), page
+// size (u32), file hash (u64), page count (u32), then per page its index (u32) and its bytes (a
+// full page, or the rest of the file for the last one).
+namespace PageDelta {
+
+const uint32_t kMaxPatchesPerBase = 64;
+
+// What the remote manifest says about the remote copy.
+struct Manifest {
+    uint32_t format = 3;
+    std::string baseId;
+    bool hasPatch = false;
+    uint32_t patchCount = 0;   // Patches uploaded since the base
+    uint32_t pageSize = 0;
+    uint64_t fileSize = 0;     // Of the reassembled file
+    uint64_t fileHash = 0;
+    uint64_t fingerprint = 0;  // Fingerprint of the reassembled file; 0 from older versions
+};
+
+// What this machine last uploaded.
+struct SyncState {
+    std::string baseId;
+    uint32_t pageSize = 0;
+    uint32_t patchCount = 0;
+    uint64_t fileSize = 0;
+    uint64_t fileHash = 0;
+    uint64_t fingerprint = 0;   // Of the file as last uploaded or restored; 0 when unknown
+    std::vector<uint64_t> baseHashes;
+};
+
+struct UploadPlan {
+    enum Kind { Unchanged, Patch, Base };
+    Kind kind = Base;
+    size_t changedPages = 0;
+    std::vector<unsigned char> patchHeader;   // Kind Patch: everything before the first page
+    std::vector<uint32_t> patchPages;         // Kind Patch: the pages it carries, ascending
+    uint64_t patchSize = 0;                   // Kind Patch: header and pages
+    Manifest manifest;                        // Upload after the base or patch
+    SyncState state;                          // Keep once everything is uploaded
+};
+
+uint64_t Hash(const unsigned char* data, size_t size);
+
+// Hash of data that arrives in pieces: the same value as Hash over all of them. Every piece but
+// the last must be a multiple of 8 bytes.
+class Hasher {
+public:
+    explicit Hasher(uint64_t totalSize);
+    void Update(const unsigned char* data, size_t size);
+    uint64_t Final() const;
+
+private:
+    uint64_t m_h;
+    uint64_t m_tail = 0;
+};
+
+// Page size from the SQLite header, or 4096 when data is not a database.
+uint32_t PageSizeOf(const unsigned char* data, size_t size);
+
+std::vector<uint64_t> HashPages(const unsigned char* data, size_t size, uint32_t pageSize);
+
+// Fingerprint of a database's content, folded from its page hashes with the header fields SQLite
+// rewrites by itself left out. A snapshot, the file it was taken from and a copy restored from it
+// all have the same one, where their file hashes differ. The second form reads source in chunks.
+uint64_t Fingerprint(const unsigned char* data, size_t size);
+bool Fingerprint(SyncSource& source, uint64_t& out);
+
+// Content-derived, so a base can be checked against the id a patch or manifest refers to.
+std::string BaseIdOf(const unsigned char* data, size_t size);
+
+// Decides what to upload for a snapshot given the last sync state (empty on the first upload),
+// reading it once. False when the snapshot cannot be read.
+bool PlanUpload(const SyncState& last, SyncSource& snapshot, UploadPlan& outPlan);
+
+// The patch of a Patch plan, read from the snapshot it was planned from as it is uploaded.
+class PatchSource : public SyncSource {
+public:
+    PatchSource(const UploadPlan& plan, SyncSource& snapshot);
+
+    unsigned long long Size() const override;
+    bool Read(unsigned long long offset, unsigned char* buffer, size_t length) override;
+
+private:
+    const UploadPlan& m_plan;
+    SyncSource& m_snapshot;
+};
+
+// Rebuilds the file from the base and a patch (null patch = the base itself) and verifies the
+// result against the manifest.
+bool Reassemble(const Manifest& manifest,
+                const std::vector<unsigned char>& base,
+                const std::vector<unsigned char>* patch,
+                std::vector<unsigned char>& out,
+                std::string& error);
+
+// Sync state matching a reassembled (or freshly downloaded) file, so the next upload diffs
+// against the remote base.
+SyncState StateFor(const Manifest& manifest, const std::vector<unsigned char>& base);
+
+std::string FormatManifest(const Manifest& manifest);
+bool ParseManifest(const std::string& text, Manifest& out);
+
+void SerializeState(const SyncState& state, std::vector<unsigned char>& out);
+bool ParseState(const std::vector<unsigned char>& bytes, SyncState& out);
+
+// Remote names of a database uploaded as fileName. From format 3 the base is
+// "<fileName>.<baseId>" and the patch "<base name>.<patchCount>-<file hash>"; before, they were
+// fileName itself and "<fileName>.patch".
+std::string ManifestName(const std::string& fileName);
+std::string BaseName(const std::string& fileName, const Manifest& manifest);
+std::string PatchName(const std::string& fileName, const Manifest& manifest);
+
+struct PushResult {
+    UploadPlan::Kind kind = UploadPlan::Unchanged;
+    size_t changedPages = 0;
+    uint64_t bytesPlanned = 0;   // Base or patch before compression
+    uint64_t bytesSent = 0;
+    SyncObjectInfo manifest;   // As it stands remotely after the push
+};
+
+// Uploads a snapshot: the base or the patch, then the manifest, written only if it is still the
+// one read at the start, then deletes the bases and patches it replaced. ioState is the last sync
+// state and becomes the new one. Conflict means another machine pushed meanwhile and the remote
+// copy is theirs; ioState is reset, so the next push is a base of its own. progress follows the
+// base or patch upload and may be empty.
+SyncStatus Push(SyncBackend& backend,
+                const std::string& fileName,
+                SyncSource& snapshot,
+                SyncState& ioState,
+                PushResult& outResult,
+                const SyncProgress& progress,
+                std::string& outError);
+
+// Downloads and reassembles the remote copy. NotFound when there is no manifest (nothing was
+// pushed, or only by a version without delta sync). outState matches the result, or is empty
+// when an older version replaced the base after the last push and the base was taken whole.
+SyncStatus Pull(SyncBackend& backend,
+                const std::string& fileName,
+                std::vector<unsigned char>& outContent,
+                SyncState& outState,
+                SyncObjectInfo& outManifest,
+                std::string& outError);
+
+} // namespace PageDelta
@@ -110,9 +110,15 @@
 #define IDM_MARKDOWN_SUBSCRIPT 5022
 #define IDM_MARKDOWN_SUPERSCRIPT 5023
 #define IDM_MARKDOWN_TABLE 5024
+#define IDM_MARKDOWN_OUTLINE 5025
 
 // Markdown Table Dimension Picker (5x5)
 #define IDM_MARKDOWN_TABLE_DIM_BASE 5200
+
+// Spelling Context Menu
+#define IDM_SPELL_ADD_WORD 5300
+#define IDM_SPELL_IGNORE_WORD 5301
+#define IDM_SPELL_SUGGESTION_BASE 5310
 #define IDM_TAG_CHANGE_BASE 6100
 
 // Tag Menu
@@ -0,0 +1,104 @@
+#define NOMINMAX
+#include "resumable_upload.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Failures in a row without progress before giving up; the waits double from kRetryDelayMs.
+const int kMaxRetries = 5;
+const int kRetryDelayMs = 500;
+
+std::string Header(const HttpResult& resp, const char* name) {
+    auto it = resp.headers.find(name);
+    return it == resp.headers.end() ? std::string() : it->second;
+}
+
+// Bytes the server holds, from the Range header of a 308 ("bytes=0-1048575").
+unsigned long long Committed(const HttpResult& resp) {
+    std::string range = Header(resp, "range");
+    size_t dash = range.find('-');
+    if (dash == std::string::npos) {
+        return 0;
+    }
+    return std::strtoull(range.c_str() + dash + 1, nullptr, 10) + 1;
+}
+
+bool Retryable(unsigned long status) {
+    return status == 0 || status == 408 || status == 429 || status >= 500;
+}
+
+} // namespace
+
+namespace ResumableUpload {
+
+std::string SessionPath(const std::string& location) {
+    size_t scheme = location.find("://");
+    if (scheme == std::string::npos) {
+        return location;
+    }
+    size_t slash = location.find('/', scheme + 3);
+    return slash == std::string::npos ? std::string("/") : location.substr(slash);
+}
+
+HttpResult Send(HttpTransport& transport,
+                const std::string& sessionPath,
+                const std::string& headers,
+                SyncSource& content,
+                const SyncProgress& progress) {
+    const unsigned long long total = content.Size();
+    const std::string totalText = std::to_string(total);
+    std::vector<unsigned char> chunk((size_t)std::min<unsigned long long>(total, kSyncChunkSize));
+
+    unsigned long long offset = 0;
+    int failures = 0;
+    bool ask = false;   // The last request failed: find out what the server has before sending more
+    for (;;) {
+        HttpResult resp;
+        if (ask || total == 0) {
+            resp = transport.Send("PUT", sessionPath, headers + "Content-Range: bytes */" + totalText + "\r\n", nullptr, 0);
+        } else {
+            size_t length = (size_t)std::min<unsigned long long>(total - offset, chunk.size());
+            if (!content.Read(offset, chunk.data(), length)) {
+                resp.error = "Failed to read the content being uploaded";
+                return resp;
+            }
+            std::string range = "Content-Range: bytes " + std::to_string(offset) + "-" +
+                std::to_string(offset + length - 1) + "/" + totalText + "\r\n";
+            resp = transport.Send("PUT", sessionPath, headers + range, chunk.data(), length);
+        }
+
+        if (resp.status == 200 || resp.status == 201) {
+            if (progress) progress(total, total);
+            return resp;
+        }
+        if (resp.status == 308) {
+            unsigned long long committed = Committed(resp);
+            if (committed > total) {
+                resp.error = "Upload session reports more data than was sent";
+                return resp;
+            }
+            if (committed > offset) {
+                failures = 0;
+            } else if (!ask && ++failures > kMaxRetries) {
+                resp.error = "Upload session is not accepting data";
+                return resp;
+            }
+            offset = committed;
+            ask = false;
+            if (progress) progress(offset, total);
+            continue;
+        }
+        if (!Retryable(resp.status) || ++failures > kMaxRetries) {
+            return resp;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(kRetryDelayMs << std::min(failures - 1, 3)));
+        ask = true;
+    }
+}
+
+} // namespace ResumableUpload
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "http_transport.h"
+#include "sync_backend.h"
+
+#include <string>
+
+// The sending half of a resumable upload, as Google Drive defines it (tools/sync_server speaks
+// the same): once a session is started, the content goes to the session in PUT requests of
+// kSyncChunkSize with "Content-Range: bytes first-last/total". The server answers 308 with
+// "Range: bytes=0-last" while it wants more and 200 or 201 once it has everything. After a lost
+// connection or a 5xx, "Content-Range: bytes */total" with no body asks how much arrived, and the
+// upload carries on from there.
+namespace ResumableUpload {
+
+// Where the session lives, from its Location header: the path on the transport's host.
+std::string SessionPath(const std::string& location);
+
+// Sends content to the session at sessionPath, retrying with backoff. headers are added to every
+// request. Returns the last response: the final 200 or 201, or whatever made the upload give up.
+// Status 0 (the server stopped answering, or content could not be read) and 308 (the server
+// stopped taking data) come with an error saying why.
+HttpResult Send(HttpTransport& transport,
+                const std::string& sessionPath,
+                const std::string& headers,
+                SyncSource& content,
+                const SyncProgress& progress);
+
+} // namespace ResumableUpload
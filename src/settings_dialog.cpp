@@ -21,7 +21,6 @@ INT_PTR CALLBACK SnippetsTabProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM
 INT_PTR CALLBACK CloudSyncTabProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
 
 static const UINT WM_APP_CLOUD_CONNECT_DONE = WM_APP + 120;
-static const UINT WM_APP_CLOUD_SYNC_DONE = WM_APP + 121;
 
 struct CloudConnectResult {
     bool success = false;
@@ -60,6 +59,7 @@ static unsigned __stdcall CloudConnectThread(void* p) {
 }
 
 struct SettingsData {
+    HWND hOwner;   // The main window; runs Sync Now
     HWND hTab;
     HWND hPages[5];
     int currentPage;
@@ -68,58 +68,14 @@ struct SettingsData {
 };
 
 struct SettingsInitParams {
+    HWND hOwner;
     Database* db;
     std::wstring dbPath;
 };
 
-struct CloudSyncThreadParams {
-    HWND hDlg;
-    Database* db;
-    std::wstring dbPath;
-    std::string clientId;
-};
-
-struct CloudSyncResultMsg {
-    bool success = false;
-    std::string error;
-    std::string remoteModifiedTime;
-    std::string localTime;
-};
-
-static std::string NowLocalTimeString() {
-    SYSTEMTIME st;
-    GetLocalTime(&st);
-    char buf[64];
-    std::snprintf(buf, sizeof(buf), "%04u-%02u-%02u %02u:%02u:%02u",
-        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
-    return std::string(buf);
-}
-
-static unsigned __stdcall CloudSyncNowThread(void* p) {
-    std::unique_ptr<CloudSyncThreadParams> params((CloudSyncThreadParams*)p);
-    std::unique_ptr<CloudSyncResultMsg> res(new CloudSyncResultMsg());
-
-    if (!params->db) {
-        res->error = "Missing database";
-        if (IsWindow(params->hDlg)) PostMessage(params->hDlg, WM_APP_CLOUD_SYNC_DONE, 0, (LPARAM)res.release());
-        return 0;
-    }
-
-    CloudSyncResult upload = CloudSync::UploadDatabaseSnapshot(params->db, params->dbPath, params->clientId);
-
-    res->success = upload.success;
-    res->error = upload.error;
-    res->remoteModifiedTime = upload.remoteModifiedTime;
-    res->localTime = NowLocalTimeString();
-
-    if (IsWindow(params->hDlg)) {
-        PostMessage(params->hDlg, WM_APP_CLOUD_SYNC_DONE, 0, (LPARAM)res.release());
-    }
-    return 0;
-}
-
 void CreateSettingsDialog(HWND hWndParent, Database* db, const std::wstring& dbPath) {
     auto* init = new SettingsInitParams();
+    init->hOwner = hWndParent;
     init->db = db;
     init->dbPath = dbPath;
     DialogBoxParam(GetModuleHandle(NULL), MAKEINTRESOURCE(IDD_SETTINGS), hWndParent, SettingsDialogProc, (LPARAM)init);
@@ -146,6 +102,7 @@ INT_PTR CALLBACK SettingsDialogProc(HWND hDlg, UINT message, WPARAM wParam, LPAR
         {
             pData = new SettingsData();
             std::unique_ptr<SettingsInitParams> init((SettingsInitParams*)lParam);
+            pData->hOwner = init ? init->hOwner : NULL;
             pData->db = init ? init->db : nullptr;
             pData->dbPath = init ? init->dbPath : L"";
             SetWindowLongPtr(hDlg, GWLP_USERDATA, (LONG_PTR)pData);
@@ -319,6 +276,13 @@ INT_PTR CALLBACK CloudSyncTabProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM
         }
         return (INT_PTR)TRUE;
 
+    case WM_APP_CLOUD_SYNC_PROGRESS:
+        {
+            std::wstring text = (lParam ? L"Preparing snapshot... " : L"Uploading... ") + std::to_wstring((int)wParam) + L"%";
+            SetDlgItemText(hDlg, IDC_STATIC_CLOUD_LAST_ERROR, text.c_str());
+        }
+        return (INT_PTR)TRUE;
+
     case WM_APP_CLOUD_SYNC_DONE:
         {
             std::unique_ptr<CloudSyncResultMsg> res((CloudSyncResultMsg*)lParam);
@@ -329,15 +293,13 @@ INT_PTR CALLBACK CloudSyncTabProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM
 
             EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_CLOUD_SYNC_NOW), TRUE);
 
+            // The window has recorded the outcome in the settings already.
             if (res && res->success) {
-                pData->db->SetSetting("cloud_last_sync_time", res->localTime);
-                pData->db->SetSetting("cloud_sync_last_error", "");
                 SetDlgItemText(hDlg, IDC_STATIC_CLOUD_LAST_SYNC, Utils::Utf8ToWide(res->localTime).c_str());
                 SetDlgItemText(hDlg, IDC_STATIC_CLOUD_LAST_ERROR, L"");
             } else {
                 std::string err = res ? res->error : "Sync failed";
                 if (err.empty()) err = "Sync failed";
-                pData->db->SetSetting("cloud_sync_last_error", err);
                 SetDlgItemText(hDlg, IDC_STATIC_CLOUD_LAST_ERROR, Utils::Utf8ToWide(err).c_str());
             }
         }
@@ -403,30 +365,19 @@ INT_PTR CALLBACK CloudSyncTabProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM
                     EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_CLOUD_CONNECT), TRUE);
                     EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_CLOUD_DISCONNECT), FALSE);
                 } else if (wmId == IDC_BUTTON_CLOUD_SYNC_NOW) {
-                    // Manual sync uploads a consistent DB snapshot.
+                    // The window runs it like its own syncs: changes exchanged, then a snapshot uploaded.
                     std::string clientId = pData->db->GetSetting("cloud_oauth_client_id", "");
-                    if (clientId.empty()) {
+                    if (clientId.empty() && CloudSync::UsesGoogleAccount(pData->db->GetSetting(CloudSync::kCloudBackendSetting, ""))) {
                         MessageBox(hDlg, L"Enter your Google OAuth Client ID first.", L"Cloud Sync", MB_OK | MB_ICONWARNING);
                         break;
                     }
 
+                    if (!pData->hOwner || !SendMessage(pData->hOwner, WM_APP_CLOUD_SYNC_NOW, (WPARAM)hDlg, 0)) {
+                        SetDlgItemText(hDlg, IDC_STATIC_CLOUD_LAST_ERROR, L"A sync is already running; try again once it finishes.");
+                        break;
+                    }
                     EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_CLOUD_SYNC_NOW), FALSE);
                     SetDlgItemText(hDlg, IDC_STATIC_CLOUD_LAST_ERROR, L"");
-
-                    auto* params = new CloudSyncThreadParams();
-                    params->hDlg = hDlg;
-                    params->db = pData->db;
-                    params->dbPath = pData->dbPath;
-                    params->clientId = clientId;
-
-                    uintptr_t th = _beginthreadex(nullptr, 0, CloudSyncNowThread, params, 0, nullptr);
-                    if (th == 0) {
-                        delete params;
-                        EnableWindow(GetDlgItem(hDlg, IDC_BUTTON_CLOUD_SYNC_NOW), TRUE);
-                        MessageBox(hDlg, L"Failed to start sync thread.", L"Cloud Sync", MB_OK | MB_ICONERROR);
-                    } else {
-                        CloseHandle((HANDLE)th);
-                    }
                 }
             } else if (wmEvent == CBN_SELCHANGE) {
                 if (wmId == IDC_COMBO_CLOUD_SYNC_INTERVAL) {
@@ -4,3 +4,16 @@
 #include "database.h"
 
 void CreateSettingsDialog(HWND hWndParent, Database* db, const std::wstring& dbPath);
+
+// Sync Now asks the window that opened the dialog to sync, so it goes through the same guard as
+// the window's own syncs: SendMessage(owner, WM_APP_CLOUD_SYNC_NOW, (WPARAM)hPage, 0) returns
+// nonzero when a sync started. The window then reports to hPage with the two messages below.
+static const UINT WM_APP_CLOUD_SYNC_NOW = WM_APP + 123;
+static const UINT WM_APP_CLOUD_SYNC_DONE = WM_APP + 121;       // lParam: CloudSyncResultMsg*, the receiver's
+static const UINT WM_APP_CLOUD_SYNC_PROGRESS = WM_APP + 122;   // wParam: percent; lParam: 1 while snapshotting
+
+struct CloudSyncResultMsg {
+    bool success = false;
+    std::string error;
+    std::string localTime;
+};
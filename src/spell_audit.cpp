@@ -0,0 +1,180 @@
+#define NOMINMAX
+#include "spell_audit.h"
+#include "utils.h"
+#include <windows.h>
+#include <process.h>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+namespace {
+
+const int kMaxAuditThreads = 16;
+const size_t kNotesPerClaim = 32;     // Notes a worker takes at once; its tallies are merged after each batch
+const DWORD kProgressIntervalMs = 250;
+
+struct WordTally {
+    int count = 0;
+    std::vector<int> noteIds;
+};
+
+typedef std::unordered_map<std::wstring, WordTally> TallyMap;
+
+struct AuditJob {
+    const std::vector<Note>* notes = nullptr;
+    const SpellAudit::CheckerFactory* makeChecker = nullptr;
+    const std::atomic<bool>* cancel = nullptr;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> checked{0};
+    CRITICAL_SECTION lock;   // Guards tallies
+    TallyMap tallies;
+};
+
+bool Cancelled(const AuditJob* job) {
+    return job->cancel && job->cancel->load(std::memory_order_relaxed);
+}
+
+std::wstring NoteText(const Note& note) {
+    std::wstring text = Utils::Utf8ToWide(note.content);
+    for (const auto& item : note.checklist_items) {
+        text += L'\n';
+        text += Utils::Utf8ToWide(item.item_text);
+    }
+    return text;
+}
+
+void MergeTallies(AuditJob* job, TallyMap& local) {
+    EnterCriticalSection(&job->lock);
+    for (auto& entry : local) {
+        WordTally& total = job->tallies[entry.first];
+        total.count += entry.second.count;
+        total.noteIds.insert(total.noteIds.end(), entry.second.noteIds.begin(), entry.second.noteIds.end());
+    }
+    LeaveCriticalSection(&job->lock);
+    local.clear();
+}
+
+// Checks batches of notes until none are left. Returns true when it stopped after a batch so the
+// caller can report progress, false once all work is claimed.
+bool AuditBatch(AuditJob* job, std::map<std::string, std::shared_ptr<SpellChecker>>& checkers, TallyMap& local) {
+    size_t first = job->next.fetch_add(kNotesPerClaim);
+    const std::vector<Note>& notes = *job->notes;
+    if (first >= notes.size() || Cancelled(job)) {
+        return false;
+    }
+    size_t last = std::min(first + kNotesPerClaim, notes.size());
+    for (size_t i = first; i < last && !Cancelled(job); ++i) {
+        const Note& note = notes[i];
+        std::shared_ptr<SpellChecker>& checker = checkers[note.spell_language];
+        if (!checker) {
+            checker = (*job->makeChecker)(note.spell_language);
+        }
+        if (checker && checker->IsReady()) {
+            std::wstring text = NoteText(note);
+            for (const auto& miss : checker->FindMisspellings(text, 0, text.size(), job->cancel)) {
+                WordTally& tally = local[text.substr(miss.start, miss.length)];
+                ++tally.count;
+                if (tally.noteIds.empty() || tally.noteIds.back() != note.id) {
+                    tally.noteIds.push_back(note.id);
+                }
+            }
+        }
+        job->checked++;
+    }
+    MergeTallies(job, local);
+    return true;
+}
+
+unsigned __stdcall AuditWorker(void* p) {
+    AuditJob* job = (AuditJob*)p;
+    std::map<std::string, std::shared_ptr<SpellChecker>> checkers;
+    TallyMap local;
+    while (AuditBatch(job, checkers, local)) {
+    }
+    return 0;
+}
+
+SpellAuditReport BuildReport(AuditJob* job, size_t maxWords) {
+    SpellAuditReport report;
+    report.notesTotal = job->notes->size();
+    report.notesChecked = job->checked.load();
+
+    EnterCriticalSection(&job->lock);
+    std::vector<const TallyMap::value_type*> ranked;
+    ranked.reserve(job->tallies.size());
+    for (const auto& entry : job->tallies) {
+        ranked.push_back(&entry);
+    }
+    size_t count = std::min(maxWords, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(),
+        [](const TallyMap::value_type* a, const TallyMap::value_type* b) {
+            if (a->second.count != b->second.count) return a->second.count > b->second.count;
+            return a->first < b->first;
+        });
+    report.distinctWords = ranked.size();
+    report.words.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        report.words[i].word = ranked[i]->first;
+        report.words[i].count = ranked[i]->second.count;
+        report.words[i].noteIds = ranked[i]->second.noteIds;
+    }
+    LeaveCriticalSection(&job->lock);
+
+    // Batches finish in any order, so ids arrive unsorted.
+    for (auto& word : report.words) {
+        std::sort(word.noteIds.begin(), word.noteIds.end());
+    }
+    return report;
+}
+
+} // namespace
+
+namespace SpellAudit {
+
+SpellAuditReport Run(const std::vector<Note>& notes, const CheckerFactory& makeChecker, size_t maxWords,
+                     const std::atomic<bool>* cancel, const ProgressCallback& onProgress) {
+    AuditJob job;
+    job.notes = &notes;
+    job.makeChecker = &makeChecker;
+    job.cancel = cancel;
+    InitializeCriticalSection(&job.lock);
+
+    SYSTEM_INFO si = {};
+    GetSystemInfo(&si);
+    int workerCount = (int)si.dwNumberOfProcessors;
+    if (workerCount < 1) workerCount = 1;
+    if (workerCount > kMaxAuditThreads) workerCount = kMaxAuditThreads;
+    size_t batches = (notes.size() + kNotesPerClaim - 1) / kNotesPerClaim;
+    if ((size_t)workerCount > batches) workerCount = (int)std::max<size_t>(batches, 1);
+
+    // The calling thread is one of the workers and reports progress between its batches.
+    std::vector<HANDLE> threads;
+    for (int t = 1; t < workerCount; ++t) {
+        uintptr_t th = _beginthreadex(nullptr, 0, AuditWorker, &job, 0, nullptr);
+        if (th) {
+            threads.push_back((HANDLE)th);
+        }
+    }
+    {
+        std::map<std::string, std::shared_ptr<SpellChecker>> checkers;
+        TallyMap local;
+        DWORD lastReport = GetTickCount();
+        while (AuditBatch(&job, checkers, local)) {
+            if (onProgress && GetTickCount() - lastReport >= kProgressIntervalMs) {
+                onProgress(BuildReport(&job, maxWords));
+                lastReport = GetTickCount();
+            }
+        }
+    }
+    for (HANDLE th : threads) {
+        WaitForSingleObject(th, INFINITE);
+        CloseHandle(th);
+    }
+
+    SpellAuditReport report = BuildReport(&job, maxWords);
+    report.cancelled = Cancelled(&job);
+    DeleteCriticalSection(&job.lock);
+    return report;
+}
+
+} // namespace SpellAudit
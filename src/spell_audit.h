@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "note.h"
+#include "spell_checker.h"
+
+struct SpellAuditWord {
+    std::wstring word;
+    int count = 0;              // Occurrences across all notes
+    std::vector<int> noteIds;   // Notes it occurs in, ascending
+};
+
+struct SpellAuditReport {
+    size_t notesChecked = 0;
+    size_t notesTotal = 0;
+    size_t distinctWords = 0;             // Unknown words found so far, not only the listed ones
+    std::vector<SpellAuditWord> words;    // Most frequent first
+    bool cancelled = false;
+};
+
+namespace SpellAudit {
+
+// Checker for a note's spell_language (empty for notes without one). Called on worker threads,
+// once per worker and locale; each worker keeps the checkers it gets.
+typedef std::function<std::shared_ptr<SpellChecker>(const std::string& locale)> CheckerFactory;
+typedef std::function<void(const SpellAuditReport&)> ProgressCallback;
+
+// Spell checks every note (content and checklist items) on a pool of worker threads and tallies
+// the unknown words. Each worker has its own checkers, which share the memory-mapped word list.
+// onProgress gets partial reports on the calling thread a few times a second; the final report
+// is returned. Stops early, with cancelled set, once *cancel becomes true.
+SpellAuditReport Run(const std::vector<Note>& notes, const CheckerFactory& makeChecker, size_t maxWords,
+                     const std::atomic<bool>* cancel, const ProgressCallback& onProgress);
+
+} // namespace SpellAudit
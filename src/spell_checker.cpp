@@ -1,48 +1,260 @@
 #include "spell_checker.h"
-#include <cwctype>
+#include "spell_tokenizer.h"
+#ifdef _WIN32
+#include "utils.h"
+#endif
 
 bool SpellChecker::Initialize(const std::wstring& affPath, const std::wstring& dicPath) {
-    std::string affUtf8 = Utils::WideToUtf8(affPath);
-    std::string dicUtf8 = Utils::WideToUtf8(dicPath);
+    m_affPath = affPath;
+    m_dicPath = dicPath;
+    m_hunspell.reset();
+    m_hunspellTried = false;
+
+    std::wstring dawgPath = dicPath;
+    size_t dot = dawgPath.find_last_of(L'.');
+    if (dot != std::wstring::npos && dawgPath.find_first_of(L"\\/", dot) == std::wstring::npos) {
+        dawgPath.erase(dot);
+    }
+    dawgPath += L".dawg";
+    if (m_dawg.Open(dawgPath)) {
+        m_ready = true;
+    } else {
+        m_ready = EnsureHunspell();
+    }
+    InvalidateCache();
+    return IsReady();
+}
+
+bool SpellChecker::EnsureHunspell() const {
+    if (m_hunspellTried) {
+        return static_cast<bool>(m_hunspell);
+    }
+    m_hunspellTried = true;
+
+#ifdef _WIN32
+    std::string affUtf8 = Utils::WideToUtf8(m_affPath);
+    std::string dicUtf8 = Utils::WideToUtf8(m_dicPath);
+#else
+    std::string affUtf8(m_affPath.begin(), m_affPath.end());   // POSIX builds (tests) use ASCII paths
+    std::string dicUtf8(m_dicPath.begin(), m_dicPath.end());
+#endif
     try {
         m_hunspell = std::make_unique<Hunspell>(affUtf8.c_str(), dicUtf8.c_str());
     } catch (...) {
         m_hunspell.reset();
     }
-    return IsReady();
+    m_hunspellUserWords = 0;
+    AddUserWordsToHunspell();
+    return static_cast<bool>(m_hunspell);
+}
+
+void SpellChecker::SetUserDictionary(std::shared_ptr<const UserDictionary> words) {
+    std::atomic_store(&m_publishedUserWords, std::move(words));
+}
+
+void SpellChecker::SyncUserWords() const {
+    std::shared_ptr<const UserDictionary> words = std::atomic_load(&m_publishedUserWords);
+    if (words != m_userWords) {
+        m_userWords = std::move(words);
+        AddUserWordsToHunspell();
+    }
+}
+
+void SpellChecker::AddUserWordsToHunspell() const {
+    // Lists only ever grow by appending, so the words already added stay a prefix.
+    if (!m_hunspell || !m_userWords) {
+        return;
+    }
+    const std::vector<std::wstring>& words = m_userWords->Words();
+    std::string utf8;
+    for (; m_hunspellUserWords < words.size(); ++m_hunspellUserWords) {
+        utf8.clear();
+        AppendUtf8(words[m_hunspellUserWords].data(), words[m_hunspellUserWords].size(), utf8);
+        m_hunspell->add(utf8);
+    }
+}
+
+bool SpellChecker::DawgAccepts(const std::string& word) const {
+    if (m_dawg.Contains(word.data(), word.size())) {
+        return true;
+    }
+
+    // Hunspell also accepts "Word" and "WORD" for "word", and "WORD" for "Word". Only ASCII case
+    // variants are tried here; anything else is left to Hunspell.
+    if (word[0] < 'A' || word[0] > 'Z') {
+        return false;
+    }
+    bool restLower = true;
+    bool restUpper = true;
+    for (size_t i = 1; i < word.size(); ++i) {
+        const char c = word[i];
+        if ((unsigned char)c >= 0x80) {
+            return false;
+        }
+        if (c >= 'A' && c <= 'Z') {
+            restLower = false;
+        } else if (c >= 'a' && c <= 'z') {
+            restUpper = false;
+        }
+    }
+
+    m_caseWord = word;
+    if (restLower) {
+        m_caseWord[0] = (char)(m_caseWord[0] - 'A' + 'a');
+        return m_dawg.Contains(m_caseWord.data(), m_caseWord.size());
+    }
+    if (!restUpper) {
+        return false;
+    }
+    for (size_t i = 1; i < m_caseWord.size(); ++i) {
+        if (m_caseWord[i] >= 'A' && m_caseWord[i] <= 'Z') {
+            m_caseWord[i] = (char)(m_caseWord[i] - 'A' + 'a');
+        }
+    }
+    if (m_dawg.Contains(m_caseWord.data(), m_caseWord.size())) {
+        return true;
+    }
+    m_caseWord[0] = (char)(m_caseWord[0] - 'A' + 'a');
+    return m_dawg.Contains(m_caseWord.data(), m_caseWord.size());
+}
+
+void SpellChecker::AppendUtf8(const wchar_t* word, size_t length, std::string& out) {
+    for (size_t i = 0; i < length; ++i) {
+        uint32_t c = (uint16_t)word[i];
+        if (c == 0x2019) {
+            c = '\'';   // Dictionaries spell contractions with a plain apostrophe
+        }
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < length && (uint16_t)word[i + 1] >= 0xDC00 && (uint16_t)word[i + 1] <= 0xDFFF) {
+            c = 0x10000 + ((c - 0xD800) << 10) + ((uint16_t)word[i + 1] - 0xDC00);
+            ++i;
+        }
+        if (c < 0x80) {
+            out.push_back((char)c);
+        } else if (c < 0x800) {
+            out.push_back((char)(0xC0 | (c >> 6)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            out.push_back((char)(0xE0 | (c >> 12)));
+            out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        } else {
+            out.push_back((char)(0xF0 | (c >> 18)));
+            out.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+            out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        }
+    }
+}
+
+void SpellChecker::AppendUtf16(const std::string& word, std::wstring& out) {
+    // Malformed sequences become U+FFFD rather than being dropped.
+    size_t i = 0;
+    while (i < word.size()) {
+        uint32_t c = (unsigned char)word[i];
+        size_t extra = 0;
+        if (c >= 0xF0 && c < 0xF8) {
+            c &= 0x07;
+            extra = 3;
+        } else if (c >= 0xE0) {
+            c &= 0x0F;
+            extra = 2;
+        } else if (c >= 0xC0) {
+            c &= 0x1F;
+            extra = 1;
+        } else if (c >= 0x80) {
+            c = 0xFFFD;
+        }
+        ++i;
+        for (size_t k = 0; k < extra; ++k, ++i) {
+            if (i >= word.size() || ((unsigned char)word[i] & 0xC0) != 0x80) {
+                c = 0xFFFD;
+                break;
+            }
+            c = (c << 6) | ((unsigned char)word[i] & 0x3F);
+        }
+        if (c >= 0x10000 && c <= 0x10FFFF) {
+            c -= 0x10000;
+            out.push_back((wchar_t)(0xD800 + (c >> 10)));
+            out.push_back((wchar_t)(0xDC00 + (c & 0x3FF)));
+        } else {
+            out.push_back((wchar_t)(c > 0x10FFFF ? 0xFFFD : c));
+        }
+    }
+}
+
+bool SpellChecker::CheckWord(const wchar_t* word, size_t length) const {
+    // UTF-16 -> UTF-8 into a reused buffer (no per-word allocation once it has grown).
+    m_utf8Word.clear();
+    AppendUtf8(word, length, m_utf8Word);
+
+    // An empty conversion is treated as correct, as before.
+    if (m_utf8Word.empty()) {
+        return true;
+    }
+    if (m_dawg.IsOpen() && DawgAccepts(m_utf8Word)) {
+        return true;
+    }
+    return EnsureHunspell() && m_hunspell->spell(m_utf8Word.c_str());
+}
+
+std::vector<std::wstring> SpellChecker::Suggest(const std::wstring& word, size_t maxCount) const {
+    std::vector<std::wstring> suggestions;
+    if (!m_ready || word.empty()) {
+        return suggestions;
+    }
+    SyncUserWords();
+    if (!EnsureHunspell()) {
+        return suggestions;
+    }
+
+    std::string utf8;
+    AppendUtf8(word.data(), word.size(), utf8);
+    std::vector<std::string> found = m_hunspell->suggest(utf8);
+    for (size_t i = 0; i < found.size() && suggestions.size() < maxCount; ++i) {
+        std::wstring suggestion;
+        AppendUtf16(found[i], suggestion);
+        if (!suggestion.empty()) {
+            suggestions.push_back(std::move(suggestion));
+        }
+    }
+    return suggestions;
 }
 
 std::vector<SpellChecker::Range> SpellChecker::FindMisspellings(const std::wstring& text) const {
+    return FindMisspellings(text, 0, text.size());
+}
+
+std::vector<SpellChecker::Range> SpellChecker::FindMisspellings(const std::wstring& text, size_t start, size_t end,
+                                                             const std::atomic<bool>* cancel,
+                                                             SpellFenceState* fences) const {
     std::vector<Range> misses;
-    if (!m_hunspell || text.empty()) {
+    if (!m_ready || text.empty()) {
         return misses;
     }
+    SyncUserWords();
+    const UserDictionary* userWords = m_userWords.get();
 
-    const size_t n = text.size();
-    size_t i = 0;
-    while (i < n) {
-        // Skip non-alphabetic characters
-        while (i < n && !iswalpha(text[i])) {
-            ++i;
+    SpellTokenizer tokenizer(text.data(), text.size(), start, end, fences);
+    SpellToken token;
+    while (tokenizer.Next(token)) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            break;
         }
-        if (i >= n) break;
-        
-        size_t start = i;
-        
-        // Collect alphabetic characters only (simple, reliable word boundaries)
-        while (i < n && iswalpha(text[i])) {
-            ++i;
+
+        // Check the word in place: user words first (a Bloom probe), then the verdict cache; only
+        // cache misses reach Hunspell
+        const wchar_t* word = text.data() + token.start;
+        size_t length = token.length;
+        bool correct = userWords && userWords->Contains(word, length);
+        if (!correct && !m_verdicts.Lookup(word, length, correct)) {
+            correct = CheckWord(word, length);
+            m_verdicts.Store(word, length, correct);
         }
-        
-        // Extract the word and check spelling
-        std::wstring word = text.substr(start, i - start);
-        std::string utf8 = Utils::WideToUtf8(word);
-        
-        // Validate that the UTF-8 conversion produced a reasonable result
-        if (!utf8.empty() && !m_hunspell->spell(utf8.c_str())) {
+
+        if (!correct) {
             Range r;
-            r.start = static_cast<LONG>(start);
-            r.length = static_cast<LONG>(i - start);
+            r.start = static_cast<long>(token.start);
+            r.length = static_cast<long>(length);
             misses.push_back(r);
         }
     }
@@ -1,25 +1,67 @@
 #pragma once
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
-#include <windows.h>
-#include "utils.h"
+#include "dawg_dictionary.h"
+#include "spell_ranges.h"
+#include "spell_tokenizer.h"
+#include "user_dictionary.h"
+#include "word_cache.h"
 #include <hunspell/hunspell.hxx>
 
+// Not thread-safe: the verdict cache and conversion buffer are shared by every call, so only one
+// thread may use an instance at a time.
 class SpellChecker {
 public:
     SpellChecker() = default;
 
+    // Uses the precompiled word list next to dicPath (en_US.dic -> en_US.dawg) when there is one;
+    // Hunspell is then only loaded for the first word the list does not accept.
     bool Initialize(const std::wstring& affPath, const std::wstring& dicPath);
-    bool IsReady() const { return static_cast<bool>(m_hunspell); }
+    bool IsReady() const { return m_ready; }
 
-    struct Range {
-        LONG start = 0; // character index (wchar_t units)
-        LONG length = 0;
-    };
+    typedef SpellRange Range;
 
     std::vector<Range> FindMisspellings(const std::wstring& text) const;
+    // Checks only the words in [start, end) of text; ranges are relative to the whole text. Stops
+    // early (returning a partial result) once *cancel becomes true. Checking ascending spans of one
+    // text, pass the same fences to each so the text is scanned for code fences only once.
+    std::vector<Range> FindMisspellings(const std::wstring& text, size_t start, size_t end,
+                                        const std::atomic<bool>* cancel = nullptr,
+                                        SpellFenceState* fences = nullptr) const;
+
+    // Up to maxCount replacements for a misspelled word, best first. Loads Hunspell on first use
+    // and can take tens of milliseconds a word, so callers precompute them off the UI thread.
+    std::vector<std::wstring> Suggest(const std::wstring& word, size_t maxCount = 8) const;
+
+    // Forgets cached verdicts; call whenever the dictionary changes.
+    void InvalidateCache() { m_verdicts.Clear(); }
+
+    // Words accepted on top of the dictionary. May be called from any thread: the checking thread
+    // picks the list up at its next FindMisspellings call and adds the new words to Hunspell too.
+    // User words are tested after the verdict cache, so publishing a list needs no invalidation.
+    void SetUserDictionary(std::shared_ptr<const UserDictionary> words);
 
 private:
-    std::unique_ptr<Hunspell> m_hunspell;
+    bool CheckWord(const wchar_t* word, size_t length) const;
+    bool DawgAccepts(const std::string& word) const;
+    bool EnsureHunspell() const;
+    void SyncUserWords() const;
+    void AddUserWordsToHunspell() const;
+    static void AppendUtf8(const wchar_t* word, size_t length, std::string& out);
+    static void AppendUtf16(const std::string& word, std::wstring& out);
+
+    std::wstring m_affPath;
+    std::wstring m_dicPath;
+    bool m_ready = false;
+    DawgDictionary m_dawg;
+    mutable std::unique_ptr<Hunspell> m_hunspell;
+    mutable bool m_hunspellTried = false;
+    mutable std::string m_caseWord;        // Case variant being looked up in m_dawg
+    mutable WordVerdictCache m_verdicts;   // Repeated words skip Hunspell entirely
+    mutable std::string m_utf8Word;        // Reused conversion buffer for cache misses
+    std::shared_ptr<const UserDictionary> m_publishedUserWords;  // Only via std::atomic_load/store
+    mutable std::shared_ptr<const UserDictionary> m_userWords;   // Checking thread's copy
+    mutable size_t m_hunspellUserWords = 0;  // Prefix of m_userWords->Words() added to Hunspell
 };
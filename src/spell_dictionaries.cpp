@@ -0,0 +1,97 @@
+#include "spell_dictionaries.h"
+#include "utils.h"
+#include <algorithm>
+
+void SpellDictionaries::Discover(const std::wstring& dictDir) {
+    m_dictDir = dictDir;
+    m_locales.clear();
+    m_checkers.clear();
+
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileW((dictDir + L"*.dic").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    do {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            continue;
+        }
+        std::wstring name(data.cFileName);
+        size_t dot = name.find_last_of(L'.');
+        if (dot == 0 || dot == std::wstring::npos) {
+            continue;
+        }
+        m_locales.push_back(Utils::WideToUtf8(name.substr(0, dot)));
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+
+    std::sort(m_locales.begin(), m_locales.end());
+}
+
+bool SpellDictionaries::HasLocale(const std::string& locale) const {
+    return !locale.empty() && std::binary_search(m_locales.begin(), m_locales.end(), locale);
+}
+
+std::shared_ptr<SpellChecker> SpellDictionaries::Get(const std::string& locale) {
+    if (!HasLocale(locale)) {
+        return nullptr;
+    }
+    auto it = m_checkers.find(locale);
+    if (it != m_checkers.end()) {
+        return it->second;
+    }
+
+    auto checker = Create(locale);
+    m_checkers[locale] = checker;
+    return checker;
+}
+
+std::shared_ptr<SpellChecker> SpellDictionaries::Create(const std::string& locale) const {
+    if (!HasLocale(locale)) {
+        return nullptr;
+    }
+    std::wstring base = m_dictDir + Utils::Utf8ToWide(locale);
+    auto checker = std::make_shared<SpellChecker>();
+    checker->Initialize(base + L".aff", base + L".dic");
+    checker->SetUserDictionary(m_userWords);
+    return checker;
+}
+
+std::vector<std::string> SpellDictionaries::Languages() const {
+    std::vector<std::string> languages;
+    for (const std::string& locale : m_locales) {
+        std::string language = LanguageOf(locale);
+        if (std::find(languages.begin(), languages.end(), language) == languages.end()) {
+            languages.push_back(language);
+        }
+    }
+    return languages;
+}
+
+std::string SpellDictionaries::LocaleForLanguage(const std::string& language, const std::string& preferred) const {
+    if (HasLocale(preferred) && LanguageOf(preferred) == language) {
+        return preferred;
+    }
+    for (const std::string& locale : m_locales) {
+        if (LanguageOf(locale) == language) {
+            return locale;
+        }
+    }
+    return std::string();
+}
+
+void SpellDictionaries::SetUserDictionary(std::shared_ptr<const UserDictionary> words) {
+    m_userWords = words;
+    for (auto& entry : m_checkers) {
+        entry.second->SetUserDictionary(words);
+    }
+}
+
+std::string SpellDictionaries::LanguageOf(const std::string& locale) {
+    size_t sep = locale.find_first_of("_-");
+    std::string language = locale.substr(0, sep);
+    for (char& c : language) {
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    }
+    return language;
+}
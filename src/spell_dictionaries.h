@@ -0,0 +1,38 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "spell_checker.h"
+
+// The Hunspell dictionaries installed in the dict folder (one <locale>.aff/.dic pair each, e.g.
+// de_DE). A locale's checker is loaded the first time it is asked for and kept afterwards.
+class SpellDictionaries {
+public:
+    // Lists the *.dic files of dictDir (with trailing separator); loads nothing yet.
+    void Discover(const std::wstring& dictDir);
+
+    const std::vector<std::string>& Locales() const { return m_locales; }
+    bool HasLocale(const std::string& locale) const;
+
+    // Checker for an installed locale, or null when it is not installed.
+    std::shared_ptr<SpellChecker> Get(const std::string& locale);
+    // A new checker of its own (not the pooled one) for a thread that checks in parallel.
+    std::shared_ptr<SpellChecker> Create(const std::string& locale) const;
+
+    // Distinct language codes of the installed locales ("en_US", "en_GB" -> "en").
+    std::vector<std::string> Languages() const;
+    // Installed locale for a language code; preferred wins when it is of that language.
+    std::string LocaleForLanguage(const std::string& language, const std::string& preferred) const;
+
+    static std::string LanguageOf(const std::string& locale);
+
+    // User words for every checker, loaded or not.
+    void SetUserDictionary(std::shared_ptr<const UserDictionary> words);
+
+private:
+    std::wstring m_dictDir;
+    std::vector<std::string> m_locales;  // Sorted
+    std::map<std::string, std::shared_ptr<SpellChecker>> m_checkers;
+    std::shared_ptr<const UserDictionary> m_userWords;
+};
@@ -0,0 +1,122 @@
+#include "spell_ranges.h"
+#include <algorithm>
+
+void SpellCheckRanges::Reset(size_t textLength) {
+    m_misses.clear();
+    m_dirty.clear();
+    m_dirty.push_back(Span(0, textLength));
+}
+
+void SpellCheckRanges::ApplyEdit(const TextEdit& edit) {
+    if (edit.Empty()) {
+        return;
+    }
+
+    const size_t oldEnd = edit.offset + edit.removed;
+    auto shift = [&](size_t pos) { return pos - edit.removed + edit.inserted; };
+
+    // Misses before the edit stay, misses after it move, misses touching it are re-checked.
+    size_t out = 0;
+    for (size_t i = 0; i < m_misses.size(); ++i) {
+        SpellRange miss = m_misses[i];
+        size_t start = (size_t)miss.start;
+        size_t end = start + (size_t)miss.length;
+        if (end < edit.offset) {
+            m_misses[out++] = miss;
+        } else if (start > oldEnd) {
+            miss.start = (long)shift(start);
+            m_misses[out++] = miss;
+        }
+    }
+    m_misses.resize(out);
+
+    // Dirty spans overlapping the edit are folded into the edited span.
+    Span edited(edit.offset, edit.offset + edit.inserted);
+    out = 0;
+    for (size_t i = 0; i < m_dirty.size(); ++i) {
+        Span span = m_dirty[i];
+        if (span.second < edit.offset) {
+            m_dirty[out++] = span;
+        } else if (span.first > oldEnd) {
+            m_dirty[out++] = Span(shift(span.first), shift(span.second));
+        } else {
+            edited.first = std::min(edited.first, span.first);
+            if (span.second > oldEnd) {
+                edited.second = std::max(edited.second, shift(span.second));
+            }
+        }
+    }
+    m_dirty.resize(out);
+    AddDirty(edited);
+}
+
+void SpellCheckRanges::MarkDirty(size_t start, size_t end) {
+    AddDirty(Span(start, end));
+}
+
+void SpellCheckRanges::AddDirty(Span span) {
+    auto it = std::lower_bound(m_dirty.begin(), m_dirty.end(), span);
+    it = m_dirty.insert(it, span);
+
+    // Merge with neighbours that overlap or touch.
+    if (it != m_dirty.begin() && (it - 1)->second >= it->first) {
+        (it - 1)->second = std::max((it - 1)->second, it->second);
+        it = m_dirty.erase(it) - 1;
+    }
+    while (it + 1 != m_dirty.end() && (it + 1)->first <= it->second) {
+        it->second = std::max(it->second, (it + 1)->second);
+        m_dirty.erase(it + 1);
+    }
+}
+
+std::vector<SpellCheckRanges::Span> SpellCheckRanges::DirtySpans(const wchar_t* text, size_t length) const {
+    std::vector<Span> spans;
+    for (const Span& dirty : m_dirty) {
+        size_t start = std::min(dirty.first, length);
+        size_t end = std::min(dirty.second, length);
+        while (start > 0 && text[start - 1] != L'\r' && text[start - 1] != L'\n') {
+            --start;
+        }
+        while (end < length && text[end] != L'\r' && text[end] != L'\n') {
+            ++end;
+        }
+        if (!spans.empty() && spans.back().second >= start) {
+            spans.back().second = std::max(spans.back().second, end);
+        } else {
+            spans.push_back(Span(start, end));
+        }
+    }
+    return spans;
+}
+
+void SpellCheckRanges::Commit(const Span& span, const std::vector<SpellRange>& found) {
+    // Replace the misses inside span.
+    auto first = std::lower_bound(m_misses.begin(), m_misses.end(), span.first,
+        [](const SpellRange& miss, size_t pos) { return (size_t)miss.start < pos; });
+    auto last = first;
+    while (last != m_misses.end() && (size_t)last->start < span.second) {
+        ++last;
+    }
+    first = m_misses.erase(first, last);
+    m_misses.insert(first, found.begin(), found.end());
+
+    // Clear the checked part of the dirty spans.
+    std::vector<Span> remaining;
+    remaining.reserve(m_dirty.size() + 1);
+    for (const Span& dirty : m_dirty) {
+        if (dirty.second <= span.first || dirty.first >= span.second) {
+            // A zero-length span at the very edge still counts as checked.
+            if (!(dirty.first == dirty.second && dirty.first >= span.first && dirty.first <= span.second)) {
+                remaining.push_back(dirty);
+            }
+            continue;
+        }
+        if (dirty.first < span.first) {
+            remaining.push_back(Span(dirty.first, span.first));
+        }
+        if (dirty.second > span.second) {
+            remaining.push_back(Span(span.second, dirty.second));
+        }
+    }
+    m_dirty.swap(remaining);
+}
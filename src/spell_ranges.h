@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "text_edit.h"
+
+// A misspelled word: character index and length in wchar_t units.
+struct SpellRange {
+    long start = 0;
+    long length = 0;
+};
+
+// Bookkeeping for incremental spell checking: the known misses (sorted by start) and the dirty
+// spans that still have to be checked. Edits shift both in place, so only text around an edit is
+// re-checked. No window or dictionary dependencies.
+class SpellCheckRanges {
+public:
+    typedef std::pair<size_t, size_t> Span;  // [first, second)
+
+    // Forgets all misses and marks the whole text dirty.
+    void Reset(size_t textLength);
+
+    // Shifts misses and dirty spans after edit, drops misses touching it and marks it dirty.
+    void ApplyEdit(const TextEdit& edit);
+
+    // Marks [start, end) for re-checking without touching the misses; Commit replaces them.
+    void MarkDirty(size_t start, size_t end);
+
+    bool HasDirty() const { return !m_dirty.empty(); }
+
+    // Dirty spans of text widened to whole lines and merged. The tokenizer's markdown spans (inline
+    // code, links) never cross a line, so a line can be re-checked on its own.
+    std::vector<Span> DirtySpans(const wchar_t* text, size_t length) const;
+
+    // Records the result of checking span: its old misses are replaced by found (sorted, inside span)
+    // and the span is no longer dirty.
+    void Commit(const Span& span, const std::vector<SpellRange>& found);
+
+    // Drops the misses pred accepts (e.g. a word just added to the user dictionary) without
+    // marking anything dirty.
+    template <typename Pred>
+    void RemoveMissesIf(Pred pred) {
+        m_misses.erase(std::remove_if(m_misses.begin(), m_misses.end(), pred), m_misses.end());
+    }
+
+    const std::vector<SpellRange>& Misses() const { return m_misses; }
+
+private:
+    void AddDirty(Span span);
+
+    std::vector<SpellRange> m_misses;
+    std::vector<Span> m_dirty;   // Sorted, non-overlapping
+};
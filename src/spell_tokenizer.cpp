@@ -0,0 +1,364 @@
+#include "spell_tokenizer.h"
+#include <cstdint>
+#include <cwctype>
+
+namespace {
+
+enum : unsigned char {
+    kOther = 0,
+    kLetter = 1,
+    kDigit = 2,
+    kJoiner = 3,   // Punctuation that can sit inside a token: contractions, hyphens, URLs, paths
+};
+
+struct AsciiClassTable {
+    unsigned char cls[128];
+
+    constexpr AsciiClassTable() : cls() {
+        for (int c = 'a'; c <= 'z'; ++c) cls[c] = kLetter;
+        for (int c = 'A'; c <= 'Z'; ++c) cls[c] = kLetter;
+        for (int c = '0'; c <= '9'; ++c) cls[c] = kDigit;
+        const char joiners[] = "'-_.@:/\\+%=?&#~";
+        for (int i = 0; joiners[i] != 0; ++i) cls[(unsigned char)joiners[i]] = kJoiner;
+    }
+};
+
+constexpr AsciiClassTable kAscii;
+
+inline unsigned char Classify(wchar_t c) {
+    if ((uint32_t)c < 128) {
+        return kAscii.cls[c];
+    }
+    if (c == 0x2019) {
+        return kJoiner;   // Typographic apostrophe
+    }
+    return iswalpha(c) ? kLetter : kOther;
+}
+
+inline bool IsApostrophe(wchar_t c) {
+    return c == L'\'' || c == 0x2019;
+}
+
+inline bool IsLineBreak(wchar_t c) {
+    return c == L'\r' || c == L'\n';
+}
+
+inline bool IsUpper(wchar_t c) {
+    return (uint32_t)c < 128 ? (c >= L'A' && c <= L'Z') : iswupper(c) != 0;
+}
+
+inline bool IsLower(wchar_t c) {
+    return (uint32_t)c < 128 ? (c >= L'a' && c <= L'z') : iswlower(c) != 0;
+}
+
+// Same rules as Markdown::ParseMarkdownFence, without building a line string.
+bool ParseFence(const wchar_t* line, size_t length, wchar_t& fenceChar, size_t& fenceLength, bool& hasInfo) {
+    size_t i = 0;
+    while (i < length && i < 3 && line[i] == L' ') {
+        ++i;
+    }
+    if (i >= length || (line[i] != L'`' && line[i] != L'~')) {
+        return false;
+    }
+
+    wchar_t ch = line[i];
+    size_t count = 0;
+    while (i < length && line[i] == ch) {
+        ++count;
+        ++i;
+    }
+    if (count < 3) {
+        return false;
+    }
+
+    hasInfo = false;
+    for (; i < length; ++i) {
+        // A backtick fence's info string can't contain backticks (that's inline code).
+        if (ch == L'`' && line[i] == L'`') {
+            return false;
+        }
+        if (line[i] != L' ' && line[i] != L'\t') {
+            hasInfo = true;
+        }
+    }
+    fenceChar = ch;
+    fenceLength = count;
+    return true;
+}
+
+} // namespace
+
+SpellTokenizer::SpellTokenizer(const wchar_t* text, size_t length, size_t start, size_t end, SpellFenceState* fences)
+    : m_text(text),
+      m_length(length),
+      m_start(start < length ? start : length),
+      m_end(end < length ? end : length),
+      m_pos(0) {
+    size_t lineStart = m_start;
+    while (lineStart > 0 && !IsLineBreak(m_text[lineStart - 1])) {
+        --lineStart;
+    }
+    if (fences && fences->pos <= lineStart) {
+        m_pos = fences->pos;
+        m_inFence = fences->inFence;
+        m_fenceChar = fences->fenceChar;
+        m_fenceLength = fences->fenceLength;
+    }
+    while (m_pos < lineStart) {
+        size_t lineEnd = LineEnd(m_pos);
+        AdvanceFence(m_pos, lineEnd);
+        m_pos = NextLineStart(lineEnd);
+    }
+    if (fences) {
+        fences->pos = m_pos;
+        fences->inFence = m_inFence;
+        fences->fenceChar = m_fenceChar;
+        fences->fenceLength = m_fenceLength;
+    }
+}
+
+size_t SpellTokenizer::LineEnd(size_t pos) const {
+    while (pos < m_length && !IsLineBreak(m_text[pos])) {
+        ++pos;
+    }
+    return pos;
+}
+
+size_t SpellTokenizer::NextLineStart(size_t lineEnd) const {
+    if (lineEnd >= m_length) {
+        return m_length;
+    }
+    if (m_text[lineEnd] == L'\r' && lineEnd + 1 < m_length && m_text[lineEnd + 1] == L'\n') {
+        return lineEnd + 2;
+    }
+    return lineEnd + 1;
+}
+
+bool SpellTokenizer::AdvanceFence(size_t pos, size_t lineEnd) {
+    wchar_t fenceChar = 0;
+    size_t fenceLength = 0;
+    bool hasInfo = false;
+    if (!ParseFence(m_text + pos, lineEnd - pos, fenceChar, fenceLength, hasInfo)) {
+        return false;
+    }
+    if (!m_inFence) {
+        m_inFence = true;
+        m_fenceChar = fenceChar;
+        m_fenceLength = fenceLength;
+        return true;
+    }
+    if (fenceChar == m_fenceChar && fenceLength >= m_fenceLength && !hasInfo) {
+        m_inFence = false;
+        return true;
+    }
+    return false;
+}
+
+bool SpellTokenizer::SkipMarkup() {
+    const wchar_t c = m_text[m_pos];
+    if (c == L'`') {
+        // Inline code: skip to the closing run of the same length, if the line has one.
+        size_t run = 0;
+        while (m_pos + run < m_lineEnd && m_text[m_pos + run] == L'`') {
+            ++run;
+        }
+        size_t i = m_pos + run;
+        while (i < m_lineEnd) {
+            if (m_text[i] != L'`') {
+                ++i;
+                continue;
+            }
+            size_t closing = 0;
+            while (i + closing < m_lineEnd && m_text[i + closing] == L'`') {
+                ++closing;
+            }
+            if (closing == run) {
+                m_pos = i + closing;
+                return true;
+            }
+            i += closing;
+        }
+        m_pos += run;
+        return true;
+    }
+
+    if (c == L'<' && m_pos + 1 < m_lineEnd) {
+        // Autolinks (<https://...>), HTML tags and comments.
+        wchar_t next = m_text[m_pos + 1];
+        if (Classify(next) == kLetter || next == L'/' || next == L'!' || next == L'?') {
+            for (size_t i = m_pos + 2; i < m_lineEnd; ++i) {
+                if (m_text[i] == L'>') {
+                    m_pos = i + 1;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    if (c == L']' && m_pos + 1 < m_lineEnd && m_text[m_pos + 1] == L'(') {
+        // Link destination of [text](url "title"); the link text itself is prose.
+        int depth = 1;
+        for (size_t i = m_pos + 2; i < m_lineEnd; ++i) {
+            if (m_text[i] == L'(') {
+                ++depth;
+            } else if (m_text[i] == L')' && --depth == 0) {
+                m_pos = i + 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (c == L'&') {
+        // Character references such as &nbsp; or &#8212;
+        size_t i = m_pos + 1;
+        while (i < m_lineEnd && i - m_pos <= 32 && (uint32_t)m_text[i] < 128 &&
+               (Classify(m_text[i]) == kLetter || Classify(m_text[i]) == kDigit || m_text[i] == L'#')) {
+            ++i;
+        }
+        if (i > m_pos + 1 && i < m_lineEnd && m_text[i] == L';') {
+            m_pos = i + 1;
+            return true;
+        }
+        return false;
+    }
+    return false;
+}
+
+// rawStart/rawEnd is the whole token including leading/trailing joiners, start/end the trimmed word.
+bool SpellTokenizer::IsCodeLike(size_t rawStart, size_t rawEnd, size_t start, size_t end) const {
+    // E-mail addresses, @mentions and URLs ("://" may be trailing, e.g. "http://").
+    for (size_t i = rawStart; i < rawEnd; ++i) {
+        if (m_text[i] == L'@') {
+            return true;
+        }
+        if (m_text[i] == L':' && i + 2 < rawEnd && m_text[i + 1] == L'/' && m_text[i + 2] == L'/') {
+            return true;
+        }
+    }
+
+    // Inside the word only hyphens and apostrophes are prose; dots, slashes, underscores and the
+    // like mean a host name, path or identifier. So do digits and a lower-to-upper case change.
+    bool prevLower = false;
+    for (size_t i = start; i < end; ++i) {
+        const wchar_t c = m_text[i];
+        const unsigned char cls = Classify(c);
+        if (cls == kDigit) {
+            return true;
+        }
+        if (cls == kJoiner) {
+            if (c != L'-' && !IsApostrophe(c)) {
+                return true;
+            }
+            prevLower = false;
+            continue;
+        }
+        if (prevLower && IsUpper(c)) {
+            return true;
+        }
+        prevLower = IsLower(c);
+    }
+    return false;
+}
+
+bool SpellTokenizer::NextPart(SpellToken& token) {
+    while (m_partPos < m_partEnd) {
+        size_t start = m_partPos;
+        size_t end = start;
+        while (end < m_partEnd && m_text[end] != L'-') {
+            ++end;
+        }
+        m_partPos = (end < m_partEnd) ? end + 1 : m_partEnd;
+
+        while (start < end && IsApostrophe(m_text[start])) {
+            ++start;
+        }
+        while (end > start && IsApostrophe(m_text[end - 1])) {
+            --end;
+        }
+        if (start < end && start >= m_start && start < m_end) {
+            token.start = start;
+            token.length = end - start;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SpellTokenizer::Next(SpellToken& token) {
+    while (true) {
+        if (NextPart(token)) {
+            return true;
+        }
+
+        if (m_atLineStart) {
+            if (m_pos >= m_end || m_pos >= m_length) {
+                return false;
+            }
+            m_lineEnd = LineEnd(m_pos);
+            if (AdvanceFence(m_pos, m_lineEnd) || m_inFence) {
+                m_pos = NextLineStart(m_lineEnd);
+                continue;
+            }
+            m_atLineStart = false;
+        }
+
+        if (m_pos >= m_lineEnd) {
+            m_pos = NextLineStart(m_lineEnd);
+            m_atLineStart = true;
+            continue;
+        }
+        if (SkipMarkup()) {
+            continue;
+        }
+        if (Classify(m_text[m_pos]) == kOther) {
+            ++m_pos;
+            continue;
+        }
+
+        size_t rawStart = m_pos;
+        while (m_pos < m_lineEnd && Classify(m_text[m_pos]) != kOther) {
+            ++m_pos;
+        }
+        size_t start = rawStart;
+        size_t end = m_pos;
+        while (start < end && Classify(m_text[start]) == kJoiner) {
+            ++start;
+        }
+        while (end > start && Classify(m_text[end - 1]) == kJoiner) {
+            --end;
+        }
+        if (start == end || IsCodeLike(rawStart, m_pos, start, end)) {
+            continue;
+        }
+        m_partPos = start;
+        m_partEnd = end;
+    }
+}
+
+bool SpellTokenizer::TouchesFence(const wchar_t* text, size_t length, size_t start, size_t end) {
+    if (start > length) start = length;
+    if (end > length) end = length;
+    while (start > 0 && !IsLineBreak(text[start - 1])) {
+        --start;
+    }
+
+    size_t pos = start;
+    while (true) {
+        size_t lineEnd = pos;
+        while (lineEnd < length && !IsLineBreak(text[lineEnd])) {
+            ++lineEnd;
+        }
+        wchar_t fenceChar = 0;
+        size_t fenceLength = 0;
+        bool hasInfo = false;
+        if (ParseFence(text + pos, lineEnd - pos, fenceChar, fenceLength, hasInfo)) {
+            return true;
+        }
+        if (lineEnd >= end || lineEnd >= length) {
+            return false;
+        }
+        pos = lineEnd + 1;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+// One word to spell check: character index and length in wchar_t units.
+struct SpellToken {
+    size_t start = 0;
+    size_t length = 0;
+};
+
+// How far a scan for code fences got: whether the line starting at pos is inside fenced code.
+// Passing the same one to the tokenizers of ascending spans of one text reads each line for
+// fences once, instead of once per span from the start of the text.
+struct SpellFenceState {
+    size_t pos = 0;
+    bool inFence = false;
+    wchar_t fenceChar = 0;
+    size_t fenceLength = 0;
+};
+
+// Splits markdown text into the words worth spell checking. Fenced code blocks, inline code, link
+// destinations, autolinks/HTML tags and entities are skipped, as are URLs, e-mail addresses, paths
+// and identifiers (snake_case, camelCase, anything with digits or dots inside). Contractions stay
+// whole ("don't") and hyphenated words are checked part by part. Works in place on the caller's
+// buffer and never allocates; ASCII is classified through a table, everything else via iswalpha.
+class SpellTokenizer {
+public:
+    // Tokenizes the lines overlapping [start, end) of text; words starting before start are skipped.
+    // The lines before start are scanned for code fences, so start may lie anywhere. With fences,
+    // the scan resumes where it stopped (if that is not past start) and is left at start's line.
+    SpellTokenizer(const wchar_t* text, size_t length, size_t start, size_t end, SpellFenceState* fences = nullptr);
+
+    bool Next(SpellToken& token);
+
+    // True when a line overlapping [start, end] of text looks like a code fence delimiter. Editing
+    // such a line can change how every line after it is tokenized.
+    static bool TouchesFence(const wchar_t* text, size_t length, size_t start, size_t end);
+
+private:
+    size_t LineEnd(size_t pos) const;
+    size_t NextLineStart(size_t lineEnd) const;
+    // Updates the fence state for the line [pos, lineEnd); true if the line is a fence delimiter.
+    bool AdvanceFence(size_t pos, size_t lineEnd);
+    // Skips a markdown construct at m_pos that holds no prose; false if there is none.
+    bool SkipMarkup();
+    bool IsCodeLike(size_t rawStart, size_t rawEnd, size_t start, size_t end) const;
+    bool NextPart(SpellToken& token);
+
+    const wchar_t* m_text;
+    size_t m_length;
+    size_t m_start;
+    size_t m_end;
+    size_t m_pos;
+    size_t m_lineEnd = 0;
+    bool m_atLineStart = true;
+    bool m_inFence = false;
+    wchar_t m_fenceChar = 0;
+    size_t m_fenceLength = 0;
+    size_t m_partPos = 0;    // Rest of the word being split at hyphens
+    size_t m_partEnd = 0;
+};
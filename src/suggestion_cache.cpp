@@ -0,0 +1,35 @@
+#include "suggestion_cache.h"
+
+SuggestionCache::SuggestionCache(size_t capacity) : m_capacity(capacity ? capacity : 1) {
+}
+
+bool SuggestionCache::Lookup(const std::wstring& word, std::vector<std::wstring>& suggestions) {
+    auto it = m_index.find(word);
+    if (it == m_index.end()) {
+        return false;
+    }
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    suggestions = it->second->second;
+    return true;
+}
+
+void SuggestionCache::Store(const std::wstring& word, std::vector<std::wstring> suggestions) {
+    auto it = m_index.find(word);
+    if (it != m_index.end()) {
+        it->second->second = std::move(suggestions);
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return;
+    }
+
+    if (m_index.size() >= m_capacity) {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+    m_entries.emplace_front(word, std::move(suggestions));
+    m_index[word] = m_entries.begin();
+}
+
+void SuggestionCache::Clear() {
+    m_entries.clear();
+    m_index.clear();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Spelling suggestions per misspelled word, least recently used entries evicted first once the
+// cache is full. Computing suggestions is slow (tens of milliseconds a word), so they are
+// precomputed for the visible misses and a context menu only looks them up.
+// Not thread-safe: callers serialize access.
+class SuggestionCache {
+public:
+    explicit SuggestionCache(size_t capacity = 256);
+
+    // Returns true and fills suggestions (possibly empty) when word is cached.
+    bool Lookup(const std::wstring& word, std::vector<std::wstring>& suggestions);
+    bool Contains(const std::wstring& word) const { return m_index.count(word) != 0; }
+    void Store(const std::wstring& word, std::vector<std::wstring> suggestions);
+
+    void Clear();
+    size_t Size() const { return m_index.size(); }
+
+private:
+    typedef std::pair<std::wstring, std::vector<std::wstring>> Entry;
+
+    size_t m_capacity;
+    std::list<Entry> m_entries;   // Most recently used first
+    std::unordered_map<std::wstring, std::list<Entry>::iterator> m_index;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Where synced objects live: a flat namespace of named blobs (Google Drive appDataFolder, a local
+// directory, or a small HTTP object server). Each object has an opaque version that changes on
+// every write, so writers can make a write conditional on what they last read.
+
+enum class SyncStatus {
+    Ok,
+    NotFound,
+    Conflict,   // A conditional write found another version
+    Failed
+};
+
+struct SyncObjectInfo {
+    std::string name;
+    std::string version;
+    unsigned long long size = 0;
+    unsigned long long modifiedTime = 0;   // FILETIME ticks, UTC; 0 when unknown
+};
+
+// ifVersion for Put: write only when the object does not exist yet.
+static const char kSyncCreateOnly[] = "*";
+
+// Large uploads are read and sent this much at a time; a multiple of 256 KiB, as Drive's
+// resumable uploads require.
+static const size_t kSyncChunkSize = 8u << 20;
+
+// Content for PutStream, read a piece at a time so an upload never holds the whole object.
+class SyncSource {
+public:
+    virtual ~SyncSource() = default;
+
+    virtual unsigned long long Size() const = 0;
+
+    // Exactly length bytes starting at offset; false on a read error.
+    virtual bool Read(unsigned long long offset, unsigned char* buffer, size_t length) = 0;
+};
+
+class MemorySyncSource : public SyncSource {
+public:
+    MemorySyncSource(const unsigned char* data, size_t size) : m_data(data), m_size(size) {}
+
+    unsigned long long Size() const override { return m_size; }
+
+    bool Read(unsigned long long offset, unsigned char* buffer, size_t length) override {
+        if (offset > m_size || length > m_size - offset) {
+            return false;
+        }
+        std::copy(m_data + offset, m_data + offset + length, buffer);
+        return true;
+    }
+
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+};
+
+// Called from the uploading thread as an upload advances: bytes acknowledged so far, and the total.
+typedef std::function<void(unsigned long long sent, unsigned long long total)> SyncProgress;
+
+class SyncBackend {
+public:
+    virtual ~SyncBackend() = default;
+
+    // ifVersion empty writes unconditionally; kSyncCreateOnly or a version read earlier makes the
+    // write fail with Conflict when the object is not in that state. outInfo may be null.
+    virtual SyncStatus Put(const std::string& name,
+                           const std::vector<unsigned char>& content,
+                           const std::string& ifVersion,
+                           SyncObjectInfo* outInfo,
+                           std::string& outError) = 0;
+
+    // Put for content too large to hold in memory. Backends that can upload in pieces override it
+    // to send kSyncChunkSize at a time and resume after a dropped connection; this one reads the
+    // whole source and calls Put. progress may be empty.
+    virtual SyncStatus PutStream(const std::string& name,
+                                 SyncSource& content,
+                                 const std::string& ifVersion,
+                                 SyncObjectInfo* outInfo,
+                                 const SyncProgress& progress,
+                                 std::string& outError) {
+        std::vector<unsigned char> bytes((size_t)content.Size());
+        if (!bytes.empty() && !content.Read(0, bytes.data(), bytes.size())) {
+            outError = "Failed to read " + name + " for upload";
+            return SyncStatus::Failed;
+        }
+        SyncStatus status = Put(name, bytes, ifVersion, outInfo, outError);
+        if (status == SyncStatus::Ok && progress) {
+            progress(bytes.size(), bytes.size());
+        }
+        return status;
+    }
+
+    virtual SyncStatus Get(const std::string& name,
+                           std::vector<unsigned char>& outContent,
+                           SyncObjectInfo* outInfo,
+                           std::string& outError) = 0;
+
+    virtual SyncStatus Stat(const std::string& name, SyncObjectInfo& outInfo, std::string& outError) = 0;
+
+    // Every object whose name starts with prefix, in no particular order.
+    virtual SyncStatus List(const std::string& prefix, std::vector<SyncObjectInfo>& outObjects, std::string& outError) = 0;
+
+    // NotFound when there is no such object.
+    virtual SyncStatus Delete(const std::string& name, std::string& outError) = 0;
+};
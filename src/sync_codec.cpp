@@ -0,0 +1,228 @@
+#include "sync_codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char kMagic[4] = { 'N', 'S', 'F', 'Z' };
+const size_t kHeaderSize = 20;
+const uint32_t kStoredFlag = 0x80000000u;
+const uint32_t kMaxBlockSize = 64u << 20;
+
+void PutU32(unsigned char* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+uint32_t GetU32(const unsigned char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= (uint32_t)p[i] << (8 * i);
+    return v;
+}
+
+uint64_t GetU64(const unsigned char* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+} // namespace
+
+namespace SyncCodec {
+
+bool IsEncoded(const unsigned char* data, size_t size) {
+    return size >= kHeaderSize && memcmp(data, kMagic, sizeof(kMagic)) == 0 && data[4] == kCodecLz;
+}
+
+CompressedSource::CompressedSource(SyncSource& original) : m_original(original) {
+}
+
+bool CompressedSource::Prepare() {
+    const uint64_t size = m_original.Size();
+    m_header.assign(kHeaderSize, 0);
+    memcpy(m_header.data(), kMagic, sizeof(kMagic));
+    m_header[4] = kCodecLz;
+    for (int i = 0; i < 8; ++i) m_header[8 + i] = (unsigned char)(size >> (8 * i));
+    PutU32(&m_header[16], kBlockSize);
+
+    size_t blocks = (size_t)((size + kBlockSize - 1) / kBlockSize);
+    m_starts.assign(1, kHeaderSize);
+    m_starts.reserve(blocks + 1);
+    m_recordIndex = (size_t)-1;
+    for (size_t i = 0; i < blocks; ++i) {
+        if (!LoadBlock(i)) {
+            return false;
+        }
+        m_starts.push_back(m_starts.back() + m_record.size());
+    }
+    return true;
+}
+
+unsigned long long CompressedSource::Size() const {
+    return m_starts.empty() ? 0 : m_starts.back();
+}
+
+bool CompressedSource::LoadBlock(size_t index) {
+    if (index == m_recordIndex) {
+        return true;
+    }
+    uint64_t start = (uint64_t)index * kBlockSize;
+    size_t length = (size_t)std::min<uint64_t>(kBlockSize, m_original.Size() - start);
+    m_plain.resize(length);
+    if (!m_original.Read(start, m_plain.data(), length)) {
+        m_recordIndex = (size_t)-1;
+        return false;
+    }
+    m_record.resize(4 + LzCodec::CompressBound(length));
+    size_t packed = m_compressor.Compress(m_plain.data(), length, m_record.data() + 4);
+    uint32_t word = (uint32_t)packed;
+    if (packed >= length) {
+        // Already compressed or random: store it, so a record never grows past its block.
+        memcpy(m_record.data() + 4, m_plain.data(), length);
+        packed = length;
+        word = (uint32_t)length | kStoredFlag;
+    }
+    PutU32(m_record.data(), word);
+    m_record.resize(4 + packed);
+    m_recordIndex = index;
+    return true;
+}
+
+bool CompressedSource::Read(unsigned long long offset, unsigned char* buffer, size_t length) {
+    if (offset > Size() || length > Size() - offset) {
+        return false;
+    }
+    while (length > 0) {
+        size_t n;
+        if (offset < kHeaderSize) {
+            n = (size_t)std::min<unsigned long long>(kHeaderSize - offset, length);
+            memcpy(buffer, m_header.data() + offset, n);
+        } else {
+            size_t index = (size_t)(std::upper_bound(m_starts.begin(), m_starts.end(), offset) - m_starts.begin()) - 1;
+            // Blocks compress the same way every time; a different size means the source changed.
+            if (!LoadBlock(index) || m_record.size() != m_starts[index + 1] - m_starts[index]) {
+                return false;
+            }
+            uint64_t within = offset - m_starts[index];
+            n = (size_t)std::min<uint64_t>(m_record.size() - within, length);
+            memcpy(buffer, m_record.data() + within, n);
+        }
+        offset += n;
+        buffer += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool Decoder::DecodeRecord(const unsigned char* record, std::vector<unsigned char>& out, std::string& error) {
+    if (m_decoded >= m_originalSize) {
+        error = "Compressed sync data is longer than its header says";
+        return false;
+    }
+    size_t length = (size_t)std::min<uint64_t>(m_blockSize, m_originalSize - m_decoded);
+    uint32_t word = GetU32(record);
+    size_t recordLength = word & ~kStoredFlag;
+    size_t at = out.size();
+    out.resize(at + length);
+    bool ok;
+    if (word & kStoredFlag) {
+        ok = recordLength == length;
+        if (ok) {
+            memcpy(&out[at], record + 4, length);
+        }
+    } else {
+        ok = LzCodec::Decompress(record + 4, recordLength, out.data() + at, length);
+    }
+    if (!ok) {
+        out.resize(at);
+        error = "Compressed sync data is damaged";
+        return false;
+    }
+    m_decoded += length;
+    return true;
+}
+
+bool Decoder::Feed(const unsigned char* data, size_t size, std::vector<unsigned char>& out, std::string& error) {
+    for (;;) {
+        if (m_haveHeader && m_pending.empty() && size >= 4) {
+            // Whole records in the input decode straight from it.
+            size_t recordLength = GetU32(data) & ~kStoredFlag;
+            if (recordLength <= LzCodec::CompressBound(m_blockSize) && size - 4 >= recordLength) {
+                if (!DecodeRecord(data, out, error)) {
+                    return false;
+                }
+                data += 4 + recordLength;
+                size -= 4 + recordLength;
+                continue;
+            }
+        }
+        size_t need = kHeaderSize;
+        if (m_haveHeader) {
+            need = 4;
+            if (m_pending.size() >= 4) {
+                uint32_t recordLength = GetU32(m_pending.data()) & ~kStoredFlag;
+                if (recordLength > LzCodec::CompressBound(m_blockSize)) {
+                    error = "Compressed sync data is damaged";
+                    return false;
+                }
+                need += recordLength;
+            }
+        }
+        if (m_pending.size() < need) {
+            if (size == 0) {
+                return true;
+            }
+            size_t take = std::min(need - m_pending.size(), size);
+            m_pending.insert(m_pending.end(), data, data + take);
+            data += take;
+            size -= take;
+            continue;
+        }
+
+        if (!m_haveHeader) {
+            if (!IsEncoded(m_pending.data(), m_pending.size())) {
+                error = "Sync data uses an unknown compression format";
+                return false;
+            }
+            m_originalSize = GetU64(&m_pending[8]);
+            m_blockSize = GetU32(&m_pending[16]);
+            if (m_blockSize == 0 || m_blockSize > kMaxBlockSize) {
+                error = "Compressed sync data is damaged";
+                return false;
+            }
+            m_haveHeader = true;
+            m_pending.clear();
+            continue;
+        }
+
+        if (!DecodeRecord(m_pending.data(), out, error)) {
+            return false;
+        }
+        m_pending.clear();
+    }
+}
+
+bool Decoder::Finished(std::string& error) const {
+    if (!m_haveHeader || m_decoded != m_originalSize || !m_pending.empty()) {
+        error = "Compressed sync data is incomplete";
+        return false;
+    }
+    return true;
+}
+
+bool Decode(const std::vector<unsigned char>& encoded, std::vector<unsigned char>& out, std::string& error) {
+    out.clear();
+    if (IsEncoded(encoded.data(), encoded.size())) {
+        // Reserve what the header promises, within what the codec could possibly expand to.
+        uint64_t promised = GetU64(&encoded[8]);
+        out.reserve((size_t)std::min<uint64_t>(promised, (uint64_t)encoded.size() * 255));
+    }
+    Decoder decoder;
+    if (!decoder.Feed(encoded.data(), encoded.size(), out, error) || !decoder.Finished(error)) {
+        out.clear();
+        return false;
+    }
+    return true;
+}
+
+} // namespace SyncCodec
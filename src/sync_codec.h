@@ -0,0 +1,75 @@
+#pragma once
+
+#include "lz_codec.h"
+#include "sync_backend.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compressed sync payloads. An encoded payload is a header, "NSFZ", the codec (u8, kCodecLz),
+// three zero bytes, the original size (u64) and the block size (u32), followed by one record per
+// block of the original: its length (u32, top bit set when the block is stored as is because it
+// would not shrink) and its bytes. Every block but the last decodes to the block size.
+// Little-endian throughout; portable, like PageDelta.
+namespace SyncCodec {
+
+const uint8_t kCodecLz = 1;
+const uint32_t kBlockSize = 1u << 20;
+
+// Whether bytes start with an encoded payload's header.
+bool IsEncoded(const unsigned char* data, size_t size);
+
+// The encoding of another source, compressed a block at a time. Prepare compresses everything
+// once to learn the encoded size (keeping 4 bytes per block); reads then compress the blocks they
+// cover again, so memory stays a block or two however large the source. The source must not
+// change in between.
+class CompressedSource : public SyncSource {
+public:
+    explicit CompressedSource(SyncSource& original);
+
+    // False when the original cannot be read.
+    bool Prepare();
+
+    unsigned long long Size() const override;
+    bool Read(unsigned long long offset, unsigned char* buffer, size_t length) override;
+
+    unsigned long long OriginalSize() const { return m_original.Size(); }
+
+private:
+    bool LoadBlock(size_t index);
+
+    SyncSource& m_original;
+    std::vector<unsigned char> m_header;
+    std::vector<uint64_t> m_starts;      // Offset of each block's record; one extra at the end
+    LzCodec::Compressor m_compressor;
+    std::vector<unsigned char> m_plain;
+    std::vector<unsigned char> m_record;  // Of block m_recordIndex
+    size_t m_recordIndex = (size_t)-1;
+};
+
+// Decodes a payload fed in pieces of any size, appending the original to out as each block
+// completes, so a download can be decoded while it arrives.
+class Decoder {
+public:
+    // False (with error set) on damaged input; stop feeding then.
+    bool Feed(const unsigned char* data, size_t size, std::vector<unsigned char>& out, std::string& error);
+
+    // Whether the whole payload arrived. Call after the last Feed.
+    bool Finished(std::string& error) const;
+
+private:
+    // Appends the block of a whole record (its length word first) to out.
+    bool DecodeRecord(const unsigned char* record, std::vector<unsigned char>& out, std::string& error);
+
+    std::vector<unsigned char> m_pending;   // Header or the current record, until complete
+    bool m_haveHeader = false;
+    uint64_t m_originalSize = 0;
+    uint32_t m_blockSize = 0;
+    uint64_t m_decoded = 0;
+};
+
+// Decodes a whole payload.
+bool Decode(const std::vector<unsigned char>& encoded, std::vector<unsigned char>& out, std::string& error);
+
+} // namespace SyncCodec
@@ -0,0 +1,239 @@
+#include "sync_ops.h"
+#include "database.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+namespace {
+
+const char kBatchMagic[8] = { 'N', 'S', 'F', 'O', 'P', 'S', '0', '1' };
+
+void PutU32(std::vector<unsigned char>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back((unsigned char)(v >> (8 * i)));
+}
+
+void PutString(std::vector<unsigned char>& out, const std::string& s) {
+    PutU32(out, (uint32_t)s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+bool GetU32(const unsigned char*& p, const unsigned char* end, uint32_t& v) {
+    if (end - p < 4) return false;
+    v = 0;
+    for (int i = 0; i < 4; ++i) v |= (uint32_t)p[i] << (8 * i);
+    p += 4;
+    return true;
+}
+
+bool GetString(const unsigned char*& p, const unsigned char* end, std::string& s) {
+    uint32_t length = 0;
+    if (!GetU32(p, end, length) || (size_t)(end - p) < length) return false;
+    s.assign((const char*)p, length);
+    p += length;
+    return true;
+}
+
+// Rows that refer to other synced rows go after them.
+int ApplyRank(const std::string& table) {
+    return (table == "checklist_items" || table == "note_tags") ? 1 : 0;
+}
+
+// Journal position of the last local change pushed.
+long long PushedSeq(Database& db) {
+    return std::strtoll(db.GetSetting("sync_pushed_seq", "0").c_str(), nullptr, 10);
+}
+
+} // namespace
+
+namespace OpSync {
+
+void SerializeBatch(const std::vector<SyncOp>& ops, std::vector<unsigned char>& out) {
+    out.assign(kBatchMagic, kBatchMagic + sizeof(kBatchMagic));
+    PutU32(out, (uint32_t)ops.size());
+    for (const SyncOp& op : ops) {
+        PutString(out, op.table);
+        PutString(out, op.gid);
+        PutString(out, op.origin);
+        PutString(out, op.payload);
+        PutU32(out, (uint32_t)op.hlc);
+        PutU32(out, (uint32_t)(op.hlc >> 32));
+        out.push_back(op.deleted ? 1 : 0);
+    }
+}
+
+bool ParseBatch(const std::vector<unsigned char>& bytes, std::vector<SyncOp>& out) {
+    out.clear();
+    const unsigned char* p = bytes.data();
+    const unsigned char* end = p + bytes.size();
+    uint32_t count = 0;
+    if (bytes.size() < sizeof(kBatchMagic) || memcmp(p, kBatchMagic, sizeof(kBatchMagic)) != 0) {
+        return false;
+    }
+    p += sizeof(kBatchMagic);
+    if (!GetU32(p, end, count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        SyncOp op;
+        uint32_t low = 0;
+        uint32_t high = 0;
+        if (!GetString(p, end, op.table) || !GetString(p, end, op.gid) || !GetString(p, end, op.origin) ||
+            !GetString(p, end, op.payload) || !GetU32(p, end, low) || !GetU32(p, end, high) || p == end) {
+            out.clear();
+            return false;
+        }
+        op.hlc = ((uint64_t)high << 32) | low;
+        op.deleted = (*p++ != 0);
+        out.push_back(std::move(op));
+    }
+    return p == end;
+}
+
+std::string BatchName(const std::string& prefix, const std::string& replica, uint32_t number) {
+    char digits[16];
+    std::snprintf(digits, sizeof(digits), "%08u", number);
+    return prefix + replica + "." + digits;
+}
+
+bool ParseBatchName(const std::string& prefix, const std::string& name, std::string& outReplica, uint32_t& outNumber) {
+    if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos || dot <= prefix.size() || dot + 1 == name.size()) {
+        return false;
+    }
+    char* endPtr = nullptr;
+    unsigned long number = std::strtoul(name.c_str() + dot + 1, &endPtr, 10);
+    if (*endPtr != '\0' || number == 0) {
+        return false;
+    }
+    outReplica = name.substr(prefix.size(), dot - prefix.size());
+    outNumber = (uint32_t)number;
+    return true;
+}
+
+bool Newer(uint64_t hlcA, const std::string& originA, uint64_t hlcB, const std::string& originB) {
+    return hlcA != hlcB ? hlcA > hlcB : originA > originB;
+}
+
+void SortForApply(std::vector<SyncOp>& ops) {
+    std::stable_sort(ops.begin(), ops.end(), [](const SyncOp& a, const SyncOp& b) {
+        int rankA = ApplyRank(a.table);
+        int rankB = ApplyRank(b.table);
+        if (rankA != rankB) return rankA < rankB;
+        return Newer(b.hlc, b.origin, a.hlc, a.origin);
+    });
+}
+
+bool Exchange(Database& db, SyncBackend& backend, const std::string& prefix, OpSyncStats& outStats, std::string& outError) {
+    outStats = OpSyncStats();
+    std::string self = db.GetSyncReplicaId();
+    if (self.empty()) {
+        outError = "Sync journal is not available";
+        return false;
+    }
+
+    std::vector<SyncObjectInfo> objects;
+    if (backend.List(prefix, objects, outError) != SyncStatus::Ok) {
+        return false;
+    }
+
+    // Every replica's batches this database has not applied yet, its own included: a database
+    // restored from another replica's file has not seen the batches pushed here before.
+    struct Pending {
+        std::string replica;
+        uint32_t number;
+        std::string name;
+    };
+    std::map<std::string, uint32_t> latest;
+    std::map<std::string, uint32_t> cursors;
+    std::vector<Pending> pending;
+    for (const SyncObjectInfo& object : objects) {
+        const std::string& name = object.name;
+        std::string replica;
+        uint32_t number = 0;
+        if (!ParseBatchName(prefix, name, replica, number)) {
+            continue;
+        }
+        latest[replica] = std::max(latest[replica], number);
+        auto cursor = cursors.find(replica);
+        if (cursor == cursors.end()) {
+            uint32_t pulled = (uint32_t)std::strtoul(db.GetSetting("sync_pulled." + replica, "0").c_str(), nullptr, 10);
+            cursor = cursors.emplace(replica, pulled).first;
+        }
+        if (number > cursor->second) {
+            pending.push_back({ replica, number, name });
+        }
+    }
+    std::sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) {
+        return a.replica != b.replica ? a.replica < b.replica : a.number < b.number;
+    });
+
+    std::vector<SyncOp> remote;
+    std::map<std::string, uint32_t> pulled;
+    for (const Pending& batch : pending) {
+        std::vector<unsigned char> bytes;
+        std::vector<SyncOp> ops;
+        if (backend.Get(batch.name, bytes, nullptr, outError) != SyncStatus::Ok) {
+            if (outError.empty()) outError = "Sync batch " + batch.name + " disappeared";
+            return false;
+        }
+        if (!ParseBatch(bytes, ops)) {
+            outError = "Damaged sync batch " + batch.name;
+            return false;
+        }
+        remote.insert(remote.end(), std::make_move_iterator(ops.begin()), std::make_move_iterator(ops.end()));
+        pulled[batch.replica] = batch.number;
+    }
+
+    if (!remote.empty()) {
+        SortForApply(remote);
+        if (!db.ApplySyncOps(remote, outStats.opsApplied)) {
+            outError = "Failed to apply remote changes";
+            return false;
+        }
+    }
+    for (const auto& entry : pulled) {
+        db.SetSetting("sync_pulled." + entry.first, std::to_string(entry.second));
+    }
+    outStats.batchesPulled = (int)pending.size();
+
+    // Push what was journaled here since the last push.
+    long long pushedSeq = PushedSeq(db);
+    std::vector<SyncOp> local;
+    long long lastSeq = 0;
+    if (!db.GetPendingSyncOps(pushedSeq, local, lastSeq)) {
+        outError = "Failed to read the sync journal";
+        return false;
+    }
+    if (local.empty()) {
+        return true;
+    }
+
+    // Create-only, so a batch is never replaced. A taken number means another copy of this
+    // database wrote it since the listing; that batch is pulled next time (the cursor stays).
+    uint32_t number = latest[self];
+    std::vector<unsigned char> bytes;
+    SerializeBatch(local, bytes);
+    SyncStatus status = SyncStatus::Conflict;
+    for (int attempt = 0; attempt < 8 && status == SyncStatus::Conflict; ++attempt) {
+        status = backend.Put(BatchName(prefix, self, ++number), bytes, kSyncCreateOnly, nullptr, outError);
+    }
+    if (status != SyncStatus::Ok) {
+        if (status == SyncStatus::Conflict) outError = "Sync batch numbers are taken";
+        return false;
+    }
+    db.SetSetting("sync_pushed_seq", std::to_string(lastSeq));
+    if (number == latest[self] + 1) {
+        db.SetSetting("sync_pulled." + self, std::to_string(number));
+    }
+    db.PruneSyncLog(lastSeq);
+    outStats.opsPushed = (int)local.size();
+    return true;
+}
+
+} // namespace OpSync
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "sync_backend.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Database;
+
+// Row-level operation sync. Triggers journal every insert, update and delete of the synced tables
+// (notes, checklist items, tags, note tags, snippets, user dictionary) into change_log, stamped
+// with a hybrid logical clock (milliseconds << 16 plus a counter, never behind a remote stamp
+// seen) and this replica's id. Rows are known by a global id instead of their local integer key.
+//
+// Each replica appends its journal to the backend as numbered batches ("<prefix><replica>.<n>",
+// written create-only) and applies the batches of every replica it has not seen yet; only that
+// replica ever writes its own names, so batches never conflict. Merging is last-writer-wins per row on (clock, replica), so
+// all replicas converge on the same rows whatever order the batches arrive in.
+struct SyncOp {
+    std::string table;
+    std::string gid;
+    uint64_t hlc = 0;
+    std::string origin;     // Replica id
+    bool deleted = false;
+    std::string payload;    // JSON object of the row's columns; parent keys as the parent's gid
+};
+
+struct OpSyncStats {
+    int opsPushed = 0;
+    int batchesPulled = 0;
+    int opsApplied = 0;     // Remote ops that changed a local row
+};
+
+namespace OpSync {
+
+// Batch layout (little-endian): "NSFOPS01", op count (u32), then per op: table, gid, origin and
+// payload as u32 length + bytes, the clock (u64) and a deleted byte.
+void SerializeBatch(const std::vector<SyncOp>& ops, std::vector<unsigned char>& out);
+bool ParseBatch(const std::vector<unsigned char>& bytes, std::vector<SyncOp>& out);
+
+std::string BatchName(const std::string& prefix, const std::string& replica, uint32_t number);
+bool ParseBatchName(const std::string& prefix, const std::string& name, std::string& outReplica, uint32_t& outNumber);
+
+// True when a should win over b (later clock; the replica id breaks ties).
+bool Newer(uint64_t hlcA, const std::string& originA, uint64_t hlcB, const std::string& originB);
+
+// Order for applying: parents before the rows that refer to them, then by clock.
+void SortForApply(std::vector<SyncOp>& ops);
+
+// Applies the batches not seen yet, then pushes the local journal as a new batch.
+bool Exchange(Database& db, SyncBackend& backend, const std::string& prefix, OpSyncStats& outStats, std::string& outError);
+
+} // namespace OpSync
@@ -0,0 +1,33 @@
+#include "text_edit.h"
+#include <algorithm>
+#include <cwchar>
+
+TextEdit DiffTextEdit(const std::wstring& before, const std::wstring& after) {
+    TextEdit edit;
+    size_t common = std::min(before.size(), after.size());
+
+    // Compare in blocks first so long unchanged prefixes stay a memcmp.
+    const size_t kBlock = 256;
+    size_t prefix = 0;
+    while (prefix + kBlock <= common && wmemcmp(before.data() + prefix, after.data() + prefix, kBlock) == 0) {
+        prefix += kBlock;
+    }
+    while (prefix < common && before[prefix] == after[prefix]) {
+        ++prefix;
+    }
+
+    size_t suffix = 0;
+    size_t maxSuffix = common - prefix;
+    while (suffix + kBlock <= maxSuffix &&
+           wmemcmp(before.data() + before.size() - suffix - kBlock, after.data() + after.size() - suffix - kBlock, kBlock) == 0) {
+        suffix += kBlock;
+    }
+    while (suffix < maxSuffix && before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) {
+        ++suffix;
+    }
+
+    edit.offset = prefix;
+    edit.removed = before.size() - prefix - suffix;
+    edit.inserted = after.size() - prefix - suffix;
+    return edit;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// A single replacement: removed characters at offset were replaced by inserted characters.
+struct TextEdit {
+    size_t offset = 0;
+    size_t removed = 0;
+    size_t inserted = 0;
+
+    bool Empty() const { return removed == 0 && inserted == 0; }
+};
+
+// Returns the smallest single edit turning before into after (common prefix/suffix trimmed).
+// Several keystrokes between two snapshots collapse into one edit spanning all of them.
+TextEdit DiffTextEdit(const std::wstring& before, const std::wstring& after);
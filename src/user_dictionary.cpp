@@ -0,0 +1,93 @@
+#include "user_dictionary.h"
+#include <cwctype>
+
+namespace {
+
+const size_t kMinBits = 1024;
+const size_t kBitsPerWord = 16;   // About 0.05% false positives with kHashes probes
+const unsigned int kHashes = 6;
+
+} // namespace
+
+UserDictionary::UserDictionary() {
+    m_bits.assign(kMinBits / 64, 0);
+    m_bitMask = kMinBits - 1;
+}
+
+uint64_t UserDictionary::Hash(wchar_t first, const wchar_t* rest, size_t restLength) {
+    // FNV-1a over the UTF-16 code units; the first unit is passed apart so case variants of a
+    // word hash without being copied.
+    uint64_t hash = 14695981039346656037ull;
+    hash ^= (uint16_t)first;
+    hash *= 1099511628211ull;
+    for (size_t i = 0; i < restLength; ++i) {
+        hash ^= (uint16_t)rest[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void UserDictionary::SetBits(uint64_t hash) {
+    // Double hashing: probe i is h1 + i * h2.
+    uint32_t h1 = (uint32_t)hash;
+    uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+    for (unsigned int i = 0; i < kHashes; ++i) {
+        size_t bit = (size_t)(h1 + i * h2) & m_bitMask;
+        m_bits[bit >> 6] |= 1ull << (bit & 63);
+    }
+}
+
+bool UserDictionary::TestBits(uint64_t hash) const {
+    uint32_t h1 = (uint32_t)hash;
+    uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+    for (unsigned int i = 0; i < kHashes; ++i) {
+        size_t bit = (size_t)(h1 + i * h2) & m_bitMask;
+        if ((m_bits[bit >> 6] & (1ull << (bit & 63))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool UserDictionary::Add(const std::wstring& word) {
+    if (word.empty() || !m_set.insert(word).second) {
+        return false;
+    }
+    m_words.push_back(word);
+
+    if (m_words.size() * kBitsPerWord > m_bitMask + 1) {
+        // Grow the filter and re-add every word so the false positive rate stays put.
+        size_t bits = m_bitMask + 1;
+        while (bits < m_words.size() * kBitsPerWord) {
+            bits <<= 1;
+        }
+        m_bits.assign(bits / 64, 0);
+        m_bitMask = bits - 1;
+        for (const std::wstring& w : m_words) {
+            SetBits(Hash(w[0], w.data() + 1, w.size() - 1));
+        }
+    } else {
+        SetBits(Hash(word[0], word.data() + 1, word.size() - 1));
+    }
+    return true;
+}
+
+bool UserDictionary::Lookup(wchar_t first, const wchar_t* rest, size_t restLength) const {
+    if (!TestBits(Hash(first, rest, restLength))) {
+        return false;
+    }
+    std::wstring key(1, first);
+    key.append(rest, restLength);
+    return m_set.count(key) != 0;
+}
+
+bool UserDictionary::Contains(const wchar_t* word, size_t length) const {
+    if (length == 0 || m_words.empty()) {
+        return false;
+    }
+    if (Lookup(word[0], word + 1, length - 1)) {
+        return true;
+    }
+    wchar_t lower = (wchar_t)towlower(word[0]);
+    return lower != word[0] && Lookup(lower, word + 1, length - 1);
+}
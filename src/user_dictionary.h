@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Words the user added to the dictionary or chose to ignore. A Bloom filter sits in front of the
+// hash set, so the common lookup (a word that is not a user word) costs a hash and a few bit tests.
+// "Word" also matches a stored "word", as in Hunspell.
+// Never changed once shared between threads: copy it, Add to the copy and publish the copy.
+class UserDictionary {
+public:
+    UserDictionary();
+
+    // False when the word is empty or already present.
+    bool Add(const std::wstring& word);
+    bool Contains(const wchar_t* word, size_t length) const;
+
+    // In the order they were added; a copy extended with Add keeps this as a prefix.
+    const std::vector<std::wstring>& Words() const { return m_words; }
+
+private:
+    static uint64_t Hash(wchar_t first, const wchar_t* rest, size_t restLength);
+    void SetBits(uint64_t hash);
+    bool TestBits(uint64_t hash) const;
+    bool Lookup(wchar_t first, const wchar_t* rest, size_t restLength) const;
+
+    std::vector<uint64_t> m_bits;
+    size_t m_bitMask = 0;
+    std::unordered_set<std::wstring> m_set;
+    std::vector<std::wstring> m_words;
+};
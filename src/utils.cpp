@@ -1,5 +1,7 @@
 #include "utils.h"
 
+#ifdef _WIN32
+
 namespace Utils {
     std::wstring Utf8ToWide(const std::string& str) {
         if (str.empty()) return std::wstring();
@@ -17,3 +19,58 @@ namespace Utils {
         return strTo;
     }
 }
+
+#else
+
+namespace Utils {
+    std::wstring Utf8ToWide(const std::string& str) {
+        std::wstring out;
+        out.reserve(str.size());
+        for (size_t i = 0; i < str.size();) {
+            unsigned char lead = (unsigned char)str[i];
+            size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+            unsigned int c = length == 1 ? lead : length == 2 ? (lead & 0x1F) : length == 3 ? (lead & 0x0F) : (lead & 0x07);
+            bool valid = length != 0 && i + length <= str.size();
+            for (size_t k = 1; valid && k < length; ++k) {
+                unsigned char next = (unsigned char)str[i + k];
+                valid = (next & 0xC0) == 0x80;
+                c = (c << 6) | (next & 0x3F);
+            }
+            // Overlong forms, surrogates and values past U+10FFFF are not characters.
+            static const unsigned int kMin[] = { 0, 0, 0x80, 0x800, 0x10000 };
+            valid = valid && c >= kMin[length] && c <= 0x10FFFF && (c < 0xD800 || c > 0xDFFF);
+            out.push_back(valid ? (wchar_t)c : (wchar_t)0xFFFD);
+            i += valid ? length : 1;
+        }
+        return out;
+    }
+
+    std::string WideToUtf8(const std::wstring& wstr) {
+        std::string out;
+        out.reserve(wstr.size());
+        for (wchar_t wc : wstr) {
+            unsigned int c = (unsigned int)wc;
+            if (c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+                c = 0xFFFD;
+            }
+            if (c < 0x80) {
+                out.push_back((char)c);
+            } else if (c < 0x800) {
+                out.push_back((char)(0xC0 | (c >> 6)));
+                out.push_back((char)(0x80 | (c & 0x3F)));
+            } else if (c < 0x10000) {
+                out.push_back((char)(0xE0 | (c >> 12)));
+                out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+                out.push_back((char)(0x80 | (c & 0x3F)));
+            } else {
+                out.push_back((char)(0xF0 | (c >> 18)));
+                out.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+                out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+                out.push_back((char)(0x80 | (c & 0x3F)));
+            }
+        }
+        return out;
+    }
+}
+
+#endif
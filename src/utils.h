@@ -1,7 +1,11 @@
 #pragma once
 #include <string>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
+// UTF-8 to and from wide strings: UTF-16 on Windows, UTF-32 elsewhere (where the tests run).
+// Invalid input becomes U+FFFD.
 namespace Utils {
     std::wstring Utf8ToWide(const std::string& str);
     std::string WideToUtf8(const std::wstring& wstr);
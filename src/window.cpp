@@ -2,9 +2,17 @@
 #include "window.h"
 #include "utils.h"
 #include "spell_checker.h"
+#include "spell_tokenizer.h"
+#include "language_detector.h"
+#include "markdown.h"
+#include "markdown_chunks.h"
+#include "code_highlight.h"
 #include "settings_dialog.h"
 #include "cloud_sync.h"
 #include "credentials.h"
+#include "html_export.h"
+#include "spell_audit.h"
+#include "heading_outline.h"
 #include "resource.h"
 #include <string>
 #include <algorithm>
@@ -16,6 +24,22 @@
 #include <cstring>
 #include <process.h>
 
+using Markdown::InlineRun;
+using Markdown::TrimLeft;
+using Markdown::TrimRightSpaces;
+using Markdown::TrimSpaces;
+using Markdown::LooksLikeMarkdownTableRow;
+using Markdown::LooksLikeMarkdownTableSeparator;
+using Markdown::SplitMarkdownTableRow;
+using Markdown::HasMarkdownHardBreak;
+using Markdown::IsHorizontalRule;
+using Markdown::ParseAtxHeading;
+using Markdown::EnsureUrlHasScheme;
+using Markdown::ParseInlineMarkdown;
+using Markdown::IsIndentedCodeLine;
+using Markdown::StripCodeIndent;
+using Markdown::ParseMarkdownFence;
+
 static std::string ToLowerAscii(std::string s) {
     std::transform(s.begin(), s.end(), s.begin(), [](unsigned char ch) {
         return (char)std::tolower(ch);
@@ -47,88 +71,33 @@ static LONG GetRichEditTextLength(HWND hwnd) {
     return (LONG)SendMessage(hwnd, EM_GETTEXTLENGTHEX, (WPARAM)&ltx, 0);
 }
 
-static std::wstring TrimLeft(const std::wstring& s) {
-    size_t i = 0;
-    while (i < s.size() && (s[i] == L' ' || s[i] == L'\t')) {
-        ++i;
-    }
-    return s.substr(i);
-}
-
-static std::wstring TrimRightSpaces(const std::wstring& s) {
-    size_t end = s.size();
-    while (end > 0 && (s[end - 1] == L' ' || s[end - 1] == L'\t')) {
-        --end;
-    }
-    return s.substr(0, end);
-}
-
-static std::wstring TrimSpaces(const std::wstring& s) {
-    size_t start = 0;
-    while (start < s.size() && (s[start] == L' ' || s[start] == L'\t')) {
-        ++start;
-    }
-    size_t end = s.size();
-    while (end > start && (s[end - 1] == L' ' || s[end - 1] == L'\t')) {
-        --end;
-    }
-    return s.substr(start, end - start);
-}
-
-static bool LooksLikeMarkdownTableRow(const std::wstring& trimmed) {
-    // Minimal heuristic: must contain at least 2 pipes and some non-pipe content.
-    int pipes = 0;
-    bool hasOther = false;
-    for (wchar_t c : trimmed) {
-        if (c == L'|') pipes++;
-        else if (c != L' ' && c != L'\t') hasOther = true;
-    }
-    return (pipes >= 2 && hasOther);
-}
-
-static bool LooksLikeMarkdownTableSeparator(const std::wstring& trimmed) {
-    // Separator line like: | --- | ---: | :--- |
-    bool sawDash = false;
-    bool sawPipe = false;
-    for (wchar_t c : trimmed) {
-        if (c == L'|') {
-            sawPipe = true;
-            continue;
-        }
-        if (c == L'-') {
-            sawDash = true;
-            continue;
-        }
-        if (c == L':' || c == L' ' || c == L'\t') {
-            continue;
+// Uses EM_GETTEXTLENGTHEX + EM_GETTEXTEX so text positions match RichEdit character positions.
+static std::wstring GetRichEditPlainText(HWND hwnd) {
+    std::wstring text;
+    LONG textLen = GetRichEditTextLength(hwnd);
+    if (textLen > 0) {
+        GETTEXTEX gtx = {};
+        gtx.flags = GT_DEFAULT;
+        gtx.codepage = 1200;
+        gtx.cb = (textLen + 1) * (DWORD)sizeof(wchar_t);
+        text.resize(textLen + 1);
+        int actualLen = (int)SendMessage(hwnd, EM_GETTEXTEX, (WPARAM)&gtx, (LPARAM)&text[0]);
+        if (actualLen > 0) {
+            text.resize(actualLen);
+        } else {
+            text.clear();
         }
-        return false;
     }
-    return sawPipe && sawDash;
+    return text;
 }
 
-static std::vector<std::wstring> SplitMarkdownTableRow(const std::wstring& line) {
-    std::wstring t = TrimSpaces(line);
-    if (!t.empty() && t.front() == L'|') t.erase(t.begin());
-    if (!t.empty() && t.back() == L'|') t.pop_back();
-
-    std::vector<std::wstring> cells;
-    size_t start = 0;
-    while (start <= t.size()) {
-        size_t end = t.find(L'|', start);
-        std::wstring cell = (end == std::wstring::npos) ? t.substr(start) : t.substr(start, end - start);
-        cells.push_back(TrimSpaces(cell));
-        if (end == std::wstring::npos) {
-            break;
-        }
-        start = end + 1;
-    }
-
-    // Drop trailing empty cell caused by a final '|' after trimming.
-    while (!cells.empty() && cells.back().empty()) {
-        cells.pop_back();
-    }
-    return cells;
+// Moves the caret to cp and scrolls its line to the top of the control.
+static void ScrollRichEditToChar(HWND hwnd, LONG cp) {
+    CHARRANGE cr = { cp, cp };
+    SendMessage(hwnd, EM_EXSETSEL, 0, (LPARAM)&cr);
+    LONG line = (LONG)SendMessage(hwnd, EM_EXLINEFROMCHAR, 0, cp);
+    LONG firstVisible = (LONG)SendMessage(hwnd, EM_GETFIRSTVISIBLELINE, 0, 0);
+    SendMessage(hwnd, EM_LINESCROLL, 0, line - firstVisible);
 }
 
 struct RtfStreamCookie {
@@ -152,12 +121,10 @@ static DWORD CALLBACK RichEditStreamInCallback(DWORD_PTR dwCookie, LPBYTE pbBuff
     return 0;
 }
 
-static std::string RtfEscape(const std::wstring& s) {
+static void AppendRtfEscaped(std::string& out, const wchar_t* s, size_t len) {
     // Produce ASCII RTF with \uN? escapes for non-ASCII.
-    std::string out;
-    out.reserve(s.size() * 2);
-
-    for (wchar_t wc : s) {
+    for (size_t i = 0; i < len; ++i) {
+        wchar_t wc = s[i];
         if (wc == L'\\' || wc == L'{' || wc == L'}') {
             out.push_back('\\');
             out.push_back((char)wc);
@@ -168,6 +135,10 @@ static std::string RtfEscape(const std::wstring& s) {
             out += "\\line ";
             continue;
         }
+        if (wc == L'\t') {
+            out += "\\tab ";
+            continue;
+        }
         if (wc >= 0x20 && wc <= 0x7E) {
             out.push_back((char)wc);
             continue;
@@ -179,7 +150,12 @@ static std::string RtfEscape(const std::wstring& s) {
         out += std::to_string((int)u);
         out += "?";
     }
+}
 
+static std::string RtfEscape(const std::wstring& s) {
+    std::string out;
+    out.reserve(s.size() * 2);
+    AppendRtfEscaped(out, s.c_str(), s.size());
     return out;
 }
 
@@ -200,137 +176,6 @@ static void StreamInRtfSelection(HWND hwndRichEdit, const std::string& rtf) {
     SendMessage(hwndRichEdit, EM_STREAMIN, (WPARAM)(SF_RTF | SFF_SELECTION), (LPARAM)&es);
 }
 
-static bool HasMarkdownHardBreak(const std::wstring& line) {
-    // In Markdown, two trailing spaces indicate a hard line break.
-    // Count actual spaces (not tabs).
-    int spaces = 0;
-    for (size_t i = line.size(); i > 0; --i) {
-        wchar_t c = line[i - 1];
-        if (c == L' ') {
-            spaces++;
-        } else if (c == L'\t') {
-            // tabs don't count toward the "two spaces" convention
-            continue;
-        } else {
-            break;
-        }
-        if (spaces >= 2) {
-            return true;
-        }
-    }
-    return false;
-}
-
-static bool IsHorizontalRule(const std::wstring& trimmed) {
-    if (trimmed.size() < 3) return false;
-    wchar_t ch = trimmed[0];
-    if (ch != L'-' && ch != L'*' && ch != L'_') return false;
-    int count = 0;
-    for (wchar_t c : trimmed) {
-        if (c == ch) {
-            count++;
-        } else if (c != L' ' && c != L'\t') {
-            return false;
-        }
-    }
-    return count >= 3;
-}
-
-static std::wstring EnsureUrlHasScheme(const std::wstring& url) {
-    if (url.empty()) {
-        return url;
-    }
-    if (url.find(L"://") != std::wstring::npos) {
-        return url;
-    }
-    // Allow mailto: and other non-:// schemes
-    if (url.find(L":") != std::wstring::npos) {
-        return url;
-    }
-    return L"https://" + url;
-}
-
-struct InlineRun {
-    std::wstring text;
-    bool bold = false;
-    bool italic = false;
-    bool strike = false;
-    bool link = false;
-    std::wstring url;
-};
-
-static std::vector<InlineRun> ParseInlineMarkdown(const std::wstring& text) {
-    std::vector<InlineRun> runs;
-    bool bold = false;
-    bool italic = false;
-    bool strike = false;
-
-    auto flush = [&](std::wstring& buf) {
-        if (!buf.empty()) {
-            InlineRun r;
-            r.text = buf;
-            r.bold = bold;
-            r.italic = italic;
-            r.strike = strike;
-            runs.push_back(std::move(r));
-            buf.clear();
-        }
-    };
-
-    std::wstring buf;
-    for (size_t i = 0; i < text.size();) {
-        // Link: [text](url)
-        if (text[i] == L'[') {
-            size_t closeBracket = text.find(L']', i + 1);
-            if (closeBracket != std::wstring::npos && closeBracket + 1 < text.size() && text[closeBracket + 1] == L'(') {
-                size_t closeParen = text.find(L')', closeBracket + 2);
-                if (closeParen != std::wstring::npos) {
-                    flush(buf);
-                    InlineRun r;
-                    r.text = text.substr(i + 1, closeBracket - (i + 1));
-                    r.bold = bold;
-                    r.italic = italic;
-                    r.strike = strike;
-                    r.link = true;
-                    r.url = text.substr(closeBracket + 2, closeParen - (closeBracket + 2));
-                    runs.push_back(std::move(r));
-                    i = closeParen + 1;
-                    continue;
-                }
-            }
-        }
-
-        // Strike: ~~
-        if (i + 1 < text.size() && text[i] == L'~' && text[i + 1] == L'~') {
-            flush(buf);
-            strike = !strike;
-            i += 2;
-            continue;
-        }
-
-        // Bold: ** or __
-        if (i + 1 < text.size() && ((text[i] == L'*' && text[i + 1] == L'*') || (text[i] == L'_' && text[i + 1] == L'_'))) {
-            flush(buf);
-            bold = !bold;
-            i += 2;
-            continue;
-        }
-
-        // Italic: * or _
-        if (text[i] == L'*' || text[i] == L'_') {
-            flush(buf);
-            italic = !italic;
-            i += 1;
-            continue;
-        }
-
-        buf.push_back(text[i]);
-        i += 1;
-    }
-    flush(buf);
-    return runs;
-}
-
 static void ApplyCharStyle(HWND hwnd, const InlineRun& run, bool enableLinks) {
     CHARFORMAT2 cf = {};
     cf.cbSize = sizeof(cf);
@@ -341,7 +186,7 @@ static void ApplyCharStyle(HWND hwnd, const InlineRun& run, bool enableLinks) {
     if (run.bold) cf.dwEffects |= CFE_BOLD;
     if (run.italic) cf.dwEffects |= CFE_ITALIC;
     if (run.strike) cf.dwEffects |= CFE_STRIKEOUT;
-    if (enableLinks && run.link) {
+    if (enableLinks && (run.link || !run.wikiTarget.empty())) {
         cf.dwEffects |= CFE_UNDERLINE;
         cf.dwEffects |= CFE_LINK;
         cf.crTextColor = RGB(0, 0, 238);
@@ -398,6 +243,78 @@ static void ApplyParaNormal(HWND hwnd) {
     SendMessage(hwnd, EM_SETPARAFORMAT, 0, (LPARAM)&pf);
 }
 
+static void ApplyDefaultCharFormat(HWND hwnd) {
+    // Reset face/size/color to the control default (e.g. after a monospace code block).
+    CHARFORMAT2 cf = {};
+    cf.cbSize = sizeof(cf);
+    SendMessage(hwnd, EM_GETCHARFORMAT, SCF_DEFAULT, (LPARAM)&cf);
+    cf.dwMask = CFM_FACE | CFM_SIZE | CFM_CHARSET | CFM_BOLD | CFM_ITALIC | CFM_STRIKEOUT | CFM_UNDERLINE | CFM_LINK | CFM_COLOR;
+    cf.dwEffects &= ~(CFE_BOLD | CFE_ITALIC | CFE_STRIKEOUT | CFE_UNDERLINE | CFE_LINK | CFE_AUTOCOLOR);
+    cf.crTextColor = RGB(0, 0, 0);
+    SendMessage(hwnd, EM_SETCHARFORMAT, SCF_SELECTION, (LPARAM)&cf);
+}
+
+// Text colors per CodeHighlight::TokenKind, in enum order.
+static const COLORREF kCodeTokenColors[CodeHighlight::kTokenKindCount] = {
+    RGB(0, 0, 0),       // Text
+    RGB(0, 0, 192),     // Keyword
+    RGB(163, 21, 21),   // String
+    RGB(0, 128, 0),     // Comment
+    RGB(9, 134, 88),    // Number
+    RGB(128, 64, 128),  // Preprocessor
+    RGB(0, 112, 160)    // Variable
+};
+
+static std::string BuildCodeBlockRtf(const std::wstring& code, CodeHighlight::Language language, int fontHalfPoints) {
+    std::vector<CodeHighlight::Run> runs;
+    CodeHighlight::Lex(language, code.c_str(), code.size(), runs);
+
+    std::string rtf;
+    rtf.reserve(code.size() + code.size() / 4 + 256);
+    rtf += "{\\rtf1\\ansi\\uc1{\\fonttbl{\\f0\\fmodern Consolas;}}{\\colortbl ;";
+    for (COLORREF c : kCodeTokenColors) {
+        rtf += "\\red" + std::to_string(GetRValue(c));
+        rtf += "\\green" + std::to_string(GetGValue(c));
+        rtf += "\\blue" + std::to_string(GetBValue(c)) + ";";
+    }
+    rtf += "}";
+
+    // One indented paragraph; source lines become \line breaks.
+    rtf += "\\pard\\li360\\f0\\fs" + std::to_string(fontHalfPoints) + " ";
+    for (const auto& run : runs) {
+        rtf += "\\cf";
+        rtf += std::to_string((int)run.kind + 1);
+        rtf += " ";
+        AppendRtfEscaped(rtf, code.c_str() + run.start, run.length);
+    }
+    rtf += "\\par}";
+    return rtf;
+}
+
+static int EstimateVisibleLineCount(HWND hwnd) {
+    RECT rc = {};
+    GetClientRect(hwnd, &rc);
+    int lineHeight = 16;
+    HDC hdc = GetDC(hwnd);
+    if (hdc) {
+        HFONT hFont = (HFONT)SendMessage(hwnd, WM_GETFONT, 0, 0);
+        HFONT oldFont = hFont ? (HFONT)SelectObject(hdc, hFont) : NULL;
+        TEXTMETRIC tm = {};
+        if (GetTextMetrics(hdc, &tm) && tm.tmHeight > 0) {
+            lineHeight = tm.tmHeight;
+        }
+        if (oldFont) {
+            SelectObject(hdc, oldFont);
+        }
+        ReleaseDC(hwnd, hdc);
+    }
+    int height = rc.bottom - rc.top;
+    if (height <= 0) {
+        height = GetSystemMetrics(SM_CYSCREEN);
+    }
+    return height / lineHeight + 1;
+}
+
 static std::wstring FormatFileSize(ULONGLONG bytes) {
     wchar_t buffer[64] = {0};
     const double KB = 1024.0;
@@ -445,35 +362,237 @@ static std::string NowLocalTimeStringA() {
 #define ID_MOVE_UP 10
 #define ID_MOVE_DOWN 11
 #define ID_PREVIEW 13
+#define ID_OUTLINE 14
 #define ID_SPELLCHECK_TIMER 2001
 #define ID_CLOUDSYNC_TIMER 2002
+#define ID_PREVIEW_CHUNK_TIMER 2003
+#define ID_OUTLINE_TIMER 2004
+#define ID_SUGGEST_TIMER 2005
+
+// Notes at least this large (in characters) render their markdown preview in chunks.
+static const size_t kLazyPreviewThresholdChars = 256 * 1024;
+static const size_t kPreviewFirstChunkMaxChars = 16 * 1024;
+static const size_t kPreviewChunkChars = 32 * 1024;
+static const DWORD kPreviewChunkTimeSliceMs = 30;
 
 static const UINT WM_APP_CLOUD_AUTO_SYNC_DONE = WM_APP + 130;
+static const UINT WM_APP_HTML_EXPORT_DONE = WM_APP + 131;
+static const UINT WM_APP_SPELLCHECK_DONE = WM_APP + 132;
+static const UINT WM_APP_SUGGESTIONS_DONE = WM_APP + 133;
+static const UINT WM_APP_SPELL_AUDIT_PROGRESS = WM_APP + 134;
+static const UINT WM_APP_SPELL_AUDIT_DONE = WM_APP + 135;
+static const UINT WM_APP_CLOUD_RESTORE_DONE = WM_APP + 136;
+
+// Misses on screen whose suggestions are computed ahead, and how many are offered.
+static const size_t kMaxPrefetchSuggestionWords = 16;
+static const size_t kMaxSuggestions = 8;
+// Unknown words listed by the spell audit, most frequent first.
+static const size_t kSpellAuditListedWords = 500;
 
 struct CloudAutoSyncThreadParams {
     HWND hwnd;
+    HWND reportTo;   // Settings page whose Sync Now started it, or NULL
     Database* db;
     std::wstring dbPath;
     std::string clientId;
+    std::shared_ptr<std::atomic<bool>> cancel;
 };
 
 struct CloudAutoSyncResultMsg {
+    HWND reportTo = NULL;
     bool success = false;
     std::string error;
     std::string localTime;
+    int changesApplied = 0;   // Rows changed here by other machines' edits
+    Database::ChangeStamp stamp;   // Of the database as the snapshot was taken
 };
 
 static unsigned __stdcall CloudAutoSyncThread(void* p) {
     std::unique_ptr<CloudAutoSyncThreadParams> params((CloudAutoSyncThreadParams*)p);
     std::unique_ptr<CloudAutoSyncResultMsg> res(new CloudAutoSyncResultMsg());
 
-    CloudSyncResult r = CloudSync::UploadDatabaseSnapshot(params->db, params->dbPath, params->clientId);
+    // Merge other machines' row changes first, so the snapshot includes them.
+    CloudSyncResult ops = CloudSync::ExchangeChanges(params->dbPath, params->clientId, res->changesApplied);
+    res->stamp = params->db->GetChangeStamp();
+    res->reportTo = params->reportTo;
+
+    // Progress for the settings page, one message per percent.
+    HWND reportTo = params->reportTo;
+    int lastPercent = -1;
+    int lastSnapshotPercent = -1;
+    SyncProgress uploadProgress;
+    Database::BackupProgress snapshotProgress;
+    if (reportTo) {
+        uploadProgress = [reportTo, &lastPercent](unsigned long long sent, unsigned long long total) {
+            int percent = total ? (int)(sent * 100 / total) : 100;
+            if (percent != lastPercent && IsWindow(reportTo)) {
+                lastPercent = percent;
+                PostMessage(reportTo, WM_APP_CLOUD_SYNC_PROGRESS, (WPARAM)percent, 0);
+            }
+        };
+        snapshotProgress = [reportTo, &lastSnapshotPercent](int copied, int total) {
+            int percent = total ? (int)((long long)copied * 100 / total) : 100;
+            if (percent != lastSnapshotPercent && IsWindow(reportTo)) {
+                lastSnapshotPercent = percent;
+                PostMessage(reportTo, WM_APP_CLOUD_SYNC_PROGRESS, (WPARAM)percent, 1);
+            }
+        };
+    }
+    CloudSyncResult r = CloudSync::UploadDatabaseSnapshot(params->db, params->dbPath, params->clientId,
+                                                          uploadProgress, params->cancel.get(), snapshotProgress);
+    res->success = r.success && ops.success;
+    res->error = !ops.success ? ops.error : r.error;
+    res->localTime = NowLocalTimeStringA();
+
+    if (IsWindow(params->hwnd) && PostMessage(params->hwnd, WM_APP_CLOUD_AUTO_SYNC_DONE, 0, (LPARAM)res.get())) {
+        res.release();
+    }
+    return 0;
+}
+
+struct CloudRestoreThreadParams {
+    HWND hwnd;
+    std::wstring dbPath;
+    std::string backendSpec;
+    std::string clientId;
+};
+
+struct CloudRestoreResultMsg {
+    bool success = false;
+    bool restored = false;
+    std::string error;
+    std::string localTime;
+};
+
+static unsigned __stdcall CloudRestoreThread(void* p) {
+    std::unique_ptr<CloudRestoreThreadParams> params((CloudRestoreThreadParams*)p);
+    std::unique_ptr<CloudRestoreResultMsg> res(new CloudRestoreResultMsg());
+
+    // Merges on a connection of its own in one transaction; the window keeps using m_db meanwhile.
+    CloudSyncResult r = CloudSync::RestoreDatabaseIfRemoteNewer(params->dbPath, params->backendSpec,
+                                                                params->clientId, res->restored);
     res->success = r.success;
     res->error = r.error;
     res->localTime = NowLocalTimeStringA();
 
-    if (IsWindow(params->hwnd)) {
-        PostMessage(params->hwnd, WM_APP_CLOUD_AUTO_SYNC_DONE, 0, (LPARAM)res.release());
+    if (IsWindow(params->hwnd) && PostMessage(params->hwnd, WM_APP_CLOUD_RESTORE_DONE, 0, (LPARAM)res.get())) {
+        res.release();
+    }
+    return 0;
+}
+
+struct SpellAuditThreadParams {
+    HWND hwnd;
+    std::wstring dbPath;
+    SpellDictionaries dictionaries;   // Copy; workers only create checkers of their own from it
+    std::string defaultLocale;
+    std::shared_ptr<std::atomic<bool>> cancel;
+};
+
+static unsigned __stdcall SpellAuditThread(void* p) {
+    std::unique_ptr<SpellAuditThreadParams> params((SpellAuditThreadParams*)p);
+    // Reads on a connection of its own; the window keeps writing through m_db meanwhile.
+    std::vector<Note> notes;
+    Database db;
+    if (db.InitializeReadOnly(Utils::WideToUtf8(params->dbPath))) {
+        notes = db.GetAllNotes(true);
+    }
+    db.Close();
+
+    const SpellDictionaries& dictionaries = params->dictionaries;
+    const std::string& defaultLocale = params->defaultLocale;
+    SpellAudit::CheckerFactory makeChecker = [&](const std::string& locale) {
+        return dictionaries.Create(dictionaries.HasLocale(locale) ? locale : defaultLocale);
+    };
+    HWND hwnd = params->hwnd;
+    auto postReport = [hwnd](UINT msg, const SpellAuditReport& report) {
+        std::unique_ptr<SpellAuditReport> copy(new SpellAuditReport(report));
+        if (IsWindow(hwnd) && PostMessage(hwnd, msg, 0, (LPARAM)copy.get())) {
+            copy.release();
+        }
+    };
+
+    SpellAuditReport report = SpellAudit::Run(notes, makeChecker, kSpellAuditListedWords, params->cancel.get(),
+        [&](const SpellAuditReport& partial) { postReport(WM_APP_SPELL_AUDIT_PROGRESS, partial); });
+    postReport(WM_APP_SPELL_AUDIT_DONE, report);
+    return 0;
+}
+
+struct HtmlExportThreadParams {
+    HWND hwnd;
+    std::vector<Note> notes;
+    std::wstring directory;
+    std::wstring indexFileName;
+    std::wstring indexTitle;
+};
+
+static unsigned __stdcall HtmlExportThread(void* p) {
+    std::unique_ptr<HtmlExportThreadParams> params((HtmlExportThreadParams*)p);
+    std::unique_ptr<HtmlExportResult> res(new HtmlExportResult(
+        HtmlExport::ExportNotesToDirectory(params->notes, params->directory, params->indexFileName, params->indexTitle)));
+
+    if (IsWindow(params->hwnd) && PostMessage(params->hwnd, WM_APP_HTML_EXPORT_DONE, 0, (LPARAM)res.get())) {
+        res.release();
+    }
+    return 0;
+}
+
+// One background spell check over a snapshot of the editor text. The worker fills found (one
+// entry per checked span) and posts the job back; the UI thread owns it again from then on.
+struct SpellCheckJob {
+    HWND hwnd = NULL;
+    std::shared_ptr<SpellChecker> checker;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    unsigned int version = 0;   // m_spellDocVersion the snapshot was taken at
+    std::shared_ptr<const UserDictionary> userWords;   // User words published at launch
+    std::wstring text;
+    std::vector<SpellCheckRanges::Span> spans;
+    std::vector<std::vector<SpellChecker::Range>> found;
+    bool cancelled = false;
+};
+
+static unsigned __stdcall SpellCheckThread(void* p) {
+    std::unique_ptr<SpellCheckJob> job((SpellCheckJob*)p);
+
+    job->found.reserve(job->spans.size());
+    SpellFenceState fences;   // Spans are ascending: the text is scanned for fences once
+    for (const auto& span : job->spans) {
+        job->found.push_back(job->checker->FindMisspellings(job->text, span.first, span.second, job->cancel.get(), &fences));
+        if (job->cancel->load()) {
+            job->cancelled = true;
+            break;
+        }
+    }
+
+    if (IsWindow(job->hwnd) && PostMessage(job->hwnd, WM_APP_SPELLCHECK_DONE, 0, (LPARAM)job.get())) {
+        job.release();
+    }
+    return 0;
+}
+
+// Suggestions for misspelled words, computed ahead of a context menu. Shares the spell check
+// worker slot (and its cancel flag), so only one thread ever uses the checker.
+struct SuggestionJob {
+    HWND hwnd = NULL;
+    std::shared_ptr<SpellChecker> checker;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    std::vector<std::wstring> words;
+    std::vector<std::vector<std::wstring>> suggestions;   // One entry per finished word
+};
+
+static unsigned __stdcall SuggestionThread(void* p) {
+    std::unique_ptr<SuggestionJob> job((SuggestionJob*)p);
+
+    job->suggestions.reserve(job->words.size());
+    for (const std::wstring& word : job->words) {
+        if (job->cancel->load()) {
+            break;
+        }
+        job->suggestions.push_back(job->checker->Suggest(word, kMaxSuggestions));
+    }
+
+    if (IsWindow(job->hwnd) && PostMessage(job->hwnd, WM_APP_SUGGESTIONS_DONE, 0, (LPARAM)job.get())) {
+        job.release();
     }
     return 0;
 }
@@ -493,10 +612,15 @@ static unsigned __stdcall CloudAutoSyncThread(void* p) {
 #define IDM_FORMAT_BOLD 401
 #define IDM_FORMAT_ITALIC 402
 #define IDM_FORMAT_UNDERLINE 403
-#define IDM_EXPORT_TXT 501
+#define IDM_EXPORT_NOTE 501
 #define IDM_PRINT 503
+#define IDM_EXPORT_ALL_HTML 504
+#define IDM_EXPORT_LISTED_HTML 505
+#define IDM_SPELL_AUDIT 506
 #define IDM_HIST_BACK 601
 #define IDM_HIST_FORWARD 602
+#define IDM_BACKLINK_BASE 700
+#define IDM_BACKLINK_MAX 100
 #define IDM_SEARCH_MODE_TOGGLE 502
 
 WNDPROC g_oldEditProc = NULL;
@@ -732,6 +856,7 @@ MainWindow::MainWindow(Database* db) : m_hwnd(NULL), m_hwndList(NULL), m_hwndEdi
 MainWindow::~MainWindow() {
     if (m_hFont) DeleteObject(m_hFont);
     if (m_hEditorFont) DeleteObject(m_hEditorFont);
+    if (m_spellPen) DeleteObject(m_spellPen);
     if (m_hMarkdownToolbarImages) {
         ImageList_Destroy(m_hMarkdownToolbarImages);
         m_hMarkdownToolbarImages = NULL;
@@ -809,19 +934,86 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
         {
             std::unique_ptr<CloudAutoSyncResultMsg> res((CloudAutoSyncResultMsg*)lParam);
             m_cloudSyncInProgress = false;
+            m_cloudSyncCancel.reset();
 
+            // Show other machines' edits.
+            if (m_db && res && res->changesApplied > 0) {
+                ReloadNotesKeepingEdits();
+            }
             if (m_db && res) {
                 if (res->success) {
+                    // Unless something was written since the snapshot, the writes here are all
+                    // that differ from what went up: the timer can skip until the next edit.
+                    const bool caughtUp = m_db->GetChangeStamp() == res->stamp;
                     m_db->SetSetting("cloud_last_sync_time", res->localTime);
                     m_db->SetSetting("cloud_sync_last_error", "");
+                    if (caughtUp) {
+                        m_cloudSyncedStamp = m_db->GetChangeStamp();
+                    }
                 } else {
                     if (!res->error.empty()) {
                         m_db->SetSetting("cloud_sync_last_error", res->error);
                     }
                 }
             }
+            if (res && res->reportTo && IsWindow(res->reportTo)) {
+                std::unique_ptr<CloudSyncResultMsg> report(new CloudSyncResultMsg());
+                report->success = res->success;
+                report->error = res->error;
+                report->localTime = res->localTime;
+                if (PostMessage(res->reportTo, WM_APP_CLOUD_SYNC_DONE, 0, (LPARAM)report.get())) {
+                    report.release();
+                }
+            }
+        }
+        return 0;
+    case WM_APP_CLOUD_SYNC_NOW:
+        return StartCloudSync((HWND)wParam) ? 1 : 0;
+    case WM_APP_CLOUD_RESTORE_DONE:
+        {
+            std::unique_ptr<CloudRestoreResultMsg> res((CloudRestoreResultMsg*)lParam);
+            m_cloudSyncInProgress = false;
+            if (!m_db || !res) {
+                return 0;
+            }
+            if (!res->success && !res->error.empty()) {
+                m_db->SetSetting("cloud_sync_last_error", res->error);
+            } else if (res->restored) {
+                m_db->SetSetting("cloud_sync_last_error", "");
+                m_db->SetSetting("cloud_last_restore_time", res->localTime);
+                ReloadNotesKeepingEdits();
+            }
+        }
+        return 0;
+    case WM_APP_HTML_EXPORT_DONE:
+        {
+            std::unique_ptr<HtmlExportResult> res((HtmlExportResult*)lParam);
+            m_htmlExportInProgress = false;
+            if (!res) {
+                return 0;
+            }
+
+            std::wstring msg = L"Exported " + std::to_wstring(res->exported) + L" note(s) to HTML.";
+            if (res->failed > 0) {
+                msg += L"\n" + std::to_wstring(res->failed) + L" note(s) could not be exported.";
+            }
+            if (!res->error.empty()) {
+                msg += L"\n\n" + Utils::Utf8ToWide(res->error);
+            }
+            SendMessage(m_hwndStatus, SB_SETTEXT, 0, (LPARAM)L"HTML export finished");
+            MessageBox(m_hwnd, msg.c_str(), L"Export", MB_OK | (res->success ? MB_ICONINFORMATION : MB_ICONWARNING));
         }
         return 0;
+    case WM_APP_SPELLCHECK_DONE:
+        OnSpellCheckDone((SpellCheckJob*)lParam);
+        return 0;
+    case WM_APP_SUGGESTIONS_DONE:
+        OnSuggestionsDone((SuggestionJob*)lParam);
+        return 0;
+    case WM_APP_SPELL_AUDIT_PROGRESS:
+    case WM_APP_SPELL_AUDIT_DONE:
+        OnSpellAuditReport((SpellAuditReport*)lParam, uMsg == WM_APP_SPELL_AUDIT_DONE);
+        return 0;
     case WM_CLOSE:
         SaveCurrentNote();
         KillTimer(m_hwnd, ID_CLOUDSYNC_TIMER);
@@ -832,7 +1024,25 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
         SaveCurrentNote();
         UnregisterHotkeys();
         KillTimer(m_hwnd, ID_SPELLCHECK_TIMER);
+        KillTimer(m_hwnd, ID_SUGGEST_TIMER);
+        if (m_spellCheckCancel) {
+            m_spellCheckCancel->store(true);
+        }
+        if (m_spellAuditCancel) {
+            m_spellAuditCancel->store(true);
+        }
+        if (m_spellAuditThread) {
+            // The audit checks the flag between notes; let it finish before the process exits.
+            WaitForSingleObject(m_spellAuditThread, INFINITE);
+            CloseHandle(m_spellAuditThread);
+            m_spellAuditThread = NULL;
+        }
+        if (m_cloudSyncCancel) {
+            m_cloudSyncCancel->store(true);
+        }
         KillTimer(m_hwnd, ID_CLOUDSYNC_TIMER);
+        KillTimer(m_hwnd, ID_OUTLINE_TIMER);
+        CancelMarkdownPreviewChunks();
         PostQuitMessage(0);
         return 0;
     case WM_LBUTTONDOWN:
@@ -911,12 +1121,21 @@ void MainWindow::SyncDatabaseOnExitIfEnabled() {
     if (m_db->GetSetting("cloud_sync_on_exit", "1") != "1") {
         return;
     }
+    if (m_db->GetChangeStamp() == m_cloudSyncedStamp) {
+        return;
+    }
     const std::string clientId = m_db->GetSetting("cloud_oauth_client_id", "");
-    if (clientId.empty()) {
+    if (clientId.empty() && CloudSync::UsesGoogleAccount(m_db->GetSetting(CloudSync::kCloudBackendSetting, ""))) {
         return;
     }
 
+    int changesApplied = 0;
+    CloudSyncResult ops = CloudSync::ExchangeChanges(m_dbPath, clientId, changesApplied);
     CloudSyncResult r = CloudSync::UploadDatabaseSnapshot(m_db, m_dbPath, clientId);
+    if (!ops.success) {
+        r.success = false;
+        r.error = ops.error;
+    }
     if (r.success) {
         m_db->SetSetting("cloud_last_sync_time", NowLocalTimeStringA());
         m_db->SetSetting("cloud_sync_last_error", "");
@@ -985,6 +1204,13 @@ void MainWindow::OnCreate() {
     SendMessage(m_hwndPreview, EM_SETEVENTMASK, 0, clickableLinks ? ENM_LINK : 0);
     SetWindowSubclass(m_hwndPreview, PreviewSubclassProc, 2, (DWORD_PTR)this);
 
+    // Create Outline Panel (right of the editor/preview, shown when toggled)
+    m_hwndOutline = CreateWindowEx(WS_EX_CLIENTEDGE, L"LISTBOX", L"",
+        WS_CHILD | WS_VSCROLL | LBS_NOTIFY | LBS_NOINTEGRALHEIGHT,
+        0, 0, 0, 0, m_hwnd, (HMENU)ID_OUTLINE, GetModuleHandle(NULL), NULL);
+    SendMessage(m_hwndOutline, WM_SETFONT, (WPARAM)m_hFont, TRUE);
+    m_outlineVisible = (m_db && m_db->GetSetting("outline_visible", "0") == "1");
+
     // Create Toolbar (Top)
     m_hwndToolbar = CreateWindowEx(0, TOOLBARCLASSNAME, NULL, WS_CHILD | WS_VISIBLE | TBSTYLE_FLAT | TBSTYLE_TOOLTIPS | TBSTYLE_LIST | CCS_NODIVIDER, 0, 0, 0, 0, m_hwnd, (HMENU)ID_TOOLBAR, GetModuleHandle(NULL), NULL);
     SendMessage(m_hwndToolbar, TB_BUTTONSTRUCTSIZE, (WPARAM)sizeof(TBBUTTON), 0);
@@ -1261,8 +1487,9 @@ void MainWindow::OnCreate() {
     int iMPara = (int)SendMessage(m_hwndMarkdownToolbar, TB_ADDSTRING, 0, (LPARAM)L"Header\0");
     int iMLine = (int)SendMessage(m_hwndMarkdownToolbar, TB_ADDSTRING, 0, (LPARAM)L"Line\0");
     int iMTagButton = (int)SendMessage(m_hwndMarkdownToolbar, TB_ADDSTRING, 0, (LPARAM)L"<None>\0");
+    int iMOutline = (int)SendMessage(m_hwndMarkdownToolbar, TB_ADDSTRING, 0, (LPARAM)L"Outline\0");
 
-    TBBUTTON mtbb[20];
+    TBBUTTON mtbb[24];
     ZeroMemory(mtbb, sizeof(mtbb));
 
     int i = 0;
@@ -1291,6 +1518,7 @@ void MainWindow::OnCreate() {
     mtbb[i].fsStyle = BTNS_SEP; i++;
 
     mtbb[i].iBitmap = imgView; mtbb[i].idCommand = IDM_MARKDOWN_PREVIEW; mtbb[i].fsState = TBSTATE_ENABLED; mtbb[i].fsStyle = BTNS_BUTTON | BTNS_AUTOSIZE; mtbb[i].iString = -1; i++;
+    mtbb[i].iBitmap = I_IMAGENONE; mtbb[i].idCommand = IDM_MARKDOWN_OUTLINE; mtbb[i].fsState = TBSTATE_ENABLED | (m_outlineVisible ? TBSTATE_CHECKED : 0); mtbb[i].fsStyle = BTNS_CHECK | BTNS_AUTOSIZE | BTNS_SHOWTEXT; mtbb[i].iString = iMOutline; i++;
     
     mtbb[i].fsStyle = BTNS_SEP; i++;
 
@@ -1351,11 +1579,20 @@ void MainWindow::OnCreate() {
     if (slash != std::wstring::npos) {
         exeDir = exeDir.substr(0, slash);
     }
-    std::wstring dictDir = exeDir + L"\\dict\\";
-    std::wstring affPath = dictDir + L"en_US.aff";
-    std::wstring dicPath = dictDir + L"en_US.dic";
-    m_spellChecker = std::make_unique<SpellChecker>();
-    m_spellChecker->Initialize(affPath, dicPath);
+    m_spellDictionaries.Discover(exeDir + L"\\dict\\");
+    if (m_db) {
+        auto userWords = std::make_shared<UserDictionary>();
+        for (const std::string& word : m_db->GetUserDictionaryWords()) {
+            userWords->Add(Utils::Utf8ToWide(word));
+        }
+        m_userWords = userWords;
+        m_spellDictionaries.SetUserDictionary(m_userWords);
+    }
+    m_defaultSpellLocale = m_db ? m_db->GetSetting("spell_locale", "en_US") : "en_US";
+    if (!m_spellDictionaries.HasLocale(m_defaultSpellLocale) && !m_spellDictionaries.Locales().empty()) {
+        m_defaultSpellLocale = m_spellDictionaries.HasLocale("en_US") ? "en_US" : m_spellDictionaries.Locales().front();
+    }
+    SelectSpellLocale(m_defaultSpellLocale);
 
     // Apply user-selected font for editor + checklist.
     ApplyEditorFontFromSettings();
@@ -1409,6 +1646,7 @@ void MainWindow::ApplyEditorFontFromSettings() {
         DeleteObject(m_hEditorFont);
     }
     m_hEditorFont = hNew;
+    m_spellMetricsFont = NULL;  // The new font may reuse the old handle value
 
     // Apply to the main editor.
     if (m_hwndEdit) {
@@ -1496,7 +1734,12 @@ void MainWindow::OnSize(int width, int height) {
         MoveWindow(m_hwndChecklistList, rightPaneX, checklistTop, rightPaneWidth, checklistHeight, TRUE);
         
         ShowWindow(m_hwndMarkdownToolbar, SW_HIDE);
+        ShowWindow(m_hwndOutline, SW_HIDE);
     } else {
+        // The outline panel takes a strip on the right of the editor/preview.
+        int outlineWidth = m_outlineVisible ? std::min(220, rightPaneWidth / 3) : 0;
+        int textWidth = rightPaneWidth - outlineWidth;
+
         // Size to fit the markdown toolbar's button height (prevents icon clipping).
         int markdownToolbarHeight = toolbarHeight;
         if (m_hwndMarkdownToolbar) {
@@ -1512,7 +1755,8 @@ void MainWindow::OnSize(int width, int height) {
             ShowWindow(m_hwndEdit, SW_HIDE);
             ShowWindow(m_hwndPreview, SW_SHOW);
 
-            MoveWindow(m_hwndPreview, rightPaneX, toolbarHeight, rightPaneWidth, clientHeight, TRUE);
+            MoveWindow(m_hwndPreview, rightPaneX, toolbarHeight, textWidth, clientHeight, TRUE);
+            MoveWindow(m_hwndOutline, rightPaneX + textWidth, toolbarHeight, outlineWidth, clientHeight, TRUE);
         } else {
             ShowWindow(m_hwndMarkdownToolbar, SW_SHOW);
             ShowWindow(m_hwndEdit, SW_SHOW);
@@ -1520,8 +1764,10 @@ void MainWindow::OnSize(int width, int height) {
 
             SendMessage(m_hwndMarkdownToolbar, TB_AUTOSIZE, 0, 0);
             MoveWindow(m_hwndMarkdownToolbar, rightPaneX, toolbarHeight, rightPaneWidth, markdownToolbarHeight, TRUE);
-            MoveWindow(m_hwndEdit, rightPaneX, toolbarHeight + markdownToolbarHeight, rightPaneWidth, clientHeight - markdownToolbarHeight, TRUE);
+            MoveWindow(m_hwndEdit, rightPaneX, toolbarHeight + markdownToolbarHeight, textWidth, clientHeight - markdownToolbarHeight, TRUE);
+            MoveWindow(m_hwndOutline, rightPaneX + textWidth, toolbarHeight + markdownToolbarHeight, outlineWidth, clientHeight - markdownToolbarHeight, TRUE);
         }
+        ShowWindow(m_hwndOutline, m_outlineVisible ? SW_SHOW : SW_HIDE);
 
         // Add small horizontal padding to the RichEdit content area
         HDC hdc = GetDC(m_hwnd);
@@ -1584,6 +1830,39 @@ void MainWindow::SetDatabasePath(const std::wstring& path) {
     ConfigureCloudSyncTimer();
 }
 
+void MainWindow::StartCloudRestore() {
+    if (m_cloudSyncInProgress) {
+        return;
+    }
+    if (!m_db || m_dbPath.empty()) {
+        return;
+    }
+    if (m_db->GetSetting("cloud_sync_enabled", "0") != "1") {
+        return;
+    }
+    const std::string clientId = m_db->GetSetting("cloud_oauth_client_id", "");
+    const std::string backendSpec = m_db->GetSetting(CloudSync::kCloudBackendSetting, "");
+    if (clientId.empty() && CloudSync::UsesGoogleAccount(backendSpec)) {
+        return;
+    }
+
+    // Holds off auto and exit syncs until the merge is in, so they upload the merged database.
+    m_cloudSyncInProgress = true;
+    auto* params = new CloudRestoreThreadParams();
+    params->hwnd = m_hwnd;
+    params->dbPath = m_dbPath;
+    params->backendSpec = backendSpec;
+    params->clientId = clientId;
+
+    uintptr_t th = _beginthreadex(nullptr, 0, CloudRestoreThread, params, 0, nullptr);
+    if (th == 0) {
+        delete params;
+        m_cloudSyncInProgress = false;
+        return;
+    }
+    CloseHandle((HANDLE)th);
+}
+
 void MainWindow::OnCommand(WPARAM wParam, LPARAM lParam) {
     switch (LOWORD(wParam)) {
     case IDM_NEW:
@@ -1592,6 +1871,18 @@ void MainWindow::OnCommand(WPARAM wParam, LPARAM lParam) {
     case IDM_SAVE:
         SaveCurrentNote();
         break;
+    case IDM_EXPORT_NOTE:
+        ExportCurrentNote();
+        break;
+    case IDM_EXPORT_ALL_HTML:
+        ExportNotesAsHtml(false);
+        break;
+    case IDM_EXPORT_LISTED_HTML:
+        ExportNotesAsHtml(true);
+        break;
+    case IDM_SPELL_AUDIT:
+        StartSpellAudit();
+        break;
     case IDM_PRINT:
         PrintCurrentNote();
         break;
@@ -1748,6 +2039,16 @@ void MainWindow::OnCommand(WPARAM wParam, LPARAM lParam) {
     case IDM_MARKDOWN_PREVIEW:
         ToggleMarkdownPreview();
         break;
+    case IDM_MARKDOWN_OUTLINE:
+        ToggleOutline();
+        break;
+    case ID_OUTLINE:
+        if (HIWORD(wParam) == LBN_SELCHANGE) {
+            JumpToOutlineHeading((int)SendMessage(m_hwndOutline, LB_GETCURSEL, 0, 0));
+        } else if (HIWORD(wParam) == LBN_DBLCLK && !m_markdownPreviewMode) {
+            SetFocus(m_hwndEdit);
+        }
+        break;
     case IDM_MARKDOWN_SUBSCRIPT:
     case IDM_MARKDOWN_SUPERSCRIPT:
         // No-op for now
@@ -1820,7 +2121,13 @@ void MainWindow::OnCommand(WPARAM wParam, LPARAM lParam) {
             // Debug: Show that EN_CHANGE fired
             SendMessage(m_hwndStatus, SB_SETTEXT, 0, (LPARAM)L"EN_CHANGE: m_isDirty set to true");
             UpdateWindowTitle();
+            // Any spell check still running is for text that no longer exists.
+            ++m_spellDocVersion;
+            if (m_spellCheckCancel) {
+                m_spellCheckCancel->store(true);
+            }
             ScheduleSpellCheck();
+            ScheduleOutlineUpdate();
         }
         break;
     case ID_SEARCH:
@@ -1892,6 +2199,15 @@ void MainWindow::OnCommand(WPARAM wParam, LPARAM lParam) {
         SetCurrentNoteColor(LOWORD(wParam) - IDM_COLOR_BASE);
     }
 
+    // Handle Backlink Commands
+    if (LOWORD(wParam) >= IDM_BACKLINK_BASE && LOWORD(wParam) < IDM_BACKLINK_BASE + IDM_BACKLINK_MAX) {
+        size_t index = LOWORD(wParam) - IDM_BACKLINK_BASE;
+        if (index < m_backlinkMenuNoteIds.size()) {
+            NavigateToNote(m_backlinkMenuNoteIds[index]);
+        }
+        return;
+    }
+
     // Handle Tag Filter Commands
     if (LOWORD(wParam) >= IDM_TAG_MENU_BASE && LOWORD(wParam) < IDM_TAG_MENU_BASE + 1000) {
         int tagId = LOWORD(wParam) - IDM_TAG_MENU_BASE;
@@ -2006,6 +2322,9 @@ LRESULT MainWindow::OnNotify(WPARAM wParam, LPARAM lParam) {
             ScheduleSpellCheck();
             m_spellCheckDeferred = false;
         }
+        if (m_outlineVisible) {
+            SendMessage(m_hwndOutline, LB_SETCURSEL, (WPARAM)m_outline.FindHeadingAt((size_t)sc->chrg.cpMin), 0);
+        }
         return 0;
     }
     
@@ -2050,6 +2369,7 @@ LRESULT MainWindow::OnNotify(WPARAM wParam, LPARAM lParam) {
             case IDM_MARKDOWN_SUPERSCRIPT: wcscpy_s(pInfo->szText, L"Superscript"); break;
             case IDM_MARKDOWN_TABLE: wcscpy_s(pInfo->szText, L"Insert Table"); break;
             case IDM_MARKDOWN_PREVIEW: wcscpy_s(pInfo->szText, L"View"); break;
+            case IDM_MARKDOWN_OUTLINE: wcscpy_s(pInfo->szText, L"Show Heading Outline"); break;
             case IDM_MARKDOWN_UNDO: wcscpy_s(pInfo->szText, L"Undo"); break;
             case IDM_MARKDOWN_REDO: wcscpy_s(pInfo->szText, L"Redo"); break;
         }
@@ -2230,6 +2550,32 @@ LRESULT MainWindow::OnNotify(WPARAM wParam, LPARAM lParam) {
                      AppendMenu(hColorMenu, MF_STRING, IDM_COLOR_BASE + color.id, wName.c_str());
                  }
                  AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hColorMenu, L"Color");
+
+                 // Backlinks Submenu: notes whose [[links]] point at this note
+                 HMENU hBacklinkMenu = CreatePopupMenu();
+                 m_backlinkMenuNoteIds.clear();
+                 if (pnmitem->iItem < (int)m_filteredIndices.size()) {
+                     int realIndex = m_filteredIndices[pnmitem->iItem];
+                     if (realIndex >= 0 && realIndex < (int)m_notes.size()) {
+                         std::vector<Database::NoteLinkRef> backlinks = m_db->GetBacklinks(m_notes[realIndex].id);
+                         for (const auto& ref : backlinks) {
+                             if ((int)m_backlinkMenuNoteIds.size() >= IDM_BACKLINK_MAX) break;
+                             AppendMenu(hBacklinkMenu, MF_STRING, IDM_BACKLINK_BASE + m_backlinkMenuNoteIds.size(), Utils::Utf8ToWide(ref.title).c_str());
+                             m_backlinkMenuNoteIds.push_back(ref.noteId);
+                         }
+                     }
+                 }
+                 if (m_backlinkMenuNoteIds.empty()) {
+                     AppendMenu(hBacklinkMenu, MF_STRING | MF_GRAYED, 0, L"(No backlinks)");
+                 }
+                 AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hBacklinkMenu, L"Backlinks");
+                 AppendMenu(hMenu, MF_SEPARATOR, 0, NULL);
+                 AppendMenu(hMenu, MF_STRING, IDM_EXPORT_NOTE, L"Export Note...");
+                 UINT bulkFlags = MF_STRING | (m_htmlExportInProgress ? MF_GRAYED : 0);
+                 AppendMenu(hMenu, bulkFlags, IDM_EXPORT_LISTED_HTML, L"Export Listed Notes as HTML...");
+                 AppendMenu(hMenu, bulkFlags, IDM_EXPORT_ALL_HTML, L"Export All Notes as HTML...");
+                 AppendMenu(hMenu, MF_SEPARATOR, 0, NULL);
+                 AppendMenu(hMenu, MF_STRING | (m_spellAuditInProgress ? MF_GRAYED : 0), IDM_SPELL_AUDIT, L"Spell Audit of All Notes...");
                  
                  POINT pt;
                  GetCursorPos(&pt);
@@ -2250,6 +2596,17 @@ LRESULT MainWindow::OnNotify(WPARAM wParam, LPARAM lParam) {
             if (src == m_hwndPreview) {
                 for (const auto& link : m_previewLinks) {
                     if (pLink->chrg.cpMin >= link.range.cpMin && pLink->chrg.cpMax <= link.range.cpMax) {
+                        if (!link.noteTitle.empty()) {
+                            // [[Title]] note link: resolve through the title index and open the note.
+                            int noteId = m_db->FindNoteIdByTitle(Utils::WideToUtf8(link.noteTitle));
+                            if (noteId == -1) {
+                                std::wstring msg = L"No note titled \"" + link.noteTitle + L"\"";
+                                SendMessage(m_hwndStatus, SB_SETTEXT, 0, (LPARAM)msg.c_str());
+                            } else {
+                                NavigateToNote(noteId);
+                            }
+                            return 0;
+                        }
                         targetUrl = link.url;
                         break;
                     }
@@ -2447,6 +2804,9 @@ void MainWindow::LoadNotesList(const std::wstring& filter, bool titleOnly, bool
 }
 
 void MainWindow::LoadNoteContent(int listIndex) {
+    // Drop any preview chunks still pending for the previous note.
+    CancelMarkdownPreviewChunks();
+
     if (listIndex >= 0 && listIndex < (int)m_filteredIndices.size()) {
         CancelChecklistItemEdit();
         int previousNoteId = m_currentNoteId;
@@ -2484,6 +2844,11 @@ void MainWindow::LoadNoteContent(int listIndex) {
         }
 
         m_isDirty = false;
+
+        // Check with the note's own dictionary once its language is known.
+        const std::string& noteLocale = m_notes[realIndex].spell_language;
+        m_spellLocaleSettled = m_spellDictionaries.HasLocale(noteLocale);
+        SelectSpellLocale(m_spellLocaleSettled ? noteLocale : m_defaultSpellLocale);
         
         // Update Toolbar State
         SendMessage(m_hwndToolbar, TB_CHECKBUTTON, IDM_PIN, m_notes[realIndex].is_pinned ? TRUE : FALSE);
@@ -2511,6 +2876,7 @@ void MainWindow::LoadNoteContent(int listIndex) {
         
         UpdateWindowTitle();
         ScheduleSpellCheck();
+        UpdateOutline(true);
     } else {
         CancelChecklistItemEdit();
         m_currentNoteIndex = -1;
@@ -2522,6 +2888,8 @@ void MainWindow::LoadNoteContent(int listIndex) {
         m_isDirty = false;
         m_isNewNote = false;
         m_checklistMode = false;
+        m_spellLocaleSettled = false;
+        SelectSpellLocale(m_defaultSpellLocale);
         
         SendMessage(m_hwndToolbar, TB_CHECKBUTTON, IDM_PIN, FALSE);
         SendMessage(m_hwndToolbar, TB_CHECKBUTTON, IDM_ARCHIVE, FALSE);
@@ -2530,6 +2898,7 @@ void MainWindow::LoadNoteContent(int listIndex) {
         UpdateNoteTagCombo();
         UpdateWindowTitle();
         ScheduleSpellCheck();
+        UpdateOutline(true);
 
         if (m_markdownPreviewMode) {
             RenderMarkdownPreview();
@@ -2537,8 +2906,80 @@ void MainWindow::LoadNoteContent(int listIndex) {
     }
 }
 
-void MainWindow::PersistLastViewedNote() {
-    if (!m_db) {
+// Reloads the list after other machines' changes came in. Unsaved edits stay in the editor; if
+// the open note changed elsewhere too, that version is kept as a conflict copy instead of being
+// overwritten by the next save.
+void MainWindow::ReloadNotesKeepingEdits() {
+    if (!m_isDirty && !m_isNewNote) {
+        LoadNotesList(m_currentSearchFilter, m_searchTitleOnly, false, m_currentNoteId);
+        return;
+    }
+
+    // The open note as it was loaded or last saved, to tell whether it changed elsewhere.
+    bool haveLoaded = false;
+    std::string loaded;
+    if (!m_isNewNote && m_currentNoteIndex >= 0 && m_currentNoteIndex < (int)m_notes.size() &&
+        m_notes[m_currentNoteIndex].id == m_currentNoteId) {
+        loaded = m_notes[m_currentNoteIndex].content;
+        haveLoaded = true;
+    }
+
+    // With nothing to select, the reload leaves the editor alone.
+    auto reload = [this]() {
+        LoadNotesList(m_currentSearchFilter, m_searchTitleOnly, false, -1);
+        m_currentNoteIndex = -1;
+        for (size_t i = 0; i < m_notes.size(); ++i) {
+            if (!m_isNewNote && m_notes[i].id == m_currentNoteId) {
+                m_currentNoteIndex = (int)i;
+                break;
+            }
+        }
+    };
+    reload();
+    if (m_isNewNote) {
+        return;
+    }
+
+    if (m_currentNoteIndex == -1) {
+        // Not listed: archived elsewhere, or deleted. A deleted note's edits are saved as a new one.
+        bool exists = false;
+        for (const Note& note : m_db->GetAllNotes(true)) {
+            if (note.id == m_currentNoteId) {
+                exists = true;
+                break;
+            }
+        }
+        if (!exists) {
+            m_isNewNote = true;
+            m_newNoteTagId = -1;
+            m_currentNoteId = -1;
+            SendMessage(m_hwndStatus, SB_SETTEXT, 0, (LPARAM)L"Note deleted on another machine; saving keeps it as a new note");
+        }
+        return;
+    }
+
+    // The same "(conflict)" copy a restore's merge makes, so a version already copied there is
+    // not copied again.
+    bool added = false;
+    if (haveLoaded && m_notes[m_currentNoteIndex].content != loaded &&
+        m_db->AddConflictCopy(m_currentNoteId, added) && added) {
+        reload();
+        SendMessage(m_hwndStatus, SB_SETTEXT, 0, (LPARAM)L"Note changed on another machine; that version was kept as a conflict copy");
+    }
+
+    // Select the open note again without loading it over the edits.
+    m_isReloading = true;
+    for (int i = 0; i < (int)m_filteredIndices.size(); ++i) {
+        if (m_filteredIndices[i] == m_currentNoteIndex) {
+            ListView_SetItemState(m_hwndList, i, LVIS_SELECTED | LVIS_FOCUSED, LVIS_SELECTED | LVIS_FOCUSED);
+            break;
+        }
+    }
+    m_isReloading = false;
+}
+
+void MainWindow::PersistLastViewedNote() {
+    if (!m_db) {
         return;
     }
 
@@ -2568,17 +3009,117 @@ void MainWindow::ToggleMarkdownPreview() {
 
     if (m_markdownPreviewMode) {
         RenderMarkdownPreview();
+    } else {
+        CancelMarkdownPreviewChunks();
     }
 }
 
+void MainWindow::ToggleOutline() {
+    m_outlineVisible = !m_outlineVisible;
+    if (m_db) {
+        m_db->SetSetting("outline_visible", m_outlineVisible ? "1" : "0");
+    }
+    SendMessage(m_hwndMarkdownToolbar, TB_CHECKBUTTON, IDM_MARKDOWN_OUTLINE, m_outlineVisible ? TRUE : FALSE);
+
+    if (m_outlineVisible) {
+        UpdateOutline(true);
+    } else {
+        // Nothing maintains the index while hidden; it is rebuilt when shown again.
+        KillTimer(m_hwnd, ID_OUTLINE_TIMER);
+        m_outline.Clear();
+        m_outlineText.clear();
+        m_outlineHeadings.clear();
+        SendMessage(m_hwndOutline, LB_RESETCONTENT, 0, 0);
+    }
+
+    RECT rcClient;
+    GetClientRect(m_hwnd, &rcClient);
+    OnSize(rcClient.right - rcClient.left, rcClient.bottom - rcClient.top);
+}
+
+void MainWindow::ScheduleOutlineUpdate() {
+    if (!m_outlineVisible) {
+        return;
+    }
+    KillTimer(m_hwnd, ID_OUTLINE_TIMER);
+    SetTimer(m_hwnd, ID_OUTLINE_TIMER, 150, NULL);
+}
+
+void MainWindow::UpdateOutline(bool rebuild) {
+    if (!m_hwndOutline || !m_outlineVisible) {
+        return;
+    }
+
+    // Edits since the last update collapse into one delta; only the lines it touched are rescanned.
+    std::wstring text = GetRichEditPlainText(m_hwndEdit);
+    if (rebuild || !m_outline.ApplyEdit(text.c_str(), text.size(), DiffTextEdit(m_outlineText, text))) {
+        m_outline.Rebuild(text.c_str(), text.size());
+    }
+    m_outlineText = std::move(text);
+
+    std::vector<OutlineHeading> headings;
+    m_outline.GetHeadings(headings);
+    bool sameEntries = (headings.size() == m_outlineHeadings.size());
+    for (size_t i = 0; sameEntries && i < headings.size(); ++i) {
+        sameEntries = (headings[i].level == m_outlineHeadings[i].level && headings[i].text == m_outlineHeadings[i].text);
+    }
+    m_outlineHeadings = std::move(headings);
+
+    // Typing inside a section only moves offsets; leave the list alone to avoid flicker.
+    if (!sameEntries) {
+        SendMessage(m_hwndOutline, WM_SETREDRAW, FALSE, 0);
+        SendMessage(m_hwndOutline, LB_RESETCONTENT, 0, 0);
+        for (const auto& heading : m_outlineHeadings) {
+            std::wstring item(2 * (heading.level - 1), L' ');
+            item += heading.text;
+            SendMessage(m_hwndOutline, LB_ADDSTRING, 0, (LPARAM)item.c_str());
+        }
+        SendMessage(m_hwndOutline, WM_SETREDRAW, TRUE, 0);
+        InvalidateRect(m_hwndOutline, NULL, TRUE);
+    }
+
+    CHARRANGE cr = {0};
+    SendMessage(m_hwndEdit, EM_EXGETSEL, 0, (LPARAM)&cr);
+    SendMessage(m_hwndOutline, LB_SETCURSEL, (WPARAM)m_outline.FindHeadingAt((size_t)cr.cpMin), 0);
+}
+
+void MainWindow::JumpToOutlineHeading(int index) {
+    if (index < 0 || index >= (int)m_outlineHeadings.size()) {
+        return;
+    }
+    const OutlineHeading& heading = m_outlineHeadings[index];
+
+    if (m_markdownPreviewMode) {
+        // Preview positions differ from the markdown source; find the same heading by text and occurrence.
+        int occurrence = 0;
+        for (int i = 0; i < index; ++i) {
+            if (m_outlineHeadings[i].text == heading.text) {
+                ++occurrence;
+            }
+        }
+        for (const auto& rendered : m_previewHeadings) {
+            if (rendered.text == heading.text && occurrence-- == 0) {
+                ScrollRichEditToChar(m_hwndPreview, rendered.cp);
+                return;
+            }
+        }
+        SendMessage(m_hwndStatus, SB_SETTEXT, 0, (LPARAM)L"Section is not rendered in the preview yet");
+        return;
+    }
+
+    ScrollRichEditToChar(m_hwndEdit, (LONG)heading.offset);
+}
+
 void MainWindow::RenderMarkdownPreview() {
     if (!m_hwndPreview) {
         return;
     }
 
-    bool clickableLinks = (m_db && m_db->GetSetting("clickable_links", "1") == "1");
-    SendMessage(m_hwndPreview, EM_AUTOURLDETECT, clickableLinks ? TRUE : FALSE, 0);
-    SendMessage(m_hwndPreview, EM_SETEVENTMASK, 0, clickableLinks ? ENM_LINK : 0);
+    CancelMarkdownPreviewChunks();
+
+    m_previewClickableLinks = (m_db && m_db->GetSetting("clickable_links", "1") == "1");
+    SendMessage(m_hwndPreview, EM_AUTOURLDETECT, m_previewClickableLinks ? TRUE : FALSE, 0);
+    SendMessage(m_hwndPreview, EM_SETEVENTMASK, 0, m_previewClickableLinks ? ENM_LINK : 0);
 
     // Prefer current editor text (includes unsaved changes)
     int len = GetWindowTextLength(m_hwndEdit);
@@ -2587,31 +3128,92 @@ void MainWindow::RenderMarkdownPreview() {
     std::wstring markdown = &buf[0];
 
     m_previewLinks.clear();
+    m_previewHeadings.clear();
+    m_previewEndBreak = 0;
+    m_previewInParagraph = false;
+    unsigned int generation = m_previewChunks.Reset(std::move(markdown));
+
+    // Small notes render in one pass. Large notes render roughly one screenful now and the
+    // rest from ID_PREVIEW_CHUNK_TIMER, so time to first paint doesn't depend on note size.
+    MarkdownChunkLimits limits;
+    if (m_previewChunks.TextSize() >= kLazyPreviewThresholdChars) {
+        limits.minLines = (size_t)EstimateVisibleLineCount(m_hwndPreview) + 4;
+        limits.maxChars = kPreviewFirstChunkMaxChars;
+    } else {
+        limits.minLines = (size_t)-1;
+    }
+
     SendMessage(m_hwndPreview, WM_SETREDRAW, FALSE, 0);
     SetWindowText(m_hwndPreview, L"");
     SendMessage(m_hwndPreview, EM_SETSEL, 0, 0);
 
-    // Split into lines (keeping markdown's hard-break behavior separate from paragraph joining)
     std::vector<std::wstring> lines;
-    {
-        size_t start = 0;
-        while (start <= markdown.size()) {
-            size_t end = markdown.find(L'\n', start);
-            std::wstring line = (end == std::wstring::npos) ? markdown.substr(start) : markdown.substr(start, end - start);
-            if (!line.empty() && line.back() == L'\r') {
-                line.pop_back();
-            }
-            lines.push_back(std::move(line));
-            if (end == std::wstring::npos) {
-                break;
-            }
-            start = end + 1;
+    if (m_previewChunks.NextChunk(generation, limits, lines)) {
+        RenderMarkdownLines(lines);
+    }
+
+    SendMessage(m_hwndPreview, EM_SETSEL, 0, 0);
+    SendMessage(m_hwndPreview, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(m_hwndPreview, NULL, TRUE);
+
+    if (m_previewChunks.HasMore()) {
+        SetTimer(m_hwnd, ID_PREVIEW_CHUNK_TIMER, USER_TIMER_MINIMUM, NULL);
+    }
+}
+
+void MainWindow::RenderNextPreviewChunk() {
+    if (!m_hwndPreview || !m_markdownPreviewMode || !m_previewChunks.HasMore()) {
+        CancelMarkdownPreviewChunks();
+        return;
+    }
+
+    // Appending moves the caret to the end; keep the user's selection and scroll position.
+    CHARRANGE sel = {};
+    SendMessage(m_hwndPreview, EM_EXGETSEL, 0, (LPARAM)&sel);
+    POINT scrollPos = {};
+    SendMessage(m_hwndPreview, EM_GETSCROLLPOS, 0, (LPARAM)&scrollPos);
+    SendMessage(m_hwndPreview, WM_SETREDRAW, FALSE, 0);
+
+    MarkdownChunkLimits limits;
+    limits.minChars = kPreviewChunkChars;
+    limits.maxChars = kPreviewChunkChars * 8;
+
+    // WM_TIMER is only delivered when the queue has no input, so a short time slice per tick
+    // keeps typing and scrolling responsive while the rest of the note streams in.
+    unsigned int generation = m_previewChunks.Generation();
+    DWORD startTick = GetTickCount();
+    std::vector<std::wstring> lines;
+    while (m_previewChunks.NextChunk(generation, limits, lines)) {
+        RenderMarkdownLines(lines);
+        if (GetTickCount() - startTick >= kPreviewChunkTimeSliceMs) {
+            break;
         }
     }
 
+    SendMessage(m_hwndPreview, EM_EXSETSEL, 0, (LPARAM)&sel);
+    SendMessage(m_hwndPreview, EM_SETSCROLLPOS, 0, (LPARAM)&scrollPos);
+    SendMessage(m_hwndPreview, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(m_hwndPreview, NULL, TRUE);
+
+    if (!m_previewChunks.HasMore()) {
+        KillTimer(m_hwnd, ID_PREVIEW_CHUNK_TIMER);
+    }
+}
+
+void MainWindow::CancelMarkdownPreviewChunks() {
+    if (m_hwnd) {
+        KillTimer(m_hwnd, ID_PREVIEW_CHUNK_TIMER);
+    }
+    m_previewChunks.Cancel();
+}
+
+void MainWindow::RenderMarkdownLines(const std::vector<std::wstring>& lines) {
+    const bool clickableLinks = m_previewClickableLinks;
+
     // Track how much break spacing we most recently emitted at the end of the document.
     // 0 = none, 1 = ends with one CRLF, 2 = ends with blank line (CRLFCRLF)
-    int endBreak = 0;
+    // Carried across chunks so appended chunks continue the same spacing.
+    int& endBreak = m_previewEndBreak;
 
     auto markTextEmitted = [&]() {
         endBreak = 0;
@@ -2658,13 +3260,40 @@ void MainWindow::RenderMarkdownPreview() {
                 pl.range.cpMax = endPos;
                 pl.url = EnsureUrlHasScheme(run.url);
                 m_previewLinks.push_back(std::move(pl));
+            } else if (clickableLinks && !run.wikiTarget.empty() && endPos > start) {
+                PreviewLink pl;
+                pl.range.cpMin = start;
+                pl.range.cpMax = endPos;
+                pl.noteTitle = run.wikiTarget;
+                m_previewLinks.push_back(std::move(pl));
             }
         }
     };
 
+    auto emitCodeBlock = [&](const std::wstring& code, CodeHighlight::Language language) {
+        SendMessage(m_hwndPreview, EM_SETSEL, -1, -1);
+        ApplyParaNormal(m_hwndPreview);
+
+        CHARFORMAT2 cfDefault = {};
+        cfDefault.cbSize = sizeof(cfDefault);
+        SendMessage(m_hwndPreview, EM_GETCHARFORMAT, SCF_DEFAULT, (LPARAM)&cfDefault);
+        int halfPoints = (cfDefault.yHeight > 0) ? (int)(cfDefault.yHeight / 10) : 20;
+
+        StreamInRtfSelection(m_hwndPreview, BuildCodeBlockRtf(code, language, halfPoints));
+        markTextEmitted();
+        endBreak = 1;
+
+        SendMessage(m_hwndPreview, EM_SETSEL, -1, -1);
+        ApplyParaNormal(m_hwndPreview);
+        ApplyDefaultCharFormat(m_hwndPreview);
+    };
+
     auto isPlainParagraphLine = [&](const std::wstring& rawLine) {
         std::wstring t = TrimLeft(rawLine);
         if (t.empty()) return false;
+        wchar_t fenceChar = 0;
+        size_t fenceLength = 0;
+        if (ParseMarkdownFence(rawLine, fenceChar, fenceLength)) return false;
         if (IsHorizontalRule(t)) return false;
         // tables
         if (LooksLikeMarkdownTableRow(t) || LooksLikeMarkdownTableSeparator(t)) return false;
@@ -2686,12 +3315,72 @@ void MainWindow::RenderMarkdownPreview() {
         return true;
     };
 
-    bool inParagraph = false;
+    bool& inParagraph = m_previewInParagraph;
 
     for (size_t lineIndex = 0; lineIndex < lines.size(); ++lineIndex) {
         const std::wstring& rawLine = lines[lineIndex];
         std::wstring trimmed = TrimLeft(rawLine);
 
+        // Fenced code block: ``` or ~~~ up to a matching closing fence (or the end of the chunk)
+        wchar_t fenceChar = 0;
+        size_t fenceLength = 0;
+        std::wstring fenceInfo;
+        if (ParseMarkdownFence(rawLine, fenceChar, fenceLength, &fenceInfo)) {
+            if (inParagraph) {
+                emitNewlines(1);
+                inParagraph = false;
+            }
+
+            std::wstring code;
+            size_t j = lineIndex + 1;
+            while (j < lines.size()) {
+                wchar_t closeChar = 0;
+                size_t closeLength = 0;
+                std::wstring closeInfo;
+                if (ParseMarkdownFence(lines[j], closeChar, closeLength, &closeInfo) &&
+                    closeChar == fenceChar && closeLength >= fenceLength && closeInfo.empty()) {
+                    break;
+                }
+                if (j > lineIndex + 1) {
+                    code += L'\n';
+                }
+                code += lines[j];
+                j++;
+            }
+
+            emitCodeBlock(code, CodeHighlight::LanguageFromInfoString(fenceInfo));
+
+            // Skip the body and the closing fence
+            lineIndex = (j < lines.size()) ? j : lines.size() - 1;
+            continue;
+        }
+
+        // Indented code block: can't interrupt a paragraph, needs a blank line (or block start) before it
+        if (!inParagraph && IsIndentedCodeLine(rawLine) && (lineIndex == 0 || TrimLeft(lines[lineIndex - 1]).empty())) {
+            std::wstring code = StripCodeIndent(rawLine);
+            size_t j = lineIndex + 1;
+            size_t lastCodeLine = lineIndex;
+            while (j < lines.size()) {
+                if (IsIndentedCodeLine(lines[j])) {
+                    // Keep blank lines that sit between indented lines
+                    for (size_t k = lastCodeLine + 1; k < j; ++k) {
+                        code += L'\n';
+                        code += StripCodeIndent(lines[k]);
+                    }
+                    code += L'\n';
+                    code += StripCodeIndent(lines[j]);
+                    lastCodeLine = j;
+                } else if (!TrimLeft(lines[j]).empty()) {
+                    break;
+                }
+                j++;
+            }
+
+            emitCodeBlock(code, CodeHighlight::Language::None);
+            lineIndex = lastCodeLine;
+            continue;
+        }
+
         if (trimmed.empty()) {
             // blank line ends paragraph
             if (inParagraph) {
@@ -2877,15 +3566,11 @@ void MainWindow::RenderMarkdownPreview() {
             }
 
             // Header
-            int headerLevel = 0;
-            size_t i = 0;
-            while (i < trimmed.size() && trimmed[i] == L'#' && headerLevel < 6) {
-                headerLevel++;
-                i++;
-            }
-            if (headerLevel > 0 && i < trimmed.size() && trimmed[i] == L' ') {
-                std::wstring headerText = trimmed.substr(i + 1);
+            std::wstring headerText;
+            int headerLevel = ParseAtxHeading(trimmed, headerText);
+            if (headerLevel > 0) {
                 ApplyHeaderCharStyle(m_hwndPreview, headerLevel);
+                m_previewHeadings.push_back({ GetRichEditTextLength(m_hwndPreview), TrimSpaces(headerText) });
 
                 // Render header text and add a small bottom margin (one blank line) unless the
                 // markdown already has a blank line next.
@@ -3044,10 +3729,6 @@ void MainWindow::RenderMarkdownPreview() {
             inParagraph = false;
         }
     }
-
-    SendMessage(m_hwndPreview, EM_SETSEL, 0, 0);
-    SendMessage(m_hwndPreview, WM_SETREDRAW, TRUE, 0);
-    InvalidateRect(m_hwndPreview, NULL, TRUE);
 }
 
 void MainWindow::SaveCurrentNote(int preferredSelectNoteId, bool autoSelectAfterSave) {
@@ -3278,6 +3959,8 @@ void MainWindow::CreateNewNote() {
     m_isDirty = false;
     m_checklistMode = false;
     m_newNoteTagId = m_selectedTagId; // Capture the current tag filter
+    m_spellLocaleSettled = false;
+    SelectSpellLocale(m_defaultSpellLocale);
 
     // Clear selection and editor
     ListView_SetItemState(m_hwndList, -1, 0, LVIS_SELECTED | LVIS_FOCUSED);
@@ -3733,7 +4416,7 @@ void MainWindow::ExportCurrentNote() {
         for (auto& c : wTitle) {
             if (wcschr(L"<>:\"/\\|?*", c)) c = L'_';
         }
-        wTitle += L".txt";
+        wTitle += L".html";
         
         OPENFILENAME ofn;
         wchar_t szFile[260];
@@ -3743,13 +4426,24 @@ void MainWindow::ExportCurrentNote() {
         ofn.lStructSize = sizeof(ofn);
         ofn.hwndOwner = m_hwnd;
         ofn.lpstrFile = szFile;
-        ofn.nMaxFile = sizeof(szFile);
-        ofn.lpstrFilter = L"Text Files (*.txt)\0*.txt\0All Files (*.*)\0*.*\0";
+        ofn.nMaxFile = sizeof(szFile) / sizeof(szFile[0]);
+        ofn.lpstrFilter = L"HTML Files (*.html)\0*.html\0Text Files (*.txt)\0*.txt\0All Files (*.*)\0*.*\0";
         ofn.nFilterIndex = 1;
-        ofn.lpstrDefExt = L"txt";
+        ofn.lpstrDefExt = L"html";
         ofn.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT;
         
         if (GetSaveFileName(&ofn) == TRUE) {
+            if (ofn.nFilterIndex != 2) {
+                std::string error;
+                if (HtmlExport::ExportNoteToFile(note, ofn.lpstrFile, error)) {
+                    MessageBox(m_hwnd, L"Note exported successfully.", L"Export", MB_OK | MB_ICONINFORMATION);
+                } else {
+                    std::wstring msg = L"Failed to save file.\n\n" + Utils::Utf8ToWide(error);
+                    MessageBox(m_hwnd, msg.c_str(), L"Error", MB_OK | MB_ICONERROR);
+                }
+                return;
+            }
+
             HANDLE hFile = CreateFile(ofn.lpstrFile, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
             if (hFile != INVALID_HANDLE_VALUE) {
                 std::string content = note.content;
@@ -3771,6 +4465,290 @@ void MainWindow::ExportCurrentNote() {
     }
 }
 
+void MainWindow::ExportNotesAsHtml(bool listedOnly) {
+    if (m_htmlExportInProgress) {
+        return;
+    }
+
+    // Listed = the current tag filter / search results, in list order.
+    std::vector<Note> notes;
+    if (listedOnly) {
+        notes.reserve(m_filteredIndices.size());
+        for (int idx : m_filteredIndices) {
+            if (idx >= 0 && idx < (int)m_notes.size()) {
+                notes.push_back(m_notes[idx]);
+            }
+        }
+    } else {
+        notes = m_notes;
+    }
+    if (notes.empty()) {
+        MessageBox(m_hwnd, L"There are no notes to export.", L"Export", MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+
+    // The notes are written next to the index page the user picks.
+    OPENFILENAME ofn;
+    wchar_t szFile[MAX_PATH] = L"index.html";
+    ZeroMemory(&ofn, sizeof(ofn));
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = m_hwnd;
+    ofn.lpstrFile = szFile;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.lpstrFilter = L"HTML Files (*.html)\0*.html\0";
+    ofn.nFilterIndex = 1;
+    ofn.lpstrDefExt = L"html";
+    ofn.lpstrTitle = L"Choose the folder and index page for the exported notes";
+    ofn.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT;
+    if (GetSaveFileName(&ofn) != TRUE) {
+        return;
+    }
+
+    std::wstring indexPath = ofn.lpstrFile;
+    size_t slash = indexPath.find_last_of(L"\\/");
+    if (slash == std::wstring::npos) {
+        return;
+    }
+
+    std::unique_ptr<HtmlExportThreadParams> params(new HtmlExportThreadParams());
+    params->hwnd = m_hwnd;
+    params->notes = std::move(notes);
+    params->directory = indexPath.substr(0, slash);
+    params->indexFileName = indexPath.substr(slash + 1);
+    params->indexTitle = listedOnly ? L"NoteSoFast - Exported Notes" : L"NoteSoFast - All Notes";
+
+    std::wstring status = L"Exporting " + std::to_wstring(params->notes.size()) + L" note(s) to HTML...";
+    uintptr_t th = _beginthreadex(nullptr, 0, HtmlExportThread, params.get(), 0, nullptr);
+    if (!th) {
+        MessageBox(m_hwnd, L"Failed to start the export.", L"Error", MB_OK | MB_ICONERROR);
+        return;
+    }
+    params.release();
+    CloseHandle((HANDLE)th);
+    m_htmlExportInProgress = true;
+    SendMessage(m_hwndStatus, SB_SETTEXT, 0, (LPARAM)status.c_str());
+}
+
+void MainWindow::StartSpellAudit() {
+    if (m_spellAuditInProgress || !m_db || m_dbPath.empty()) {
+        return;
+    }
+    if (m_spellDictionaries.Locales().empty()) {
+        MessageBox(m_hwnd, L"No spell check dictionaries are installed.", L"Spell Audit", MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+
+    std::unique_ptr<SpellAuditThreadParams> params(new SpellAuditThreadParams());
+    params->hwnd = m_hwnd;
+    params->dbPath = m_dbPath;
+    params->dictionaries = m_spellDictionaries;
+    params->defaultLocale = m_defaultSpellLocale;
+    params->cancel = std::make_shared<std::atomic<bool>>(false);
+
+    uintptr_t th = _beginthreadex(nullptr, 0, SpellAuditThread, params.get(), 0, nullptr);
+    if (!th) {
+        MessageBox(m_hwnd, L"Failed to start the spell audit.", L"Error", MB_OK | MB_ICONERROR);
+        return;
+    }
+    if (m_spellAuditThread) {
+        CloseHandle(m_spellAuditThread);   // The previous audit has finished
+    }
+    m_spellAuditThread = (HANDLE)th;
+    m_spellAuditCancel = params->cancel;
+    params.release();
+    m_spellAuditInProgress = true;
+    m_spellAuditWords.clear();
+
+    if (!m_hwndSpellAudit) {
+        static bool registered = false;
+        if (!registered) {
+            WNDCLASSEXW wc = {0};
+            wc.cbSize = sizeof(wc);
+            wc.lpfnWndProc = MainWindow::SpellAuditWndProc;
+            wc.hInstance = GetModuleHandle(NULL);
+            wc.lpszClassName = L"NoteSoFastSpellAuditClass";
+            wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+            wc.hbrBackground = (HBRUSH)(COLOR_BTNFACE + 1);
+            RegisterClassExW(&wc);
+            registered = true;
+        }
+        m_hwndSpellAudit = CreateWindowEx(WS_EX_TOOLWINDOW, L"NoteSoFastSpellAuditClass", L"Spell Audit",
+            WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, 520, 480, m_hwnd, NULL, GetModuleHandle(NULL), this);
+    }
+    if (m_hwndSpellAudit) {
+        FillSpellAuditList(std::vector<std::wstring>());
+        SetWindowText(m_hwndSpellAuditStatus, L"Checking notes...");
+        ShowWindow(m_hwndSpellAudit, SW_SHOW);
+    }
+    SendMessage(m_hwndStatus, SB_SETTEXT, 0, (LPARAM)L"Spell audit started");
+}
+
+void MainWindow::OnSpellAuditReport(SpellAuditReport* report, bool finished) {
+    std::unique_ptr<SpellAuditReport> res(report);
+    if (finished) {
+        m_spellAuditInProgress = false;
+        m_spellAuditCancel.reset();
+    }
+    if (!res) {
+        return;
+    }
+
+    // Words added since the report was taken are left out; the selection survives the refresh.
+    std::vector<std::wstring> selected = SelectedAuditWords();
+    m_spellAuditWords.clear();
+    for (auto& word : res->words) {
+        if (!m_userWords || !m_userWords->Contains(word.word.c_str(), word.word.size())) {
+            m_spellAuditWords.push_back(std::move(word));
+        }
+    }
+    FillSpellAuditList(selected);
+
+    std::wstring status;
+    if (finished && res->cancelled) {
+        status = L"Cancelled after ";
+    } else if (finished) {
+        status = L"Checked ";
+    } else {
+        status = L"Checking... ";
+    }
+    status += std::to_wstring(res->notesChecked) + L" of " + std::to_wstring(res->notesTotal) + L" notes, " +
+              std::to_wstring(res->distinctWords) + L" unknown word(s)";
+    if (m_hwndSpellAuditStatus) {
+        SetWindowText(m_hwndSpellAuditStatus, status.c_str());
+    }
+    if (finished) {
+        SendMessage(m_hwndStatus, SB_SETTEXT, 0, (LPARAM)L"Spell audit finished");
+    }
+}
+
+std::vector<std::wstring> MainWindow::SelectedAuditWords() const {
+    std::vector<std::wstring> words;
+    int selCount = m_hwndSpellAuditList ? (int)SendMessage(m_hwndSpellAuditList, LB_GETSELCOUNT, 0, 0) : 0;
+    if (selCount <= 0) {
+        return words;
+    }
+    std::vector<int> rows(selCount);
+    SendMessage(m_hwndSpellAuditList, LB_GETSELITEMS, selCount, (LPARAM)rows.data());
+    for (int row : rows) {
+        int index = (int)SendMessage(m_hwndSpellAuditList, LB_GETITEMDATA, row, 0);
+        if (index >= 0 && index < (int)m_spellAuditWords.size()) {
+            words.push_back(m_spellAuditWords[index].word);
+        }
+    }
+    return words;
+}
+
+void MainWindow::FillSpellAuditList(const std::vector<std::wstring>& selected) {
+    if (!m_hwndSpellAuditList) {
+        return;
+    }
+
+    SendMessage(m_hwndSpellAuditList, WM_SETREDRAW, FALSE, 0);
+    SendMessage(m_hwndSpellAuditList, LB_RESETCONTENT, 0, 0);
+    for (size_t i = 0; i < m_spellAuditWords.size(); ++i) {
+        const SpellAuditWord& word = m_spellAuditWords[i];
+        std::wstring row = word.word + L"  \x2014  " + std::to_wstring(word.count) + L" in " +
+                           std::to_wstring(word.noteIds.size()) + L" note(s):";
+        for (size_t n = 0; n < word.noteIds.size() && n < 5; ++n) {
+            row += L" #" + std::to_wstring(word.noteIds[n]);
+        }
+        if (word.noteIds.size() > 5) {
+            row += L" ...";
+        }
+        int item = (int)SendMessage(m_hwndSpellAuditList, LB_ADDSTRING, 0, (LPARAM)row.c_str());
+        SendMessage(m_hwndSpellAuditList, LB_SETITEMDATA, item, (LPARAM)i);
+        if (std::find(selected.begin(), selected.end(), word.word) != selected.end()) {
+            SendMessage(m_hwndSpellAuditList, LB_SETSEL, TRUE, item);
+        }
+    }
+    SendMessage(m_hwndSpellAuditList, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(m_hwndSpellAuditList, NULL, TRUE);
+}
+
+void MainWindow::AddSelectedAuditWords() {
+    std::vector<std::wstring> words = SelectedAuditWords();
+    if (words.empty()) {
+        return;
+    }
+
+    for (const std::wstring& word : words) {
+        AddUserWord(word, true);
+    }
+    m_spellAuditWords.erase(std::remove_if(m_spellAuditWords.begin(), m_spellAuditWords.end(),
+        [&](const SpellAuditWord& w) { return std::find(words.begin(), words.end(), w.word) != words.end(); }),
+        m_spellAuditWords.end());
+    FillSpellAuditList(std::vector<std::wstring>());
+
+    std::wstring status = L"Added " + std::to_wstring(words.size()) + L" word(s) to the dictionary";
+    SendMessage(m_hwndStatus, SB_SETTEXT, 0, (LPARAM)status.c_str());
+}
+
+LRESULT CALLBACK MainWindow::SpellAuditWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    enum { ID_AUDIT_LIST = 1, ID_AUDIT_ADD, ID_AUDIT_CLOSE };
+    MainWindow* self = NULL;
+    if (uMsg == WM_NCCREATE) {
+        self = (MainWindow*)((CREATESTRUCT*)lParam)->lpCreateParams;
+        SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)self);
+    } else {
+        self = (MainWindow*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+    }
+    if (!self) {
+        return DefWindowProc(hwnd, uMsg, wParam, lParam);
+    }
+
+    switch (uMsg) {
+    case WM_CREATE: {
+        HINSTANCE hInst = GetModuleHandle(NULL);
+        self->m_hwndSpellAuditStatus = CreateWindow(L"STATIC", L"", WS_CHILD | WS_VISIBLE | SS_LEFTNOWORDWRAP,
+            0, 0, 0, 0, hwnd, NULL, hInst, NULL);
+        self->m_hwndSpellAuditList = CreateWindowEx(WS_EX_CLIENTEDGE, L"LISTBOX", L"",
+            WS_CHILD | WS_VISIBLE | WS_VSCROLL | LBS_EXTENDEDSEL | LBS_NOINTEGRALHEIGHT,
+            0, 0, 0, 0, hwnd, (HMENU)ID_AUDIT_LIST, hInst, NULL);
+        HWND add = CreateWindow(L"BUTTON", L"Add Selected to Dictionary", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+            0, 0, 0, 0, hwnd, (HMENU)ID_AUDIT_ADD, hInst, NULL);
+        HWND close = CreateWindow(L"BUTTON", L"Close", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+            0, 0, 0, 0, hwnd, (HMENU)ID_AUDIT_CLOSE, hInst, NULL);
+        HWND controls[] = { self->m_hwndSpellAuditStatus, self->m_hwndSpellAuditList, add, close };
+        for (HWND control : controls) {
+            SendMessage(control, WM_SETFONT, (WPARAM)self->m_hFont, TRUE);
+        }
+        return 0;
+    }
+    case WM_SIZE: {
+        int width = LOWORD(lParam);
+        int height = HIWORD(lParam);
+        const int margin = 8;
+        const int buttonHeight = 28;
+        MoveWindow(self->m_hwndSpellAuditStatus, margin, margin, width - 2 * margin, 22, TRUE);
+        MoveWindow(self->m_hwndSpellAuditList, margin, margin + 26, width - 2 * margin,
+                   height - 3 * margin - 26 - buttonHeight, TRUE);
+        MoveWindow(GetDlgItem(hwnd, ID_AUDIT_ADD), margin, height - margin - buttonHeight, 220, buttonHeight, TRUE);
+        MoveWindow(GetDlgItem(hwnd, ID_AUDIT_CLOSE), width - margin - 90, height - margin - buttonHeight, 90, buttonHeight, TRUE);
+        return 0;
+    }
+    case WM_COMMAND:
+        if (LOWORD(wParam) == ID_AUDIT_ADD) {
+            self->AddSelectedAuditWords();
+        } else if (LOWORD(wParam) == ID_AUDIT_CLOSE) {
+            SendMessage(hwnd, WM_CLOSE, 0, 0);
+        }
+        return 0;
+    case WM_CLOSE:
+        // Closing the list also stops an audit that is still running.
+        if (self->m_spellAuditCancel) {
+            self->m_spellAuditCancel->store(true);
+        }
+        DestroyWindow(hwnd);
+        return 0;
+    case WM_DESTROY:
+        self->m_hwndSpellAudit = NULL;
+        self->m_hwndSpellAuditStatus = NULL;
+        self->m_hwndSpellAuditList = NULL;
+        return 0;
+    }
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
 void MainWindow::PrintCurrentNote() {
     if (m_currentNoteIndex >= 0 && m_currentNoteIndex < (int)m_notes.size()) {
         const Note& note = m_notes[m_currentNoteIndex];
@@ -3874,6 +4852,19 @@ void MainWindow::OnTimer(UINT_PTR timerId) {
     }
     if (timerId == ID_CLOUDSYNC_TIMER) {
         TriggerCloudSyncIfIdle();
+        return;
+    }
+    if (timerId == ID_PREVIEW_CHUNK_TIMER) {
+        RenderNextPreviewChunk();
+        return;
+    }
+    if (timerId == ID_OUTLINE_TIMER) {
+        KillTimer(m_hwnd, ID_OUTLINE_TIMER);
+        UpdateOutline(false);        return;
+    }
+    if (timerId == ID_SUGGEST_TIMER) {
+        KillTimer(m_hwnd, ID_SUGGEST_TIMER);
+        PrefetchSuggestions();
     }
 }
 
@@ -3925,32 +4916,53 @@ void MainWindow::TriggerCloudSyncIfIdle() {
     if (m_db->GetSetting("cloud_sync_enabled", "0") != "1") {
         return;
     }
+    // Nothing written since the last sync: no snapshot, no network.
+    if (m_db->GetChangeStamp() == m_cloudSyncedStamp) {
+        return;
+    }
 
     const std::string clientId = m_db->GetSetting("cloud_oauth_client_id", "");
-    if (clientId.empty()) {
-        return;
+    if (CloudSync::UsesGoogleAccount(m_db->GetSetting(CloudSync::kCloudBackendSetting, ""))) {
+        if (clientId.empty()) {
+            return;
+        }
+
+        // Skip if not connected.
+        std::string refresh;
+        if (!Credentials::ReadUtf8String(CloudSync::kCloudRefreshTokenCredTarget, refresh) || refresh.empty()) {
+            return;
+        }
     }
 
-    // Skip if not connected.
-    std::string refresh;
-    if (!Credentials::ReadUtf8String(CloudSync::kCloudRefreshTokenCredTarget, refresh) || refresh.empty()) {
-        return;
+    StartCloudSync(NULL);
+}
+
+// Exchanges changes and uploads a snapshot on a worker, unless a sync or restore is running.
+// reportTo (a settings page, or NULL) gets progress and the outcome.
+bool MainWindow::StartCloudSync(HWND reportTo) {
+    if (m_cloudSyncInProgress || !m_db || m_dbPath.empty()) {
+        return false;
     }
 
     m_cloudSyncInProgress = true;
     auto* params = new CloudAutoSyncThreadParams();
     params->hwnd = m_hwnd;
+    params->reportTo = reportTo;
     params->db = m_db;
     params->dbPath = m_dbPath;
-    params->clientId = clientId;
+    params->clientId = m_db->GetSetting("cloud_oauth_client_id", "");
+    params->cancel = std::make_shared<std::atomic<bool>>(false);
+    m_cloudSyncCancel = params->cancel;
 
     uintptr_t th = _beginthreadex(nullptr, 0, CloudAutoSyncThread, params, 0, nullptr);
     if (th == 0) {
         delete params;
         m_cloudSyncInProgress = false;
-        return;
+        m_cloudSyncCancel.reset();
+        return false;
     }
     CloseHandle((HANDLE)th);
+    return true;
 }
 
 void MainWindow::ScheduleSpellCheck() {
@@ -3962,6 +4974,11 @@ void MainWindow::RunSpellCheck() {
     if (!m_spellChecker || !m_spellChecker->IsReady()) {
         return;
     }
+    if (m_spellCheckInFlight) {
+        // One worker at a time; OnSpellCheckDone runs the check once it is back.
+        m_spellCheckPending = true;
+        return;
+    }
 
     // Get cursor position to check for active selection
     CHARRANGE cursorPos = {0};
@@ -3970,35 +4987,295 @@ void MainWindow::RunSpellCheck() {
         m_spellCheckDeferred = true;
         return;
     }
-    int cursorEnd = cursorPos.cpMax;
 
-    // Use EM_GETTEXTLENGTHEX + EM_GETTEXTEX so text positions match RichEdit semantics
-    GETTEXTLENGTHEX ltx = {};
-    ltx.flags = GTL_DEFAULT;
-    ltx.codepage = 1200; // UTF-16LE
-    int textLen = (int)SendMessage(m_hwndEdit, EM_GETTEXTLENGTHEX, (WPARAM)&ltx, 0);
+    // Only re-check the words around what changed since the last run; earlier misses are shifted
+    // and shown right away while the worker checks the rest.
+    std::wstring text = GetRichEditPlainText(m_hwndEdit);
+    if (!m_spellLocaleSettled) {
+        DetectNoteSpellLocale(text);
+    }
+    TextEdit edit = DiffTextEdit(m_lastCheckedText, text);
+    m_spellRanges.ApplyEdit(edit);
+    if (!edit.Empty() &&
+        (SpellTokenizer::TouchesFence(m_lastCheckedText.c_str(), m_lastCheckedText.size(), edit.offset, edit.offset + edit.removed) ||
+         SpellTokenizer::TouchesFence(text.c_str(), text.size(), edit.offset, edit.offset + edit.inserted))) {
+        // Opening or closing a code block changes which of the following lines are prose.
+        m_spellRanges.MarkDirty(edit.offset, text.size());
+    }
+    m_lastCheckedText = std::move(text);
+    UpdateSpellUnderlines(!edit.Empty());
 
-    std::wstring text;
-    if (textLen > 0) {
-        GETTEXTEX gtx = {};
-        gtx.flags = GT_DEFAULT;
-        gtx.codepage = 1200;
-        gtx.cb = (textLen + 1) * (DWORD)sizeof(wchar_t);
-        text.resize(textLen + 1);
-        int actualLen = (int)SendMessage(m_hwndEdit, EM_GETTEXTEX, (WPARAM)&gtx, (LPARAM)&text[0]);
-        if (actualLen > 0) {
-            text.resize(actualLen);
-        } else {
-            text.clear();
+    std::vector<SpellCheckRanges::Span> spans = m_spellRanges.DirtySpans(m_lastCheckedText.c_str(), m_lastCheckedText.size());
+    if (spans.empty()) {
+        PrefetchSuggestions();
+        return;
+    }
+
+    std::unique_ptr<SpellCheckJob> job(new SpellCheckJob());
+    job->hwnd = m_hwnd;
+    job->checker = m_spellChecker;
+    job->cancel = std::make_shared<std::atomic<bool>>(false);
+    job->version = m_spellDocVersion;
+    job->text = m_lastCheckedText;
+    job->spans = std::move(spans);
+    job->userWords = m_userWords;
+
+    uintptr_t th = _beginthreadex(nullptr, 0, SpellCheckThread, job.get(), 0, nullptr);
+    if (!th) {
+        // No worker; check on this thread instead.
+        SpellFenceState fences;
+        for (const auto& span : job->spans) {
+            m_spellRanges.Commit(span, m_spellChecker->FindMisspellings(m_lastCheckedText, span.first, span.second,
+                                                                        nullptr, &fences));
+        }
+        UpdateSpellUnderlines(false);
+        return;
+    }
+    m_spellCheckCancel = job->cancel;
+    m_spellCheckInFlight = true;
+    job.release();
+    CloseHandle((HANDLE)th);
+}
+
+void MainWindow::OnSpellCheckDone(SpellCheckJob* job) {
+    std::unique_ptr<SpellCheckJob> result(job);
+    m_spellCheckInFlight = false;
+    m_spellCheckCancel.reset();
+    if (!result) {
+        return;
+    }
+
+    // m_spellRanges is only changed by RunSpellCheck, which waits for the worker, so it still
+    // describes the snapshot. Results for an edited text are dropped and their spans stay dirty.
+    if (!result->cancelled && result->version == m_spellDocVersion) {
+        for (size_t i = 0; i < result->spans.size() && i < result->found.size(); ++i) {
+            m_spellRanges.Commit(result->spans[i], result->found[i]);
+        }
+        if (result->userWords != m_userWords) {
+            DropUserWordMisses();   // A word was added while the worker ran
         }
+        UpdateSpellUnderlines(false);
     }
 
-    auto misses = m_spellChecker->FindMisspellings(text);
+    if (m_spellCheckPending) {
+        m_spellCheckPending = false;
+        RunSpellCheck();
+    } else {
+        PrefetchSuggestions();
+    }
+}
+
+void MainWindow::PrefetchSuggestions() {
+    if (!m_spellChecker || !m_spellChecker->IsReady() || m_spellCheckInFlight || m_lastMisses.empty()) {
+        return;
+    }
+
+    // The misses on screen are the ones a context menu is likely to be opened on.
+    int visibleStart = 0;
+    int visibleEnd = 0;
+    GetVisibleTextRange(visibleStart, visibleEnd);
+    std::unique_ptr<SuggestionJob> job(new SuggestionJob());
+    auto it = std::lower_bound(m_lastMisses.begin(), m_lastMisses.end(), visibleStart,
+        [](const SpellChecker::Range& miss, int pos) { return miss.start + miss.length <= pos; });
+    for (; it != m_lastMisses.end() && it->start < visibleEnd && job->words.size() < kMaxPrefetchSuggestionWords; ++it) {
+        std::wstring word = m_lastCheckedText.substr(it->start, it->length);
+        if (!m_suggestions.Contains(word) &&
+            std::find(job->words.begin(), job->words.end(), word) == job->words.end()) {
+            job->words.push_back(std::move(word));
+        }
+    }
+    if (job->words.empty()) {
+        return;
+    }
+
+    job->hwnd = m_hwnd;
+    job->checker = m_spellChecker;
+    job->cancel = std::make_shared<std::atomic<bool>>(false);
+    uintptr_t th = _beginthreadex(nullptr, 0, SuggestionThread, job.get(), 0, nullptr);
+    if (!th) {
+        return;   // Speculative only; the context menu computes what is missing
+    }
+    m_spellCheckCancel = job->cancel;
+    m_spellCheckInFlight = true;
+    job.release();
+    CloseHandle((HANDLE)th);
+}
+
+void MainWindow::OnSuggestionsDone(SuggestionJob* job) {
+    std::unique_ptr<SuggestionJob> result(job);
+    m_spellCheckInFlight = false;
+    m_spellCheckCancel.reset();
+    if (!result) {
+        return;
+    }
+
+    // Suggestions depend only on the word, so even a cancelled run's finished words are kept,
+    // unless the dictionary was switched meanwhile.
+    if (result->checker == m_spellChecker) {
+        for (size_t i = 0; i < result->suggestions.size() && i < result->words.size(); ++i) {
+            m_suggestions.Store(result->words[i], std::move(result->suggestions[i]));
+        }
+    }
+
+    // A cancelled run was cut short by an edit or a dictionary switch; the check that follows
+    // prefetches again once it is done.
+    if (m_spellCheckPending) {
+        m_spellCheckPending = false;
+        RunSpellCheck();
+    }
+}
+
+void MainWindow::SelectSpellLocale(const std::string& locale) {
+    std::shared_ptr<SpellChecker> checker = m_spellDictionaries.Get(locale);
+    m_spellLocale = locale;
+    if (checker == m_spellChecker) {
+        return;
+    }
+
+    // Every verdict so far came from the other dictionary; check the whole text again.
+    m_spellChecker = checker;
+    ++m_spellDocVersion;
+    if (m_spellCheckCancel) {
+        *m_spellCheckCancel = true;
+    }
+    m_spellRanges.Reset(m_lastCheckedText.size());
+    m_lastMisses.clear();
+    m_suggestions.Clear();
+    if (m_hwndEdit) {
+        InvalidateRect(m_hwndEdit, NULL, FALSE);
+    }
+}
+
+void MainWindow::DetectNoteSpellLocale(const std::wstring& text) {
+    std::vector<std::string> languages = m_spellDictionaries.Languages();
+    if (languages.size() < 2) {
+        m_spellLocaleSettled = true;  // Nothing to choose between
+        return;
+    }
+    std::string language = LanguageDetector::Detect(text.c_str(), text.size(), languages);
+    if (language.empty()) {
+        return;  // Too little prose yet; try again after more typing
+    }
+
+    // Regional variants read alike, so the default locale decides between them.
+    std::string locale = m_spellDictionaries.LocaleForLanguage(language, m_defaultSpellLocale);
+    SelectSpellLocale(locale);
+    if (m_isNewNote || m_currentNoteId == -1) {
+        return;  // Stored once the note is saved and reopened
+    }
+    m_spellLocaleSettled = true;
+    if (m_db) {
+        m_db->SetNoteSpellLanguage(m_currentNoteId, locale);
+    }
+    if (m_currentNoteIndex >= 0 && m_currentNoteIndex < (int)m_notes.size()) {
+        m_notes[m_currentNoteIndex].spell_language = locale;
+    }
+}
+
+void MainWindow::AddUserWord(const std::wstring& word, bool remember) {
+    if (remember && m_db) {
+        m_db->AddUserDictionaryWord(Utils::WideToUtf8(word));
+    }
+
+    // Publish an extended copy; a running worker keeps reading the list it started with.
+    auto words = std::make_shared<UserDictionary>(m_userWords ? *m_userWords : UserDictionary());
+    if (!words->Add(word)) {
+        return;
+    }
+    m_userWords = words;
+    m_spellDictionaries.SetUserDictionary(m_userWords);
+    m_suggestions.Clear();   // The new word may now be suggested for others
+
+    // Known misses of the word go away now; nothing needs re-checking.
+    DropUserWordMisses();
+    UpdateSpellUnderlines(false);
+}
+
+void MainWindow::DropUserWordMisses() {
+    if (!m_userWords) {
+        return;
+    }
+    const UserDictionary& words = *m_userWords;
+    const std::wstring& text = m_lastCheckedText;
+    m_spellRanges.RemoveMissesIf([&](const SpellRange& miss) {
+        return miss.start + miss.length <= (long)text.size() && words.Contains(text.data() + miss.start, miss.length);
+    });
+}
+
+bool MainWindow::ShowSpellContextMenu(LPARAM lParam) {
+    // Right-click (or the menu key, which reports -1,-1) on an underlined word.
+    POINT pt = { (short)LOWORD(lParam), (short)HIWORD(lParam) };
+    LONG pos = 0;
+    if (lParam == -1) {
+        CHARRANGE sel = {0};
+        SendMessage(m_hwndEdit, EM_EXGETSEL, 0, (LPARAM)&sel);
+        pos = sel.cpMin;
+        pt = GetCharPosition(pos);
+        ClientToScreen(m_hwndEdit, &pt);
+    } else {
+        POINTL client = { pt.x, pt.y };
+        ScreenToClient(m_hwndEdit, (POINT*)&client);
+        pos = (LONG)SendMessage(m_hwndEdit, EM_CHARFROMPOS, 0, (LPARAM)&client);
+    }
+
+    auto it = std::lower_bound(m_lastMisses.begin(), m_lastMisses.end(), pos,
+        [](const SpellChecker::Range& miss, LONG p) { return miss.start + miss.length < p; });
+    if (it == m_lastMisses.end() || it->start > pos ||
+        it->start + it->length > (LONG)m_lastCheckedText.size()) {
+        return false;
+    }
+    LONG wordStart = it->start;
+    std::wstring word = m_lastCheckedText.substr(it->start, it->length);
+
+    // Usually prefetched; otherwise compute them now if no worker holds the checker.
+    std::vector<std::wstring> suggestions;
+    bool haveSuggestions = m_suggestions.Lookup(word, suggestions);
+    if (!haveSuggestions && !m_spellCheckInFlight && m_spellChecker) {
+        suggestions = m_spellChecker->Suggest(word, kMaxSuggestions);
+        m_suggestions.Store(word, suggestions);
+        haveSuggestions = true;
+    }
+
+    HMENU hMenu = CreatePopupMenu();
+    for (size_t i = 0; i < suggestions.size(); ++i) {
+        AppendMenu(hMenu, MF_STRING, IDM_SPELL_SUGGESTION_BASE + (UINT)i, suggestions[i].c_str());
+    }
+    if (suggestions.empty()) {
+        AppendMenu(hMenu, MF_STRING | MF_GRAYED, 0, haveSuggestions ? L"(No suggestions)" : L"(Suggestions not ready)");
+    }
+    AppendMenu(hMenu, MF_SEPARATOR, 0, NULL);
+    AppendMenu(hMenu, MF_STRING, IDM_SPELL_ADD_WORD, L"Add to Dictionary");
+    AppendMenu(hMenu, MF_STRING, IDM_SPELL_IGNORE_WORD, L"Ignore All");
+    UINT cmd = TrackPopupMenu(hMenu, TPM_LEFTALIGN | TPM_TOPALIGN | TPM_RETURNCMD, pt.x, pt.y, 0, m_hwnd, NULL);
+    DestroyMenu(hMenu);
+
+    if (cmd >= IDM_SPELL_SUGGESTION_BASE && cmd < IDM_SPELL_SUGGESTION_BASE + suggestions.size()) {
+        // Replace the word only if the editor still has it where it was checked.
+        std::wstring text = GetRichEditPlainText(m_hwndEdit);
+        if (wordStart + word.size() <= text.size() && text.compare(wordStart, word.size(), word) == 0) {
+            FinalizeCurrentWord();
+            CHARRANGE sel = { wordStart, wordStart + (LONG)word.size() };
+            SendMessage(m_hwndEdit, EM_EXSETSEL, 0, (LPARAM)&sel);
+            SendMessage(m_hwndEdit, EM_REPLACESEL, TRUE, (LPARAM)suggestions[cmd - IDM_SPELL_SUGGESTION_BASE].c_str());
+        }
+    } else if (cmd == IDM_SPELL_ADD_WORD) {
+        AddUserWord(word, true);
+    } else if (cmd == IDM_SPELL_IGNORE_WORD) {
+        AddUserWord(word, false);   // For this session only
+    }
+    return true;
+}
+
+void MainWindow::UpdateSpellUnderlines(bool textChanged) {
+    CHARRANGE cursorPos = {0};
+    SendMessage(m_hwndEdit, EM_EXGETSEL, 0, (LPARAM)&cursorPos);
+    int cursorEnd = cursorPos.cpMax;
+    const std::wstring& text = m_lastCheckedText;
 
     // Filter out words that are incomplete (adjacent to cursor position)
     // Only underline words that are complete (followed by space/punctuation, not at cursor)
     std::vector<SpellChecker::Range> filteredMisses;
-    for (const auto& miss : misses) {
+    for (const auto& miss : m_spellRanges.Misses()) {
         // Skip if word contains or is adjacent to cursor
         if (miss.start <= cursorEnd && cursorEnd <= miss.start + miss.length + 1) {
             continue;  // Don't mark incomplete words being typed
@@ -4013,12 +5290,6 @@ void MainWindow::RunSpellCheck() {
         filteredMisses.push_back(miss);
     }
 
-    // Limit work to keep UI snappy
-    const size_t kMaxMisses = 128;
-    if (filteredMisses.size() > kMaxMisses) {
-        filteredMisses.resize(kMaxMisses);
-    }
-
     auto rangesEqual = [](const std::vector<SpellChecker::Range>& a, const std::vector<SpellChecker::Range>& b) {
         if (a.size() != b.size()) return false;
         for (size_t i = 0; i < a.size(); ++i) {
@@ -4027,15 +5298,14 @@ void MainWindow::RunSpellCheck() {
         return true;
     };
 
+    m_spellCheckDeferred = false;
+
     // If nothing changed, avoid extra redraws
-    if (text == m_lastCheckedText && rangesEqual(filteredMisses, m_lastMisses)) {
-        m_spellCheckDeferred = false;
+    if (!textChanged && rangesEqual(filteredMisses, m_lastMisses)) {
         return;
     }
 
-    m_lastCheckedText = text;
-    m_lastMisses = filteredMisses;
-    m_spellCheckDeferred = false;
+    m_lastMisses = std::move(filteredMisses);
     InvalidateRect(m_hwndEdit, NULL, FALSE);
 }
 
@@ -4089,6 +5359,11 @@ LRESULT CALLBACK MainWindow::RichEditSubclassProc(HWND hwnd, UINT uMsg, WPARAM w
     }
 
     switch (uMsg) {
+    case WM_CONTEXTMENU:
+        if (self->ShowSpellContextMenu(lParam)) {
+            return 0;
+        }
+        break;
     case WM_LBUTTONDBLCLK:
         if (!self->m_markdownPreviewMode && !self->m_checklistMode && self->m_db && self->m_db->GetSetting("double_click_markdown", "0") == "1") {
             self->ToggleMarkdownPreview();
@@ -4186,6 +5461,10 @@ LRESULT CALLBACK MainWindow::RichEditSubclassProc(HWND hwnd, UINT uMsg, WPARAM w
                 self->DrawSpellUnderlines(hdc);
                 ReleaseDC(hwnd, hdc);
             }
+            if (!self->m_lastMisses.empty()) {
+                // New misses came into view; fetch their suggestions once scrolling settles.
+                SetTimer(self->m_hwnd, ID_SUGGEST_TIMER, 300, NULL);
+            }
             return res;
         }
     }
@@ -4203,30 +5482,61 @@ POINT MainWindow::GetCharPosition(int index) const {
     return pt;
 }
 
+void MainWindow::GetVisibleTextRange(int& start, int& end) const {
+    // Whole lines from the first visible one through the one at the bottom edge, clamped to the
+    // checked text.
+    int textLen = (int)m_lastCheckedText.size();
+    RECT rc;
+    GetClientRect(m_hwndEdit, &rc);
+    int firstLine = (int)SendMessage(m_hwndEdit, EM_GETFIRSTVISIBLELINE, 0, 0);
+    start = (int)SendMessage(m_hwndEdit, EM_LINEINDEX, firstLine, 0);
+    POINTL bottomRight = { rc.right, rc.bottom };
+    int lastChar = (int)SendMessage(m_hwndEdit, EM_CHARFROMPOS, 0, (LPARAM)&bottomRight);
+    int lastLine = (int)SendMessage(m_hwndEdit, EM_EXLINEFROMCHAR, 0, lastChar);
+    end = (int)SendMessage(m_hwndEdit, EM_LINEINDEX, lastLine + 1, 0);
+    if (start < 0) {
+        start = 0;
+    }
+    if (end < 0 || end > textLen) {
+        end = textLen;
+    }
+}
+
 void MainWindow::DrawSpellUnderlines(HDC hdc) const {
     if (m_lastMisses.empty() || hdc == NULL) {
         return;
     }
 
-    HPEN pen = CreatePen(PS_SOLID, 1, RGB(200, 0, 0));
-    HGDIOBJ oldPen = SelectObject(hdc, pen);
     HFONT font = (HFONT)SendMessage(m_hwndEdit, WM_GETFONT, 0, 0);
     HFONT oldFont = (HFONT)SelectObject(hdc, font);
-
-    TEXTMETRIC tm;
-    GetTextMetrics(hdc, &tm);
-    int underlineY = tm.tmAscent + 2;
+    if (!m_spellPen) {
+        m_spellPen = CreatePen(PS_SOLID, 1, RGB(200, 0, 0));
+    }
+    if (font != m_spellMetricsFont) {
+        TEXTMETRIC tm;
+        GetTextMetrics(hdc, &tm);
+        m_spellUnderlineY = tm.tmAscent + 2;
+        m_spellMetricsFont = font;
+    }
+    HGDIOBJ oldPen = SelectObject(hdc, m_spellPen);
     int safeTextLen = (int)m_lastCheckedText.size();
 
-    for (const auto& miss : m_lastMisses) {
-        int start = miss.start;
-        int end = start + miss.length;
+    // Only the misses on the visible lines are drawn, so the cost of a paint does not depend on
+    // how long the note is or how many misses it has.
+    int visibleStart = 0;
+    int visibleEnd = 0;
+    GetVisibleTextRange(visibleStart, visibleEnd);
+
+    auto it = std::lower_bound(m_lastMisses.begin(), m_lastMisses.end(), visibleStart,
+        [](const SpellChecker::Range& miss, int pos) { return miss.start + miss.length <= pos; });
+    for (; it != m_lastMisses.end() && it->start < visibleEnd; ++it) {
+        int start = it->start;
+        int end = start + it->length;
         while (start < end) {
             int line = (int)SendMessage(m_hwndEdit, EM_LINEFROMCHAR, start, 0);
             if (line == -1) {
                 break;
             }
-            (void)SendMessage(m_hwndEdit, EM_LINEINDEX, line, 0);
             int nextLineStart = (int)SendMessage(m_hwndEdit, EM_LINEINDEX, line + 1, 0);
             if (nextLineStart == -1) {
                 nextLineStart = safeTextLen;
@@ -4249,7 +5559,7 @@ void MainWindow::DrawSpellUnderlines(HDC hdc) const {
                 pEnd = pStart;
             }
 
-            int y = pStart.y + underlineY;
+            int y = pStart.y + m_spellUnderlineY;
             MoveToEx(hdc, pStart.x, y, NULL);
             LineTo(hdc, pEnd.x, y);
 
@@ -4259,7 +5569,6 @@ void MainWindow::DrawSpellUnderlines(HDC hdc) const {
 
     SelectObject(hdc, oldFont);
     SelectObject(hdc, oldPen);
-    DeleteObject(pen);
 }
 
 void MainWindow::ResetWordUndoState() {
@@ -4397,6 +5706,26 @@ void MainWindow::NavigateHistory(int offset) {
     UpdateHistoryButtons();
 }
 
+void MainWindow::NavigateToNote(int noteId) {
+    if (noteId == m_currentNoteId && !m_isNewNote) {
+        return;
+    }
+    if (!PromptToSaveIfDirty(noteId, false)) {
+        return;
+    }
+
+    // Saving may have reloaded the list, so look the note up afterwards.
+    int listIndex = FindListIndexByNoteId(noteId);
+    if (listIndex == -1) {
+        SendMessage(m_hwndStatus, SB_SETTEXT, 0, (LPARAM)L"Linked note is hidden by the current filter");
+        return;
+    }
+
+    ListView_SetItemState(m_hwndList, listIndex, LVIS_SELECTED | LVIS_FOCUSED, LVIS_SELECTED | LVIS_FOCUSED);
+    ListView_EnsureVisible(m_hwndList, listIndex, FALSE);
+    LoadNoteContent(listIndex);
+}
+
 int MainWindow::FindListIndexByNoteId(int noteId) {
     for (int i = 0; i < (int)m_filteredIndices.size(); ++i) {
         int realIndex = m_filteredIndices[i];
@@ -2,12 +2,21 @@
 #include <windows.h>
 #include <commctrl.h>
 #include <richedit.h>
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <string>
 #include "database.h"
 #include "note.h"
 #include "spell_checker.h"
+#include "spell_dictionaries.h"
+#include "suggestion_cache.h"
+#include "spell_audit.h"
+#include "markdown_chunks.h"
+#include "heading_outline.h"
+
+struct SpellCheckJob;
+struct SuggestionJob;
 
 class MainWindow {
 public:
@@ -20,6 +29,8 @@ public:
     // Public for window procedure callbacks
     void NavigateSearchHistory(int offset);
     void SetDatabasePath(const std::wstring& path);
+    // Merges remote changes made since the last sync in the background (cloud sync enabled only).
+    void StartCloudRestore();
 
     Database* GetDatabase() const { return m_db; }
 
@@ -41,13 +52,24 @@ protected:
 
     void LoadNotesList(const std::wstring& filter = L"", bool titleOnly = false, bool autoSelectFirst = true, int selectNoteId = -1);
     void LoadNoteContent(int index);
+    void ReloadNotesKeepingEdits();
     void PersistLastViewedNote();
     void ToggleMarkdownPreview();
     void RenderMarkdownPreview();
+    void RenderMarkdownLines(const std::vector<std::wstring>& lines);
+    void RenderNextPreviewChunk();
+    void CancelMarkdownPreviewChunks();
     void SaveCurrentNote(int preferredSelectNoteId = -1, bool autoSelectAfterSave = true);
     void CreateNewNote();
     void DeleteCurrentNote();
     void ExportCurrentNote();
+    void ExportNotesAsHtml(bool listedOnly);
+    void StartSpellAudit();
+    void OnSpellAuditReport(SpellAuditReport* report, bool finished);
+    std::vector<std::wstring> SelectedAuditWords() const;
+    void FillSpellAuditList(const std::vector<std::wstring>& selected);
+    void AddSelectedAuditWords();
+    static LRESULT CALLBACK SpellAuditWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
     void PrintCurrentNote();
     void TogglePinCurrentNote();
     void ToggleArchiveCurrentNote();
@@ -69,11 +91,25 @@ protected:
     void OnTimer(UINT_PTR timerId);
     void ScheduleSpellCheck();
     void RunSpellCheck();
+    void OnSpellCheckDone(SpellCheckJob* job);
+    void UpdateSpellUnderlines(bool textChanged);
+    void SelectSpellLocale(const std::string& locale);
+    void DetectNoteSpellLocale(const std::wstring& text);
+    void AddUserWord(const std::wstring& word, bool remember);
+    void DropUserWordMisses();
+    bool ShowSpellContextMenu(LPARAM lParam);
+    void PrefetchSuggestions();
+    void OnSuggestionsDone(SuggestionJob* job);
     bool PromptToSaveIfDirty(int preferredSelectNoteId = -1, bool autoSelectAfterSave = true);
     void RecordHistory(int noteIndex);
     void NavigateHistory(int offset);
     void UpdateHistoryButtons();
     int FindListIndexByNoteId(int noteId);
+    void NavigateToNote(int noteId);
+    void ToggleOutline();
+    void ScheduleOutlineUpdate();
+    void UpdateOutline(bool rebuild);
+    void JumpToOutlineHeading(int index);
     void UpdateWindowTitle();
     void SaveSearchHistory();
     void ShowSettingsDialog();
@@ -85,6 +121,7 @@ protected:
     void SyncDatabaseOnExitIfEnabled();
     void ConfigureCloudSyncTimer();
     void TriggerCloudSyncIfIdle();
+    bool StartCloudSync(HWND reportTo);
 
     HWND m_hwnd;
     HWND m_hwndList;
@@ -132,22 +169,54 @@ protected:
     std::vector<int> m_history;
     int m_historyPos = -1;
     bool m_navigatingHistory = false;
+    std::vector<int> m_backlinkMenuNoteIds;  // Note ids behind the IDM_BACKLINK_BASE context menu entries
     bool m_isNewNote = false;
     bool m_spellCheckDeferred = false;   // Selection active; rerun once selection clears
+    bool m_spellCheckInFlight = false;   // A worker is using m_spellChecker (checking or suggesting)
+    bool m_spellCheckPending = false;    // A check was requested while the worker was busy
+    unsigned int m_spellDocVersion = 0;  // Bumped on every edit; stale worker results are dropped
+    std::shared_ptr<std::atomic<bool>> m_spellCheckCancel;  // Cancel flag of the in-flight worker
     bool m_statusPartsConfigured = false;
     bool m_dbInfoNeedsRefresh = false;
     std::wstring m_dbPath;
 
     bool m_cloudSyncInProgress = false;
+    std::shared_ptr<std::atomic<bool>> m_cloudSyncCancel;   // Stops the auto sync's snapshot
+    Database::ChangeStamp m_cloudSyncedStamp;   // Of m_db after the last successful sync
+    bool m_htmlExportInProgress = false;
+
+    // Spell audit of the whole database and the window listing its result
+    bool m_spellAuditInProgress = false;
+    std::shared_ptr<std::atomic<bool>> m_spellAuditCancel;
+    HANDLE m_spellAuditThread = NULL;   // Joined in WM_DESTROY
+    HWND m_hwndSpellAudit = NULL;
+    HWND m_hwndSpellAuditStatus = NULL;
+    HWND m_hwndSpellAuditList = NULL;
+    std::vector<SpellAuditWord> m_spellAuditWords;   // Rows of m_hwndSpellAuditList
 
     HIMAGELIST m_hMarkdownToolbarImages = NULL;
 
     bool m_markdownPreviewMode = false;
+    HWND m_hwndOutline = NULL;
+    bool m_outlineVisible = false;
+    HeadingOutline m_outline;
+    std::wstring m_outlineText;                     // Editor text m_outline was last updated from
+    std::vector<OutlineHeading> m_outlineHeadings;  // Entries listed in m_hwndOutline
     struct PreviewLink {
         CHARRANGE range;
         std::wstring url;
+        std::wstring noteTitle;  // [[link]] target; url is empty for those
     };
     std::vector<PreviewLink> m_previewLinks;
+    struct PreviewHeading {
+        LONG cp;
+        std::wstring text;
+    };
+    std::vector<PreviewHeading> m_previewHeadings;  // Rendered headings, in order (for outline jumps)
+    MarkdownChunkScheduler m_previewChunks;
+    bool m_previewClickableLinks = false;
+    int m_previewEndBreak = 0;           // Break spacing at the end of the preview (carried across chunks)
+    bool m_previewInParagraph = false;
     
     // Search history
     std::vector<std::string> m_searchHistory;
@@ -156,19 +225,31 @@ protected:
     DWORD m_lastSearchChangeTime = 0;
 
     // Spell checking
-    std::unique_ptr<SpellChecker> m_spellChecker;
+    std::shared_ptr<SpellChecker> m_spellChecker;  // Checker of m_spellLocale; shared with the worker
+    SpellDictionaries m_spellDictionaries;
+    std::string m_defaultSpellLocale;  // "spell_locale" setting, used until a note's language is known
+    std::string m_spellLocale;
+    bool m_spellLocaleSettled = false;  // Current note's language is stored or cannot be detected
+    std::shared_ptr<const UserDictionary> m_userWords;  // Added and ignored words; never modified once published
+    SuggestionCache m_suggestions;  // Suggestions of m_spellChecker, filled ahead for visible misses
     struct WordAction {
         LONG start;
         std::wstring text;
     };
-    std::vector<SpellChecker::Range> m_lastMisses;
+    std::vector<SpellChecker::Range> m_lastMisses;  // Underlined misses, sorted by start
     std::wstring m_lastCheckedText;  // Store text that was analyzed for spell check
+    SpellCheckRanges m_spellRanges;  // All misses of m_lastCheckedText plus spans still to check
     std::vector<WordAction> m_wordUndoStack;
     std::vector<WordAction> m_wordRedoStack;
     std::wstring m_currentWord;
     LONG m_currentWordStart = -1;
     static LRESULT CALLBACK RichEditSubclassProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR idSubclass, DWORD_PTR refData);
     void DrawSpellUnderlines(HDC hdc) const;
+    void GetVisibleTextRange(int& start, int& end) const;
+    // Paint-time state reused between DrawSpellUnderlines calls; metrics follow the editor font.
+    mutable HPEN m_spellPen = NULL;
+    mutable HFONT m_spellMetricsFont = NULL;
+    mutable int m_spellUnderlineY = 0;
     POINT GetCharPosition(int index) const;
     void FinalizeCurrentWord();
     bool PerformWordUndo();
@@ -0,0 +1,73 @@
+#include "word_cache.h"
+#include <cwchar>
+
+WordVerdictCache::WordVerdictCache(size_t capacity) {
+    size_t size = kProbeWindow;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    m_entries.resize(size);
+    m_mask = size - 1;
+}
+
+uint32_t WordVerdictCache::Hash(const wchar_t* word, size_t length) {
+    // FNV-1a over the UTF-16 code units.
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (uint32_t)(uint16_t)word[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool WordVerdictCache::Matches(const Entry& entry, uint32_t hash, const wchar_t* word, size_t length) const {
+    return entry.epoch == m_epoch && entry.hash == hash && entry.length == length &&
+           wmemcmp(entry.word, word, length) == 0;
+}
+
+bool WordVerdictCache::Lookup(const wchar_t* word, size_t length, bool& correct) const {
+    if (length == 0 || length > kMaxWordLength) {
+        return false;
+    }
+    uint32_t hash = Hash(word, length);
+    for (size_t i = 0; i < kProbeWindow; ++i) {
+        const Entry& entry = m_entries[(hash + i) & m_mask];
+        if (Matches(entry, hash, word, length)) {
+            correct = entry.correct;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WordVerdictCache::Store(const wchar_t* word, size_t length, bool correct) {
+    if (length == 0 || length > kMaxWordLength) {
+        return;
+    }
+    uint32_t hash = Hash(word, length);
+
+    // Reuse a free/stale slot in the probe window; otherwise evict one picked by the hash.
+    Entry* slot = &m_entries[(hash + (hash >> 29) % kProbeWindow) & m_mask];
+    for (size_t i = 0; i < kProbeWindow; ++i) {
+        Entry& entry = m_entries[(hash + i) & m_mask];
+        if (entry.epoch != m_epoch || Matches(entry, hash, word, length)) {
+            slot = &entry;
+            break;
+        }
+    }
+
+    slot->epoch = m_epoch;
+    slot->hash = hash;
+    slot->length = (uint8_t)length;
+    slot->correct = correct;
+    wmemcpy(slot->word, word, length);
+}
+
+void WordVerdictCache::Clear() {
+    if (++m_epoch == 0) {
+        for (auto& entry : m_entries) {
+            entry.epoch = 0;
+        }
+        m_epoch = 1;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed-size cache of spelling verdicts keyed by the word's UTF-16 text. Lookups hash the
+// caller's buffer in place and never allocate. Entries are stored inline in an open-addressed
+// table with a short probe window; when the window is full a slot in it is overwritten, so
+// memory stays bounded no matter how many distinct words pass through.
+// Not thread-safe: callers serialize access.
+class WordVerdictCache {
+public:
+    // Longer words bypass the cache (they are rare and the key would not fit inline).
+    static const size_t kMaxWordLength = 24;
+
+    explicit WordVerdictCache(size_t capacity = 8192);
+
+    // Returns true and sets correct when the verdict for word is cached.
+    bool Lookup(const wchar_t* word, size_t length, bool& correct) const;
+    void Store(const wchar_t* word, size_t length, bool correct);
+
+    // Drops every verdict (e.g. after the dictionary changed). O(1) except on epoch wrap-around.
+    void Clear();
+
+private:
+    struct Entry {
+        uint32_t epoch = 0;   // Entry is live only when it matches m_epoch
+        uint32_t hash = 0;
+        uint8_t length = 0;
+        bool correct = false;
+        wchar_t word[kMaxWordLength];
+    };
+
+    static const size_t kProbeWindow = 4;
+
+    static uint32_t Hash(const wchar_t* word, size_t length);
+    bool Matches(const Entry& entry, uint32_t hash, const wchar_t* word, size_t length) const;
+
+    std::vector<Entry> m_entries;
+    size_t m_mask = 0;
+    uint32_t m_epoch = 1;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+// Timing helpers for the benchmarks (tests/bench_*.cpp, each its own program).
+namespace Bench {
+
+inline double NowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Best of runs calls of fn, in milliseconds: the least disturbed run.
+template <typename Fn>
+double BestOf(int runs, Fn fn) {
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) {
+        double start = NowMs();
+        fn();
+        double elapsed = NowMs() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+} // namespace Bench
@@ -0,0 +1,73 @@
+// Lexing throughput of fenced code blocks per language: lines per millisecond over a few thousand
+// lines of typical source, lexed into a reused run vector as the preview does.
+#include "bench.h"
+
+#include "code_highlight.h"
+
+#include <string>
+#include <vector>
+
+using CodeHighlight::Language;
+
+namespace {
+
+struct Sample {
+    const char* name;
+    Language language;
+    const wchar_t* lines;   // Repeated to fill the block
+};
+
+const Sample kSamples[] = {
+    { "cpp", Language::Cpp,
+      L"#include <vector>\n"
+      L"// Sums the values that pass the filter.\n"
+      L"static int Sum(const std::vector<int>& values, bool (*keep)(int)) {\n"
+      L"    int total = 0; /* running */\n"
+      L"    for (size_t i = 0; i < values.size(); ++i) {\n"
+      L"        if (keep(values[i])) total += values[i] * 2.5e-1;\n"
+      L"    }\n"
+      L"    return total > 0x7f ? total : printf(\"%d\\n\", total);\n"
+      L"}\n" },
+    { "python", Language::Python,
+      L"def load(path, encoding='utf-8'):\n"
+      L"    \"\"\"Reads the notes file.\"\"\"\n"
+      L"    with open(path, encoding=encoding) as f:  # closed on exit\n"
+      L"        for line in f:\n"
+      L"            if not line.strip(): continue\n"
+      L"            yield line.split('\\t', 1)[0], 42\n" },
+    { "sql", Language::Sql,
+      L"-- notes edited this week\n"
+      L"SELECT n.id, n.title FROM notes n\n"
+      L"  LEFT JOIN note_tags t ON t.note_id = n.id\n"
+      L"  where n.modified_at > datetime('now', '-7 days') AND n.is_archived = 0\n"
+      L"  ORDER BY n.modified_at DESC LIMIT 50;\n" },
+    { "shell", Language::Shell,
+      L"#!/bin/sh\n"
+      L"for f in \"$@\"; do  # each argument\n"
+      L"    if [ -f \"${f}\" ]; then echo \"$f: $(wc -l < $f)\"; fi\n"
+      L"done\n" },
+};
+
+const size_t kLines = 5000;
+
+} // namespace
+
+int main() {
+    std::vector<CodeHighlight::Run> runs;
+    for (const Sample& sample : kSamples) {
+        std::wstring block;
+        size_t lines = 0;
+        while (lines < kLines) {
+            for (const wchar_t* p = sample.lines; *p; ++p) {
+                block += *p;
+                if (*p == L'\n') ++lines;
+            }
+        }
+        double ms = Bench::BestOf(20, [&]() {
+            CodeHighlight::Lex(sample.language, block.data(), block.size(), runs);
+        });
+        printf("%-7s %zu lines (%.0f KB): %.3f ms, %.0f lines/ms, %zu runs\n", sample.name, lines,
+               block.size() / 1024.0, ms, lines / ms, runs.size());
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+// DAWG dictionary: build time and size for an affix-expanded word list, time to open (map) the
+// file, resident memory after opening and after lookups, and lookup throughput. Linux reads the
+// resident set from /proc/self/status; elsewhere it is reported as 0.
+#include "bench.h"
+
+#include "dawg_dictionary.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+long ResidentKb() {
+    FILE* f = fopen("/proc/self/status", "r");
+    if (!f) {
+        return 0;
+    }
+    char line[256];
+    long kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            kb = atol(line + 6);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+} // namespace
+
+int main() {
+    // About the size of an expanded en_US: 50k stems with a handful of suffix rules each.
+    const char* endings[] = { "", "s", "ed", "ing", "er", "ers", "ly", "ness", "able", "ation", "ations" };
+    const char* syllables[] = { "ka", "mo", "ri", "tel", "on", "pra", "vis", "un", "der", "gal", "es", "tor" };
+    std::vector<std::string> words;
+    unsigned int seed = 7;
+    for (int i = 0; i < 50000; ++i) {
+        std::string stem;
+        int parts = 2 + i % 3;
+        for (int p = 0; p < parts; ++p) {
+            seed = seed * 1103515245u + 12345u;
+            stem += syllables[(seed >> 16) % 12];
+        }
+        for (int e = 0; e < 1 + i % 11; ++e) {
+            words.push_back(stem + endings[e]);
+        }
+    }
+    std::vector<std::string> probes(words.begin(), words.begin() + 100000);
+
+    std::vector<unsigned char> image;
+    std::string error;
+    double buildMs = Bench::NowMs();
+    if (!DawgDictionary::Build(words, image, error)) {
+        printf("build failed: %s\n", error.c_str());
+        return 1;
+    }
+    buildMs = Bench::NowMs() - buildMs;
+    size_t textBytes = 0;
+    for (const std::string& w : words) {
+        textBytes += w.size() + 1;
+    }
+    printf("build: %zu words (%.1f MB as text) -> %.2f MB image in %.0f ms\n", words.size(), textBytes / 1e6,
+           image.size() / 1e6, buildMs);
+    words.clear();
+    words.shrink_to_fit();
+
+    std::string path = "/tmp/notesofast_bench_" + std::to_string(getpid()) + ".dawg";
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f || fwrite(image.data(), 1, image.size(), f) != image.size()) {
+        printf("cannot write %s\n", path.c_str());
+        return 1;
+    }
+    fclose(f);
+    image.clear();
+    image.shrink_to_fit();
+
+    long rssBefore = ResidentKb();
+    DawgDictionary dict;
+    double openMs = Bench::NowMs();
+    bool opened = dict.Open(std::wstring(path.begin(), path.end()));
+    openMs = Bench::NowMs() - openMs;
+    long rssOpen = ResidentKb();
+    if (!opened) {
+        printf("open failed\n");
+        return 1;
+    }
+
+    size_t found = 0;
+    double lookupMs = Bench::BestOf(5, [&]() {
+        found = 0;
+        for (const std::string& w : probes) {
+            found += dict.Contains(w.data(), w.size()) ? 1 : 0;
+        }
+    });
+    long rssLookups = ResidentKb();
+    printf("open: %.3f ms; RSS +%ld KB after open, +%ld KB after lookups\n", openMs, rssOpen - rssBefore,
+           rssLookups - rssBefore);
+    printf("lookup: %zu words in %.1f ms, %.1f M lookups/s (%zu found)\n", probes.size(), lookupMs,
+           probes.size() / lookupMs / 1000, found);
+    remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Bulk HTML export of 10,000 generated notes: each converted and written to a file of its own,
+// then the index page, on one thread and on a pool of up to eight as HtmlExport runs it. Notes
+// carry headings, lists, a table, a code block and links to one another.
+#include "bench.h"
+
+#include "html_document.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+const int kNotes = 10000;
+
+std::vector<Note> MakeNotes() {
+    std::vector<Note> notes;
+    for (int i = 0; i < kNotes; ++i) {
+        Note note;
+        note.id = i + 1;
+        note.title = "Note " + std::to_string(i) + " <draft>";
+        note.created_at = note.modified_at = "2026-10-18 09:00:00";
+        std::string& c = note.content;
+        c += "# Meeting " + std::to_string(i) + "\n\nNotes from **today** & *yesterday*, see [[Note " +
+             std::to_string((i * 7 + 1) % kNotes) + " <draft>]] and [the docs](https://example.com/" +
+             std::to_string(i) + ").\n\n";
+        for (int k = 0; k < 8; ++k) {
+            c += "- item " + std::to_string(k) + " with `code` and ~~old~~ text\n";
+        }
+        c += "\n| name | value |\n|------|-------|\n| a < b | " + std::to_string(i) + " |\n\n";
+        c += "```cpp\nfor (int k = 0; k < " + std::to_string(i) + "; ++k) { total += \"x\"[0]; }\n```\n\n";
+        for (int k = 0; k < 6; ++k) {
+            c += "Paragraph line " + std::to_string(k) + " of a longer note, with quotes \"like this\".\n";
+        }
+        notes.push_back(std::move(note));
+    }
+    return notes;
+}
+
+bool WriteFile(const std::string& path, const std::function<bool(const HtmlDocument::Sink&)>& write) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    bool ok = write([f](const char* data, size_t size) { return fwrite(data, 1, size, f) == size; });
+    return fclose(f) == 0 && ok;
+}
+
+std::string Narrow(const std::wstring& name) {
+    return std::string(name.begin(), name.end());   // Generated titles are ASCII
+}
+
+} // namespace
+
+int main() {
+    char dirTemplate[] = "/tmp/notesofast_export_XXXXXX";
+    if (!mkdtemp(dirTemplate)) {
+        return 1;
+    }
+    std::string dir = dirTemplate;
+    std::vector<Note> notes = MakeNotes();
+    size_t markdownBytes = 0;
+    for (const Note& note : notes) {
+        markdownBytes += note.content.size();
+    }
+
+    std::vector<int> threadCounts = { 1 };
+    int maxThreads = (int)std::min(8u, std::thread::hardware_concurrency());
+    if (maxThreads > 1) {
+        threadCounts.push_back(maxThreads);
+    }
+    for (int threads : threadCounts) {
+        std::atomic<size_t> htmlBytes(0);
+        std::atomic<int> failed(0);
+        double ms = Bench::BestOf(3, [&]() {
+            htmlBytes = 0;
+            std::vector<std::wstring> fileNames;
+            HtmlDocument::LinkTargets links;
+            for (const Note& note : notes) {
+                fileNames.push_back(HtmlDocument::FileNameForNote(note));
+                links.Add(note, fileNames.back());
+            }
+            std::atomic<size_t> next(0);
+            auto worker = [&]() {
+                for (size_t i; (i = next.fetch_add(1)) < notes.size();) {
+                    bool ok = WriteFile(dir + "/" + Narrow(fileNames[i]), [&](const HtmlDocument::Sink& sink) {
+                        return HtmlDocument::WriteNote(notes[i], &links, [&](const char* data, size_t size) {
+                            htmlBytes += size;
+                            return sink(data, size);
+                        });
+                    });
+                    if (!ok) ++failed;
+                }
+            };
+            std::vector<std::thread> pool;
+            for (int t = 1; t < threads; ++t) {
+                pool.emplace_back(worker);
+            }
+            worker();
+            for (std::thread& t : pool) {
+                t.join();
+            }
+            std::vector<unsigned char> listed(notes.size(), 1);
+            if (!WriteFile(dir + "/index.html", [&](const HtmlDocument::Sink& sink) {
+                    return HtmlDocument::WriteIndex("All notes", notes, fileNames, listed, sink);
+                })) {
+                ++failed;
+            }
+        });
+        printf("%d notes (%.1f MB markdown, %.1f MB HTML), %d thread(s): %.0f ms, %.0f notes/s%s\n", kNotes,
+               markdownBytes / 1048576.0, htmlBytes.load() / 1048576.0, threads, ms, kNotes * 1000.0 / ms,
+               failed ? ", FAILED writes" : "");
+    }
+
+    std::string command = "rm -rf '" + dir + "'";
+    return system(command.c_str()) == 0 ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+// Language detection cost per call, as paid when a note is opened: a short note, a long note (only
+// the start is sampled) and high-entropy text that fills the trigram table.
+#include "bench.h"
+
+#include "language_detector.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+void Run(const char* label, const std::wstring& text, const std::vector<std::string>& candidates) {
+    const int calls = 2000;
+    std::string result;
+    double ms = Bench::BestOf(3, [&]() {
+        for (int i = 0; i < calls; ++i) {
+            result = LanguageDetector::Detect(text.c_str(), text.size(), candidates);
+        }
+    });
+    printf("%-12s %8zu chars: %7.2f us/call -> \"%s\"\n", label, text.size(), ms * 1000 / calls, result.c_str());
+}
+
+} // namespace
+
+int main() {
+    const std::vector<std::string>& all = LanguageDetector::SupportedLanguages();
+    const std::wstring paragraph = L"Die Besprechung mit dem Designteam wurde auf Donnerstag verschoben. Wir werden die "
+                                   L"Entw\u00FCrfe f\u00FCr den neuen Ablauf pr\u00FCfen und entscheiden, welche der "
+                                   L"beiden Varianten wir zuerst ausliefern. ";
+    std::wstring longNote;
+    for (int i = 0; i < 2000; ++i) {
+        longNote += paragraph;
+    }
+    std::wstring noise;
+    unsigned int seed = 1;
+    for (int i = 0; i < 16 * 1024; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        noise.push_back(i % 13 == 12 ? L' ' : (wchar_t)(L'a' + (seed >> 8) % 26));
+    }
+
+    Run("short note", paragraph, all);
+    Run("long note", longNote, all);
+    Run("noise", noise, all);
+    return 0;
+}
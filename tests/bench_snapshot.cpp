@@ -0,0 +1,164 @@
+// Note save latency on the UI's connection while the sync thread snapshots the database on its
+// own, as CloudAutoSyncThread does: with no snapshot running, during Database::BackupToFile (a few
+// pages a step), and during a one-pass sqlite3_backup_step(-1) copy as it was done before. Each
+// in the rollback journal mode the app uses and in WAL.
+#include "bench.h"
+
+#include "database.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+enum class Snapshot { None, Stepped, OnePass };
+
+const int kSaves = 300;
+const int kSavePauseMs = 3;   // Between saves, as autosave while typing
+
+std::string g_dir;
+
+// The schema through Database, then the notes in one transaction so building takes seconds.
+void Populate(const std::string& path, int notes) {
+    {
+        Database db;
+        if (!db.Initialize(path)) {
+            return;
+        }
+    }
+    sqlite3* db = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+        sqlite3_prepare_v2(db, "INSERT INTO notes (title, content) VALUES (?, ?)", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+        std::mt19937 rng(46);
+        for (int i = 0; i < notes; ++i) {
+            std::string title = "note " + std::to_string(i);
+            std::string content;
+            size_t length = 500 + rng() % 4000;
+            while (content.size() < length) {
+                content += "lorem ipsum " + std::to_string(rng() % 1000) + " ";
+            }
+            sqlite3_bind_text(stmt, 1, title.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, content.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+        sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+}
+
+// The old snapshot: the whole file in one step, on a connection of its own.
+bool OnePassCopy(const std::string& source, const std::string& dest) {
+    sqlite3* src = nullptr;
+    sqlite3* out = nullptr;
+    bool ok = false;
+    if (sqlite3_open(source.c_str(), &src) == SQLITE_OK && sqlite3_open(dest.c_str(), &out) == SQLITE_OK) {
+        sqlite3_busy_timeout(src, 5000);
+        sqlite3_backup* backup = sqlite3_backup_init(out, "main", src, "main");
+        if (backup) {
+            ok = sqlite3_backup_step(backup, -1) == SQLITE_DONE;
+            sqlite3_backup_finish(backup);
+        }
+    }
+    sqlite3_close(out);
+    sqlite3_close(src);
+    return ok;
+}
+
+void Run(const std::string& path, const char* mode, Snapshot snapshot) {
+    Database ui;
+    Database sync;
+    if (!ui.Initialize(path) || !sync.Initialize(path)) {
+        printf("cannot open %s\n", path.c_str());
+        return;
+    }
+    std::vector<Note> notes = ui.GetAllNotes(true);
+    std::string dest = g_dir + "/snapshot.db";
+
+    std::atomic<bool> stop(false);
+    int snapshots = 0;
+    double snapshotMs = 0;
+    std::thread worker;
+    if (snapshot != Snapshot::None) {
+        worker = std::thread([&]() {
+            while (!stop.load()) {
+                remove(dest.c_str());
+                double start = Bench::NowMs();
+                bool ok = snapshot == Snapshot::Stepped ? sync.BackupToFile(dest, &stop) : OnePassCopy(path, dest);
+                if (ok) {
+                    snapshotMs += Bench::NowMs() - start;
+                    ++snapshots;
+                }
+            }
+        });
+    }
+
+    std::mt19937 rng(7);
+    std::vector<double> latencies;
+    int failed = 0;
+    for (int i = 0; i < kSaves; ++i) {
+        Note note = notes[rng() % notes.size()];
+        note.content += " typed";
+        double start = Bench::NowMs();
+        if (!ui.UpdateNote(note)) {
+            ++failed;
+        }
+        latencies.push_back(Bench::NowMs() - start);
+        std::this_thread::sleep_for(std::chrono::milliseconds(kSavePauseMs));
+    }
+    stop = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    static const char* names[] = { "no snapshot", "BackupToFile", "one-pass copy" };
+    printf("%-8s %-14s save p50 %6.2f ms  p99 %7.2f ms  max %7.2f ms", mode, names[(int)snapshot],
+           latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100], latencies.back());
+    if (snapshot != Snapshot::None) {
+        printf("  (%d snapshots, %.0f ms each)", snapshots, snapshots ? snapshotMs / snapshots : 0.0);
+    }
+    if (failed) {
+        printf("  %d saves failed", failed);
+    }
+    printf("\n");
+    remove(dest.c_str());
+}
+
+} // namespace
+
+int main() {
+    char dir[] = "/tmp/notesofast_bench_XXXXXX";
+    if (!mkdtemp(dir)) {
+        printf("cannot create a temporary directory\n");
+        return 1;
+    }
+    g_dir = dir;
+
+    const char* modes[] = { "delete", "wal" };
+    for (const char* mode : modes) {
+        std::string path = g_dir + "/notes-" + mode + ".db";
+        sqlite3* db = nullptr;
+        if (sqlite3_open(path.c_str(), &db) == SQLITE_OK) {
+            sqlite3_exec(db, (std::string("PRAGMA journal_mode=") + mode).c_str(), nullptr, nullptr, nullptr);
+        }
+        sqlite3_close(db);
+        Populate(path, 4000);
+        Run(path, mode, Snapshot::None);
+        Run(path, mode, Snapshot::Stepped);
+        Run(path, mode, Snapshot::OnePass);
+    }
+    std::string command = "rm -rf '" + g_dir + "'";
+    return system(command.c_str()) == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+// Tokenizer throughput over a large mixed markdown note, and many-span checks with and without a
+// shared fence state (one scan of the text versus one per span).
+#include "bench.h"
+
+#include "spell_tokenizer.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+int main() {
+    const std::wstring paragraph =
+        L"The quick brown fox jumps over the lazy dog; see [docs](https://example.com/a) and `code` "
+        L"don't well-known getValue.\r\n";
+    const std::wstring fence = L"```cpp\r\nint main() { return 0; }\r\n```\r\n";
+    std::wstring text;
+    while (text.size() < ((size_t)4 << 20)) {
+        text += paragraph;
+        if (text.size() % 7 == 0) {
+            text += fence;
+        }
+    }
+
+    size_t words = 0;
+    double ms = Bench::BestOf(5, [&]() {
+        words = 0;
+        SpellTokenizer tokenizer(text.data(), text.size(), 0, text.size());
+        SpellToken token;
+        while (tokenizer.Next(token)) {
+            ++words;
+        }
+    });
+    printf("tokenize %.1f M chars: %.1f ms, %.0f M chars/s, %zu words\n",
+           text.size() / 1e6, ms, text.size() / ms / 1000, words);
+
+    // One span per 200th line, as after a search-and-replace across the note.
+    std::vector<std::pair<size_t, size_t>> spans;
+    size_t lineStart = 0;
+    for (size_t line = 0; lineStart < text.size(); ++line) {
+        size_t lineEnd = text.find(L'\n', lineStart);
+        if (lineEnd == std::wstring::npos) {
+            lineEnd = text.size();
+        }
+        if (line % 200 == 0) {
+            spans.push_back(std::make_pair(lineStart, lineEnd));
+        }
+        lineStart = lineEnd + 1;
+    }
+    for (int shared = 0; shared < 2; ++shared) {
+        double spanMs = Bench::BestOf(3, [&]() {
+            SpellFenceState fences;
+            for (const auto& span : spans) {
+                SpellTokenizer tokenizer(text.data(), text.size(), span.first, span.second, shared ? &fences : nullptr);
+                SpellToken token;
+                while (tokenizer.Next(token)) {
+                }
+            }
+        });
+        printf("%zu spans, %s fence state: %.1f ms\n", spans.size(), shared ? "shared" : "no", spanMs);
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Compression ratio and speed of sync payloads (SyncCodec over LzCodec) on note databases: the
+// files named on the command line, or else one built here through Database with a few thousand
+// notes of generated text, tags and checklist items.
+//
+//   bench_sync_codec [notes.db ...]
+#include "bench.h"
+
+#include "database.h"
+#include "sync_codec.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+bool ReadFile(const std::string& path, std::vector<unsigned char>& out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    out.clear();
+    unsigned char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        out.insert(out.end(), buf, buf + n);
+    }
+    fclose(f);
+    return true;
+}
+
+std::string BuildDatabase(int notes) {
+    static const char* words[] = { "meeting", "notes", "tomorrow", "project", "draft", "review", "call", "the",
+                                   "a", "with", "and", "for", "budget", "plan", "ideas", "list", "buy", "milk",
+                                   "follow", "up", "on", "email", "from", "team", "design", "release", "bug" };
+    std::string path = "/tmp/notesofast_bench_" + std::to_string(getpid()) + ".db";
+    remove(path.c_str());
+    Database db;
+    if (!db.Initialize(path)) {
+        return std::string();
+    }
+    std::mt19937 rng(45);
+    std::vector<Database::Tag> tags;
+    for (int i = 0; i < 20; ++i) {
+        Database::Tag tag = { 0, L"tag" + std::to_wstring(i), 0 };
+        db.CreateTag(tag);
+        tags.push_back(tag);
+    }
+    for (int i = 0; i < notes; ++i) {
+        Note note;
+        note.title = std::string(words[rng() % 27]) + " " + words[rng() % 27] + " " + std::to_string(i);
+        size_t length = 200 + rng() % 3000;
+        while (note.content.size() < length) {
+            note.content += words[rng() % 27];
+            note.content += (rng() % 12 == 0) ? "\n" : " ";
+        }
+        db.CreateNote(note);
+        db.AddTagToNote(note.id, tags[rng() % tags.size()].id);
+        if (i % 5 == 0) {
+            ChecklistItem item;
+            item.note_id = note.id;
+            item.item_text = std::string(words[rng() % 27]) + " " + words[rng() % 27];
+            db.CreateChecklistItem(item);
+        }
+    }
+    return path;
+}
+
+void Measure(const std::string& label, const std::vector<unsigned char>& original) {
+    MemorySyncSource source(original.data(), original.size());
+    std::vector<unsigned char> encoded;
+    double compressMs = Bench::BestOf(3, [&]() {
+        SyncCodec::CompressedSource packed(source);
+        packed.Prepare();
+        encoded.resize((size_t)packed.Size());
+        packed.Read(0, encoded.data(), encoded.size());
+    });
+    std::vector<unsigned char> decoded;
+    std::string error;
+    bool ok = true;
+    double decodeMs = Bench::BestOf(3, [&]() {
+        ok = SyncCodec::Decode(encoded, decoded, error);
+    });
+    double mb = original.size() / 1e6;
+    printf("%s: %.1f MB -> %.1f MB (ratio %.2f); compress %.0f MB/s, decode %.0f MB/s%s\n", label.c_str(), mb,
+           encoded.size() / 1e6, (double)original.size() / encoded.size(), mb / (compressMs / 1000),
+           mb / (decodeMs / 1000), ok && decoded == original ? "" : " (ROUND TRIP FAILED)");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<unsigned char> bytes;
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            if (!ReadFile(argv[i], bytes)) {
+                printf("cannot read %s\n", argv[i]);
+                return 1;
+            }
+            Measure(argv[i], bytes);
+        }
+        return 0;
+    }
+
+    std::string path = BuildDatabase(3000);
+    if (path.empty() || !ReadFile(path, bytes)) {
+        printf("cannot build the database\n");
+        return 1;
+    }
+    Measure("generated notes.db (3000 notes)", bytes);
+    remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,96 @@
+// Full-document spell checks through SpellChecker with a cold and a warm verdict cache, against a
+// DAWG of generated words (and Hunspell for the words it lacks, where the build links it). Two
+// documents: 20k words of running text over a 6000-word vocabulary, where the cold pass already
+// hits the cache for repeats, and 6000 distinct words, where it never does.
+#include "bench.h"
+
+#include "dawg_dictionary.h"
+#include "spell_checker.h"
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const size_t kVocabulary = 6000;
+
+std::string Word(size_t index) {
+    static const char* syllables[] = { "ka", "mo", "ri", "tel", "on", "pra", "vis", "un", "der", "gal", "es", "tor" };
+    std::string word;
+    for (size_t n = index + 12; n > 0; n /= 12) {
+        word += syllables[n % 12];
+    }
+    return word;
+}
+
+void Measure(const char* label, SpellChecker& checker, const std::wstring& text, size_t words) {
+    size_t misses = 0;
+    double cold = Bench::BestOf(5, [&]() {
+        checker.InvalidateCache();
+        misses = checker.FindMisspellings(text).size();
+    });
+    double warm = Bench::BestOf(5, [&]() {
+        checker.FindMisspellings(text);
+    });
+    printf("%s: %zu words, cold cache %.2f ms (%.0f ns/word), warm cache %.2f ms (%.0f ns/word), %zu misses\n",
+           label, words, cold, cold * 1e6 / words, warm, warm * 1e6 / words, misses);
+}
+
+} // namespace
+
+int main() {
+    std::vector<std::string> vocabulary;
+    for (size_t i = 0; i < kVocabulary; ++i) {
+        vocabulary.push_back(Word(i));
+    }
+    std::vector<unsigned char> image;
+    std::string error;
+    if (!DawgDictionary::Build(vocabulary, image, error)) {
+        printf("build failed: %s\n", error.c_str());
+        return 1;
+    }
+    std::string base = "/tmp/notesofast_bench_" + std::to_string(getpid());
+    FILE* f = fopen((base + ".dawg").c_str(), "wb");
+    if (!f || fwrite(image.data(), 1, image.size(), f) != image.size()) {
+        printf("cannot write %s.dawg\n", base.c_str());
+        return 1;
+    }
+    fclose(f);
+
+    SpellChecker checker;
+    std::wstring wideBase(base.begin(), base.end());
+    if (!checker.Initialize(wideBase + L".aff", wideBase + L".dic")) {
+        printf("cannot open the dictionary\n");
+        return 1;
+    }
+
+    // Running text: common words far more often than rare ones, sentences starting with a
+    // capital, and one word in fifty misspelled.
+    std::wstring text;
+    unsigned int seed = 1;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        double r = ((seed >> 8) & 0xFFFF) / 65536.0;
+        std::string word = vocabulary[(size_t)(r * r * r * kVocabulary)];
+        if (i % 50 == 17) {
+            word += "q";
+        }
+        if (i % 12 == 0) {
+            word[0] = (char)(word[0] - 'a' + 'A');
+        }
+        text += std::wstring(word.begin(), word.end());
+        text += (i % 12 == 11) ? L".\r\n" : L" ";
+    }
+    Measure("running text", checker, text, 20000);
+
+    std::wstring distinct;
+    for (const std::string& word : vocabulary) {
+        distinct += std::wstring(word.begin(), word.end()) + L" ";
+    }
+    Measure("distinct words", checker, distinct, vocabulary.size());
+
+    remove((base + ".dawg").c_str());
+    return 0;
+}
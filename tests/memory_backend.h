@@ -0,0 +1,105 @@
+#pragma once
+
+#include "sync_backend.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// SyncBackend over a map, for tests: versions are a counter, modified times a fake clock, and
+// beforePut runs at the start of every Put so a test can slip another machine's write in.
+class MemorySyncBackend : public SyncBackend {
+public:
+    struct Object {
+        std::vector<unsigned char> content;
+        std::string version;
+        unsigned long long modifiedTime = 0;
+    };
+
+    std::map<std::string, Object> objects;
+    std::function<void(const std::string& name)> beforePut;
+    size_t puts = 0;
+    unsigned long long bytesPut = 0;
+
+    SyncStatus Put(const std::string& name, const std::vector<unsigned char>& content, const std::string& ifVersion,
+                   SyncObjectInfo* outInfo, std::string& outError) override {
+        if (beforePut) {
+            auto hook = beforePut;
+            beforePut = nullptr;   // The hook may write through this backend itself
+            hook(name);
+        }
+        auto it = objects.find(name);
+        if (!ifVersion.empty()) {
+            bool exists = it != objects.end();
+            if (ifVersion == kSyncCreateOnly ? exists : (!exists || it->second.version != ifVersion)) {
+                outError = name + " was changed by someone else";
+                return SyncStatus::Conflict;
+            }
+        }
+        Object& object = objects[name];
+        object.content = content;
+        object.version = std::to_string(++m_clock);
+        object.modifiedTime = m_clock;
+        ++puts;
+        bytesPut += content.size();
+        if (outInfo) {
+            *outInfo = InfoOf(name, object);
+        }
+        return SyncStatus::Ok;
+    }
+
+    SyncStatus Get(const std::string& name, std::vector<unsigned char>& outContent, SyncObjectInfo* outInfo,
+                   std::string& outError) override {
+        auto it = objects.find(name);
+        if (it == objects.end()) {
+            outError = name + " not found";
+            return SyncStatus::NotFound;
+        }
+        outContent = it->second.content;
+        if (outInfo) {
+            *outInfo = InfoOf(name, it->second);
+        }
+        return SyncStatus::Ok;
+    }
+
+    SyncStatus Stat(const std::string& name, SyncObjectInfo& outInfo, std::string& outError) override {
+        auto it = objects.find(name);
+        if (it == objects.end()) {
+            outError = name + " not found";
+            return SyncStatus::NotFound;
+        }
+        outInfo = InfoOf(name, it->second);
+        return SyncStatus::Ok;
+    }
+
+    SyncStatus List(const std::string& prefix, std::vector<SyncObjectInfo>& outObjects, std::string& outError) override {
+        outObjects.clear();
+        for (const auto& entry : objects) {
+            if (entry.first.compare(0, prefix.size(), prefix) == 0) {
+                outObjects.push_back(InfoOf(entry.first, entry.second));
+            }
+        }
+        return SyncStatus::Ok;
+    }
+
+    SyncStatus Delete(const std::string& name, std::string& outError) override {
+        if (objects.erase(name) == 0) {
+            outError = name + " not found";
+            return SyncStatus::NotFound;
+        }
+        return SyncStatus::Ok;
+    }
+
+private:
+    static SyncObjectInfo InfoOf(const std::string& name, const Object& object) {
+        SyncObjectInfo info;
+        info.name = name;
+        info.version = object.version;
+        info.size = object.content.size();
+        info.modifiedTime = object.modifiedTime;
+        return info;
+    }
+
+    unsigned long long m_clock = 0;
+};
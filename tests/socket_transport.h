@@ -0,0 +1,179 @@
+#pragma once
+
+#include "http_transport.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+
+// Plain HTTP/1.1 over a loopback socket, for the tests to reach tools/sync_server the way
+// WinHttpTransport reaches a real server: one keep-alive connection, reopened when the server has
+// dropped it. Counts what it sends, so tests can check the round trips a sync takes.
+class SocketTransport : public HttpTransport {
+public:
+    explicit SocketTransport(unsigned short port) : m_port(port) {}
+
+    ~SocketTransport() override { Disconnect(); }
+
+    HttpResult Send(const std::string& method,
+                    const std::string& path,
+                    const std::string& headers,
+                    const unsigned char* body,
+                    size_t bodySize) override {
+        std::string request = method + " " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\n" + headers +
+            "Content-Length: " + std::to_string(bodySize) + "\r\n\r\n";
+        if (bodySize > 0) {
+            request.append((const char*)body, bodySize);
+        }
+        HttpResult result;
+        // A kept-alive connection the server has since closed fails at once: retry on a new one.
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            bool reused = m_socket >= 0;
+            if (!reused && !Connect()) {
+                result.error = "Cannot connect to 127.0.0.1:" + std::to_string(m_port);
+                return result;
+            }
+            ++requests;
+            bool answered = false;
+            if (SendAll(request) && Receive(method == "HEAD", result, answered)) {
+                return result;
+            }
+            Disconnect();
+            if (!reused || answered) {
+                break;
+            }
+            result = HttpResult();
+        }
+        result.status = 0;
+        result.error = "Connection to 127.0.0.1:" + std::to_string(m_port) + " lost";
+        return result;
+    }
+
+    // Closes the connection, as a server timing it out would.
+    void Disconnect() {
+        if (m_socket >= 0) {
+            close(m_socket);
+            m_socket = -1;
+        }
+        m_pending.clear();
+    }
+
+    unsigned long long requests = 0;      // Sent, counting retries
+    unsigned long long connections = 0;   // Opened
+
+protected:
+    // Sends some bytes of a request; false when the connection is gone.
+    virtual bool SendBytes(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = send(m_socket, data, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            size -= (size_t)n;
+        }
+        return true;
+    }
+
+private:
+    bool Connect() {
+        m_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (m_socket < 0) {
+            return false;
+        }
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(m_port);
+        if (connect(m_socket, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            Disconnect();
+            return false;
+        }
+        int noDelay = 1;
+        setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        ++connections;
+        return true;
+    }
+
+    bool SendAll(const std::string& data) {
+        return SendBytes(data.data(), data.size());
+    }
+
+    // Reads until m_pending holds at least size bytes.
+    bool Fill(size_t size, bool& answered) {
+        char buf[65536];
+        while (m_pending.size() < size) {
+            ssize_t n = recv(m_socket, buf, sizeof(buf), 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            answered = true;
+            m_pending.append(buf, (size_t)n);
+        }
+        return true;
+    }
+
+    bool Receive(bool noBody, HttpResult& out, bool& answered) {
+        size_t end;
+        while ((end = m_pending.find("\r\n\r\n")) == std::string::npos) {
+            if (!Fill(m_pending.size() + 1, answered)) {
+                return false;
+            }
+        }
+        std::string header = m_pending.substr(0, end + 2);
+        m_pending.erase(0, end + 4);
+
+        size_t lineEnd = header.find("\r\n");
+        size_t space = header.find(' ');
+        if (space == std::string::npos || space > lineEnd) {
+            return false;
+        }
+        out.status = std::strtoul(header.c_str() + space + 1, nullptr, 10);
+        for (size_t pos = lineEnd + 2; pos < header.size();) {
+            size_t next = header.find("\r\n", pos);
+            std::string line = header.substr(pos, next - pos);
+            pos = next + 2;
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string name = line.substr(0, colon);
+            for (char& c : name) {
+                c = (char)std::tolower((unsigned char)c);
+            }
+            size_t value = line.find_first_not_of(' ', colon + 1);
+            out.headers[name] = value == std::string::npos ? std::string() : line.substr(value);
+        }
+
+        auto contentLength = out.headers.find("content-length");
+        size_t length = (noBody || contentLength == out.headers.end())
+            ? 0 : (size_t)std::strtoull(contentLength->second.c_str(), nullptr, 10);
+        if (!Fill(length, answered)) {
+            return false;
+        }
+        out.body = m_pending.substr(0, length);
+        m_pending.erase(0, length);
+        auto connection = out.headers.find("connection");
+        if (connection != out.headers.end() && connection->second == "close") {
+            Disconnect();
+        }
+        return true;
+    }
+
+    unsigned short m_port;
+    int m_socket = -1;
+    std::string m_pending;   // Received, not yet consumed
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "http_sync_backend.h"
+#include "local_sync_backend.h"
+#include "socket_transport.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+// The backends the sync tests run against besides MemorySyncBackend: a sync folder on disk, as
+// LocalSyncBackend writes it, and tools/sync_server on loopback, as HttpSyncBackend talks to it.
+
+// A LocalSyncBackend on a fresh temporary directory, removed again at the end.
+struct SyncFolder {
+    SyncFolder() : path(MakeDir()), backend(std::wstring(path.begin(), path.end())) {}
+
+    ~SyncFolder() {
+        std::string command = "rm -rf '" + path + "'";
+        if (system(command.c_str()) != 0) {
+            printf("  could not remove %s\n", path.c_str());
+        }
+    }
+
+    std::string path;
+    LocalSyncBackend backend;
+
+private:
+    static std::string MakeDir() {
+        char path[] = "/tmp/notesofast_sync_XXXXXX";
+        return mkdtemp(path) ? path : "/tmp";
+    }
+};
+
+// The sync_server built next to the test binary, started on a free port the first time a test
+// needs it and stopped when the tests exit.
+class SyncServer {
+public:
+    // 0 when the server could not be started.
+    static unsigned short Port() {
+        static SyncServer server;
+        return server.m_port;
+    }
+
+private:
+    SyncServer() {
+        char self[4096];
+        ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+        std::string binary = "build/tests/sync_server";
+        if (length > 0) {
+            std::string dir(self, (size_t)length);
+            binary = dir.substr(0, dir.rfind('/') + 1) + "sync_server";
+        }
+        int out[2];
+        if (pipe(out) != 0) {
+            return;
+        }
+        m_pid = fork();
+        if (m_pid == 0) {
+#ifdef __linux__
+            prctl(PR_SET_PDEATHSIG, SIGTERM);   // Not left behind when a test crashes
+#endif
+            dup2(out[1], STDOUT_FILENO);
+            close(out[0]);
+            close(out[1]);
+            execl(binary.c_str(), binary.c_str(), "--port", "0", (char*)nullptr);
+            _exit(127);
+        }
+        close(out[1]);
+        // "Listening on http://127.0.0.1:<port>", or nothing when the server did not start.
+        std::string line;
+        char c;
+        while (m_pid > 0 && line.size() < 256 && read(out[0], &c, 1) == 1 && c != '\n') {
+            line.push_back(c);
+        }
+        close(out[0]);
+        size_t colon = line.rfind(':');
+        if (line.compare(0, 12, "Listening on") == 0 && colon != std::string::npos) {
+            m_port = (unsigned short)std::atoi(line.c_str() + colon + 1);
+        } else {
+            printf("  could not start %s\n", binary.c_str());
+        }
+    }
+
+    ~SyncServer() {
+        if (m_pid > 0) {
+            kill(m_pid, SIGTERM);
+            waitpid(m_pid, nullptr, 0);
+        }
+    }
+
+    pid_t m_pid = -1;
+    unsigned short m_port = 0;
+};
+
+// An HttpSyncBackend on a store of its own on the shared sync_server. The transport stays
+// reachable, so tests can count the requests a sync makes.
+struct SyncServerStore {
+    SyncServerStore() : transport(new SocketTransport(SyncServer::Port())) {
+        static int stores = 0;
+        backend.reset(new HttpSyncBackend(std::unique_ptr<HttpTransport>(transport),
+                                          "/store" + std::to_string(++stores)));
+    }
+
+    bool Running() const { return SyncServer::Port() != 0; }
+
+    SocketTransport* transport;   // Owned by backend
+    std::unique_ptr<HttpSyncBackend> backend;
+};
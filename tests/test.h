@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// Minimal harness for the portable modules' tests: TEST defines a case, CHECK records a failure
+// and carries on, and test_main.cpp runs every case (or those whose names contain argv[1]).
+namespace Test {
+
+struct Case {
+    const char* name;
+    void (*run)();
+};
+
+std::vector<Case>& Cases();
+void Fail(const char* file, int line, const char* expression);
+
+struct Registrar {
+    Registrar(const char* name, void (*run)()) { Cases().push_back({ name, run }); }
+};
+
+} // namespace Test
+
+#define TEST(name) \
+    static void name(); \
+    static Test::Registrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(expression) \
+    do { \
+        if (!(expression)) Test::Fail(__FILE__, __LINE__, #expression); \
+    } while (0)
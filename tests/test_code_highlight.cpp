@@ -0,0 +1,95 @@
+#include "test.h"
+
+#include "code_highlight.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using CodeHighlight::Language;
+using CodeHighlight::TokenKind;
+
+namespace {
+
+typedef std::vector<std::pair<std::wstring, TokenKind>> Tokens;
+
+// The colored runs of text, after checking they cover it in order with no two alike in a row.
+Tokens Colored(Language language, const std::wstring& text) {
+    std::vector<CodeHighlight::Run> runs;
+    CodeHighlight::Lex(language, text.data(), text.size(), runs);
+    Tokens tokens;
+    size_t at = 0;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        CHECK(runs[i].start == at && runs[i].length > 0);
+        CHECK(i == 0 || runs[i].kind != runs[i - 1].kind);
+        at += runs[i].length;
+        if (runs[i].kind != TokenKind::Text) {
+            tokens.push_back(std::make_pair(text.substr(runs[i].start, runs[i].length), runs[i].kind));
+        }
+    }
+    CHECK(at == text.size());
+    return tokens;
+}
+
+} // namespace
+
+TEST(HighlightMapsInfoStrings) {
+    CHECK(CodeHighlight::LanguageFromInfoString(L"cpp") == Language::Cpp);
+    CHECK(CodeHighlight::LanguageFromInfoString(L"Python title=\"x\"") == Language::Python);
+    CHECK(CodeHighlight::LanguageFromInfoString(L"ts{.line-numbers}") == Language::JavaScript);
+    CHECK(CodeHighlight::LanguageFromInfoString(L"SQLite") == Language::Sql);
+    CHECK(CodeHighlight::LanguageFromInfoString(L"") == Language::None);
+    CHECK(CodeHighlight::LanguageFromInfoString(L"cobol") == Language::None);
+    CHECK(Colored(Language::None, L"int x = 1;").empty());
+}
+
+TEST(HighlightFindsKeywordsAndNumbers) {
+    CHECK(Colored(Language::Cpp, L"int main() { return 0x1F; }") ==
+          (Tokens{ { L"int", TokenKind::Keyword }, { L"return", TokenKind::Keyword }, { L"0x1F", TokenKind::Number } }));
+    // Whole words only, and C++ keywords are case-sensitive.
+    CHECK(Colored(Language::Cpp, L"integer Return for_each").empty());
+    CHECK(Colored(Language::Python, L"def f(self): pass") ==
+          (Tokens{ { L"def", TokenKind::Keyword }, { L"self", TokenKind::Keyword }, { L"pass", TokenKind::Keyword } }));
+    CHECK(Colored(Language::Cpp, L"x = 2.5e-3;") == (Tokens{ { L"2.5e-3", TokenKind::Number } }));
+    CHECK(Colored(Language::Cpp, L"#include <x>\nint y;") ==
+          (Tokens{ { L"#include <x>", TokenKind::Preprocessor }, { L"int", TokenKind::Keyword } }));
+}
+
+TEST(HighlightMatchesSqlKeywordsInAnyCase) {
+    CHECK(Colored(Language::Sql, L"SELECT id From notes where Title LIKE 'a%'") ==
+          (Tokens{ { L"SELECT", TokenKind::Keyword }, { L"From", TokenKind::Keyword }, { L"where", TokenKind::Keyword },
+                   { L"LIKE", TokenKind::Keyword }, { L"'a%'", TokenKind::String } }));
+    CHECK(Colored(Language::Sql, L"selected fromage").empty());
+}
+
+TEST(HighlightFindsStringsAndComments) {
+    CHECK(Colored(Language::Cpp, L"s = \"a\\\"b\"; // note \"x\"\nint") ==
+          (Tokens{ { L"\"a\\\"b\"", TokenKind::String }, { L"// note \"x\"", TokenKind::Comment },
+                   { L"int", TokenKind::Keyword } }));
+    CHECK(Colored(Language::Cpp, L"a /* int\nfor */ b") == (Tokens{ { L"/* int\nfor */", TokenKind::Comment } }));
+    CHECK(Colored(Language::Python, L"x = '''a\n'b'\n''' # done") ==
+          (Tokens{ { L"'''a\n'b'\n'''", TokenKind::String }, { L"# done", TokenKind::Comment } }));
+    CHECK(Colored(Language::Sql, L"-- all\nSELECT 1") ==
+          (Tokens{ { L"-- all", TokenKind::Comment }, { L"SELECT", TokenKind::Keyword }, { L"1", TokenKind::Number } }));
+    // Shell: '#' starts a comment only at the start of a word.
+    CHECK(Colored(Language::Shell, L"echo a#b $HOME # c") ==
+          (Tokens{ { L"echo", TokenKind::Keyword }, { L"$HOME", TokenKind::Variable }, { L"# c", TokenKind::Comment } }));
+    CHECK(Colored(Language::Json, L"{\"key\": \"value\", \"n\": null}") ==
+          (Tokens{ { L"\"key\"", TokenKind::Variable }, { L"\"value\"", TokenKind::String }, { L"\"n\"", TokenKind::Variable },
+                   { L"null", TokenKind::Keyword } }));
+}
+
+TEST(HighlightEndsUnterminatedTokens) {
+    // A string stops at the end of its line unless the language lets it span lines.
+    CHECK(Colored(Language::Cpp, L"\"open\nint x;") ==
+          (Tokens{ { L"\"open", TokenKind::String }, { L"int", TokenKind::Keyword } }));
+    CHECK(Colored(Language::JavaScript, L"`open\nlet x") == (Tokens{ { L"`open\nlet x", TokenKind::String } }));
+    CHECK(Colored(Language::Python, L"'''open\nif x:") == (Tokens{ { L"'''open\nif x:", TokenKind::String } }));
+    CHECK(Colored(Language::Cpp, L"\"ends in escape\\") == (Tokens{ { L"\"ends in escape\\", TokenKind::String } }));
+    // A block comment with no close runs to the end.
+    CHECK(Colored(Language::Cpp, L"int /* open\nreturn") ==
+          (Tokens{ { L"int", TokenKind::Keyword }, { L"/* open\nreturn", TokenKind::Comment } }));
+    CHECK(Colored(Language::Sql, L"/*") == (Tokens{ { L"/*", TokenKind::Comment } }));
+    CHECK(Colored(Language::Shell, L"echo ${open") ==
+          (Tokens{ { L"echo", TokenKind::Keyword }, { L"${open", TokenKind::Variable } }));
+}
@@ -0,0 +1,93 @@
+#include "test.h"
+
+#include "dawg_dictionary.h"
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Writes the image of words to a temporary file and opens it, as the spell checker does.
+bool OpenBuilt(const std::vector<std::string>& words, DawgDictionary& dict, std::vector<unsigned char>* image = nullptr) {
+    std::vector<unsigned char> built;
+    std::string error;
+    if (!DawgDictionary::Build(words, built, error)) {
+        return false;
+    }
+    std::string path = "/tmp/notesofast_test_" + std::to_string(getpid()) + ".dawg";
+    FILE* f = fopen(path.c_str(), "wb");
+    bool ok = f && fwrite(built.data(), 1, built.size(), f) == built.size();
+    if (f) {
+        fclose(f);
+    }
+    ok = ok && dict.Open(std::wstring(path.begin(), path.end()));
+    remove(path.c_str());   // The mapping stays valid
+    if (image) {
+        *image = std::move(built);
+    }
+    return ok;
+}
+
+bool Has(const DawgDictionary& dict, const std::string& word) {
+    return dict.Contains(word.data(), word.size());
+}
+
+} // namespace
+
+TEST(DawgAcceptsExactlyItsWords) {
+    DawgDictionary dict;
+    CHECK(OpenBuilt({ "walk", "walked", "walking", "walks", "talk", "talked", "talks", "a", "caf\xc3\xa9", "walk" }, dict));
+    CHECK(dict.IsOpen());
+    CHECK(dict.WordCount() == 9);
+    CHECK(Has(dict, "walk") && Has(dict, "walking") && Has(dict, "talks") && Has(dict, "a"));
+    CHECK(Has(dict, "caf\xc3\xa9"));
+    CHECK(!Has(dict, "wal") && !Has(dict, "walke") && !Has(dict, "talking") && !Has(dict, "") && !Has(dict, "Walk"));
+}
+
+TEST(DawgSharesSuffixes) {
+    // Every stem takes the same endings: minimization merges the ending subtrees, so the image
+    // grows with the stems, not stems x endings.
+    std::vector<std::string> words;
+    const char* endings[] = { "", "s", "ed", "ing", "er", "ers", "able", "ation", "ations" };
+    for (int i = 0; i < 2000; ++i) {
+        std::string stem = "st" + std::to_string(i * 7919 % 100000) + "x";
+        for (const char* ending : endings) {
+            words.push_back(stem + ending);
+        }
+    }
+    DawgDictionary dict;
+    std::vector<unsigned char> image;
+    CHECK(OpenBuilt(words, dict, &image));
+    CHECK(dict.WordCount() == words.size());
+    size_t textBytes = 0;
+    for (const std::string& w : words) {
+        textBytes += w.size() + 1;
+        if (!Has(dict, w)) {
+            CHECK(Has(dict, w));
+            break;
+        }
+    }
+    CHECK(image.size() < textBytes / 2);
+    CHECK(!Has(dict, "st0xingly"));
+}
+
+TEST(DawgRejectsDamagedFiles) {
+    std::vector<unsigned char> image;
+    std::string error;
+    CHECK(DawgDictionary::Build({ "one", "two" }, image, error));
+    image.pop_back();
+    std::string path = "/tmp/notesofast_test_bad_" + std::to_string(getpid()) + ".dawg";
+    FILE* f = fopen(path.c_str(), "wb");
+    CHECK(f != nullptr);
+    if (f) {
+        fwrite(image.data(), 1, image.size(), f);
+        fclose(f);
+    }
+    DawgDictionary dict;
+    CHECK(!dict.Open(std::wstring(path.begin(), path.end())));
+    CHECK(!dict.IsOpen() && !Has(dict, "one"));
+    remove(path.c_str());
+    CHECK(!dict.Open(L"/nonexistent/path.dawg"));
+}
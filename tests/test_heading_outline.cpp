@@ -0,0 +1,135 @@
+#include "test.h"
+
+#include "heading_outline.h"
+#include "text_edit.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<OutlineHeading> HeadingsOf(const std::wstring& text) {
+    HeadingOutline outline;
+    outline.Rebuild(text.c_str(), text.size());
+    std::vector<OutlineHeading> headings;
+    outline.GetHeadings(headings);
+    return headings;
+}
+
+bool SameHeadings(const std::vector<OutlineHeading>& a, const std::vector<OutlineHeading>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].offset != b[i].offset || a[i].level != b[i].level || a[i].text != b[i].text) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Applies after as an edit of the outline of before, rebuilding when the outline asks for it.
+void Edit(HeadingOutline& outline, std::wstring& text, const std::wstring& after) {
+    TextEdit edit = DiffTextEdit(text, after);
+    text = after;
+    if (!outline.ApplyEdit(text.c_str(), text.size(), edit)) {
+        outline.Rebuild(text.c_str(), text.size());
+    }
+}
+
+} // namespace
+
+TEST(OutlineFindsHeadingsOutsideFences) {
+    std::wstring text = L"# One\r\ntext\n## Two\n```\n# not a heading\n```\n###### Six\n####### seven\n#nospace\n";
+    auto headings = HeadingsOf(text);
+    CHECK(headings.size() == 3);
+    if (headings.size() == 3) {
+        CHECK(headings[0].offset == 0 && headings[0].level == 1 && headings[0].text == L"One");
+        CHECK(headings[1].offset == text.find(L"## Two") && headings[1].level == 2 && headings[1].text == L"Two");
+        CHECK(headings[2].offset == text.find(L"###### Six") && headings[2].level == 6);
+    }
+}
+
+TEST(OutlineInsertShiftsLaterHeadings) {
+    std::wstring text = L"# A\nbody\n# B\nbody\n# C\n";
+    HeadingOutline outline;
+    outline.Rebuild(text.c_str(), text.size());
+    Edit(outline, text, L"# A\nbody\n## New\nmore body text\n# B\nbody\n# C\n");
+    std::vector<OutlineHeading> headings;
+    outline.GetHeadings(headings);
+    CHECK(outline.Count() == 4);
+    CHECK(SameHeadings(headings, HeadingsOf(text)));
+}
+
+TEST(OutlineRemoveDropsHeadings) {
+    std::wstring text = L"# A\n# B\n# C\n# D\n";
+    HeadingOutline outline;
+    outline.Rebuild(text.c_str(), text.size());
+    Edit(outline, text, L"# A\n# D\n");
+    std::vector<OutlineHeading> headings;
+    outline.GetHeadings(headings);
+    CHECK(outline.Count() == 2);
+    CHECK(SameHeadings(headings, HeadingsOf(text)));
+    Edit(outline, text, L"");
+    CHECK(outline.Count() == 0);
+}
+
+TEST(OutlineFindHeadingAtRanksByOffset) {
+    std::wstring text = L"intro\n# A\nx\n# B\ny\n# C\n";
+    HeadingOutline outline;
+    outline.Rebuild(text.c_str(), text.size());
+    CHECK(outline.FindHeadingAt(0) == -1);
+    CHECK(outline.FindHeadingAt(text.find(L"# A")) == 0);
+    CHECK(outline.FindHeadingAt(text.find(L"x")) == 0);
+    CHECK(outline.FindHeadingAt(text.find(L"# B")) == 1);
+    CHECK(outline.FindHeadingAt(text.size()) == 2);
+}
+
+TEST(OutlineRandomEditsMatchRebuild) {
+    const wchar_t* pieces[] = { L"# Head\n", L"## Sub heading\r\n", L"plain words ", L"\n", L"\r\n", L"#", L" ",
+                                L"text\n### Deep\n", L"```\n", L"~~~\n", L"####### no\n" };
+    std::mt19937 rng(12345);
+    std::wstring text = L"# Start\nbody\n";
+    HeadingOutline outline;
+    outline.Rebuild(text.c_str(), text.size());
+    for (int step = 0; step < 3000; ++step) {
+        std::wstring after = text;
+        size_t at = after.empty() ? 0 : rng() % (after.size() + 1);
+        if (rng() % 3 == 0 && !after.empty()) {
+            size_t length = std::min<size_t>(1 + rng() % 12, after.size() - std::min(at, after.size()));
+            after.erase(std::min(at, after.size()), length);
+        } else {
+            after.insert(at, pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))]);
+        }
+        if (after.size() > 4000) {
+            after.erase(0, 2000);
+        }
+        Edit(outline, text, after);
+
+        std::vector<OutlineHeading> headings;
+        outline.GetHeadings(headings);
+        auto expected = HeadingsOf(text);
+        if (!SameHeadings(headings, expected)) {
+            CHECK(SameHeadings(headings, expected));
+            break;
+        }
+        CHECK(outline.Count() == expected.size());
+
+        size_t probe = rng() % (text.size() + 1);
+        int rank = -1;
+        for (size_t i = 0; i < expected.size() && expected[i].offset <= probe; ++i) {
+            rank = (int)i;
+        }
+        CHECK(outline.FindHeadingAt(probe) == rank);
+    }
+}
+
+TEST(DiffTextEditTrimsCommonEnds) {
+    TextEdit edit = DiffTextEdit(L"hello world", L"hello brave world");
+    CHECK(edit.offset == 6 && edit.removed == 0 && edit.inserted == 6);
+    edit = DiffTextEdit(L"abcdef", L"abXef");
+    CHECK(edit.offset == 2 && edit.removed == 2 && edit.inserted == 1);
+    CHECK(DiffTextEdit(L"same", L"same").Empty());
+}
@@ -0,0 +1,140 @@
+#include "test.h"
+
+#include "html_document.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+Note MakeNote(int id, const std::string& title, const std::string& content) {
+    Note note;
+    note.id = id;
+    note.title = title;
+    note.content = content;
+    note.created_at = "2026-01-02 03:04:05";
+    note.modified_at = "2026-01-02 03:04:05";
+    return note;
+}
+
+std::string Export(const Note& note, const HtmlDocument::LinkTargets* links = nullptr) {
+    std::string out;
+    bool ok = HtmlDocument::WriteNote(note, links, [&](const char* data, size_t size) {
+        out.append(data, size);
+        return true;
+    });
+    return ok ? out : std::string();
+}
+
+bool Contains(const std::string& html, const std::string& part) {
+    return html.find(part) != std::string::npos;
+}
+
+} // namespace
+
+TEST(HtmlEscapesTitleContentAndItems) {
+    Note note = MakeNote(1, "<script>\"Tom\" & 'Jerry'</script>", "a < b && c > \"d\"\r\nline <i>two</i>");
+    std::string html = Export(note);
+    CHECK(Contains(html, "<title>&lt;script&gt;&quot;Tom&quot; &amp; &#39;Jerry&#39;&lt;/script&gt;</title>"));
+    CHECK(Contains(html, "<p>a &lt; b &amp;&amp; c &gt; &quot;d&quot;\nline &lt;i&gt;two&lt;/i&gt;</p>"));
+    CHECK(!Contains(html, "<script>") && !Contains(html, "<i>") && !Contains(html, "\r"));
+
+    Note list = MakeNote(2, "list", "");
+    list.is_checklist = true;
+    ChecklistItem item;
+    item.item_text = "milk & <eggs>";
+    item.is_checked = true;
+    list.checklist_items.push_back(item);
+    CHECK(Contains(Export(list), "<li><input type=\"checkbox\" disabled checked> milk &amp; &lt;eggs&gt;</li>"));
+}
+
+TEST(HtmlEscapesCodeAndKeepsUnicode) {
+    std::string html = Export(MakeNote(1, "code", "```cpp\nif (a < b) return \"x&y\";\n```\n\n\xC3\xA9t\xC3\xA9 \xF0\x9F\x98\x80"));
+    CHECK(Contains(html, "<span class=\"kw\">if</span> (a &lt; b)"));
+    CHECK(Contains(html, "<span class=\"str\">&quot;x&amp;y&quot;</span>"));
+    CHECK(Contains(html, "<p>\xC3\xA9t\xC3\xA9 \xF0\x9F\x98\x80</p>"));
+}
+
+TEST(HtmlWritesOnlySafeLinks) {
+    std::string html = Export(MakeNote(1, "links",
+        "[ok](https://example.com/?a=1&b=\"2\") [bad](javascript:alert(1)) [bare](example.org)"));
+    CHECK(Contains(html, "<a href=\"https://example.com/?a=1&amp;b=&quot;2&quot;\">ok</a>"));
+    CHECK(!Contains(html, "javascript:") && Contains(html, "bad"));
+    CHECK(Contains(html, "<a href=\"https://example.org\">bare</a>"));
+}
+
+TEST(HtmlLinksBetweenExportedNotes) {
+    std::vector<Note> notes = {
+        MakeNote(7, "Target Note", "the later one"),
+        MakeNote(3, "target note", "the first one"),
+        MakeNote(4, "Caf\xC3\xA9 & <plans>", "x"),
+    };
+    HtmlDocument::LinkTargets links;
+    std::vector<std::wstring> fileNames;
+    for (const Note& note : notes) {
+        fileNames.push_back(HtmlDocument::FileNameForNote(note));
+        links.Add(note, fileNames.back());
+    }
+    CHECK(fileNames[2] == L"Caf\u00e9 & _plans_-4.html");
+
+    Note source = MakeNote(1, "source", "See [[TARGET NOTE]], [[Caf\xC3\xA9 & <plans>]] and [[missing <one>]].");
+    std::string html = Export(source, &links);
+    // Titles ignore ASCII case and the lowest id wins, as the app resolves links.
+    CHECK(Contains(html, "<a class=\"wikilink\" href=\"target%20note-3.html\">TARGET NOTE</a>"));
+    CHECK(Contains(html, "<a class=\"wikilink\" href=\"Caf%C3%A9%20%26%20_plans_-4.html\">Caf\xC3\xA9 &amp; &lt;plans&gt;</a>"));
+    CHECK(Contains(html, "<span class=\"wikilink\" title=\"missing &lt;one&gt;\">missing &lt;one&gt;</span>"));
+
+    // Exported alone, a note's links have nowhere to point.
+    CHECK(!Contains(Export(source), "<a class=\"wikilink\""));
+}
+
+TEST(HtmlIndexLinksEveryExportedNote) {
+    std::vector<Note> notes = { MakeNote(1, "a & b", "x"), MakeNote(2, "", "y"), MakeNote(3, "failed", "z") };
+    std::vector<std::wstring> fileNames;
+    for (const Note& note : notes) {
+        fileNames.push_back(HtmlDocument::FileNameForNote(note));
+    }
+    std::string html;
+    CHECK(HtmlDocument::WriteIndex("Notes <all>", notes, fileNames, { 1, 1, 0 }, [&](const char* data, size_t size) {
+        html.append(data, size);
+        return true;
+    }));
+    CHECK(Contains(html, "<h1>Notes &lt;all&gt;</h1>"));
+    CHECK(Contains(html, "<li><a href=\"a%20%26%20b-1.html\">a &amp; b</a>"));
+    CHECK(Contains(html, "<li><a href=\"note-2.html\">(untitled)</a>"));
+    CHECK(!Contains(html, "failed"));
+}
+
+TEST(HtmlFileNamesAreValidOnWindows) {
+    CHECK(HtmlDocument::FileNameForNote(MakeNote(5, "a/b\\c:d*e?f\"g<h>i|j", "")) == L"a_b_c_d_e_f_g_h_i_j-5.html");
+    CHECK(HtmlDocument::FileNameForNote(MakeNote(6, "trailing. . ", "")) == L"trailing-6.html");
+    CHECK(HtmlDocument::FileNameForNote(MakeNote(8, "...", "")) == L"note-8.html");
+    std::wstring longName = HtmlDocument::FileNameForNote(MakeNote(9, std::string(100, 'x'), ""));
+    CHECK(longName == std::wstring(48, L'x') + L"-9.html");
+}
+
+TEST(HtmlStreamsLargeNotesInChunks) {
+    std::string content;
+    for (int i = 0; i < 40000; ++i) {
+        content += "## Heading " + std::to_string(i) + "\nSome *text* & more text on line " + std::to_string(i) + ".\n\n";
+    }
+    size_t chunks = 0;
+    size_t largest = 0;
+    size_t total = 0;
+    CHECK(HtmlDocument::WriteNote(MakeNote(1, "big", content), nullptr, [&](const char*, size_t size) {
+        ++chunks;
+        largest = std::max(largest, size);
+        total += size;
+        return true;
+    }));
+    CHECK(total > content.size() && chunks > 10 && largest < 128 * 1024);
+
+    // A sink that fails stops the document.
+    size_t calls = 0;
+    CHECK(!HtmlDocument::WriteNote(MakeNote(1, "big", content), nullptr, [&](const char*, size_t) {
+        ++calls;
+        return false;
+    }));
+    CHECK(calls == 1);
+}
@@ -0,0 +1,192 @@
+#include "test.h"
+
+#include "database.h"
+#include "page_delta.h"
+#include "sync_backends.h"
+#include "sync_ops.h"
+
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// The server's own count of the requests it has answered, from GET /stats.
+unsigned long long ServerRequests() {
+    SocketTransport transport(SyncServer::Port());
+    HttpResult resp = transport.Send("GET", "/stats", std::string(), nullptr, 0);
+    size_t at = resp.body.find("requests ");
+    return resp.status == 200 && at != std::string::npos ? std::stoull(resp.body.substr(at + 9)) : 0;
+}
+
+// One sync as the app runs it: exchange journaled edits, then push a snapshot of the database.
+bool Sync(Database& db, SyncBackend& backend, PageDelta::SyncState& state, const std::string& snapshotPath) {
+    OpSyncStats stats;
+    std::string error;
+    if (!OpSync::Exchange(db, backend, "notes.db.ops.", stats, error) || !db.BackupToFile(snapshotPath)) {
+        return false;
+    }
+    std::ifstream in(snapshotPath, std::ios::binary);
+    std::vector<unsigned char> snapshot((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    MemorySyncSource source(snapshot.data(), snapshot.size());
+    uint64_t fingerprint = 0;
+    if (state.fingerprint != 0 && PageDelta::Fingerprint(source, fingerprint) && fingerprint == state.fingerprint) {
+        return true;   // Nothing to send, as CloudSync::UploadDatabaseSnapshot skips the push
+    }
+    PageDelta::PushResult result;
+    return PageDelta::Push(backend, "notes.db", source, state, result, SyncProgress(), error) == SyncStatus::Ok;
+}
+
+// Sends all but the last withheld bytes of a request, then hangs up: the server sees a request cut
+// off mid-body and drops it, and no response arrives.
+class CutOffTransport : public SocketTransport {
+public:
+    CutOffTransport(unsigned short port, size_t withheld) : SocketTransport(port), m_withheld(withheld) {}
+
+protected:
+    bool SendBytes(const char* data, size_t size) override {
+        SocketTransport::SendBytes(data, size - std::min(size, m_withheld));
+        Disconnect();
+        return false;
+    }
+
+private:
+    size_t m_withheld;
+};
+
+// A transport to sync_server whose connection drops once, partway through the upload chunk that
+// carries byte dropAt. Keeps the Content-Range of every request.
+class DroppingTransport : public HttpTransport {
+public:
+    DroppingTransport(unsigned short port, unsigned long long dropAt)
+        : m_port(port), m_inner(port), m_dropAt(dropAt) {}
+
+    HttpResult Send(const std::string& method,
+                    const std::string& path,
+                    const std::string& headers,
+                    const unsigned char* body,
+                    size_t bodySize) override {
+        size_t at = headers.find("Content-Range: ");
+        if (at != std::string::npos) {
+            ranges.push_back(headers.substr(at + 15, headers.find("\r\n", at) - at - 15));
+        }
+        unsigned long long first = at == std::string::npos ? 0 : std::strtoull(headers.c_str() + at + 21, nullptr, 10);
+        if (!dropped && bodySize > 0 && first <= m_dropAt && m_dropAt < first + bodySize) {
+            dropped = true;
+            CutOffTransport cut(m_port, (size_t)(first + bodySize - m_dropAt));
+            return cut.Send(method, path, headers, body, bodySize);
+        }
+        return m_inner.Send(method, path, headers, body, bodySize);
+    }
+
+    std::vector<std::string> ranges;
+    bool dropped = false;
+
+private:
+    unsigned short m_port;
+    SocketTransport m_inner;
+    unsigned long long m_dropAt;
+};
+
+} // namespace
+
+TEST(HttpSyncResumesUploadAfterDroppedConnection) {
+    if (!SyncServerStore().Running()) {
+        CHECK(false);
+        return;
+    }
+    // Two and a half chunks; the connection drops in the second, then in the first.
+    const unsigned long long total = kSyncChunkSize * 5 / 2;
+    std::vector<unsigned char> content((size_t)total);
+    std::mt19937 rng(7);
+    for (unsigned char& c : content) {
+        c = (unsigned char)rng();
+    }
+    const unsigned long long chunk = kSyncChunkSize;
+    struct Case {
+        unsigned long long dropAt;
+        unsigned long long resumeFrom;
+        std::vector<unsigned long long> progress;   // Bytes sent, as reported
+    };
+    const Case cases[] = {
+        // The first chunk is kept and reported again once the server confirms it.
+        { chunk + chunk / 2, chunk, { chunk, chunk, 2 * chunk, total } },
+        { 1000, 0, { 0, chunk, 2 * chunk, total } },
+    };
+    int store = 0;
+    for (const Case& c : cases) {
+        DroppingTransport* transport = new DroppingTransport(SyncServer::Port(), c.dropAt);
+        HttpSyncBackend backend{std::unique_ptr<HttpTransport>(transport), "/resume" + std::to_string(++store)};
+        std::vector<unsigned long long> sent;
+        bool totals = true;
+        SyncProgress progress = [&](unsigned long long done, unsigned long long all) {
+            sent.push_back(done);
+            totals = totals && all == total;
+        };
+
+        MemorySyncSource source(content.data(), content.size());
+        SyncObjectInfo info;
+        std::string error;
+        CHECK(backend.PutStream("big.db", source, std::string(), &info, progress, error) == SyncStatus::Ok);
+        CHECK(transport->dropped && info.size == total);
+
+        // The dropped chunk, a query with no data, then the rest from what the server kept.
+        std::string totalText = std::to_string(total);
+        size_t dropped = c.dropAt / chunk;
+        CHECK(transport->ranges.size() == dropped + 2 + (3 - c.resumeFrom / chunk));
+        if (transport->ranges.size() > dropped + 2) {
+            CHECK(transport->ranges[dropped + 1] == "bytes */" + totalText);
+            CHECK(transport->ranges[dropped + 2] ==
+                  "bytes " + std::to_string(c.resumeFrom) + "-" + std::to_string(c.resumeFrom + chunk - 1) + "/" + totalText);
+        }
+        CHECK(sent == c.progress && totals);
+
+        std::vector<unsigned char> stored;
+        CHECK(backend.Get("big.db", stored, nullptr, error) == SyncStatus::Ok);
+        CHECK(stored == content);
+    }
+}
+
+TEST(HttpSyncRoundTripsPerSync) {
+    SyncServerStore store;
+    CHECK(store.Running());
+    if (!store.Running()) {
+        return;
+    }
+    SyncFolder dir;
+    Database db;
+    CHECK(db.Initialize(dir.path + "/a.db"));
+    for (int i = 0; i < 20; ++i) {
+        Note note;
+        note.title = "note " + std::to_string(i);
+        note.content = std::string(200, 'a' + i % 26);
+        CHECK(db.CreateNote(note));
+    }
+    PageDelta::SyncState state;
+    std::string snapshot = dir.path + "/snapshot.db";
+    CHECK(Sync(db, *store.backend, state, snapshot));
+
+    unsigned long long serverBefore = ServerRequests();
+    unsigned long long before = store.transport->requests;
+    CHECK(Sync(db, *store.backend, state, snapshot));
+    unsigned long long idle = store.transport->requests - before;
+
+    Note note;
+    note.title = "edited";
+    CHECK(db.CreateNote(note));
+    before = store.transport->requests;
+    CHECK(Sync(db, *store.backend, state, snapshot));
+    unsigned long long edited = store.transport->requests - before;
+    // Unchanged: one listing of the op batches. One new note: the listing, the batch, the manifest
+    // read, patch and manifest writes, and the listing that looks for replaced objects to delete.
+    CHECK(idle == 1);
+    CHECK(edited <= 6);
+
+    // What the transport counted is what reached the server (plus the second /stats request).
+    CHECK(ServerRequests() - serverBefore == idle + edited + 1);
+    // Every request of every sync went over the one kept-alive connection.
+    CHECK(store.transport->connections == 1);
+    db.Close();
+}
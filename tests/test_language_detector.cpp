@@ -0,0 +1,68 @@
+#include "test.h"
+
+#include "language_detector.h"
+
+#include <string>
+
+namespace {
+
+const std::vector<std::string> kAll = { "en", "de", "fr", "es", "it", "pt", "nl" };
+
+std::string Detect(const std::wstring& text, const std::vector<std::string>& candidates = kAll) {
+    return LanguageDetector::Detect(text.c_str(), text.size(), candidates);
+}
+
+// Words of random letters: almost every trigram is new.
+std::wstring RandomWords(size_t words, size_t wordLength, unsigned int seed) {
+    std::wstring text;
+    for (size_t w = 0; w < words; ++w) {
+        for (size_t i = 0; i < wordLength; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            text.push_back((wchar_t)(L'a' + (seed >> 8) % 26));
+        }
+        text.push_back(L' ');
+    }
+    return text;
+}
+
+} // namespace
+
+TEST(DetectsCommonLanguages) {
+    CHECK(Detect(L"The meeting with the design team is moved to Thursday. We will review the mockups for the "
+                 L"new onboarding flow and decide which of the two options to ship first. Please bring your "
+                 L"notes and any feedback from customers that you collected during the last week.") == "en");
+    CHECK(Detect(L"Die Besprechung mit dem Designteam wurde auf Donnerstag verschoben. Wir werden die "
+                 L"Entw\u00FCrfe f\u00FCr den neuen Ablauf pr\u00FCfen und entscheiden, welche der beiden "
+                 L"Varianten wir zuerst ausliefern. Bitte bringt eure Notizen und das Feedback der Kunden "
+                 L"mit, das ihr in der letzten Woche gesammelt habt.") == "de");
+    CHECK(Detect(L"La r\u00E9union avec l'\u00E9quipe de conception est d\u00E9plac\u00E9e \u00E0 jeudi. "
+                 L"Nous allons examiner les maquettes du nouveau parcours et d\u00E9cider laquelle des deux "
+                 L"options sera livr\u00E9e en premier. Merci d'apporter vos notes et les retours des "
+                 L"clients que vous avez recueillis pendant la semaine derni\u00E8re.") == "fr");
+    CHECK(Detect(L"De vergadering met het ontwerpteam is verplaatst naar donderdag. We gaan de ontwerpen van "
+                 L"de nieuwe registratiestroom bekijken en beslissen welke van de twee opties we als eerste "
+                 L"uitbrengen. Neem alsjeblieft je aantekeningen mee en de feedback van klanten die je "
+                 L"vorige week hebt verzameld.") == "nl");
+}
+
+TEST(DetectIgnoresCodeAndShortText) {
+    CHECK(Detect(L"ok") == "");
+    CHECK(Detect(L"```cpp\nint main() { return foo_bar(x); }\n```\nRemember to call the plumber about the "
+                 L"leaking kitchen sink before the weekend, and check whether the invoice from the last "
+                 L"visit was already paid.") == "en");
+    // Only the candidates are considered.
+    CHECK(Detect(L"The meeting with the design team is moved to Thursday. We will review the mockups for the "
+                 L"new onboarding flow and decide which of the two options to ship first.", { "de", "fr" }) == "");
+}
+
+TEST(DetectFinishesOnHighEntropyText) {
+    // Far more distinct trigrams than the counting table has slots.
+    CHECK(Detect(RandomWords(400, 14, 1)) == "");
+    CHECK(Detect(RandomWords(1, 16 * 1024, 2)) == "");
+    // English after a block of noise is still sampled and scored.
+    std::wstring mixed = RandomWords(40, 10, 3);
+    for (int i = 0; i < 20; ++i) {
+        mixed += L"the weather is nice and we are going to walk with the dog to the river in the morning. ";
+    }
+    CHECK(Detect(mixed) == "en");
+}
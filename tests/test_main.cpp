@@ -0,0 +1,43 @@
+#include "test.h"
+
+#include <cstring>
+
+namespace {
+
+int g_failures = 0;
+
+} // namespace
+
+namespace Test {
+
+std::vector<Case>& Cases() {
+    static std::vector<Case> cases;
+    return cases;
+}
+
+void Fail(const char* file, int line, const char* expression) {
+    printf("  FAILED %s:%d: %s\n", file, line, expression);
+    ++g_failures;
+}
+
+} // namespace Test
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    int run = 0;
+    int failedCases = 0;
+    for (const Test::Case& c : Test::Cases()) {
+        if (filter && !strstr(c.name, filter)) {
+            continue;
+        }
+        int before = g_failures;
+        c.run();
+        ++run;
+        if (g_failures != before) {
+            printf("%s: FAILED\n", c.name);
+            ++failedCases;
+        }
+    }
+    printf("%d test(s), %d failed\n", run, failedCases);
+    return failedCases == 0 ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+#include "test.h"
+
+#include "markdown.h"
+
+TEST(SafeLinksKeepWebAndMailSchemes) {
+    CHECK(Markdown::IsSafeLinkUrl(L"https://example.com/a?b=c"));
+    CHECK(Markdown::IsSafeLinkUrl(L"HTTP://example.com"));
+    CHECK(Markdown::IsSafeLinkUrl(L"mailto:someone@example.com"));
+}
+
+TEST(SafeLinksAllowRelativeUrls) {
+    CHECK(Markdown::IsSafeLinkUrl(L"example.com"));
+    CHECK(Markdown::IsSafeLinkUrl(L"notes/other.html"));
+    CHECK(Markdown::IsSafeLinkUrl(L"../up.html#a:b"));
+    CHECK(Markdown::IsSafeLinkUrl(L"#section"));
+    CHECK(Markdown::IsSafeLinkUrl(L"?q=a:b"));
+    CHECK(Markdown::IsSafeLinkUrl(L"//cdn.example.com/x"));
+}
+
+TEST(SafeLinksRejectScriptAndLocalSchemes) {
+    CHECK(!Markdown::IsSafeLinkUrl(L"javascript:alert(1)"));
+    CHECK(!Markdown::IsSafeLinkUrl(L"JavaScript:alert(1)"));
+    CHECK(!Markdown::IsSafeLinkUrl(L"  javascript:alert(1)"));
+    CHECK(!Markdown::IsSafeLinkUrl(L"java\tscript:alert(1)"));
+    CHECK(!Markdown::IsSafeLinkUrl(L"java\nscript:alert(1)"));
+    CHECK(!Markdown::IsSafeLinkUrl(L"data:text/html,<b>x</b>"));
+    CHECK(!Markdown::IsSafeLinkUrl(L"vbscript:msgbox"));
+    CHECK(!Markdown::IsSafeLinkUrl(L"file:///C:/Windows"));
+}
@@ -0,0 +1,140 @@
+#include "test.h"
+
+#include "markdown.h"
+#include "markdown_chunks.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// Renders chunks the way the preview and the HTML exporter do, each on its own: a fence opens a
+// code block that runs to a matching closing fence or the end of the chunk. Returns, per chunk
+// line that is not a fence, whether it came out as code.
+std::vector<std::pair<std::wstring, bool>> RenderChunks(const std::wstring& text, const MarkdownChunkLimits& limits,
+                                                        size_t* chunkCount = nullptr) {
+    std::vector<std::pair<std::wstring, bool>> out;
+    MarkdownChunkScheduler chunks;
+    unsigned int generation = chunks.Reset(text);
+    std::vector<std::wstring> lines;
+    size_t count = 0;
+    while (chunks.NextChunk(generation, limits, lines)) {
+        ++count;
+        wchar_t openChar = 0;
+        size_t openLength = 0;
+        for (const std::wstring& line : lines) {
+            wchar_t fenceChar = 0;
+            size_t fenceLength = 0;
+            std::wstring info;
+            if (Markdown::ParseMarkdownFence(line, fenceChar, fenceLength, &info)) {
+                if (openChar == 0) {
+                    openChar = fenceChar;
+                    openLength = fenceLength;
+                    continue;
+                }
+                if (fenceChar == openChar && fenceLength >= openLength && info.empty()) {
+                    openChar = 0;
+                    continue;
+                }
+            }
+            out.push_back(std::make_pair(line, openChar != 0));
+        }
+    }
+    if (chunkCount) {
+        *chunkCount = count;
+    }
+    return out;
+}
+
+} // namespace
+
+TEST(ChunksCutOnlyAfterBlankLines) {
+    std::wstring text;
+    for (int i = 0; i < 100; ++i) {
+        text += L"Paragraph " + std::to_wstring(i) + L" with some words.\n\n";
+    }
+    MarkdownChunkLimits limits;
+    limits.minChars = 200;
+
+    MarkdownChunkScheduler chunks;
+    unsigned int generation = chunks.Reset(text);
+    std::vector<std::wstring> lines;
+    std::wstring joined;
+    size_t count = 0;
+    while (chunks.NextChunk(generation, limits, lines)) {
+        ++count;
+        CHECK(!lines.empty());
+        CHECK(lines.back().empty() || !chunks.HasMore());
+        for (const std::wstring& line : lines) {
+            joined += line + L"\n";
+        }
+    }
+    CHECK(count > 1);
+    CHECK(joined == text + L"\n");
+}
+
+TEST(ChunksResetDropsTheOldGeneration) {
+    MarkdownChunkScheduler chunks;
+    unsigned int first = chunks.Reset(L"a\n\nb\n");
+    unsigned int second = chunks.Reset(L"c\n");
+    std::vector<std::wstring> lines;
+    MarkdownChunkLimits limits;
+    CHECK(!chunks.NextChunk(first, limits, lines));
+    CHECK(chunks.NextChunk(second, limits, lines));
+    CHECK(!lines.empty() && lines[0] == L"c");
+    chunks.Cancel();
+    CHECK(!chunks.NextChunk(second, limits, lines));
+}
+
+TEST(FenceLongerThanAChunkStaysCode) {
+    std::wstring text = L"Intro *text*\n\n```cpp\n";
+    for (int i = 0; i < 300; ++i) {
+        text += L"int value" + std::to_wstring(i) + L" = " + std::to_wstring(i) + L";\n";
+        if (i % 40 == 39) {
+            text += L"\n";   // Blank lines inside the block are not block boundaries
+        }
+    }
+    text += L"```\n\nAfter the *block*.\n";
+
+    MarkdownChunkLimits limits;
+    limits.maxChars = 512;
+    size_t chunkCount = 0;
+    auto rendered = RenderChunks(text, limits, &chunkCount);
+    CHECK(chunkCount > 10);
+
+    size_t codeLines = 0;
+    for (const auto& line : rendered) {
+        if (line.first.compare(0, 9, L"int value") == 0) {
+            CHECK(line.second);
+            ++codeLines;
+        } else if (line.first.compare(0, 5, L"After") == 0 || line.first.compare(0, 5, L"Intro") == 0) {
+            CHECK(!line.second);
+        }
+    }
+    CHECK(codeLines == 300);
+    CHECK(!rendered.empty() && rendered.back().first == L"" && !rendered.back().second);
+}
+
+TEST(ReopenedFenceKeepsItsInfoString) {
+    std::wstring text = L"~~~~ python\n";
+    for (int i = 0; i < 50; ++i) {
+        text += L"print(" + std::to_wstring(i) + L")\n";
+    }
+    text += L"~~~~\n";
+
+    MarkdownChunkScheduler chunks;
+    unsigned int generation = chunks.Reset(text);
+    MarkdownChunkLimits limits;
+    limits.maxChars = 100;
+    std::vector<std::wstring> lines;
+    CHECK(chunks.NextChunk(generation, limits, lines));
+    CHECK(!lines.empty() && lines[0] == L"~~~~ python");
+    CHECK(chunks.NextChunk(generation, limits, lines));
+    CHECK(!lines.empty() && lines[0] == L"~~~~python");
+
+    wchar_t fenceChar = 0;
+    size_t fenceLength = 0;
+    std::wstring info;
+    CHECK(Markdown::ParseMarkdownFence(lines[0], fenceChar, fenceLength, &info));
+    CHECK(fenceChar == L'~' && fenceLength == 4 && info == L"python");
+}
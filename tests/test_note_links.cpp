@@ -0,0 +1,124 @@
+#include "test.h"
+
+#include "database.h"
+
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// A database in a fresh directory, removed again at the end.
+struct LinkedNotes {
+    LinkedNotes() {
+        char path[] = "/tmp/notesofast_links_XXXXXX";
+        dir = mkdtemp(path) ? path : "/tmp";
+        CHECK(db.Initialize(dir + "/notes.db"));
+    }
+
+    ~LinkedNotes() {
+        db.Close();
+        std::string command = "rm -rf '" + dir + "'";
+        CHECK(system(command.c_str()) == 0);
+    }
+
+    Note Add(const std::string& title, const std::string& content = std::string()) {
+        Note note;
+        note.title = title;
+        note.content = content;
+        CHECK(db.CreateNote(note));
+        return note;
+    }
+
+    void Set(Note& note, const std::string& title, const std::string& content) {
+        note.title = title;
+        note.content = content;
+        CHECK(db.UpdateNote(note));
+    }
+
+    // Ids of the notes linking to noteId.
+    std::vector<int> From(int noteId) {
+        std::vector<int> ids;
+        for (const Database::NoteLinkRef& ref : db.GetBacklinks(noteId)) {
+            ids.push_back(ref.noteId);
+        }
+        return ids;
+    }
+
+    std::string dir;
+    Database db;
+};
+
+} // namespace
+
+TEST(NoteLinksFollowContentEdits) {
+    LinkedNotes t;
+    Note target = t.Add("Target");
+    Note other = t.Add("Other");
+    Note source = t.Add("Source", "see [[Target]]");
+    CHECK(t.From(target.id) == std::vector<int>{ source.id });
+
+    // Titles match ignoring ASCII case; the same target twice is one link, and a note's link to
+    // itself is no backlink.
+    t.Set(source, "Source", "[[target]] and [[TARGET]] and [[Source]]");
+    CHECK(t.From(target.id) == std::vector<int>{ source.id });
+    CHECK(t.From(source.id).empty());
+
+    // Removing the link; linking elsewhere.
+    t.Set(source, "Source", "no links now");
+    CHECK(t.From(target.id).empty());
+    t.Set(source, "Source", "[[Other]]");
+    CHECK(t.From(target.id).empty() && t.From(other.id) == std::vector<int>{ source.id });
+}
+
+TEST(NoteLinksWaitForTheirTitle) {
+    LinkedNotes t;
+    Note early = t.Add("Early", "[[Later]]");
+    Note later = t.Add("later");
+    CHECK(t.From(later.id) == std::vector<int>{ early.id });
+}
+
+TEST(NoteLinksFollowRenamedTargets) {
+    LinkedNotes t;
+    Note target = t.Add("Plan");
+    Note source = t.Add("Source", "[[Plan]] and [[Budget]]");
+    CHECK(t.From(target.id) == std::vector<int>{ source.id });
+
+    // Renamed away: the link waits for the old title; renamed to another linked title: it is found.
+    t.Set(target, "Budget", "");
+    CHECK(t.From(target.id) == std::vector<int>{ source.id });
+    Note plan = t.Add("PLAN");
+    CHECK(t.From(plan.id) == std::vector<int>{ source.id });
+    t.Set(target, "Unlinked", "");
+    CHECK(t.From(target.id).empty());
+
+    // Of two notes with the title, the older one is the target, whichever was renamed last.
+    Note newer = t.Add("Budget");
+    t.Set(target, "budget", "");
+    CHECK(t.From(target.id) == std::vector<int>{ source.id });
+    CHECK(t.From(newer.id).empty());
+    t.Set(target, "Unlinked", "");
+    CHECK(t.From(newer.id) == std::vector<int>{ source.id });
+}
+
+TEST(NoteLinksFollowDeletedTargets) {
+    LinkedNotes t;
+    Note first = t.Add("Topic");
+    Note second = t.Add("topic");
+    Note source = t.Add("Source", "[[Topic]]");
+    Note more = t.Add("More", "[[Topic]]");
+    CHECK(t.From(first.id) == (std::vector<int>{ more.id, source.id }));
+    CHECK(t.From(second.id).empty());
+
+    // The next note with the title takes the links; with none left they wait for a new one.
+    CHECK(t.db.DeleteNote(first.id));
+    CHECK(t.From(second.id) == (std::vector<int>{ more.id, source.id }));
+    CHECK(t.db.DeleteNote(second.id));
+    Note again = t.Add("Topic");
+    CHECK(t.From(again.id) == (std::vector<int>{ more.id, source.id }));
+
+    // A deleted source takes its links with it.
+    CHECK(t.db.DeleteNote(more.id));
+    CHECK(t.From(again.id) == std::vector<int>{ source.id });
+}
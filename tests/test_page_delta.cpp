@@ -0,0 +1,293 @@
+#include "test.h"
+
+#include "memory_backend.h"
+#include "page_delta.h"
+#include "sync_backends.h"
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::vector<unsigned char> Bytes;
+
+// Random pages behind a SQLite header, so PageSizeOf reads the page size; random bytes also keep
+// the codec from hiding mistakes by compressing everything away.
+Bytes MakeDatabase(size_t pages, uint32_t pageSize, std::mt19937& rng) {
+    Bytes db(pages * pageSize);
+    for (unsigned char& c : db) {
+        c = (unsigned char)rng();
+    }
+    memcpy(db.data(), "SQLite format 3", 16);
+    db[16] = (unsigned char)(pageSize >> 8);
+    db[17] = (unsigned char)pageSize;
+    return db;
+}
+
+void TouchPages(Bytes& db, uint32_t pageSize, size_t count, std::mt19937& rng) {
+    size_t pages = db.size() / pageSize;
+    for (size_t i = 0; i < count; ++i) {
+        db[(1 + rng() % (pages - 1)) * pageSize + rng() % pageSize] ^= 0x5A;
+    }
+}
+
+SyncStatus Push(SyncBackend& backend, const Bytes& db, PageDelta::SyncState& state,
+                PageDelta::PushResult* outResult = nullptr) {
+    MemorySyncSource source(db.data(), db.size());
+    PageDelta::PushResult result;
+    std::string error;
+    SyncStatus status = PageDelta::Push(backend, "notes.db", source, state, result, SyncProgress(), error);
+    if (outResult) {
+        *outResult = result;
+    }
+    return status;
+}
+
+bool PullEquals(SyncBackend& backend, const Bytes& expected, PageDelta::SyncState* outState = nullptr) {
+    Bytes content;
+    PageDelta::SyncState state;
+    SyncObjectInfo manifest;
+    std::string error;
+    if (PageDelta::Pull(backend, "notes.db", content, state, manifest, error) != SyncStatus::Ok) {
+        return false;
+    }
+    if (outState) {
+        *outState = state;
+    }
+    return content == expected;
+}
+
+size_t CountObjects(SyncBackend& backend) {
+    std::vector<SyncObjectInfo> objects;
+    std::string error;
+    return backend.List("notes.db", objects, error) == SyncStatus::Ok ? objects.size() : 0;
+}
+
+// memory, when backend is one, also has the bytes uploaded checked.
+void PushesPatchesAndPullsThemBack(SyncBackend& backend, MemorySyncBackend* memory) {
+    std::mt19937 rng(41);
+    const uint32_t pageSize = 4096;
+    PageDelta::SyncState state;
+    Bytes db = MakeDatabase(256, pageSize, rng);
+
+    PageDelta::PushResult result;
+    CHECK(Push(backend, db, state, &result) == SyncStatus::Ok);
+    CHECK(result.kind == PageDelta::UploadPlan::Base);
+    CHECK(PullEquals(backend, db));
+
+    int patches = 0;
+    for (int round = 0; round < 40; ++round) {
+        if (round % 5 == 4) {
+            Bytes extra = MakeDatabase(2, pageSize, rng);
+            db.insert(db.end(), extra.begin() + pageSize, extra.end());
+        } else {
+            TouchPages(db, pageSize, 1 + rng() % 4, rng);
+        }
+        unsigned long long before = memory ? memory->bytesPut : 0;
+        CHECK(Push(backend, db, state, &result) == SyncStatus::Ok);
+        if (result.kind == PageDelta::UploadPlan::Patch) {
+            ++patches;
+            // Cumulative since the base, but never past half the file.
+            CHECK(!memory || memory->bytesPut - before < db.size() / 2 + 1024);
+        }
+        if (!PullEquals(backend, db)) {
+            CHECK(PullEquals(backend, db));
+            return;
+        }
+        // The manifest, its base and at most one patch; the ones they replaced are gone.
+        CHECK(CountObjects(backend) <= 3);
+    }
+    CHECK(patches > 30);
+
+    // Nothing changed: nothing is uploaded.
+    size_t puts = memory ? memory->puts : 0;
+    CHECK(Push(backend, db, state, &result) == SyncStatus::Ok);
+    CHECK(result.kind == PageDelta::UploadPlan::Unchanged && (!memory || memory->puts == puts));
+}
+
+void ContinuesFromAnotherMachine(SyncBackend& backend) {
+    std::mt19937 rng(42);
+    const uint32_t pageSize = 1024;
+    PageDelta::SyncState a;
+    Bytes db = MakeDatabase(300, pageSize, rng);
+    CHECK(Push(backend, db, a) == SyncStatus::Ok);
+
+    // B restores, edits and patches A's base; A then patches on top without a new base.
+    PageDelta::SyncState b;
+    CHECK(PullEquals(backend, db, &b));
+    TouchPages(db, pageSize, 3, rng);
+    PageDelta::PushResult result;
+    CHECK(Push(backend, db, b, &result) == SyncStatus::Ok && result.kind == PageDelta::UploadPlan::Patch);
+    TouchPages(db, pageSize, 3, rng);
+    CHECK(Push(backend, db, a, &result) == SyncStatus::Ok && result.kind == PageDelta::UploadPlan::Patch);
+    CHECK(PullEquals(backend, db));
+}
+
+} // namespace
+
+TEST(PageDeltaPushesPatchesAndPullsThemBack) {
+    MemorySyncBackend backend;
+    PushesPatchesAndPullsThemBack(backend, &backend);
+}
+
+TEST(PageDeltaPushesPatchesThroughFolder) {
+    SyncFolder folder;
+    PushesPatchesAndPullsThemBack(folder.backend, nullptr);
+}
+
+TEST(PageDeltaPushesPatchesThroughServer) {
+    SyncServerStore store;
+    CHECK(store.Running());
+    if (store.Running()) {
+        PushesPatchesAndPullsThemBack(*store.backend, nullptr);
+    }
+}
+
+TEST(PageDeltaContinuesFromAnotherMachine) {
+    MemorySyncBackend backend;
+    ContinuesFromAnotherMachine(backend);
+}
+
+TEST(PageDeltaContinuesThroughFolder) {
+    SyncFolder folder;
+    ContinuesFromAnotherMachine(folder.backend);
+}
+
+TEST(PageDeltaContinuesThroughServer) {
+    SyncServerStore store;
+    CHECK(store.Running());
+    if (store.Running()) {
+        ContinuesFromAnotherMachine(*store.backend);
+    }
+}
+
+TEST(PageDeltaLosingPushPublishesNothing) {
+    std::mt19937 rng(45);
+    const uint32_t pageSize = 4096;
+    MemorySyncBackend backend;
+    PageDelta::SyncState a;
+    Bytes dbA = MakeDatabase(64, pageSize, rng);
+    CHECK(Push(backend, dbA, a) == SyncStatus::Ok);
+    PageDelta::SyncState b;
+    Bytes dbB = dbA;
+    CHECK(PullEquals(backend, dbB, &b));
+
+    // B patches the same base after A read the manifest and before A uploads its own patch.
+    TouchPages(dbA, pageSize, 3, rng);
+    TouchPages(dbB, pageSize, 3, rng);
+    bool pushedB = false;
+    backend.beforePut = [&](const std::string&) {
+        pushedB = Push(backend, dbB, b) == SyncStatus::Ok;
+    };
+    CHECK(Push(backend, dbA, a) == SyncStatus::Conflict);
+    CHECK(pushedB);
+    CHECK(PullEquals(backend, dbB));
+
+    // A's next push wins, and clears away B's patch and its own orphan.
+    PageDelta::PushResult result;
+    CHECK(Push(backend, dbA, a, &result) == SyncStatus::Ok && result.kind == PageDelta::UploadPlan::Base);
+    CHECK(PullEquals(backend, dbA));
+    CHECK(backend.objects.size() == 2);
+}
+
+TEST(PageDeltaReadsAndReplacesFormat2) {
+    std::mt19937 rng(46);
+    const uint32_t pageSize = 4096;
+    MemorySyncBackend backend;
+    PageDelta::SyncState state;
+    Bytes db = MakeDatabase(32, pageSize, rng);
+    CHECK(Push(backend, db, state) == SyncStatus::Ok);
+    TouchPages(db, pageSize, 2, rng);
+    CHECK(Push(backend, db, state) == SyncStatus::Ok);
+
+    // Rename everything the way a format 2 upload named it.
+    PageDelta::Manifest manifest;
+    const Bytes& text = backend.objects["notes.db.manifest"].content;
+    CHECK(PageDelta::ParseManifest(std::string(text.begin(), text.end()), manifest));
+    backend.objects["notes.db"] = backend.objects[PageDelta::BaseName("notes.db", manifest)];
+    backend.objects["notes.db.patch"] = backend.objects[PageDelta::PatchName("notes.db", manifest)];
+    backend.objects.erase(PageDelta::BaseName("notes.db", manifest));
+    backend.objects.erase(PageDelta::PatchName("notes.db", manifest));
+    manifest.format = 2;
+    std::string legacy = PageDelta::FormatManifest(manifest);
+    backend.objects["notes.db.manifest"].content.assign(legacy.begin(), legacy.end());
+    CHECK(PageDelta::BaseName("notes.db", manifest) == "notes.db");
+    CHECK(PullEquals(backend, db, &state));
+
+    // The next push starts a base under the new names and drops the old patch.
+    TouchPages(db, pageSize, 2, rng);
+    PageDelta::PushResult result;
+    CHECK(Push(backend, db, state, &result) == SyncStatus::Ok && result.kind == PageDelta::UploadPlan::Base);
+    CHECK(PullEquals(backend, db));
+    CHECK(backend.objects.count("notes.db.patch") == 0 && backend.objects.count("notes.db") == 1);
+}
+
+TEST(PageDeltaRefusesDamagedObjects) {
+    std::mt19937 rng(43);
+    const uint32_t pageSize = 4096;
+    MemorySyncBackend backend;
+    PageDelta::SyncState state;
+    Bytes db = MakeDatabase(64, pageSize, rng);
+    CHECK(Push(backend, db, state) == SyncStatus::Ok);
+    TouchPages(db, pageSize, 2, rng);
+    PageDelta::PushResult result;
+    CHECK(Push(backend, db, state, &result) == SyncStatus::Ok && result.kind == PageDelta::UploadPlan::Patch);
+
+    // Every object the manifest names is checked: flip a byte in each in turn.
+    PageDelta::Manifest manifest;
+    CHECK(PageDelta::ParseManifest(std::string(backend.objects["notes.db.manifest"].content.begin(),
+                                               backend.objects["notes.db.manifest"].content.end()), manifest));
+    for (auto& entry : backend.objects) {
+        if (entry.first.find("manifest") != std::string::npos) {
+            continue;
+        }
+        Bytes& content = entry.second.content;
+        content[content.size() / 2] ^= 1;
+        CHECK(!PullEquals(backend, db));
+        content[content.size() / 2] ^= 1;
+    }
+    CHECK(PullEquals(backend, db));
+
+    // A manifest that promises a larger file than the patch describes.
+    manifest.fileSize *= 3;
+    std::string bad = PageDelta::FormatManifest(manifest);
+    backend.objects["notes.db.manifest"].content.assign(bad.begin(), bad.end());
+    CHECK(!PullEquals(backend, db));
+
+    // A patch and manifest that agree on a terabyte file are refused before anything is allocated.
+    Bytes base(db.begin(), db.begin() + 4 * pageSize);
+    manifest.baseId = PageDelta::BaseIdOf(base.data(), base.size());
+    manifest.fileSize = 1ull << 40;
+    Bytes patch(8, 0);
+    memcpy(patch.data(), "NSFPTCH1", 8);
+    patch.push_back((unsigned char)manifest.baseId.size());
+    patch.push_back(0);
+    patch.insert(patch.end(), manifest.baseId.begin(), manifest.baseId.end());
+    for (int i = 0; i < 8; ++i) patch.push_back((unsigned char)(manifest.fileSize >> (8 * i)));
+    for (int i = 0; i < 4; ++i) patch.push_back((unsigned char)(manifest.pageSize >> (8 * i)));
+    for (int i = 0; i < 8; ++i) patch.push_back((unsigned char)(manifest.fileHash >> (8 * i)));
+    for (int i = 0; i < 4; ++i) patch.push_back(i == 0 ? 1 : 0);
+    patch.insert(patch.end(), 4 + pageSize, 0);
+    Bytes out;
+    std::string error;
+    CHECK(!PageDelta::Reassemble(manifest, base, &patch, out, error));
+    CHECK(out.empty());
+}
+
+TEST(PageDeltaStateSurvivesSerialization) {
+    std::mt19937 rng(44);
+    Bytes db = MakeDatabase(32, 4096, rng);
+    MemorySyncSource source(db.data(), db.size());
+    PageDelta::UploadPlan plan;
+    CHECK(PageDelta::PlanUpload(PageDelta::SyncState(), source, plan));
+    Bytes bytes;
+    PageDelta::SerializeState(plan.state, bytes);
+    PageDelta::SyncState back;
+    CHECK(PageDelta::ParseState(bytes, back));
+    CHECK(back.baseId == plan.state.baseId && back.baseHashes == plan.state.baseHashes &&
+          back.fingerprint == plan.state.fingerprint && back.fileHash == plan.state.fileHash);
+    bytes.pop_back();
+    CHECK(!PageDelta::ParseState(bytes, back));
+}
@@ -0,0 +1,125 @@
+#include "test.h"
+
+#include "spell_ranges.h"
+#include "spell_tokenizer.h"
+#include "text_edit.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Stand-in dictionary: every word whose length is a multiple of 3 is a miss.
+std::vector<SpellRange> Check(const std::wstring& text, size_t start, size_t end, SpellFenceState* fences = nullptr) {
+    std::vector<SpellRange> misses;
+    SpellTokenizer tokenizer(text.data(), text.size(), start, end, fences);
+    SpellToken token;
+    while (tokenizer.Next(token)) {
+        if (token.length % 3 == 0) {
+            misses.push_back({ (long)token.start, (long)token.length });
+        }
+    }
+    return misses;
+}
+
+bool SameMisses(const std::vector<SpellRange>& a, const std::vector<SpellRange>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].start != b[i].start || a[i].length != b[i].length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Brings ranges up to date with text after the edit from before, as the editor does.
+void Recheck(SpellCheckRanges& ranges, const std::wstring& before, const std::wstring& text) {
+    TextEdit edit = DiffTextEdit(before, text);
+    ranges.ApplyEdit(edit);
+    if (!edit.Empty() &&
+        (SpellTokenizer::TouchesFence(before.c_str(), before.size(), edit.offset, edit.offset + edit.removed) ||
+         SpellTokenizer::TouchesFence(text.c_str(), text.size(), edit.offset, edit.offset + edit.inserted))) {
+        ranges.MarkDirty(edit.offset, text.size());
+    }
+    SpellFenceState fences;
+    for (const auto& span : ranges.DirtySpans(text.c_str(), text.size())) {
+        ranges.Commit(span, Check(text, span.first, span.second, &fences));
+    }
+}
+
+} // namespace
+
+TEST(RangesResetMarksEverythingDirty) {
+    std::wstring text = L"abc de fgh\nxyz";
+    SpellCheckRanges ranges;
+    ranges.Reset(text.size());
+    CHECK(ranges.HasDirty());
+    auto spans = ranges.DirtySpans(text.c_str(), text.size());
+    CHECK(spans.size() == 1 && spans[0].first == 0 && spans[0].second == text.size());
+    ranges.Commit(spans[0], Check(text, 0, text.size()));
+    CHECK(!ranges.HasDirty());
+    CHECK(ranges.Misses().size() == 3);
+}
+
+TEST(RangesEditShiftsLaterMisses) {
+    std::wstring text = L"abc de\nfgh ij\nklm";
+    SpellCheckRanges ranges;
+    ranges.Reset(0);
+    Recheck(ranges, L"", text);
+    CHECK(ranges.Misses().size() == 3);
+
+    std::wstring after = L"abc de\nnew words here\nfgh ij\nklm";
+    TextEdit edit = DiffTextEdit(text, after);
+    ranges.ApplyEdit(edit);
+    // The misses after the edit moved by its length before anything was re-checked.
+    CHECK(ranges.Misses().back().start == (long)after.find(L"klm"));
+    auto spans = ranges.DirtySpans(after.c_str(), after.size());
+    CHECK(spans.size() == 1);
+    if (!spans.empty()) {
+        // Widened to whole lines, not the whole text.
+        CHECK(spans[0].first == 7 && spans[0].second <= after.find(L"klm"));
+    }
+}
+
+TEST(RangesRemoveMissesIf) {
+    std::wstring text = L"abc abcdef xyz";
+    SpellCheckRanges ranges;
+    ranges.Reset(0);
+    Recheck(ranges, L"", text);
+    CHECK(ranges.Misses().size() == 3);
+    ranges.RemoveMissesIf([&](const SpellRange& r) { return text.compare(r.start, r.length, L"xyz") == 0; });
+    CHECK(ranges.Misses().size() == 2);
+    CHECK(!ranges.HasDirty());
+}
+
+TEST(RangesRandomEditsMatchFullCheck) {
+    const wchar_t* pieces[] = { L"word ", L"abc ", L"```", L"~~~", L"`", L"\r", L"\r\n", L"[x](y z) ", L"<a b>",
+                                L"don't ", L"well-known ", L"http://a.b ", L"foo_bar ", L" ", L"xyz", L"q", L"-",
+                                L"'", L"&amp;", L"]( " };
+    std::mt19937 rng(7);
+    std::wstring text;
+    SpellCheckRanges ranges;
+    ranges.Reset(0);
+    for (int step = 0; step < 20000; ++step) {
+        std::wstring before = text;
+        for (int op = 0; op < 1 + (int)(rng() % 2); ++op) {
+            size_t at = text.empty() ? 0 : rng() % (text.size() + 1);
+            if (rng() % 3 == 0 && !text.empty()) {
+                text.erase(at, 1 + rng() % 8);
+            } else {
+                text.insert(at, pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))]);
+            }
+            if (text.size() > 600) {
+                text.erase(0, 100);
+            }
+        }
+        Recheck(ranges, before, text);
+        if (!SameMisses(ranges.Misses(), Check(text, 0, text.size()))) {
+            CHECK(SameMisses(ranges.Misses(), Check(text, 0, text.size())));
+            break;
+        }
+    }
+}
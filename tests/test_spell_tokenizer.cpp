@@ -0,0 +1,102 @@
+#include "test.h"
+
+#include "spell_tokenizer.h"
+
+#include <clocale>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::wstring> Words(const std::wstring& text, size_t start = 0, size_t end = (size_t)-1,
+                                SpellFenceState* fences = nullptr) {
+    std::vector<std::wstring> words;
+    SpellTokenizer tokenizer(text.data(), text.size(), start, end, fences);
+    SpellToken token;
+    while (tokenizer.Next(token)) {
+        words.push_back(text.substr(token.start, token.length));
+    }
+    return words;
+}
+
+typedef std::vector<std::wstring> WordList;
+
+} // namespace
+
+TEST(TokenizerSplitsProse) {
+    CHECK(Words(L"Hello world") == (WordList{ L"Hello", L"world" }));
+    CHECK(Words(L"'quoted' text.") == (WordList{ L"quoted", L"text" }));
+    CHECK(Words(L"end...") == (WordList{ L"end" }));
+    CHECK(Words(L"**bold** _em_ ~~strike~~ # Head") == (WordList{ L"bold", L"em", L"strike", L"Head" }));
+}
+
+TEST(TokenizerKeepsContractionsAndSplitsHyphens) {
+    CHECK(Words(L"don't stop") == (WordList{ L"don't", L"stop" }));
+    CHECK(Words(L"don\u2019t") == (WordList{ L"don\u2019t" }));
+    CHECK(Words(L"well-known fact") == (WordList{ L"well", L"known", L"fact" }));
+}
+
+TEST(TokenizerSkipsUrlsAddressesAndIdentifiers) {
+    CHECK(Words(L"see https://example.com/path?q=1 now") == (WordList{ L"see", L"now" }));
+    CHECK(Words(L"mail me@example.com ok") == (WordList{ L"mail", L"ok" }));
+    CHECK(Words(L"call getValue or snake_case or v2 or file.txt") == (WordList{ L"call", L"or", L"or", L"or" }));
+    CHECK(Words(L"@mention here") == (WordList{ L"here" }));
+}
+
+TEST(TokenizerSkipsMarkdownSpans) {
+    CHECK(Words(L"use `code spans here` ok") == (WordList{ L"use", L"ok" }));
+    CHECK(Words(L"use ``a ` b`` ok") == (WordList{ L"use", L"ok" }));
+    CHECK(Words(L"unclosed `tick word") == (WordList{ L"unclosed", L"tick", L"word" }));
+    CHECK(Words(L"[link text](http://x.y/z (paren)) after") == (WordList{ L"link", L"text", L"after" }));
+    CHECK(Words(L"<https://auto.link> and <b>bold</b>") == (WordList{ L"and", L"bold" }));
+    CHECK(Words(L"a &nbsp; b") == (WordList{ L"a", L"b" }));
+    CHECK(Words(L"x < y") == (WordList{ L"x", L"y" }));
+}
+
+TEST(TokenizerSkipsFencedCode) {
+    CHECK(Words(L"before\r```cpp\rint fooBar = misspeled;\r```\rafter") == (WordList{ L"before", L"after" }));
+    CHECK(Words(L"a\r\n~~~\r\nin code\r\n```\r\nstill\r\n~~~~\r\nout") == (WordList{ L"a", L"out" }));
+}
+
+TEST(TokenizerChecksOnlyTheRange) {
+    std::wstring text = L"one two\rthree four";
+    CHECK(Words(text, 8, 12) == (WordList{ L"three" }));
+    CHECK(Words(text, 8, text.size()) == (WordList{ L"three", L"four" }));
+    CHECK(Words(text, 3, 5) == (WordList{ L"two" }));
+    std::wstring fenced = L"```\rin fence\r```\rout";
+    CHECK(Words(fenced, 4, 12).empty());
+    CHECK(Words(fenced, 17, 20) == (WordList{ L"out" }));
+}
+
+TEST(TokenizerFenceStateCarriesAcrossSpans) {
+    std::wstring text;
+    for (int i = 0; i < 40; ++i) {
+        text += (i % 7 == 3) ? L"```\n" : L"word" + std::wstring(1, (wchar_t)(L'a' + i % 26)) + L" text\n";
+    }
+    SpellFenceState fences;
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find(L'\n', lineStart);
+        CHECK(Words(text, lineStart, lineEnd, &fences) == Words(text, lineStart, lineEnd));
+        lineStart = lineEnd + 1;
+    }
+    // A state past the span is not used: the scan starts over.
+    CHECK(Words(text, 0, 10, &fences) == Words(text, 0, 10));
+    CHECK(fences.pos == 0 && !fences.inFence);
+}
+
+TEST(TokenizerTouchesFence) {
+    std::wstring text = L"text\n```\ncode\n```\nmore";
+    CHECK(!SpellTokenizer::TouchesFence(text.c_str(), text.size(), 0, 3));
+    CHECK(SpellTokenizer::TouchesFence(text.c_str(), text.size(), 6, 6));
+    CHECK(SpellTokenizer::TouchesFence(text.c_str(), text.size(), 12, 16));
+}
+
+TEST(TokenizerClassifiesNonAsciiLetters) {
+    // Letters outside ASCII go through iswalpha, which needs a Unicode locale.
+    if (!setlocale(LC_CTYPE, "C.UTF-8") && !setlocale(LC_CTYPE, "en_US.UTF-8")) {
+        return;
+    }
+    CHECK(Words(L"caf\u00e9 na\u00efve") == (WordList{ L"caf\u00e9", L"na\u00efve" }));
+    setlocale(LC_CTYPE, "C");
+}
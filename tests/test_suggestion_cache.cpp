@@ -0,0 +1,102 @@
+#include "test.h"
+
+#include "suggestion_cache.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::vector<std::wstring> Words;
+
+} // namespace
+
+TEST(SuggestionCacheStoresAndLooksUp) {
+    SuggestionCache cache(4);
+    Words out;
+    CHECK(!cache.Lookup(L"wrold", out) && !cache.Contains(L"wrold"));
+    cache.Store(L"wrold", { L"world", L"would" });
+    cache.Store(L"qzx", {});   // No suggestions is a valid, cached answer
+    CHECK(cache.Lookup(L"wrold", out) && out == Words({ L"world", L"would" }));
+    CHECK(cache.Lookup(L"qzx", out) && out.empty());
+    CHECK(cache.Contains(L"qzx") && cache.Size() == 2);
+    CHECK(!cache.Lookup(L"Wrold", out));
+}
+
+TEST(SuggestionCacheEvictsLeastRecentlyUsed) {
+    SuggestionCache cache(3);
+    cache.Store(L"a", { L"A" });
+    cache.Store(L"b", { L"B" });
+    cache.Store(L"c", { L"C" });
+    Words out;
+    CHECK(cache.Lookup(L"a", out));   // a is now the most recent; b the least
+    cache.Store(L"d", { L"D" });
+    CHECK(cache.Size() == 3);
+    CHECK(!cache.Contains(L"b") && cache.Contains(L"a") && cache.Contains(L"c") && cache.Contains(L"d"));
+
+    // Contains does not count as a use; storing an existing word does.
+    CHECK(cache.Contains(L"c"));
+    cache.Store(L"c", { L"C2" });
+    cache.Store(L"e", { L"E" });
+    CHECK(!cache.Contains(L"a") && cache.Contains(L"c"));
+    CHECK(cache.Lookup(L"c", out) && out == Words({ L"C2" }));
+}
+
+TEST(SuggestionCacheClearInvalidatesEverything) {
+    SuggestionCache cache(8);
+    cache.Store(L"teh", { L"the" });
+    cache.Store(L"adn", { L"and" });
+    cache.Clear();
+    Words out;
+    CHECK(cache.Size() == 0 && !cache.Lookup(L"teh", out) && !cache.Contains(L"adn"));
+    cache.Store(L"teh", { L"the", L"tech" });
+    CHECK(cache.Lookup(L"teh", out) && out.size() == 2);
+}
+
+TEST(SuggestionCacheMatchesReferenceLru) {
+    // Random stores and lookups compared against a plain recency list.
+    const size_t capacity = 16;
+    SuggestionCache cache(capacity);
+    std::vector<std::wstring> recent;   // Most recent first
+    unsigned int seed = 5;
+    for (int step = 0; step < 20000; ++step) {
+        seed = seed * 1103515245u + 12345u;
+        std::wstring word = L"w" + std::to_wstring((seed >> 8) % 40);
+        auto pos = std::find(recent.begin(), recent.end(), word);
+        Words out;
+        if ((seed >> 20) % 3 == 0) {
+            bool hit = cache.Lookup(word, out);
+            if (hit != (pos != recent.end()) || (hit && out != Words({ word + L"!" }))) {
+                CHECK(hit == (pos != recent.end()));
+                return;
+            }
+            if (!hit) {
+                continue;
+            }
+            recent.erase(pos);
+        } else {
+            cache.Store(word, { word + L"!" });
+            if (pos != recent.end()) {
+                recent.erase(pos);
+            } else if (recent.size() == capacity) {
+                recent.pop_back();
+            }
+        }
+        recent.insert(recent.begin(), word);
+        if (cache.Size() != recent.size()) {
+            CHECK(cache.Size() == recent.size());
+            return;
+        }
+    }
+    for (const std::wstring& word : recent) {
+        CHECK(cache.Contains(word));
+    }
+}
+
+TEST(SuggestionCacheZeroCapacityKeepsOne) {
+    SuggestionCache cache(0);
+    cache.Store(L"a", {});
+    cache.Store(L"b", {});
+    CHECK(cache.Size() == 1 && cache.Contains(L"b"));
+}
@@ -0,0 +1,137 @@
+#include "test.h"
+
+#include "lz_codec.h"
+#include "sync_codec.h"
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::vector<unsigned char> Bytes;
+
+// Words with runs of repeats, roughly as compressible as note text.
+Bytes MakeText(size_t size, std::mt19937& rng) {
+    static const char* words[] = { "note ", "meeting ", "tomorrow ", "- [ ] ", "buy milk ", "## Plans\n",
+                                   "the ", "project ", "draft ", "call back ", "\n", "2024-05-01 " };
+    Bytes text;
+    while (text.size() < size) {
+        const char* word = words[rng() % (sizeof(words) / sizeof(words[0]))];
+        text.insert(text.end(), word, word + strlen(word));
+    }
+    text.resize(size);
+    return text;
+}
+
+Bytes MakeRandom(size_t size, std::mt19937& rng) {
+    Bytes bytes(size);
+    for (unsigned char& c : bytes) {
+        c = (unsigned char)rng();
+    }
+    return bytes;
+}
+
+// Encodes through CompressedSource, reading it in uneven pieces as an upload would.
+Bytes Encode(const Bytes& original) {
+    MemorySyncSource source(original.data(), original.size());
+    SyncCodec::CompressedSource packed(source);
+    Bytes encoded;
+    if (!packed.Prepare()) {
+        return encoded;
+    }
+    encoded.resize((size_t)packed.Size());
+    size_t piece = 7;
+    for (size_t at = 0; at < encoded.size(); at += piece, piece = piece * 3 + 1) {
+        size_t length = encoded.size() - at < piece ? encoded.size() - at : piece;
+        if (!packed.Read(at, encoded.data() + at, length)) {
+            return Bytes();
+        }
+    }
+    return encoded;
+}
+
+bool RoundTrips(const Bytes& original) {
+    Bytes encoded = Encode(original);
+    Bytes decoded;
+    std::string error;
+    return SyncCodec::IsEncoded(encoded.data(), encoded.size()) &&
+           SyncCodec::Decode(encoded, decoded, error) && decoded == original;
+}
+
+} // namespace
+
+TEST(SyncCodecRoundTrips) {
+    std::mt19937 rng(51);
+    const size_t sizes[] = { 0, 1, 4, 100, 65536 + 3, SyncCodec::kBlockSize, 2 * SyncCodec::kBlockSize + 123 };
+    for (size_t size : sizes) {
+        CHECK(RoundTrips(MakeText(size, rng)));
+        CHECK(RoundTrips(MakeRandom(size, rng)));
+    }
+
+    // Text shrinks; random blocks are stored, so they grow by the framing only.
+    Bytes text = MakeText(SyncCodec::kBlockSize + 5000, rng);
+    CHECK(Encode(text).size() < text.size() / 2);
+    Bytes noise = MakeRandom(SyncCodec::kBlockSize + 5000, rng);
+    CHECK(Encode(noise).size() <= noise.size() + 20 + 2 * 4);
+}
+
+TEST(SyncCodecDecodesInPieces) {
+    std::mt19937 rng(52);
+    Bytes original = MakeText(2 * SyncCodec::kBlockSize + 777, rng);
+    Bytes noise = MakeRandom(SyncCodec::kBlockSize / 2, rng);
+    original.insert(original.end(), noise.begin(), noise.end());
+    Bytes encoded = Encode(original);
+
+    SyncCodec::Decoder decoder;
+    Bytes decoded;
+    std::string error;
+    bool ok = true;
+    for (size_t at = 0; ok && at < encoded.size();) {
+        size_t length = 1 + rng() % 100000;
+        if (length > encoded.size() - at) length = encoded.size() - at;
+        ok = decoder.Feed(encoded.data() + at, length, decoded, error);
+        at += length;
+    }
+    CHECK(ok && decoder.Finished(error));
+    CHECK(decoded == original);
+}
+
+TEST(SyncCodecRefusesDamagedInput) {
+    std::mt19937 rng(53);
+    Bytes original = MakeText(SyncCodec::kBlockSize + 4096, rng);
+    Bytes encoded = Encode(original);
+    Bytes decoded;
+    std::string error;
+
+    // Cut short, at the header or inside a block.
+    const size_t cuts[] = { 10, 21, encoded.size() / 2, encoded.size() - 1 };
+    for (size_t cut : cuts) {
+        Bytes shorter(encoded.begin(), encoded.begin() + cut);
+        CHECK(!SyncCodec::Decode(shorter, decoded, error));
+    }
+
+    // A header that promises more, or less, than the blocks hold.
+    Bytes bigger = encoded;
+    bigger[8] ^= 1;
+    CHECK(!SyncCodec::Decode(bigger, decoded, error));
+    Bytes trailing = encoded;
+    trailing.push_back(0);
+    CHECK(!SyncCodec::Decode(trailing, decoded, error));
+
+    // A block cut short does not decode, and flipped bytes never take the decoder outside its
+    // buffers, whatever it makes of them.
+    Bytes block(original.begin(), original.begin() + 65536);
+    Bytes packed(LzCodec::CompressBound(block.size()));
+    LzCodec::Compressor compressor;
+    packed.resize(compressor.Compress(block.data(), block.size(), packed.data()));
+    Bytes out(block.size());
+    CHECK(LzCodec::Decompress(packed.data(), packed.size(), out.data(), out.size()) && out == block);
+    CHECK(!LzCodec::Decompress(packed.data(), packed.size() - 1, out.data(), out.size()));
+    for (int i = 0; i < 2000; ++i) {
+        Bytes damaged = packed;
+        damaged[rng() % damaged.size()] ^= (unsigned char)(1 + rng() % 255);
+        LzCodec::Decompress(damaged.data(), damaged.size(), out.data(), out.size());
+    }
+}
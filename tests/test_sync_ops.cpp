@@ -0,0 +1,560 @@
+#include "test.h"
+
+#include "database.h"
+#include "memory_backend.h"
+#include "sync_backends.h"
+#include "sync_ops.h"
+
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const char kPrefix[] = "notes.db.ops.";
+
+// A fresh directory per test for the replicas' database files.
+std::string TempDir() {
+    char path[] = "/tmp/notesofast_test_XXXXXX";
+    return mkdtemp(path) ? path : "/tmp";
+}
+
+void RemoveDir(const std::string& dir) {
+    std::string command = "rm -rf '" + dir + "'";
+    CHECK(system(command.c_str()) == 0);
+}
+
+long long QueryInt(const std::string& path, const char* sql) {
+    sqlite3* db = nullptr;
+    long long value = -1;
+    sqlite3_stmt* stmt;
+    if (sqlite3_open(path.c_str(), &db) == SQLITE_OK && sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            value = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+    return value;
+}
+
+// Local id on the replica at toPath of the note with local id noteId at fromPath; -1 if none.
+long long SameNoteOn(const std::string& fromPath, long long noteId, const std::string& toPath) {
+    sqlite3* db = nullptr;
+    long long value = -1;
+    std::string attach = "ATTACH DATABASE '" + fromPath + "' AS other";
+    std::string sql = "SELECT r.local_id FROM sync_rows r JOIN other.sync_rows o ON o.tbl = r.tbl AND o.gid = r.gid "
+                      "WHERE r.tbl = 'notes' AND o.local_id = " + std::to_string(noteId);
+    sqlite3_stmt* stmt;
+    if (sqlite3_open(toPath.c_str(), &db) == SQLITE_OK &&
+        sqlite3_exec(db, attach.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK &&
+        sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            value = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+    return value;
+}
+
+// The synced content of a replica with rows named by gid, so local ids don't matter.
+std::string Dump(const std::string& path) {
+    const char* queries[] = {
+        "SELECT 'N', r.gid, n.title, n.content, n.is_pinned, n.is_archived FROM notes n "
+        "JOIN sync_rows r ON r.tbl = 'notes' AND r.local_id = n.id ORDER BY r.gid",
+        "SELECT 'T', r.gid, t.name FROM tags t JOIN sync_rows r ON r.tbl = 'tags' AND r.local_id = t.id ORDER BY r.gid",
+        "SELECT 'C', r.gid, c.item_text, c.is_checked, (SELECT gid FROM sync_rows WHERE tbl = 'notes' AND local_id = c.note_id) "
+        "FROM checklist_items c JOIN sync_rows r ON r.tbl = 'checklist_items' AND r.local_id = c.id "
+        "WHERE c.note_id IN (SELECT id FROM notes) ORDER BY r.gid",
+        "SELECT 'NT', (SELECT gid FROM sync_rows WHERE tbl = 'notes' AND local_id = note_id) || '/' || "
+        "(SELECT gid FROM sync_rows WHERE tbl = 'tags' AND local_id = tag_id) AS k FROM note_tags "
+        "WHERE note_id IN (SELECT id FROM notes) AND tag_id IN (SELECT id FROM tags) ORDER BY k",
+        "SELECT 'W', word FROM user_dictionary ORDER BY word",
+    };
+    std::string out;
+    sqlite3* db = nullptr;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        sqlite3_close(db);
+        return out;
+    }
+    for (const char* sql : queries) {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+            out += "error: " + std::string(sqlite3_errmsg(db)) + "\n";
+            continue;
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            for (int i = 0; i < sqlite3_column_count(stmt); ++i) {
+                const unsigned char* text = sqlite3_column_text(stmt, i);
+                out += text ? (const char*)text : "NULL";
+                out += '|';
+            }
+            out += '\n';
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+    return out;
+}
+
+bool Exchange(Database& db, SyncBackend& backend, OpSyncStats* outStats = nullptr) {
+    OpSyncStats stats;
+    std::string error;
+    bool ok = OpSync::Exchange(db, backend, kPrefix, stats, error);
+    if (outStats) {
+        *outStats = stats;
+    }
+    return ok;
+}
+
+// One random local edit: notes, pins, tags, checklist items and user words.
+void RandomEdit(Database& db, std::mt19937& rng, int round) {
+    std::vector<Note> notes = db.GetAllNotes(true);
+    int op = rng() % 10;
+    if (op < 3 || notes.empty()) {
+        Note note;
+        note.title = "t" + std::to_string(rng() % 1000);
+        note.content = "c [[t" + std::to_string(rng() % 1000) + "]]";
+        db.CreateNote(note);
+    } else if (op < 6) {
+        Note note = notes[rng() % notes.size()];
+        note.content += " edit" + std::to_string(round);
+        db.UpdateNote(note);
+    } else if (op < 7) {
+        db.DeleteNote(notes[rng() % notes.size()].id);
+    } else if (op < 8) {
+        db.TogglePin(notes[rng() % notes.size()].id, rng() % 2 != 0);
+    } else if (op < 9) {
+        std::vector<Database::Tag> tags = db.GetTags();
+        if (tags.empty() || rng() % 3 == 0) {
+            Database::Tag tag = { 0, L"tag" + std::to_wstring(rng() % 50), 0 };
+            db.CreateTag(tag);
+        } else {
+            db.AddTagToNote(notes[rng() % notes.size()].id, tags[rng() % tags.size()].id);
+        }
+    } else {
+        ChecklistItem item;
+        item.note_id = notes[rng() % notes.size()].id;
+        item.item_text = "item";
+        db.CreateChecklistItem(item);
+        db.AddUserDictionaryWord("w" + std::to_string(rng() % 30));
+    }
+}
+
+// Another machine's copy of db as it is now: the same rows under a replica id of its own.
+bool CopyReplica(Database& db, const std::string& path) {
+    if (!db.BackupToFile(path)) {
+        return false;
+    }
+    sqlite3* raw = nullptr;
+    bool ok = sqlite3_open(path.c_str(), &raw) == SQLITE_OK &&
+              sqlite3_exec(raw, "UPDATE sync_state SET replica = lower(hex(randomblob(8)))", nullptr, nullptr, nullptr) ==
+                  SQLITE_OK;
+    sqlite3_close(raw);
+    return ok;
+}
+
+Note MakeNote(Database& db, const std::string& title, const std::string& content) {
+    Note note;
+    note.title = title;
+    note.content = content;
+    CHECK(db.CreateNote(note));
+    return note;
+}
+
+// The note titled title, or one with id -1.
+Note FindNote(Database& db, const std::string& title) {
+    for (const Note& note : db.GetAllNotes(true)) {
+        if (note.title == title) {
+            return note;
+        }
+    }
+    return Note();
+}
+
+void Edit(Database& db, const std::string& title, const std::string& content) {
+    Note note = FindNote(db, title);
+    CHECK(note.id != -1);
+    note.content = content;
+    CHECK(db.UpdateNote(note));
+}
+
+// Random edits on two replicas, exchanged through backend at random, end up the same on both.
+void TwoReplicasConverge(SyncBackend& backend) {
+    std::string dir = TempDir();
+    std::mt19937 rng(42);
+    Database a;
+    Database b;
+    CHECK(a.Initialize(dir + "/a.db") && b.Initialize(dir + "/b.db"));
+    CHECK(a.GetSyncReplicaId() != b.GetSyncReplicaId());
+    Database* replicas[2] = { &a, &b };
+
+    for (int round = 0; round < 60; ++round) {
+        for (Database* db : replicas) {
+            for (int n = rng() % 6; n > 0; --n) {
+                RandomEdit(*db, rng, round);
+            }
+        }
+        // The same note edited on both: the later edit wins everywhere.
+        if (round % 10 == 5) {
+            CHECK(Exchange(a, backend) && Exchange(b, backend) && Exchange(a, backend));
+            std::vector<Note> notes = a.GetAllNotes(true);
+            long long theirsId = notes.empty() ? -1 : SameNoteOn(dir + "/a.db", notes[0].id, dir + "/b.db");
+            CHECK(notes.empty() || theirsId != -1);
+            if (theirsId != -1) {
+                Note mine = notes[0];
+                mine.content = "from a";
+                a.UpdateNote(mine);
+                usleep(2000);
+                for (Note& theirs : b.GetAllNotes(true)) {
+                    if (theirs.id == theirsId) {
+                        theirs.content = "from b";
+                        b.UpdateNote(theirs);
+                        break;
+                    }
+                }
+                CHECK(Exchange(a, backend) && Exchange(b, backend) && Exchange(a, backend));
+                for (const Note& note : a.GetAllNotes(true)) {
+                    if (note.id == mine.id) {
+                        CHECK(note.content == "from b");
+                    }
+                }
+            }
+        }
+        if (rng() % 3 == 0) {
+            CHECK(Exchange(*replicas[rng() % 2], backend));
+        }
+    }
+    CHECK(Exchange(a, backend) && Exchange(b, backend) && Exchange(a, backend));
+    a.Close();
+    b.Close();
+
+    std::string dumpA = Dump(dir + "/a.db");
+    CHECK(dumpA.find("error") == std::string::npos && dumpA.find("N|") != std::string::npos);
+    CHECK(dumpA == Dump(dir + "/b.db"));
+
+    // A replica joining late catches up from the batches alone.
+    {
+        Database c;
+        CHECK(c.Initialize(dir + "/c.db"));
+        CHECK(Exchange(c, backend));
+    }
+    CHECK(Dump(dir + "/c.db") == dumpA);
+
+    // After exchanging, the journals are empty again.
+    CHECK(QueryInt(dir + "/a.db", "SELECT COUNT(*) FROM change_log") == 0);
+    RemoveDir(dir);
+}
+
+} // namespace
+
+TEST(SyncJournalKeepsOneEntryPerRow) {
+    std::string dir = TempDir();
+    std::string path = dir + "/a.db";
+    {
+        Database db;
+        CHECK(db.Initialize(path));
+        Note note;
+        note.title = "often edited";
+        CHECK(db.CreateNote(note));
+        for (int i = 0; i < 200; ++i) {
+            note.content = "edit " + std::to_string(i);
+            CHECK(db.UpdateNote(note));
+            db.TogglePin(note.id, i % 2 != 0);
+        }
+        for (int i = 0; i < 50; ++i) {
+            db.AddUserDictionaryWord("word");
+        }
+    }
+    // Never synced: the log holds each row's latest op, not its history.
+    long long entries = QueryInt(path, "SELECT COUNT(*) FROM change_log");
+    long long rows = QueryInt(path, "SELECT COUNT(*) FROM sync_rows");
+    CHECK(entries > 0 && entries <= rows);
+    CHECK(QueryInt(path, "SELECT COUNT(*) FROM change_log WHERE tbl = 'notes'") == 1);
+
+    // The latest op is the one kept.
+    Database db;
+    CHECK(db.Initialize(path));
+    std::vector<SyncOp> ops;
+    long long lastSeq = 0;
+    CHECK(db.GetPendingSyncOps(0, ops, lastSeq));
+    bool found = false;
+    for (const SyncOp& op : ops) {
+        if (op.table == "notes") {
+            found = op.payload.find("edit 199") != std::string::npos;
+        }
+    }
+    CHECK(found);
+    db.Close();
+    RemoveDir(dir);
+}
+
+TEST(SyncJournalCompactsOlderLogs) {
+    // A log written by triggers that appended every change is cut down to one entry per row on open.
+    std::string dir = TempDir();
+    std::string path = dir + "/a.db";
+    {
+        Database db;
+        CHECK(db.Initialize(path));
+        Note note;
+        note.title = "n";
+        CHECK(db.CreateNote(note));
+    }
+    sqlite3* raw = nullptr;
+    CHECK(sqlite3_open(path.c_str(), &raw) == SQLITE_OK);
+    CHECK(sqlite3_exec(raw, "INSERT INTO change_log (tbl, gid, hlc, origin, deleted, payload) "
+                            "SELECT tbl, gid, hlc, origin, deleted, payload FROM change_log;"
+                            "INSERT INTO change_log (tbl, gid, hlc, origin, deleted, payload) "
+                            "SELECT tbl, gid, hlc, origin, deleted, payload FROM change_log;",
+                       nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(raw);
+    long long before = QueryInt(path, "SELECT COUNT(*) FROM change_log");
+    {
+        Database db;
+        CHECK(db.Initialize(path));
+    }
+    CHECK(QueryInt(path, "SELECT COUNT(*) FROM change_log") * 4 == before);
+    RemoveDir(dir);
+}
+
+TEST(SyncTwoReplicasConverge) {
+    MemorySyncBackend backend;
+    TwoReplicasConverge(backend);
+}
+
+TEST(SyncTwoReplicasConvergeThroughFolder) {
+    SyncFolder folder;
+    TwoReplicasConverge(folder.backend);
+}
+
+TEST(SyncTwoReplicasConvergeThroughServer) {
+    SyncServerStore store;
+    CHECK(store.Running());
+    if (store.Running()) {
+        TwoReplicasConverge(*store.backend);
+    }
+}
+
+TEST(SyncSpellLanguageStaysLocal) {
+    // Opening a note caches its detected locale; that is no edit and must not outrank one made
+    // elsewhere that has not been pulled yet.
+    std::string dir = TempDir();
+    MemorySyncBackend backend;
+    Database a;
+    Database b;
+    CHECK(a.Initialize(dir + "/a.db") && b.Initialize(dir + "/b.db"));
+    Note note;
+    note.title = "shared";
+    note.content = "first";
+    CHECK(a.CreateNote(note));
+    CHECK(Exchange(a, backend) && Exchange(b, backend));
+
+    long long theirsId = SameNoteOn(dir + "/a.db", note.id, dir + "/b.db");
+    CHECK(theirsId != -1);
+    for (Note& theirs : b.GetAllNotes(true)) {
+        if (theirs.id == theirsId) {
+            theirs.content = "edited on b";
+            CHECK(b.UpdateNote(theirs));
+        }
+    }
+    usleep(2000);
+    CHECK(a.SetNoteSpellLanguage(note.id, "en_GB"));
+    CHECK(Exchange(a, backend) && Exchange(b, backend) && Exchange(a, backend));
+
+    for (const Note& mine : a.GetAllNotes(true)) {
+        if (mine.id == note.id) {
+            CHECK(mine.content == "edited on b");
+            CHECK(mine.spell_language == "en_GB");
+        }
+    }
+    for (const Note& theirs : b.GetAllNotes(true)) {
+        if (theirs.id == theirsId) {
+            CHECK(theirs.content == "edited on b");
+            CHECK(theirs.spell_language.empty());
+        }
+    }
+    a.Close();
+    b.Close();
+    RemoveDir(dir);
+}
+
+TEST(SyncMergeTakesOneSidedChanges) {
+    std::string dir = TempDir();
+    Database a;
+    CHECK(a.Initialize(dir + "/a.db"));
+    const char* titles[] = { "kept", "edited there", "deleted there", "edited here", "deleted here" };
+    for (const char* title : titles) {
+        MakeNote(a, title, "base");
+    }
+    CHECK(a.BackupToFile(dir + "/base.db") && CopyReplica(a, dir + "/b.db"));
+    {
+        Database b;
+        CHECK(b.Initialize(dir + "/b.db"));
+        Edit(b, "edited there", "there");
+        CHECK(b.DeleteNote(FindNote(b, "deleted there").id));
+        Note added = MakeNote(b, "added there", "new");
+        Database::Tag tag = { 0, L"from b", 0 };
+        CHECK(b.CreateTag(tag) && b.AddTagToNote(added.id, tag.id));
+        ChecklistItem item;
+        item.note_id = added.id;
+        item.item_text = "step";
+        CHECK(b.CreateChecklistItem(item));
+    }
+    Edit(a, "edited here", "here");
+    CHECK(a.DeleteNote(FindNote(a, "deleted here").id));
+
+    Database::MergeStats stats;
+    CHECK(a.MergeFrom(dir + "/b.db", dir + "/base.db", stats));
+    CHECK(stats.conflicts == 0 && stats.rowsMerged > 0);
+    CHECK(FindNote(a, "kept").content == "base");
+    CHECK(FindNote(a, "edited there").content == "there");
+    CHECK(FindNote(a, "edited here").content == "here");
+    CHECK(FindNote(a, "deleted there").id == -1);
+    CHECK(FindNote(a, "deleted here").id == -1);
+    Note added = FindNote(a, "added there");
+    CHECK(added.content == "new");
+    std::vector<Database::Tag> tags = a.GetNoteTags(added.id);
+    CHECK(tags.size() == 1 && a.GetTags().size() == 1 && tags[0].id == a.GetTags()[0].id);
+    std::vector<ChecklistItem> items = a.GetChecklistItems(added.id);
+    CHECK(items.size() == 1 && items[0].item_text == "step");
+    CHECK(a.GetAllNotes(true).size() == 4);
+    a.Close();
+    RemoveDir(dir);
+}
+
+TEST(SyncMergeCopiesConflictingNote) {
+    // Edited on both sides: this edit stays, the other arrives as a copy with its items, tags and
+    // links, and merging the same download again adds nothing.
+    std::string dir = TempDir();
+    Database a;
+    CHECK(a.Initialize(dir + "/a.db"));
+    Note target = MakeNote(a, "target", "linked to");
+    MakeNote(a, "shared", "base");
+    CHECK(a.BackupToFile(dir + "/base.db") && CopyReplica(a, dir + "/b.db"));
+    {
+        Database b;
+        CHECK(b.Initialize(dir + "/b.db"));
+        Note shared = FindNote(b, "shared");
+        shared.content = "there, see [[target]]";
+        CHECK(b.UpdateNote(shared));
+        ChecklistItem item;
+        item.note_id = shared.id;
+        item.item_text = "from b";
+        CHECK(b.CreateChecklistItem(item));
+        Database::Tag tag = { 0, L"remote", 0 };
+        CHECK(b.CreateTag(tag) && b.AddTagToNote(shared.id, tag.id));
+    }
+    Edit(a, "shared", "here");
+
+    Database::MergeStats stats;
+    CHECK(a.MergeFrom(dir + "/b.db", dir + "/base.db", stats));
+    CHECK(stats.conflicts == 1);
+    CHECK(FindNote(a, "shared").content == "here");
+    Note copy = FindNote(a, "shared (conflict)");
+    CHECK(copy.id != -1 && copy.content == "there, see [[target]]");
+    std::vector<ChecklistItem> items = a.GetChecklistItems(copy.id);
+    CHECK(items.size() == 1 && items[0].item_text == "from b");
+    std::vector<Database::Tag> tags = a.GetNoteTags(copy.id);
+    CHECK(tags.size() == 1 && a.GetTags().size() == 1 && tags[0].id == a.GetTags()[0].id);
+    std::vector<Database::NoteLinkRef> backlinks = a.GetBacklinks(target.id);
+    CHECK(backlinks.size() == 1 && backlinks[0].noteId == copy.id);
+
+    std::string before = Dump(dir + "/a.db");
+    size_t notes = a.GetAllNotes(true).size();
+    CHECK(a.MergeFrom(dir + "/b.db", dir + "/base.db", stats));
+    CHECK(stats.conflicts == 0 && stats.rowsMerged == 0);
+    CHECK(a.GetAllNotes(true).size() == notes);
+    CHECK(Dump(dir + "/a.db") == before);
+    a.Close();
+    RemoveDir(dir);
+}
+
+TEST(SyncConflictCopyOfNoteIsAddedOnce) {
+    // The window keeps a note changed elsewhere, while it had unsaved edits, through the same copy
+    // as the merge: with its items, tags and links, and not twice.
+    std::string dir = TempDir();
+    Database a;
+    CHECK(a.Initialize(dir + "/a.db"));
+    Note target = MakeNote(a, "target", "linked to");
+    Note open = MakeNote(a, "open", "from elsewhere, see [[target]]");
+    ChecklistItem item;
+    item.note_id = open.id;
+    item.item_text = "item";
+    CHECK(a.CreateChecklistItem(item));
+    Database::Tag tag = { 0, L"tag", 0 };
+    CHECK(a.CreateTag(tag) && a.AddTagToNote(open.id, tag.id));
+
+    bool added = false;
+    CHECK(a.AddConflictCopy(open.id, added) && added);
+    Note copy = FindNote(a, "open (conflict)");
+    CHECK(copy.id != -1 && copy.content == open.content);
+    std::vector<ChecklistItem> items = a.GetChecklistItems(copy.id);
+    CHECK(items.size() == 1 && items[0].item_text == "item");
+    std::vector<Database::Tag> tags = a.GetNoteTags(copy.id);
+    CHECK(tags.size() == 1 && tags[0].id == tag.id);
+    CHECK(a.GetBacklinks(target.id).size() == 2);
+
+    size_t notes = a.GetAllNotes(true).size();
+    CHECK(a.AddConflictCopy(open.id, added) && !added);
+    CHECK(a.GetAllNotes(true).size() == notes);
+    a.Close();
+    RemoveDir(dir);
+}
+
+TEST(SyncMergeWithoutBaseTakesLaterChanges) {
+    std::string dir = TempDir();
+    Database a;
+    CHECK(a.Initialize(dir + "/a.db"));
+    MakeNote(a, "one", "base");
+    MakeNote(a, "two", "base");
+    CHECK(CopyReplica(a, dir + "/b.db"));
+    {
+        Database b;
+        CHECK(b.Initialize(dir + "/b.db"));
+        Edit(b, "two", "there");
+        usleep(2000);
+        Edit(b, "one", "there");
+        MakeNote(b, "three", "there");
+    }
+    usleep(2000);
+    Edit(a, "two", "here");
+
+    Database::MergeStats stats;
+    CHECK(a.MergeFrom(dir + "/b.db", "", stats));
+    CHECK(stats.conflicts == 0);
+    CHECK(FindNote(a, "one").content == "there");
+    CHECK(FindNote(a, "two").content == "here");
+    CHECK(FindNote(a, "three").content == "there");
+    CHECK(FindNote(a, "two (conflict)").id == -1);
+    a.Close();
+    RemoveDir(dir);
+}
+
+TEST(SyncMergeRejectsFileWithoutJournal) {
+    std::string dir = TempDir();
+    sqlite3* raw = nullptr;
+    CHECK(sqlite3_open((dir + "/plain.db").c_str(), &raw) == SQLITE_OK);
+    CHECK(sqlite3_exec(raw, "CREATE TABLE notes (id INTEGER PRIMARY KEY, title TEXT, content TEXT);"
+                            "INSERT INTO notes (title, content) VALUES ('stranger', 'x');",
+                       nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(raw);
+
+    Database a;
+    CHECK(a.Initialize(dir + "/a.db"));
+    MakeNote(a, "mine", "kept");
+    std::string before = Dump(dir + "/a.db");
+    Database::MergeStats stats;
+    CHECK(!a.MergeFrom(dir + "/plain.db", "", stats));
+    CHECK(!a.MergeFrom(dir + "/missing.db", "", stats));
+    CHECK(stats.rowsMerged == 0 && stats.conflicts == 0);
+    CHECK(Dump(dir + "/a.db") == before);
+
+    // Still usable afterwards: nothing was left attached.
+    MakeNote(a, "after", "x");
+    CHECK(a.GetAllNotes(true).size() == 2);
+    a.Close();
+    RemoveDir(dir);
+}
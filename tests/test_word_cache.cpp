@@ -0,0 +1,89 @@
+#include "test.h"
+
+#include "dawg_dictionary.h"
+#include "spell_checker.h"
+#include "word_cache.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+TEST(VerdictCacheStoresAndLooksUp) {
+    WordVerdictCache cache(64);
+    bool correct = false;
+    CHECK(!cache.Lookup(L"hello", 5, correct));
+    cache.Store(L"hello", 5, true);
+    cache.Store(L"wrold", 5, false);
+    CHECK(cache.Lookup(L"hello", 5, correct) && correct);
+    CHECK(cache.Lookup(L"wrold", 5, correct) && !correct);
+    // Keys are the exact text: a prefix or another case is a different word.
+    CHECK(!cache.Lookup(L"hell", 4, correct));
+    CHECK(!cache.Lookup(L"Hello", 5, correct));
+}
+
+TEST(VerdictCacheClearDropsEverything) {
+    WordVerdictCache cache(64);
+    cache.Store(L"word", 4, true);
+    cache.Clear();
+    bool correct = false;
+    CHECK(!cache.Lookup(L"word", 4, correct));
+    cache.Store(L"word", 4, false);
+    CHECK(cache.Lookup(L"word", 4, correct) && !correct);
+}
+
+TEST(VerdictCacheSkipsLongWords) {
+    WordVerdictCache cache(64);
+    std::wstring longWord(WordVerdictCache::kMaxWordLength + 1, L'a');
+    cache.Store(longWord.c_str(), longWord.size(), true);
+    bool correct = false;
+    CHECK(!cache.Lookup(longWord.c_str(), longWord.size(), correct));
+}
+
+TEST(VerdictCacheStaysBoundedAndConsistent) {
+    WordVerdictCache cache(256);
+    for (int i = 0; i < 100000; ++i) {
+        std::wstring word = L"w" + std::to_wstring(i);
+        cache.Store(word.c_str(), word.size(), i % 2 == 0);
+    }
+    // Old entries were overwritten; whatever survived still has its own verdict.
+    int hits = 0;
+    for (int i = 0; i < 100000; ++i) {
+        std::wstring word = L"w" + std::to_wstring(i);
+        bool correct = false;
+        if (cache.Lookup(word.c_str(), word.size(), correct)) {
+            ++hits;
+            CHECK(correct == (i % 2 == 0));
+        }
+    }
+    CHECK(hits > 0 && hits <= 256);
+}
+
+TEST(SpellCheckerAnswersFromDictionaryAndCache) {
+    std::vector<unsigned char> image;
+    std::string error;
+    CHECK(DawgDictionary::Build({ "hello", "world" }, image, error));
+    std::string base = "/tmp/notesofast_test_" + std::to_string(getpid());
+    FILE* f = fopen((base + ".dawg").c_str(), "wb");
+    CHECK(f && fwrite(image.data(), 1, image.size(), f) == image.size());
+    if (f) {
+        fclose(f);
+    }
+    SpellChecker checker;
+    std::wstring wideBase(base.begin(), base.end());
+    CHECK(checker.Initialize(wideBase + L".aff", wideBase + L".dic"));
+    remove((base + ".dawg").c_str());
+
+    // The second pass answers from the cache, with the same result.
+    const std::wstring text = L"Hello wrold, HELLO world";
+    for (int pass = 0; pass < 2; ++pass) {
+        std::vector<SpellChecker::Range> misses = checker.FindMisspellings(text);
+        CHECK(misses.size() == 1 && misses[0].start == 6 && misses[0].length == 5);
+    }
+    // User words apply at once, cached verdicts or not.
+    std::shared_ptr<UserDictionary> words = std::make_shared<UserDictionary>();
+    words->Add(L"wrold");
+    checker.SetUserDictionary(words);
+    CHECK(checker.FindMisspellings(text).empty());
+}
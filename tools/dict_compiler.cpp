@@ -0,0 +1,506 @@
+// Offline dictionary compiler: expands a Hunspell .aff/.dic pair (or reads a plain word list)
+// into every accepted word form and writes them as a DawgDictionary file.
+//
+//   dict_compiler en_US.aff en_US.dic en_US.dawg
+//   dict_compiler --wordlist words.txt en_US.dawg
+//
+// The expansion covers plain prefix/suffix rules and their cross products. Anything it skips
+// (compounds, two-level affixes, KEEPCASE and ONLYINCOMPOUND stems) is still accepted at run time
+// by falling back to Hunspell, so the output only has to be a subset of what Hunspell accepts.
+//
+// Build: cl /EHsc /O2 /Isrc tools\dict_compiler.cpp src\dawg_dictionary.cpp /Febuild\dict_compiler.exe
+//        g++ -std=c++14 -O2 -Isrc tools/dict_compiler.cpp src/dawg_dictionary.cpp -o dict_compiler
+#include "dawg_dictionary.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum class FlagMode { Char, Long, Num, Utf8 };
+
+struct CondElement {
+    bool any = false;       // '.'
+    bool negate = false;    // [^...]
+    std::u32string chars;
+};
+
+struct AffixRule {
+    std::u32string strip;
+    std::u32string add;
+    std::vector<CondElement> condition;
+};
+
+struct AffixClass {
+    bool prefix = false;
+    bool crossProduct = false;
+    std::vector<AffixRule> rules;
+};
+
+struct AffixData {
+    bool utf8 = true;
+    FlagMode flagMode = FlagMode::Char;
+    std::map<std::string, AffixClass> classes;
+    std::string needAffix;
+    std::string onlyInCompound;
+    std::string forbiddenWord;
+    std::string keepCase;
+    std::string circumfix;
+};
+
+bool ReadFile(const char* path, std::string& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        out.append(buffer, n);
+    }
+    fclose(f);
+    return true;
+}
+
+std::vector<std::string> SplitLines(const std::string& data) {
+    std::vector<std::string> lines;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t end = data.find('\n', pos);
+        if (end == std::string::npos) {
+            end = data.size();
+        }
+        std::string line = data.substr(pos, end - pos);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        lines.push_back(line);
+        pos = end + 1;
+    }
+    return lines;
+}
+
+std::vector<std::string> SplitFields(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t pos = 0;
+    while (pos < line.size()) {
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) {
+            ++pos;
+        }
+        size_t end = pos;
+        while (end < line.size() && line[end] != ' ' && line[end] != '\t') {
+            ++end;
+        }
+        if (end > pos) {
+            fields.push_back(line.substr(pos, end - pos));
+        }
+        pos = end;
+    }
+    return fields;
+}
+
+std::u32string Decode(const std::string& s, bool utf8) {
+    std::u32string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = (unsigned char)s[i];
+        if (!utf8 || c < 0x80) {
+            out.push_back(c);   // ISO8859-1 maps straight to code points
+            continue;
+        }
+        int extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+        char32_t cp = c & (0x3F >> extra);
+        for (int k = 0; k < extra && i + 1 < s.size(); ++k) {
+            cp = (cp << 6) | ((unsigned char)s[++i] & 0x3F);
+        }
+        out.push_back(cp);
+    }
+    return out;
+}
+
+std::string EncodeUtf8(const std::u32string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char32_t c : s) {
+        if (c < 0x80) {
+            out.push_back((char)c);
+        } else if (c < 0x800) {
+            out.push_back((char)(0xC0 | (c >> 6)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            out.push_back((char)(0xE0 | (c >> 12)));
+            out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        } else {
+            out.push_back((char)(0xF0 | (c >> 18)));
+            out.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+            out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back((char)(0x80 | (c & 0x3F)));
+        }
+    }
+    return out;
+}
+
+std::vector<std::string> ParseFlags(const std::string& s, const AffixData& aff) {
+    std::vector<std::string> flags;
+    switch (aff.flagMode) {
+    case FlagMode::Long:
+        for (size_t i = 0; i + 1 < s.size(); i += 2) {
+            flags.push_back(s.substr(i, 2));
+        }
+        break;
+    case FlagMode::Num: {
+        size_t pos = 0;
+        while (pos < s.size()) {
+            size_t end = s.find(',', pos);
+            if (end == std::string::npos) {
+                end = s.size();
+            }
+            if (end > pos) {
+                flags.push_back(s.substr(pos, end - pos));
+            }
+            pos = end + 1;
+        }
+        break;
+    }
+    case FlagMode::Utf8:
+        for (char32_t c : Decode(s, true)) {
+            flags.push_back(EncodeUtf8(std::u32string(1, c)));
+        }
+        break;
+    default:
+        for (char c : s) {
+            flags.push_back(std::string(1, c));
+        }
+        break;
+    }
+    return flags;
+}
+
+bool HasFlag(const std::vector<std::string>& flags, const std::string& flag) {
+    if (flag.empty()) {
+        return false;
+    }
+    for (const auto& f : flags) {
+        if (f == flag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<CondElement> ParseCondition(const std::u32string& s) {
+    std::vector<CondElement> cond;
+    if (s == U".") {
+        return cond;
+    }
+    for (size_t i = 0; i < s.size(); ++i) {
+        CondElement e;
+        if (s[i] == U'.') {
+            e.any = true;
+        } else if (s[i] == U'[') {
+            ++i;
+            if (i < s.size() && s[i] == U'^') {
+                e.negate = true;
+                ++i;
+            }
+            while (i < s.size() && s[i] != U']') {
+                e.chars.push_back(s[i++]);
+            }
+        } else {
+            e.chars.push_back(s[i]);
+        }
+        cond.push_back(e);
+    }
+    return cond;
+}
+
+bool ElementMatches(const CondElement& e, char32_t c) {
+    if (e.any) {
+        return true;
+    }
+    bool found = e.chars.find(c) != std::u32string::npos;
+    return e.negate ? !found : found;
+}
+
+bool ParseAff(const std::string& data, AffixData& aff, std::string& error) {
+    std::vector<std::string> lines = SplitLines(data);
+
+    // SET and FLAG change how everything else is read, so look for them first.
+    for (const std::string& line : lines) {
+        std::vector<std::string> f = SplitFields(line);
+        if (f.size() >= 2 && f[0] == "SET") {
+            if (f[1] == "UTF-8") {
+                aff.utf8 = true;
+            } else if (f[1] == "ISO8859-1") {
+                aff.utf8 = false;
+            } else {
+                error = "Unsupported dictionary encoding " + f[1];
+                return false;
+            }
+        } else if (f.size() >= 2 && f[0] == "FLAG") {
+            aff.flagMode = (f[1] == "long") ? FlagMode::Long : (f[1] == "num") ? FlagMode::Num :
+                           (f[1] == "UTF-8") ? FlagMode::Utf8 : FlagMode::Char;
+        }
+    }
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::vector<std::string> f = SplitFields(lines[i]);
+        if (f.size() < 2) {
+            continue;
+        }
+        if (f[0] == "NEEDAFFIX" || f[0] == "PSEUDOROOT") {
+            aff.needAffix = f[1];
+        } else if (f[0] == "ONLYINCOMPOUND") {
+            aff.onlyInCompound = f[1];
+        } else if (f[0] == "FORBIDDENWORD") {
+            aff.forbiddenWord = f[1];
+        } else if (f[0] == "KEEPCASE") {
+            aff.keepCase = f[1];
+        } else if (f[0] == "CIRCUMFIX") {
+            aff.circumfix = f[1];
+        } else if ((f[0] == "PFX" || f[0] == "SFX") && f.size() >= 4 && aff.classes.find(f[1]) == aff.classes.end()) {
+            // Header: PFX flag cross_product count, then count rule lines.
+            AffixClass cls;
+            cls.prefix = (f[0] == "PFX");
+            cls.crossProduct = (f[2] == "Y");
+            int count = atoi(f[3].c_str());
+            for (int k = 0; k < count && i + 1 < lines.size(); ++k) {
+                std::vector<std::string> r = SplitFields(lines[++i]);
+                if (r.size() < 4 || r[0] != f[0] || r[1] != f[1]) {
+                    continue;
+                }
+                std::string add = r[3];
+                std::string cont;
+                size_t slash = add.find('/');
+                if (slash != std::string::npos) {
+                    cont = add.substr(slash + 1);
+                    add = add.substr(0, slash);
+                }
+                // Affixes that need another affix on top are two-level; leave those to Hunspell.
+                std::vector<std::string> contFlags = ParseFlags(cont, aff);
+                if (HasFlag(contFlags, aff.needAffix) || HasFlag(contFlags, aff.circumfix)) {
+                    continue;
+                }
+                AffixRule rule;
+                rule.strip = (r[2] == "0") ? std::u32string() : Decode(r[2], aff.utf8);
+                rule.add = (add == "0") ? std::u32string() : Decode(add, aff.utf8);
+                rule.condition = ParseCondition(r.size() >= 5 ? Decode(r[4], aff.utf8) : std::u32string(U"."));
+                cls.rules.push_back(rule);
+            }
+            aff.classes[f[1]] = cls;
+        }
+    }
+    return true;
+}
+
+bool ApplySuffix(const std::u32string& word, const AffixRule& rule, std::u32string& out) {
+    const auto& cond = rule.condition;
+    if (word.size() < rule.strip.size() || word.size() < cond.size()) {
+        return false;
+    }
+    if (word.compare(word.size() - rule.strip.size(), rule.strip.size(), rule.strip) != 0) {
+        return false;
+    }
+    for (size_t k = 0; k < cond.size(); ++k) {
+        if (!ElementMatches(cond[k], word[word.size() - cond.size() + k])) {
+            return false;
+        }
+    }
+    out = word.substr(0, word.size() - rule.strip.size()) + rule.add;
+    return !out.empty();
+}
+
+bool ApplyPrefix(const std::u32string& word, const AffixRule& rule, std::u32string& out) {
+    const auto& cond = rule.condition;
+    if (word.size() < rule.strip.size() || word.size() < cond.size()) {
+        return false;
+    }
+    if (word.compare(0, rule.strip.size(), rule.strip) != 0) {
+        return false;
+    }
+    for (size_t k = 0; k < cond.size(); ++k) {
+        if (!ElementMatches(cond[k], word[k])) {
+            return false;
+        }
+    }
+    out = rule.add + word.substr(rule.strip.size());
+    return !out.empty();
+}
+
+// Expands one .dic entry into its accepted forms.
+void ExpandStem(const std::u32string& stem, const std::vector<std::string>& flags, const AffixData& aff,
+                std::vector<std::string>& words) {
+    if (!HasFlag(flags, aff.needAffix)) {
+        words.push_back(EncodeUtf8(stem));
+    }
+
+    std::vector<std::u32string> crossSuffixed;
+    std::u32string form;
+    for (const std::string& flag : flags) {
+        auto it = aff.classes.find(flag);
+        if (it == aff.classes.end() || it->second.prefix) {
+            continue;
+        }
+        for (const AffixRule& rule : it->second.rules) {
+            if (ApplySuffix(stem, rule, form)) {
+                words.push_back(EncodeUtf8(form));
+                if (it->second.crossProduct) {
+                    crossSuffixed.push_back(form);
+                }
+            }
+        }
+    }
+
+    for (const std::string& flag : flags) {
+        auto it = aff.classes.find(flag);
+        if (it == aff.classes.end() || !it->second.prefix) {
+            continue;
+        }
+        for (const AffixRule& rule : it->second.rules) {
+            if (ApplyPrefix(stem, rule, form)) {
+                words.push_back(EncodeUtf8(form));
+            }
+            if (!it->second.crossProduct) {
+                continue;
+            }
+            for (const std::u32string& suffixed : crossSuffixed) {
+                if (ApplyPrefix(suffixed, rule, form)) {
+                    words.push_back(EncodeUtf8(form));
+                }
+            }
+        }
+    }
+}
+
+bool ExpandDictionary(const char* affPath, const char* dicPath, std::vector<std::string>& words, std::string& error) {
+    std::string affData;
+    std::string dicData;
+    if (!ReadFile(affPath, affData)) {
+        error = std::string("Cannot read ") + affPath;
+        return false;
+    }
+    if (!ReadFile(dicPath, dicData)) {
+        error = std::string("Cannot read ") + dicPath;
+        return false;
+    }
+
+    AffixData aff;
+    if (!ParseAff(affData, aff, error)) {
+        return false;
+    }
+
+    std::set<std::string> forbidden;
+    std::vector<std::string> lines = SplitLines(dicData);
+    for (size_t i = 1; i < lines.size(); ++i) {   // Line 0 is the approximate entry count
+        const std::string& line = lines[i];
+        if (line.empty() || line[0] == '\t' || line[0] == '#') {
+            continue;
+        }
+        // word[/flags][ morphological fields]; "\/" is a literal slash in the word.
+        std::string word;
+        std::string flagText;
+        size_t pos = 0;
+        while (pos < line.size() && line[pos] != '/' && line[pos] != '\t' && line[pos] != ' ') {
+            if (line[pos] == '\\' && pos + 1 < line.size() && line[pos + 1] == '/') {
+                ++pos;
+            }
+            word.push_back(line[pos++]);
+        }
+        if (pos < line.size() && line[pos] == '/') {
+            size_t end = ++pos;
+            while (end < line.size() && line[end] != '\t' && line[end] != ' ') {
+                ++end;
+            }
+            flagText = line.substr(pos, end - pos);
+        }
+        if (word.empty()) {
+            continue;
+        }
+
+        std::vector<std::string> flags = ParseFlags(flagText, aff);
+        std::u32string stem = Decode(word, aff.utf8);
+        if (HasFlag(flags, aff.forbiddenWord)) {
+            forbidden.insert(EncodeUtf8(stem));
+            continue;
+        }
+        // Case-sensitive or compound-only stems would be accepted wrongly by the case fallback
+        // or on their own; Hunspell handles them.
+        if (HasFlag(flags, aff.keepCase) || HasFlag(flags, aff.onlyInCompound)) {
+            continue;
+        }
+        ExpandStem(stem, flags, aff, words);
+    }
+
+    if (!forbidden.empty()) {
+        std::vector<std::string> kept;
+        kept.reserve(words.size());
+        for (auto& w : words) {
+            if (forbidden.find(w) == forbidden.end()) {
+                kept.push_back(std::move(w));
+            }
+        }
+        words.swap(kept);
+    }
+    return true;
+}
+
+bool ReadWordList(const char* path, std::vector<std::string>& words, std::string& error) {
+    std::string data;
+    if (!ReadFile(path, data)) {
+        error = std::string("Cannot read ") + path;
+        return false;
+    }
+    for (std::string& line : SplitLines(data)) {
+        if (!line.empty()) {
+            words.push_back(std::move(line));
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> words;
+    std::string error;
+    const char* outPath = nullptr;
+    bool ok = false;
+
+    if (argc == 4 && strcmp(argv[1], "--wordlist") != 0) {
+        ok = ExpandDictionary(argv[1], argv[2], words, error);
+        outPath = argv[3];
+    } else if (argc == 4) {
+        ok = ReadWordList(argv[2], words, error);
+        outPath = argv[3];
+    } else {
+        fprintf(stderr, "Usage: dict_compiler <file.aff> <file.dic> <out.dawg>\n"
+                        "       dict_compiler --wordlist <words.txt> <out.dawg>\n");
+        return 2;
+    }
+
+    std::vector<unsigned char> image;
+    if (ok) {
+        ok = DawgDictionary::Build(std::move(words), image, error);
+    }
+    if (!ok) {
+        fprintf(stderr, "dict_compiler: %s\n", error.c_str());
+        return 1;
+    }
+
+    FILE* f = fopen(outPath, "wb");
+    if (!f || fwrite(image.data(), 1, image.size(), f) != image.size()) {
+        fprintf(stderr, "dict_compiler: cannot write %s\n", outPath);
+        if (f) fclose(f);
+        return 1;
+    }
+    fclose(f);
+
+    uint32_t wordCount = (uint32_t)image[16] | ((uint32_t)image[17] << 8) | ((uint32_t)image[18] << 16) | ((uint32_t)image[19] << 24);
+    printf("Wrote %s: %u words, %u bytes\n", outPath, wordCount, (unsigned)image.size());
+    return 0;
+}
@@ -0,0 +1,477 @@
+// Stand-in sync server: a tiny in-memory HTTP object store speaking the protocol of
+// HttpSyncBackend (src/http_sync_backend.h), so sync can be exercised and timed without Google
+// Drive, on Windows or Linux. Point the app at it with the setting
+// cloud_sync_backend = http://127.0.0.1:8787
+//
+//   sync_server [--port 8787] [--delay-ms 0]
+//
+// --port 0 takes any free port; the one taken is printed on the first line ("Listening on ...").
+// Each base path (whatever precedes /o/ or /u/) is a separate store. Uploads larger than a chunk
+// go through resumable upload sessions under /u/ (see src/resumable_upload.h). --delay-ms holds every response
+// back to mimic a slow link. GET /stats reports the requests, connections and bytes seen so far.
+// Objects live until they are deleted or the server exits.
+//
+// Build: cl /EHsc /O2 tools\sync_server.cpp /Febuild\sync_server.exe
+//        g++ -std=c++14 -O2 -pthread tools/sync_server.cpp -o sync_server
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET Socket;
+typedef int socklen_t;
+#define CloseSocket closesocket
+const int kSendFlags = 0;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int Socket;
+const Socket INVALID_SOCKET = -1;
+#define CloseSocket close
+const int kSendFlags = MSG_NOSIGNAL;   // A client hanging up is not fatal
+#endif
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+struct Object {
+    std::string content;
+    unsigned long long version = 0;
+    unsigned long long modifiedTime = 0;   // FILETIME ticks, UTC
+};
+
+// A resumable upload. Finished sessions stay, so a client that lost the final response can ask.
+struct Upload {
+    std::string key;           // Of the object being written
+    std::string ifMatch;
+    std::string ifNoneMatch;
+    unsigned long long total = 0;
+    std::string received;
+    bool done = false;
+    Object result;             // Once done: the version written (no content)
+};
+
+std::mutex g_lock;
+std::map<std::string, Object> g_objects;
+std::map<unsigned long long, Upload> g_uploads;
+unsigned long long g_nextVersion = 1;
+unsigned long long g_nextUpload = 1;
+std::atomic<unsigned long long> g_requests(0);
+std::atomic<unsigned long long> g_connections(0);
+std::atomic<unsigned long long> g_bytesIn(0);
+std::atomic<unsigned long long> g_bytesOut(0);
+int g_delayMs = 0;
+
+unsigned long long NowFileTime() {
+    const unsigned long long kUnixEpoch = 116444736000000000ull;
+    auto since = std::chrono::system_clock::now().time_since_epoch();
+    return kUnixEpoch + (unsigned long long)std::chrono::duration_cast<std::chrono::microseconds>(since).count() * 10;
+}
+
+std::string PercentEncode(const std::string& s) {
+    static const char* hex = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : s) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out.push_back((char)c);
+        } else {
+            out.push_back('%');
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 15]);
+        }
+    }
+    return out;
+}
+
+std::string PercentDecode(const std::string& s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '%' && i + 2 < s.size() && std::isxdigit((unsigned char)s[i + 1]) &&
+            std::isxdigit((unsigned char)s[i + 2])) {
+            out.push_back((char)std::strtol(s.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        } else {
+            out.push_back(s[i]);
+        }
+    }
+    return out;
+}
+
+struct Request {
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> headers;   // Names lower-cased
+    std::string body;
+};
+
+struct Response {
+    int status = 200;
+    std::string reason = "OK";
+    std::string headers;
+    std::string body;
+    size_t contentLength = 0;   // Differs from body.size() only for HEAD
+};
+
+std::string Header(const Request& request, const char* name) {
+    auto it = request.headers.find(name);
+    return it == request.headers.end() ? std::string() : it->second;
+}
+
+void SetStatus(Response& response, int status, const char* reason) {
+    response.status = status;
+    response.reason = reason;
+}
+
+void DescribeObject(const Object& object, Response& response) {
+    response.headers += "ETag: \"" + std::to_string(object.version) + "\"\r\n";
+    response.headers += "X-Modified-Time: " + std::to_string(object.modifiedTime) + "\r\n";
+}
+
+// Whether a write of key may go ahead under If-Match / If-None-Match. Call with g_lock held.
+bool ConditionHolds(const std::string& key, const std::string& ifMatch, const std::string& ifNoneMatch) {
+    auto it = g_objects.find(key);
+    bool exists = it != g_objects.end();
+    return !(ifNoneMatch == "*" && exists) &&
+        (ifMatch.empty() || (exists && ifMatch == "\"" + std::to_string(it->second.version) + "\""));
+}
+
+// Stores content under key. Call with g_lock held.
+Object& Write(const std::string& key, std::string content) {
+    Object& object = g_objects[key];
+    object.content = std::move(content);
+    object.version = g_nextVersion++;
+    object.modifiedTime = NowFileTime();
+    return object;
+}
+
+void HandleObject(const Request& request, const std::string& name, Response& response) {
+    std::lock_guard<std::mutex> hold(g_lock);
+    auto it = g_objects.find(name);
+
+    if (request.method == "GET" || request.method == "HEAD") {
+        if (it == g_objects.end()) {
+            SetStatus(response, 404, "Not Found");
+            return;
+        }
+        DescribeObject(it->second, response);
+        response.contentLength = it->second.content.size();
+        if (request.method == "GET") {
+            response.body = it->second.content;
+        }
+        return;
+    }
+
+    if (request.method == "DELETE") {
+        if (it == g_objects.end()) {
+            SetStatus(response, 404, "Not Found");
+            return;
+        }
+        g_objects.erase(it);
+        return;
+    }
+
+    if (request.method != "PUT") {
+        SetStatus(response, 405, "Method Not Allowed");
+        return;
+    }
+    if (!ConditionHolds(name, Header(request, "if-match"), Header(request, "if-none-match"))) {
+        SetStatus(response, 412, "Precondition Failed");
+        return;
+    }
+    bool exists = it != g_objects.end();
+    Object& object = Write(name, request.body);
+    if (!exists) {
+        SetStatus(response, 201, "Created");
+    }
+    DescribeObject(object, response);
+}
+
+// POST <base>/u/<name> starts a session; PUT <base>/u/<name>?upload_id=<n> sends to it.
+void HandleUpload(const Request& request, const std::string& base, const std::string& encodedName,
+                  const std::string& query, Response& response) {
+    std::string key = base + "/o/" + PercentDecode(encodedName);
+    std::lock_guard<std::mutex> hold(g_lock);
+
+    if (request.method == "POST") {
+        Upload upload;
+        upload.key = key;
+        upload.ifMatch = Header(request, "if-match");
+        upload.ifNoneMatch = Header(request, "if-none-match");
+        upload.total = std::strtoull(Header(request, "x-upload-content-length").c_str(), nullptr, 10);
+        if (!ConditionHolds(key, upload.ifMatch, upload.ifNoneMatch)) {
+            SetStatus(response, 412, "Precondition Failed");
+            return;
+        }
+        unsigned long long id = g_nextUpload++;
+        g_uploads[id] = std::move(upload);
+        response.headers += "Location: " + base + "/u/" + encodedName + "?upload_id=" + std::to_string(id) + "\r\n";
+        return;
+    }
+    if (request.method != "PUT") {
+        SetStatus(response, 405, "Method Not Allowed");
+        return;
+    }
+
+    size_t at = query.find("upload_id=");
+    auto it = g_uploads.find(at == std::string::npos ? 0 : std::strtoull(query.c_str() + at + 10, nullptr, 10));
+    if (it == g_uploads.end() || it->second.key != key) {
+        SetStatus(response, 404, "Not Found");
+        return;
+    }
+    Upload& upload = it->second;
+    if (upload.done) {
+        DescribeObject(upload.result, response);
+        return;
+    }
+
+    // "bytes <first>-<last>/<total>" carries data, "bytes */<total>" asks how much arrived.
+    std::string range = Header(request, "content-range");
+    if (range.compare(0, 6, "bytes ") == 0 && range[6] != '*') {
+        unsigned long long first = std::strtoull(range.c_str() + 6, nullptr, 10);
+        if (first <= upload.received.size()) {
+            upload.received.resize((size_t)first);
+            upload.received += request.body;
+        }
+    }
+    if (upload.received.size() > upload.total) {
+        g_uploads.erase(it);
+        SetStatus(response, 400, "Bad Request");
+        return;
+    }
+    if (upload.received.size() < upload.total) {
+        SetStatus(response, 308, "Resume Incomplete");
+        if (!upload.received.empty()) {
+            response.headers += "Range: bytes=0-" + std::to_string(upload.received.size() - 1) + "\r\n";
+        }
+        return;
+    }
+
+    if (!ConditionHolds(key, upload.ifMatch, upload.ifNoneMatch)) {
+        g_uploads.erase(it);
+        SetStatus(response, 412, "Precondition Failed");
+        return;
+    }
+    bool exists = g_objects.count(key) != 0;
+    const Object& written = Write(key, std::move(upload.received));
+    upload.result.version = written.version;
+    upload.result.modifiedTime = written.modifiedTime;
+    upload.received = std::string();
+    upload.done = true;
+    if (!exists) {
+        SetStatus(response, 201, "Created");
+    }
+    DescribeObject(upload.result, response);
+}
+
+void HandleList(const std::string& space, const std::string& query, Response& response) {
+    std::string prefix;
+    size_t at = query.find("prefix=");
+    if (at != std::string::npos) {
+        prefix = PercentDecode(query.substr(at + 7, query.find('&', at) - (at + 7)));
+    }
+    std::string key = space + prefix;
+    std::lock_guard<std::mutex> hold(g_lock);
+    for (auto it = g_objects.lower_bound(key); it != g_objects.end(); ++it) {
+        if (it->first.compare(0, key.size(), key) != 0) {
+            break;
+        }
+        response.body += PercentEncode(it->first.substr(space.size())) + " " + std::to_string(it->second.version) + " " +
+            std::to_string(it->second.content.size()) + " " + std::to_string(it->second.modifiedTime) + "\n";
+    }
+    response.contentLength = response.body.size();
+}
+
+void Handle(const Request& request, Response& response) {
+    std::string path = request.path;
+    std::string query;
+    size_t question = path.find('?');
+    if (question != std::string::npos) {
+        query = path.substr(question + 1);
+        path.resize(question);
+    }
+
+    if (path == "/stats" && request.method == "GET") {
+        std::ostringstream stats;
+        stats << "requests " << g_requests.load() << "\nconnections " << g_connections.load()
+              << "\nbytes_in " << g_bytesIn.load() << "\nbytes_out " << g_bytesOut.load() << "\n";
+        response.body = stats.str();
+        response.contentLength = response.body.size();
+        return;
+    }
+
+    size_t uploads = path.rfind("/u/");
+    if (uploads != std::string::npos && path.find('/', uploads + 3) == std::string::npos) {
+        HandleUpload(request, path.substr(0, uploads), path.substr(uploads + 3), query, response);
+        return;
+    }
+
+    // Objects are kept under "<base path>/o/<name>"; a name never contains an unencoded '/'.
+    size_t objects = path.rfind("/o/");
+    if (objects == std::string::npos) {
+        SetStatus(response, 404, "Not Found");
+        return;
+    }
+    std::string space = path.substr(0, objects + 3);
+    std::string name = PercentDecode(path.substr(objects + 3));
+    if (name.empty()) {
+        if (request.method != "GET") {
+            SetStatus(response, 405, "Method Not Allowed");
+            return;
+        }
+        response.headers += "Content-Type: text/plain\r\n";
+        HandleList(space, query, response);
+        return;
+    }
+    HandleObject(request, space + name, response);
+}
+
+bool SendAll(Socket s, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int n = send(s, data.data() + sent, (int)(data.size() - sent), kSendFlags);
+        if (n <= 0) {
+            return false;
+        }
+        sent += (size_t)n;
+    }
+    g_bytesOut += data.size();
+    return true;
+}
+
+// Reads one request, keeping whatever follows it in pending. False when the client is done.
+bool ReadRequest(Socket s, std::string& pending, Request& request) {
+    char buf[65536];
+    size_t headerEnd;
+    while ((headerEnd = pending.find("\r\n\r\n")) == std::string::npos) {
+        int n = recv(s, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return false;
+        }
+        g_bytesIn += (unsigned long long)n;
+        pending.append(buf, (size_t)n);
+    }
+
+    std::istringstream head(pending.substr(0, headerEnd));
+    std::string line;
+    std::getline(head, line);
+    std::istringstream requestLine(line);
+    requestLine >> request.method >> request.path;
+    request.headers.clear();
+    while (std::getline(head, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = line.substr(0, colon);
+        for (char& c : name) c = (char)std::tolower((unsigned char)c);
+        size_t value = line.find_first_not_of(' ', colon + 1);
+        request.headers[name] = value == std::string::npos ? std::string() : line.substr(value);
+    }
+
+    size_t length = (size_t)std::strtoull(Header(request, "content-length").c_str(), nullptr, 10);
+    pending.erase(0, headerEnd + 4);
+    while (pending.size() < length) {
+        int n = recv(s, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return false;
+        }
+        g_bytesIn += (unsigned long long)n;
+        pending.append(buf, (size_t)n);
+    }
+    request.body = pending.substr(0, length);
+    pending.erase(0, length);
+    return !request.method.empty();
+}
+
+void Serve(Socket client) {
+    ++g_connections;
+    int noDelay = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+    std::string pending;
+    Request request;
+    while (ReadRequest(client, pending, request)) {
+        ++g_requests;
+        Response response;
+        Handle(request, response);
+        if (g_delayMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(g_delayMs));
+        }
+        bool close = Header(request, "connection") == "close";
+        std::string out = "HTTP/1.1 " + std::to_string(response.status) + " " + response.reason + "\r\n";
+        out += response.headers;
+        out += "Content-Length: " + std::to_string(response.contentLength) + "\r\n";
+        out += close ? "Connection: close\r\n\r\n" : "\r\n";
+        out += response.body;
+        if (!SendAll(client, out) || close) {
+            break;
+        }
+    }
+    CloseSocket(client);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int port = 8787;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--port") == 0) {
+            port = std::atoi(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--delay-ms") == 0) {
+            g_delayMs = std::atoi(argv[i + 1]);
+        } else {
+            std::fprintf(stderr, "usage: sync_server [--port 8787] [--delay-ms 0]\n");
+            return 2;
+        }
+    }
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        std::fprintf(stderr, "WSAStartup failed\n");
+        return 1;
+    }
+#endif
+
+    Socket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET) {
+        std::fprintf(stderr, "socket failed\n");
+        return 1;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 16) != 0) {
+        std::fprintf(stderr, "Cannot listen on 127.0.0.1:%d\n", port);
+        CloseSocket(listener);
+        return 1;
+    }
+    socklen_t addrLength = sizeof(addr);
+    if (getsockname(listener, (sockaddr*)&addr, &addrLength) == 0) {
+        port = ntohs(addr.sin_port);
+    }
+    std::printf("Listening on http://127.0.0.1:%d\n", port);
+    std::fflush(stdout);
+
+    for (;;) {
+        Socket client = accept(listener, nullptr, nullptr);
+        if (client == INVALID_SOCKET) {
+            continue;
+        }
+        std::thread(Serve, client).detach();
+    }
+}